@@ -0,0 +1,183 @@
+// This source file is part of the 'tau' open source project.
+// Copyright (c) 2016, Yuriy Vosel.
+// Licensed under Boost Software License.
+// See LICENSE.txt for the licence information.
+
+// Builds the same layout of the given size (5000 elements by default: pages of 10 rows, 10 elements
+// each) with the library's builder (LayoutInfo) and with the ArenaLayoutBuilder, and reports the heap
+// allocations and the time of the build + getJson(). The arena builder is measured with the new arena
+// and with the reused one (reset() between the builds); the arena blocks are counted as the allocations
+// too. The ids and the notes are prepared beforehand, as the constants of the real application would be.
+// Checks that both JSON texts are the same.
+// Usage: benchmark_gcc_cpp11 [elements] [repetitions]
+
+#include <tau/layout_generation/layout_info.h>
+#include <tau_additional/layout_generation/arena_layout_builder.h>
+#include <tau_additional/util/monotonic_arena.h>
+#include <tau_additional/util/monotonic_clock.h>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <vector>
+#include <stdlib.h>
+
+namespace {
+    uint64_t g_allocationsCount = 0;
+};
+
+void * operator new(size_t size) {
+    ++g_allocationsCount;
+    void * result = malloc(size > 0 ? size : 1);
+    if (result == NULL) {
+        throw std::bad_alloc();
+    }
+    return result;
+}
+void operator delete(void * pointer) noexcept {
+    free(pointer);
+}
+void operator delete(void * pointer, size_t) noexcept {
+    free(pointer);
+}
+
+namespace {
+    static const size_t ELEMENTS_PER_ROW = 10;
+    static const size_t ROWS_PER_PAGE = 10;
+
+    std::string getElementName(char const * prefix, size_t index) {
+        std::ostringstream result;
+        result << prefix << index;
+        return result.str();
+    }
+
+    struct LayoutData
+    {
+        std::vector<tau::common::ElementID> elementIDs;
+        std::vector<std::string> notes;
+        std::vector<tau::common::LayoutPageID> pageIDs;
+    };
+
+    void prepareLayoutData(size_t elementsCount, LayoutData & data) {
+        for (size_t i = 0; i < elementsCount; ++i) {
+            data.elementIDs.push_back(tau::common::ElementID(getElementName("ELEMENT_", i)));
+            // Some notes need the escaping
+            data.notes.push_back((i % 97 == 0) ? getElementName("say \"hi\" \\ ", i) : getElementName("Element ", i));
+        }
+        for (size_t i = 0; i * ELEMENTS_PER_ROW * ROWS_PER_PAGE < elementsCount; ++i) {
+            data.pageIDs.push_back(tau::common::LayoutPageID(getElementName("PAGE_", i)));
+        }
+    }
+
+    std::string buildWithLibrary(LayoutData const & data)
+    {
+        using namespace tau::layout_generation;
+        LayoutInfo resultLayout;
+        size_t element = 0;
+        for (size_t page = 0; page < data.pageIDs.size(); ++page) {
+            EvenlySplitLayoutElementsContainer rows(true);
+            for (size_t row = 0; row < ROWS_PER_PAGE && element < data.elementIDs.size(); ++row) {
+                EvenlySplitLayoutElementsContainer columns(false);
+                for (size_t column = 0; column < ELEMENTS_PER_ROW && element < data.elementIDs.size(); ++column, ++element) {
+                    switch (element % 5) {
+                        case 0: columns.push(ButtonLayoutElement().note(data.notes[element]).ID(data.elementIDs[element])
+                            .switchToAnotherLayoutPageOnClick(data.pageIDs[0])); break;
+                        case 1: columns.push(TextInputLayoutElement().ID(data.elementIDs[element]).initialValue(data.notes[element])); break;
+                        case 2: columns.push(BooleanInputLayoutElement(element % 2 == 0).note(data.notes[element]).ID(data.elementIDs[element])); break;
+                        case 3: columns.push(LabelElement(data.notes[element]).ID(data.elementIDs[element])); break;
+                        default: columns.push(EmptySpace()); break;
+                    }
+                }
+                rows.push(columns);
+            }
+            resultLayout.pushLayoutPage(LayoutPage(data.pageIDs[page], rows));
+        }
+        resultLayout.setStartLayoutPage(data.pageIDs[0]);
+        return resultLayout.getJson();
+    }
+
+    std::string buildWithArena(LayoutData const & data, tau_additional::util::MonotonicArena & arena)
+    {
+        typedef tau_additional::layout_generation::ArenaLayoutBuilder ArenaLayoutBuilder;
+        ArenaLayoutBuilder layout(arena);
+        size_t element = 0;
+        for (size_t page = 0; page < data.pageIDs.size(); ++page) {
+            ArenaLayoutBuilder::Element rows = layout.evenlySplit(true);
+            for (size_t row = 0; row < ROWS_PER_PAGE && element < data.elementIDs.size(); ++row) {
+                ArenaLayoutBuilder::Element columns = layout.evenlySplit(false);
+                for (size_t column = 0; column < ELEMENTS_PER_ROW && element < data.elementIDs.size(); ++column, ++element) {
+                    switch (element % 5) {
+                        case 0: columns.push(layout.button().note(data.notes[element]).ID(data.elementIDs[element])
+                            .switchToAnotherLayoutPageOnClick(data.pageIDs[0])); break;
+                        case 1: columns.push(layout.textInput().ID(data.elementIDs[element]).initialValue(data.notes[element])); break;
+                        case 2: columns.push(layout.booleanInput(element % 2 == 0).note(data.notes[element]).ID(data.elementIDs[element])); break;
+                        case 3: columns.push(layout.label(data.notes[element]).ID(data.elementIDs[element])); break;
+                        default: columns.push(layout.emptySpace()); break;
+                    }
+                }
+                rows.push(columns);
+            }
+            layout.pushLayoutPage(data.pageIDs[page], rows);
+        }
+        layout.setStartLayoutPage(data.pageIDs[0]);
+        return layout.getJson();
+    }
+
+    void report(char const * name, uint64_t allocations, uint64_t nanoseconds, size_t repetitions) {
+        std::cout << name << double(allocations) / repetitions << " allocations, "
+            << double(nanoseconds) / repetitions / 1000 << " us per build + getJson()\n";
+    }
+};
+
+int main(int argc, char ** argv)
+{
+    size_t elementsCount = (argc > 1) ? strtoul(argv[1], NULL, 10) : 5000;
+    size_t repetitions = (argc > 2) ? strtoul(argv[2], NULL, 10) : 20;
+    if (elementsCount == 0 || repetitions == 0) {
+        std::cerr << "Usage: benchmark_gcc_cpp11 [elements] [repetitions]\n";
+        return -1;
+    }
+    LayoutData data;
+    prepareLayoutData(elementsCount, data);
+
+    std::string libraryJson = buildWithLibrary(data);
+    tau_additional::util::MonotonicArena checkArena;
+    bool sameJson = (buildWithArena(data, checkArena) == libraryJson);
+    std::cout << elementsCount << " elements, JSON " << libraryJson.size() << " bytes, the same for both builders: "
+        << (sameJson ? "yes" : "NO") << "\n";
+
+    size_t checksum = 0;
+    uint64_t allocationsBefore = g_allocationsCount;
+    uint64_t start = tau_additional::util::getMonotonicNanoseconds();
+    for (size_t i = 0; i < repetitions; ++i) {
+        checksum += buildWithLibrary(data).size();
+    }
+    report("LayoutInfo:            ", g_allocationsCount - allocationsBefore,
+        tau_additional::util::getMonotonicNanoseconds() - start, repetitions);
+
+    allocationsBefore = g_allocationsCount;
+    start = tau_additional::util::getMonotonicNanoseconds();
+    uint64_t arenaBlocks = 0; // malloc()-ed, not seen by the operator new
+    for (size_t i = 0; i < repetitions; ++i) {
+        tau_additional::util::MonotonicArena arena;
+        checksum += buildWithArena(data, arena).size();
+        arenaBlocks += arena.getStatistics().blocksAllocated;
+    }
+    report("arena, new every time: ", g_allocationsCount - allocationsBefore + arenaBlocks,
+        tau_additional::util::getMonotonicNanoseconds() - start, repetitions);
+
+    tau_additional::util::MonotonicArena reusedArena;
+    buildWithArena(data, reusedArena);
+    allocationsBefore = g_allocationsCount;
+    arenaBlocks = reusedArena.getStatistics().blocksAllocated;
+    start = tau_additional::util::getMonotonicNanoseconds();
+    for (size_t i = 0; i < repetitions; ++i) {
+        reusedArena.reset();
+        checksum += buildWithArena(data, reusedArena).size();
+    }
+    report("arena, reused:         ",
+        g_allocationsCount - allocationsBefore + reusedArena.getStatistics().blocksAllocated - arenaBlocks,
+        tau_additional::util::getMonotonicNanoseconds() - start, repetitions);
+    std::cout << "arena blocks: " << reusedArena.getStatistics().blocksAllocated << ", "
+        << reusedArena.getStatistics().bytesUsed << " bytes used (checksum " << checksum << ")\n";
+    return 0;
+}
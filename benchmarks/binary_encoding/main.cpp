@@ -0,0 +1,193 @@
+// This source file is part of the 'tau' open source project.
+// Copyright (c) 2016, Yuriy Vosel.
+// Licensed under Boost Software License.
+// See LICENSE.txt for the licence information.
+
+// Compares the binary encoding (BinaryLayoutCodec, BinaryPacketSerializer) with the JSON/text path:
+// the size and the encode/decode time of the sample02-extendedDemo layout and of a synthetic
+// 1000-element layout, and the size and the serialization time of the small update packets.
+// The layout is encoded from the document model and decoded into it, the same work for both paths.
+// Usage: benchmark_gcc_cpp11 [repetitions]
+
+#include <tau/layout_generation/layout_info.h>
+#include <tau_additional/communications_handling/binary_encoding.h>
+#include <tau_additional/communications_handling/packet_serializer.h>
+#include <tau_additional/util/json_value.h>
+#include <tau_additional/util/monotonic_clock.h>
+#include <iostream>
+#include <sstream>
+#include <stdlib.h>
+
+namespace {
+    std::string const INITIAL_TEXT_VALUE("initial text");
+
+    // Same layout, as it is built in the sample
+    std::string buildSampleLayoutJson()
+    {
+        using namespace tau::layout_generation;
+        LayoutInfo resultLayout;
+        resultLayout.pushLayoutPage(LayoutPage(tau::common::LayoutPageID("LAYOUT_PAGE_1"),
+            EvenlySplitLayoutElementsContainer(true)
+                .push(EvenlySplitLayoutElementsContainer(false)
+                    .push(BooleanInputLayoutElement(true).note(INITIAL_TEXT_VALUE)
+                        .ID(tau::common::ElementID("BOOL_INPUT")))
+                    .push(ButtonLayoutElement().note(INITIAL_TEXT_VALUE)
+                        .ID(tau::common::ElementID("BUTTON_WITH_NOTE_TO_REPLACE"))))
+                .push(TextInputLayoutElement().ID(tau::common::ElementID("TEXT_INPUT"))
+                    .initialValue(INITIAL_TEXT_VALUE))
+                .push(EmptySpace())
+                .push(EmptySpace())
+                .push(EmptySpace())
+                .push(EvenlySplitLayoutElementsContainer(false)
+                    .push(ButtonLayoutElement().note("reset notes").ID(tau::common::ElementID("BUTTON_TO_RESET_NOTES")))
+                    .push(EmptySpace())
+                    .push(ButtonLayoutElement().note("go to page 2").ID(tau::common::ElementID("BUTTON_TO_PG2"))
+                        .switchToAnotherLayoutPageOnClick(tau::common::LayoutPageID("LAYOUT_PAGE_2"))))
+        ));
+        resultLayout.pushLayoutPage(LayoutPage(tau::common::LayoutPageID("LAYOUT_PAGE_2"),
+            EvenlySplitLayoutElementsContainer(true)
+                .push(EvenlySplitLayoutElementsContainer(false)
+                    .push(ButtonLayoutElement().note("1").ID(tau::common::ElementID("BUTTON_1")))
+                    .push(ButtonLayoutElement().note("2").ID(tau::common::ElementID("BUTTON_2"))))
+                .push(EvenlySplitLayoutElementsContainer(false)
+                    .push(ButtonLayoutElement().note("3").ID(tau::common::ElementID("BUTTON_3")))
+                    .push(ButtonLayoutElement().note("4").ID(tau::common::ElementID("BUTTON_4"))))
+                .push(EvenlySplitLayoutElementsContainer(true)
+                    .push(LabelElement("").ID(tau::common::ElementID("LABEL_ON_PAGE2")))
+                    .push(LabelElement("").ID(tau::common::ElementID("SERVER_UPTIME_LABEL")))
+                    .push(ButtonLayoutElement().note("back to page 1").ID(tau::common::ElementID("BUTTON_TO_PG1"))))
+        ));
+        resultLayout.setStartLayoutPage(tau::common::LayoutPageID("LAYOUT_PAGE_1"));
+        return resultLayout.getJson();
+    }
+
+    std::string getElementName(char const * prefix, size_t index) {
+        std::ostringstream result;
+        result << prefix << index;
+        return result.str();
+    }
+
+    // 10 pages, 10 rows of 10 elements each: buttons, text and boolean inputs, labels, empty spaces
+    std::string buildSyntheticLayoutJson(size_t elementsCount)
+    {
+        using namespace tau::layout_generation;
+        static const size_t ELEMENTS_PER_ROW = 10;
+        static const size_t ROWS_PER_PAGE = 10;
+        LayoutInfo resultLayout;
+        size_t element = 0;
+        for (size_t page = 0; element < elementsCount; ++page) {
+            EvenlySplitLayoutElementsContainer rows(true);
+            for (size_t row = 0; row < ROWS_PER_PAGE && element < elementsCount; ++row) {
+                EvenlySplitLayoutElementsContainer columns(false);
+                for (size_t column = 0; column < ELEMENTS_PER_ROW && element < elementsCount; ++column, ++element) {
+                    tau::common::ElementID id(getElementName("ELEMENT_", element));
+                    switch (element % 5) {
+                        case 0: columns.push(ButtonLayoutElement().note(getElementName("Button ", element)).ID(id)); break;
+                        case 1: columns.push(TextInputLayoutElement().ID(id).initialValue("")); break;
+                        case 2: columns.push(BooleanInputLayoutElement(false).note("enabled").ID(id)); break;
+                        case 3: columns.push(LabelElement(getElementName("Value ", element)).ID(id)); break;
+                        default: columns.push(EmptySpace()); break;
+                    }
+                }
+                rows.push(columns);
+            }
+            resultLayout.pushLayoutPage(LayoutPage(tau::common::LayoutPageID(getElementName("PAGE_", page)), rows));
+        }
+        resultLayout.setStartLayoutPage(tau::common::LayoutPageID("PAGE_0"));
+        return resultLayout.getJson();
+    }
+
+    void runLayoutBenchmark(char const * name, std::string const & layoutJson, size_t repetitions)
+    {
+        using tau_additional::communications_handling::BinaryLayoutCodec;
+        tau_additional::util::JsonValue layout;
+        tau_additional::util::JsonValue::parse(layoutJson, layout);
+        std::string binary;
+        BinaryLayoutCodec::encode(layout, binary);
+        std::string roundTrip;
+        BinaryLayoutCodec::decodeToJson(binary.data(), binary.size(), roundTrip);
+
+        size_t checksum = 0;
+        uint64_t start = tau_additional::util::getMonotonicNanoseconds();
+        for (size_t i = 0; i < repetitions; ++i) {
+            checksum += layout.toJson().size();
+        }
+        uint64_t jsonEncodeTime = tau_additional::util::getMonotonicNanoseconds() - start;
+
+        start = tau_additional::util::getMonotonicNanoseconds();
+        for (size_t i = 0; i < repetitions; ++i) {
+            std::string encoded;
+            BinaryLayoutCodec::encode(layout, encoded);
+            checksum += encoded.size();
+        }
+        uint64_t binaryEncodeTime = tau_additional::util::getMonotonicNanoseconds() - start;
+
+        start = tau_additional::util::getMonotonicNanoseconds();
+        for (size_t i = 0; i < repetitions; ++i) {
+            tau_additional::util::JsonValue decoded;
+            tau_additional::util::JsonValue::parse(layoutJson, decoded);
+            checksum += decoded.getMembers().size();
+        }
+        uint64_t jsonDecodeTime = tau_additional::util::getMonotonicNanoseconds() - start;
+
+        start = tau_additional::util::getMonotonicNanoseconds();
+        for (size_t i = 0; i < repetitions; ++i) {
+            tau_additional::util::JsonValue decoded;
+            BinaryLayoutCodec::decode(binary.data(), binary.size(), decoded);
+            checksum += decoded.getMembers().size();
+        }
+        uint64_t binaryDecodeTime = tau_additional::util::getMonotonicNanoseconds() - start;
+
+        std::cout << name << " layout: JSON " << layoutJson.size() << " bytes, binary " << binary.size()
+            << " bytes (" << 100.0 * binary.size() / layoutJson.size() << "%), round trip "
+            << ((roundTrip == layoutJson) ? "ok" : "FAILED") << "\n"
+            << "    encode: JSON " << double(jsonEncodeTime) / repetitions / 1000 << " us, binary "
+            << double(binaryEncodeTime) / repetitions / 1000 << " us\n"
+            << "    decode: JSON " << double(jsonDecodeTime) / repetitions / 1000 << " us, binary "
+            << double(binaryDecodeTime) / repetitions / 1000 << " us (checksum " << checksum << ")\n";
+    }
+
+    void runPacketsBenchmark(std::string const & layoutJson, size_t packetsCount)
+    {
+        using namespace tau_additional::communications_handling;
+        BinaryLayoutDictionary dictionary;
+        std::string binary;
+        BinaryLayoutCodec::encodeJson(layoutJson, binary, &dictionary);
+
+        std::vector<tau::common::ElementID> ids;
+        for (size_t i = 0; i < 100; ++i) {
+            ids.push_back(tau::common::ElementID(getElementName("ELEMENT_", i * 5 + 3)));
+        }
+        std::string const note("Value 12345");
+
+        PacketSerializer textSerializer;
+        size_t textBytes = 0;
+        uint64_t start = tau_additional::util::getMonotonicNanoseconds();
+        for (size_t i = 0; i < packetsCount; ++i) {
+            textBytes += textSerializer.changeElementNote(ids[i % ids.size()], note).size();
+        }
+        uint64_t textTime = tau_additional::util::getMonotonicNanoseconds() - start;
+
+        BinaryPacketSerializer binarySerializer(&dictionary);
+        size_t binaryBytes = 0;
+        start = tau_additional::util::getMonotonicNanoseconds();
+        for (size_t i = 0; i < packetsCount; ++i) {
+            binaryBytes += binarySerializer.changeElementNote(ids[i % ids.size()], note).size();
+        }
+        uint64_t binaryTime = tau_additional::util::getMonotonicNanoseconds() - start;
+
+        std::cout << "note change packets: text " << double(textBytes) / packetsCount << " bytes, "
+            << double(textTime) / packetsCount << " ns; binary " << double(binaryBytes) / packetsCount << " bytes, "
+            << double(binaryTime) / packetsCount << " ns\n";
+    }
+};
+
+int main(int argc, char ** argv)
+{
+    size_t repetitions = (argc > 1) ? strtoul(argv[1], NULL, 10) : 2000;
+    runLayoutBenchmark("sample02", buildSampleLayoutJson(), repetitions * 10);
+    std::string syntheticLayout = buildSyntheticLayoutJson(1000);
+    runLayoutBenchmark("synthetic 1000-element", syntheticLayout, repetitions);
+    runPacketsBenchmark(syntheticLayout, repetitions * 500);
+    return 0;
+}
@@ -0,0 +1,110 @@
+// This source file is part of the 'tau' open source project.
+// Copyright (c) 2016, Yuriy Vosel.
+// Licensed under Boost Software License.
+// See LICENSE.txt for the licence information.
+
+// Measures the cost of pushing one changeElementNote packet to many clients:
+// serializing it for every connection (sendPacket_* in every dispatcher) versus
+// SessionRegistry::broadcast() of the packet, which is serialized once.
+// The connections queue the packets in memory (the queues are emptied after every update,
+// as the flush would do), so only the fan-out cost is measured, not the socket writes.
+// Usage: benchmark_gcc_cpp11 [clients] [updates]
+
+#include <tau_additional/communications_handling/packet_serializer.h>
+#include <tau_additional/communications_handling/session_registry.h>
+#include <tau_additional/util/monotonic_clock.h>
+#include <iostream>
+#include <vector>
+#include <stdlib.h>
+
+class QueueingPacketsGenerator :
+    public tau::communications_handling::OutgiongPacketsGenerator,
+    public tau_additional::communications_handling::SharedBufferSender
+{
+public:
+    std::vector<tau_additional::util::SharedBuffer> m_queue;
+    size_t m_queuedBytes;
+
+    QueueingPacketsGenerator(): m_queuedBytes(0) {};
+
+    // Same as BufferedOutgoingPacketsGenerator: the data is copied into the new buffer
+    virtual void sendData(std::string const & data) {
+        m_queue.push_back(tau_additional::util::SharedBuffer(data));
+        m_queuedBytes += data.size();
+    }
+    virtual void sendSharedBuffer(tau_additional::util::SharedBuffer const & data) {
+        m_queue.push_back(data);
+        m_queuedBytes += data.size();
+    }
+    virtual void close_connection() {}
+};
+
+// Same work, as the dispatcher does in the samples: serializes the packet for its own connection
+class PerConnectionDispatcher : public tau::util::BasicEventsDispatcher
+{
+public:
+    PerConnectionDispatcher(
+        tau::communications_handling::OutgiongPacketsGenerator & outgoingGeneratorToUse):
+            tau::util::BasicEventsDispatcher(outgoingGeneratorToUse)
+        {};
+    void updateLabel(tau::common::ElementID const & labelID, std::string const & text) {
+        sendPacket_changeElementNote(labelID, text);
+    }
+};
+
+int main(int argc, char ** argv)
+{
+    size_t clientsCount = (argc > 1) ? strtoul(argv[1], NULL, 10) : 1000;
+    size_t updatesCount = (argc > 2) ? strtoul(argv[2], NULL, 10) : 1000;
+    tau::common::ElementID const LABEL_ID("LABEL_ON_PAGE2");
+    std::string const TEXT("Button 1 pressed by one of the operators");
+
+    std::vector<QueueingPacketsGenerator> generators(clientsCount);
+    std::vector<PerConnectionDispatcher *> dispatchers;
+    tau_additional::communications_handling::SessionRegistry registry;
+    for (size_t i = 0; i < clientsCount; ++i) {
+        dispatchers.push_back(new PerConnectionDispatcher(generators[i]));
+        registry.addSession(generators[i]);
+    }
+
+    uint64_t perConnectionTime = 0;
+    uint64_t perConnectionBytes = 0;
+    for (size_t update = 0; update < updatesCount; ++update) {
+        uint64_t start = tau_additional::util::getMonotonicNanoseconds();
+        for (size_t i = 0; i < clientsCount; ++i) {
+            dispatchers[i]->updateLabel(LABEL_ID, TEXT);
+        }
+        perConnectionTime += tau_additional::util::getMonotonicNanoseconds() - start;
+        for (size_t i = 0; i < clientsCount; ++i) {
+            perConnectionBytes += generators[i].m_queuedBytes;
+            generators[i].m_queuedBytes = 0;
+            generators[i].m_queue.clear();
+        }
+    }
+
+    uint64_t broadcastTime = 0;
+    uint64_t broadcastBytes = 0;
+    tau_additional::communications_handling::PacketSerializer serializer;
+    for (size_t update = 0; update < updatesCount; ++update) {
+        uint64_t start = tau_additional::util::getMonotonicNanoseconds();
+        std::string packet = serializer.changeElementNote(LABEL_ID, TEXT);
+        registry.broadcast(tau_additional::util::SharedBuffer::adopt(packet));
+        broadcastTime += tau_additional::util::getMonotonicNanoseconds() - start;
+        for (size_t i = 0; i < clientsCount; ++i) {
+            broadcastBytes += generators[i].m_queuedBytes;
+            generators[i].m_queuedBytes = 0;
+            generators[i].m_queue.clear();
+        }
+    }
+
+    std::cout << clientsCount << " clients, " << updatesCount << " updates\n"
+        << "serialized per connection: " << double(perConnectionTime) / updatesCount / 1000
+        << " us/update (" << double(perConnectionTime) / updatesCount / clientsCount << " ns/client)\n"
+        << "broadcast: " << double(broadcastTime) / updatesCount / 1000
+        << " us/update (" << double(broadcastTime) / updatesCount / clientsCount << " ns/client)\n"
+        << "queued bytes: " << perConnectionBytes << " / " << broadcastBytes << "\n";
+    for (size_t i = 0; i < dispatchers.size(); ++i) {
+        delete dispatchers[i];
+    }
+    return 0;
+}
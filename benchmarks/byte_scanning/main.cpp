@@ -0,0 +1,200 @@
+// This source file is part of the 'tau' open source project.
+// Copyright (c) 2016, Yuriy Vosel.
+// Licensed under Boost Software License.
+// See LICENSE.txt for the licence information.
+
+// Throughput of the byte scanning code with every ByteScanner implementation, which the CPU supports
+// (scalar, SSE2, AVX2), on the mixed traffic:
+// - framing of the client-to-server packets ("type|field|field\n") into the fields;
+// - the access log records of these packets (LogRecord, as the server writes them for every event);
+// - JsonValue parse + write of the layout, which the server sends.
+// The traffic is read from the file (the byte stream, which a real client sends to the server, for
+// example, dumped from the tcp session with the tcpflow tool), or generated: button clicks, boolean
+// switches and the text updates with the values of 0..200 characters. The results of all the
+// implementations are compared.
+// Usage: benchmark_gcc_cpp11 [traffic file] [repetitions]
+
+#include <tau/layout_generation/layout_info.h>
+#include <tau_additional/util/async_logger.h>
+#include <tau_additional/util/byte_scanner.h>
+#include <tau_additional/util/json_value.h>
+#include <tau_additional/util/monotonic_clock.h>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <stdlib.h>
+
+namespace {
+    using namespace tau_additional::util;
+
+    std::string getElementName(char const * prefix, size_t index) {
+        std::ostringstream result;
+        result << prefix << index;
+        return result.str();
+    }
+
+    std::string generateTraffic(size_t packetsCount) {
+        static char const WORDS[] = "the quick brown fox jumps over the lazy dog, \"quoted\" and back\\slashed ";
+        std::string result;
+        for (size_t i = 0; i < packetsCount; ++i) {
+            std::string id = getElementName("ELEMENT_", (i * 7) % 1000);
+            switch (i % 4) {
+                case 0: result += "button_click|" + id + "\n"; break;
+                case 1: result += "bool_value_changed|" + id + "|" + ((i % 8 == 1) ? "true" : "false") + "\n"; break;
+                default: {
+                    std::string value;
+                    size_t length = (i * 37) % 200;
+                    for (size_t j = 0; j < length; ++j) {
+                        value += WORDS[(i + j) % (sizeof(WORDS) - 1)];
+                    }
+                    result += "text_value_changed|" + id + "|" + value + "\n";
+                }
+            }
+        }
+        return result;
+    }
+
+    std::string buildLayoutJson(size_t elementsCount)
+    {
+        using namespace tau::layout_generation;
+        LayoutInfo resultLayout;
+        size_t element = 0;
+        for (size_t page = 0; element < elementsCount; ++page) {
+            EvenlySplitLayoutElementsContainer rows(true);
+            for (size_t row = 0; row < 10 && element < elementsCount; ++row) {
+                EvenlySplitLayoutElementsContainer columns(false);
+                for (size_t column = 0; column < 10 && element < elementsCount; ++column, ++element) {
+                    tau::common::ElementID id(getElementName("ELEMENT_", element));
+                    switch (element % 4) {
+                        case 0: columns.push(ButtonLayoutElement().note(getElementName("Press the button number ", element)).ID(id)); break;
+                        case 1: columns.push(TextInputLayoutElement().ID(id).initialValue(getElementName("Initial value of the input ", element))); break;
+                        case 2: columns.push(BooleanInputLayoutElement(false).note("Enable the \"fast\" mode").ID(id)); break;
+                        default: columns.push(LabelElement(getElementName("The current value of the parameter is ", element)).ID(id)); break;
+                    }
+                }
+                rows.push(columns);
+            }
+            resultLayout.pushLayoutPage(LayoutPage(tau::common::LayoutPageID(getElementName("PAGE_", page)), rows));
+        }
+        resultLayout.setStartLayoutPage(tau::common::LayoutPageID("PAGE_0"));
+        return resultLayout.getJson();
+    }
+
+    // Returns the sum of the fields lengths and the fields count
+    uint64_t frameTraffic(std::string const & traffic) {
+        static ByteSet const DELIMITERS = ByteSet('|').add('\n');
+        uint64_t result = 0;
+        size_t position = 0;
+        while (position < traffic.size()) {
+            size_t fieldLength = findFirstOf(traffic.data() + position, traffic.size() - position, DELIMITERS);
+            result += fieldLength + 1;
+            position += fieldLength + 1;
+        }
+        return result;
+    }
+
+    uint64_t logTraffic(std::string const & traffic) {
+        uint64_t result = 0;
+        size_t position = 0;
+        while (position < traffic.size()) {
+            size_t end = traffic.find('\n', position);
+            if (end == std::string::npos) {
+                end = traffic.size();
+            }
+            size_t typeEnd = traffic.find('|', position);
+            if (typeEnd == std::string::npos || typeEnd > end) {
+                typeEnd = end;
+            }
+            std::string type(traffic, position, typeEnd - position);
+            std::string fields(traffic, typeEnd, end - typeEnd);
+            LogRecord record("packet received");
+            record.field("type", type).field("data", fields);
+            result += record.getLength();
+            position = end + 1;
+        }
+        return result;
+    }
+
+    uint64_t parseAndWriteLayout(std::string const & json) {
+        JsonValue value;
+        if (!JsonValue::parse(json, value)) {
+            return 0;
+        }
+        return value.toJson().size();
+    }
+
+    struct Results
+    {
+        uint64_t framing;
+        uint64_t logging;
+        uint64_t layout;
+    };
+
+    double getMegabytesPerSecond(size_t bytes, size_t repetitions, uint64_t nanoseconds) {
+        return double(bytes) * repetitions * 1000 / double(nanoseconds ? nanoseconds : 1);
+    }
+
+    Results run(char const * name, std::string const & traffic, std::string const & layoutJson, size_t repetitions) {
+        Results results;
+        uint64_t start = getMonotonicNanoseconds();
+        for (size_t i = 0; i < repetitions; ++i) {
+            results.framing = frameTraffic(traffic);
+        }
+        uint64_t framingTime = getMonotonicNanoseconds() - start;
+        start = getMonotonicNanoseconds();
+        for (size_t i = 0; i < repetitions; ++i) {
+            results.logging = logTraffic(traffic);
+        }
+        uint64_t loggingTime = getMonotonicNanoseconds() - start;
+        start = getMonotonicNanoseconds();
+        for (size_t i = 0; i < repetitions; ++i) {
+            results.layout = parseAndWriteLayout(layoutJson);
+        }
+        uint64_t layoutTime = getMonotonicNanoseconds() - start;
+        std::cout << name << "framing " << getMegabytesPerSecond(traffic.size(), repetitions, framingTime)
+            << " MB/s, logging " << getMegabytesPerSecond(traffic.size(), repetitions, loggingTime)
+            << " MB/s, layout parse + write " << getMegabytesPerSecond(layoutJson.size(), repetitions, layoutTime)
+            << " MB/s\n";
+        return results;
+    }
+};
+
+int main(int argc, char ** argv)
+{
+    std::string traffic;
+    if (argc > 1) {
+        std::ifstream input(argv[1], std::ios::binary);
+        if (!input) {
+            std::cerr << "Could not open " << argv[1] << "\n";
+            return -1;
+        }
+        traffic.assign(std::istreambuf_iterator<char>(input), std::istreambuf_iterator<char>());
+    } else {
+        traffic = generateTraffic(20000);
+    }
+    size_t repetitions = (argc > 2) ? strtoul(argv[2], NULL, 10) : 50;
+    if (traffic.empty() || repetitions == 0) {
+        std::cerr << "Usage: benchmark_gcc_cpp11 [traffic file] [repetitions]\n";
+        return -1;
+    }
+    std::string layoutJson = buildLayoutJson(1000);
+    std::cout << "traffic " << traffic.size() << " bytes, layout " << layoutJson.size() << " bytes, "
+        << repetitions << " repetitions\n";
+
+    static char const * const NAMES[] = { "scalar: ", "SSE2:   ", "AVX2:   " };
+    ByteScannerImplementation best = getByteScannerImplementation();
+    Results expected = { 0, 0, 0 };
+    bool same = true;
+    for (int implementation = BYTE_SCANNER_SCALAR; implementation <= best; ++implementation) {
+        setByteScannerImplementation(ByteScannerImplementation(implementation));
+        Results results = run(NAMES[implementation], traffic, layoutJson, repetitions);
+        if (implementation == BYTE_SCANNER_SCALAR) {
+            expected = results;
+        }
+        same = same && results.framing == expected.framing && results.logging == expected.logging
+            && results.layout == expected.layout && results.layout != 0;
+    }
+    std::cout << "the same results: " << (same ? "yes" : "NO") << "\n";
+    return 0;
+}
@@ -0,0 +1,124 @@
+// This source file is part of the 'tau' open source project.
+// Copyright (c) 2016, Yuriy Vosel.
+// Licensed under Boost Software License.
+// See LICENSE.txt for the licence information.
+
+// Compares the button click dispatch latency: the if/else chain over the element ids
+// (as in the samples) versus the RoutingEventsDispatcher hash table,
+// for 10, 100 and 1000 buttons. The clicked buttons are uniformly distributed.
+// Usage: benchmark_gcc_cpp11 [clicks per measurement]
+
+#include <tau/util/basic_events_dispatcher.h>
+#include <tau_additional/util/routing_events_dispatcher.h>
+#include <tau_additional/util/monotonic_clock.h>
+#include <sstream>
+#include <vector>
+#include <stdlib.h>
+
+class NullOutgoingPacketsGenerator :
+    public tau::communications_handling::OutgiongPacketsGenerator
+{
+public:
+    virtual void sendData(std::string const & data) {}
+    virtual void close_connection() {}
+};
+
+namespace {
+    std::vector<tau::common::ElementID> buttonIDs;
+
+    void fillButtonIDs(size_t count) {
+        buttonIDs.clear();
+        for (size_t i = 0; i < count; ++i) {
+            std::stringstream id;
+            id << "BUTTON_" << i;
+            buttonIDs.push_back(tau::common::ElementID(id.str()));
+        }
+    }
+};
+
+// Equivalent of the 'if (buttonID == BUTTON_1_ID) {...} else if ...' chain with buttonIDs.size() branches
+class IfChainEventsDispatcher : public tau::util::BasicEventsDispatcher
+{
+public:
+    size_t m_handledCount;
+    IfChainEventsDispatcher(
+        tau::communications_handling::OutgiongPacketsGenerator & outgoingGeneratorToUse):
+            tau::util::BasicEventsDispatcher(outgoingGeneratorToUse), m_handledCount(0)
+        {};
+
+    virtual void packetReceived_buttonClick(tau::common::ElementID const & buttonID) {
+        for (size_t i = 0; i < buttonIDs.size(); ++i) {
+            if (buttonID == buttonIDs[i]) {
+                buttonPressed(buttonID);
+                break;
+            }
+        }
+    }
+private:
+    void buttonPressed(tau::common::ElementID const & buttonID) {
+        ++m_handledCount;
+    }
+};
+
+class RoutedEventsDispatcher :
+    public tau_additional::util::RoutingEventsDispatcher<RoutedEventsDispatcher>
+{
+public:
+    size_t m_handledCount;
+    RoutedEventsDispatcher(
+        tau::communications_handling::OutgiongPacketsGenerator & outgoingGeneratorToUse):
+            tau_additional::util::RoutingEventsDispatcher<RoutedEventsDispatcher>(outgoingGeneratorToUse),
+            m_handledCount(0)
+        {};
+
+    static void registerEventRoutes(RoutingTable & table) {}
+
+    // The shared table is built once for the dispatcher type, so the benchmark
+    // routes through its own table to be able to vary the elements count.
+    void click(RoutingTable const & table, tau::common::ElementID const & buttonID) {
+        table.routeButtonClick(*this, buttonID);
+    }
+    void buttonPressed(tau::common::ElementID const & buttonID) {
+        ++m_handledCount;
+    }
+};
+
+int main(int argc, char ** argv)
+{
+    size_t clicksCount = (argc > 1) ? strtoul(argv[1], NULL, 10) : 1000000;
+    NullOutgoingPacketsGenerator outgoingPacketsGenerator;
+    size_t elementCounts[] = {10, 100, 1000};
+    for (size_t c = 0; c < sizeof(elementCounts) / sizeof(elementCounts[0]); ++c) {
+        fillButtonIDs(elementCounts[c]);
+        std::vector<size_t> clicks(clicksCount);
+        srand(12345);
+        for (size_t i = 0; i < clicksCount; ++i) {
+            clicks[i] = rand() % buttonIDs.size();
+        }
+
+        IfChainEventsDispatcher ifChain(outgoingPacketsGenerator);
+        uint64_t start = tau_additional::util::getMonotonicNanoseconds();
+        for (size_t i = 0; i < clicksCount; ++i) {
+            ifChain.packetReceived_buttonClick(buttonIDs[clicks[i]]);
+        }
+        uint64_t ifChainTime = tau_additional::util::getMonotonicNanoseconds() - start;
+
+        RoutedEventsDispatcher::RoutingTable table;
+        for (size_t i = 0; i < buttonIDs.size(); ++i) {
+            table.onButtonClick(tau_additional::common::InternedElementID(buttonIDs[i]),
+                &RoutedEventsDispatcher::buttonPressed);
+        }
+        RoutedEventsDispatcher routed(outgoingPacketsGenerator);
+        start = tau_additional::util::getMonotonicNanoseconds();
+        for (size_t i = 0; i < clicksCount; ++i) {
+            routed.click(table, buttonIDs[clicks[i]]);
+        }
+        uint64_t routedTime = tau_additional::util::getMonotonicNanoseconds() - start;
+
+        std::cout << elementCounts[c] << " elements: if-chain "
+            << double(ifChainTime) / clicksCount << " ns/click, routing table "
+            << double(routedTime) / clicksCount << " ns/click (handled "
+            << ifChain.m_handledCount << "/" << routed.m_handledCount << ")\n";
+    }
+    return 0;
+}
@@ -0,0 +1,150 @@
+// This source file is part of the 'tau' open source project.
+// Copyright (c) 2016, Yuriy Vosel.
+// Licensed under Boost Software License.
+// See LICENSE.txt for the licence information.
+
+// Latency of the fast clients, while another client keeps the slow handler busy.
+// The PooledBoostAsioServer with one network thread is run in the process twice: with the handlers
+// called on the network thread, and with the OffloadingEventsDispatcher (the handlers run by the
+// WorkerPool). One client clicks the 'slow' button (the handler sleeps), the other clients click
+// the 'fast' one and measure the click-to-reply latency over the loopback.
+// Usage: benchmark_gcc_cpp11 [fast clients] [seconds per mode] [slow handler milliseconds]
+
+#include <tau/util/basic_events_dispatcher.h>
+#include <tau_additional/util/monotonic_clock.h>
+#include <tau_additional/util/offloading_events_dispatcher.h>
+#include <tau_additional/util/pooled_boost_asio_server.h>
+#include <boost/thread.hpp>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+    unsigned g_slowHandlerMilliseconds = 20;
+
+    class BenchmarkEventsDispatcher : public tau::util::BasicEventsDispatcher
+    {
+    public:
+        BenchmarkEventsDispatcher(
+            tau::communications_handling::OutgiongPacketsGenerator & outgoingGeneratorToUse):
+                tau::util::BasicEventsDispatcher(outgoingGeneratorToUse)
+            {};
+
+        virtual void packetReceived_buttonClick(tau::common::ElementID const & buttonID) {
+            if (buttonID.getValue() == "slow") {
+                timespec delay;
+                delay.tv_sec = g_slowHandlerMilliseconds / 1000;
+                delay.tv_nsec = long(g_slowHandlerMilliseconds % 1000) * 1000000;
+                nanosleep(&delay, NULL);
+            }
+            sendPacket_changeElementNote(buttonID, "done");
+        }
+    };
+
+    struct ClientResult
+    {
+        ClientResult(): requests(0) {};
+        std::vector<uint64_t> latencies;
+        uint64_t requests;
+    };
+
+    // Clicks the button, waits for the reply line, repeats until the end time.
+    void runClient(unsigned short port, std::string button, uint64_t endTime, ClientResult * result) {
+        int socketHandle = socket(AF_INET, SOCK_STREAM, 0);
+        int noDelay = 1;
+        setsockopt(socketHandle, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+        sockaddr_in address;
+        memset(&address, 0, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        address.sin_port = htons(port);
+        if (connect(socketHandle, (sockaddr *)(&address), sizeof(address)) != 0) {
+            close(socketHandle);
+            return;
+        }
+        std::string request("click|" + button + "\n");
+        char buffer[256];
+        while (tau_additional::util::getMonotonicNanoseconds() < endTime) {
+            uint64_t start = tau_additional::util::getMonotonicNanoseconds();
+            if (send(socketHandle, request.data(), request.size(), MSG_NOSIGNAL) != ssize_t(request.size())) {
+                break;
+            }
+            bool replied = false;
+            while (!replied) {
+                ssize_t received = recv(socketHandle, buffer, sizeof(buffer), 0);
+                if (received <= 0) {
+                    close(socketHandle);
+                    return;
+                }
+                replied = (buffer[received - 1] == '\n');
+            }
+            result->latencies.push_back(tau_additional::util::getMonotonicNanoseconds() - start);
+            ++result->requests;
+        }
+        close(socketHandle);
+    }
+
+    double getPercentileMilliseconds(std::vector<uint64_t> const & sorted, double fraction) {
+        if (sorted.empty()) {
+            return 0;
+        }
+        size_t index = std::min(sorted.size() - 1, size_t(fraction * sorted.size()));
+        return sorted[index] / 1000000.0;
+    }
+
+    template <typename EventsDispatcherType>
+    void runMode(char const * name, unsigned short port, size_t fastClients, unsigned seconds) {
+        tau_additional::util::IoServicePool pool(1);
+        tau_additional::util::PooledBoostAsioServer<EventsDispatcherType> server(pool, port);
+        server.start();
+        boost::thread networkThread(boost::bind(&tau_additional::util::IoServicePool::run, &pool));
+
+        uint64_t endTime = tau_additional::util::getMonotonicNanoseconds() + uint64_t(seconds) * 1000000000;
+        std::vector<ClientResult> results(fastClients + 1);
+        boost::thread_group clients;
+        clients.create_thread(boost::bind(&runClient, port, std::string("slow"), endTime, &results[0]));
+        for (size_t i = 1; i <= fastClients; ++i) {
+            clients.create_thread(boost::bind(&runClient, port, std::string("fast"), endTime, &results[i]));
+        }
+        clients.join_all();
+        pool.stop();
+        networkThread.join();
+
+        std::vector<uint64_t> fastLatencies;
+        for (size_t i = 1; i <= fastClients; ++i) {
+            fastLatencies.insert(fastLatencies.end(), results[i].latencies.begin(), results[i].latencies.end());
+        }
+        std::sort(fastLatencies.begin(), fastLatencies.end());
+        std::cout << name << ": slow clicks " << results[0].requests
+            << ", fast clicks " << fastLatencies.size()
+            << ", fast latency p50 " << getPercentileMilliseconds(fastLatencies, 0.5)
+            << " ms, p99 " << getPercentileMilliseconds(fastLatencies, 0.99)
+            << " ms, max " << getPercentileMilliseconds(fastLatencies, 1.0) << " ms" << std::endl;
+    }
+};
+
+int main(int argc, char ** argv)
+{
+    size_t fastClients = (argc > 1) ? size_t(atoi(argv[1])) : 4;
+    unsigned seconds = (argc > 2) ? unsigned(atoi(argv[2])) : 3;
+    if (argc > 3) {
+        g_slowHandlerMilliseconds = unsigned(atoi(argv[3]));
+    }
+    std::cout << "fast clients: " << fastClients << ", slow handler: " << g_slowHandlerMilliseconds
+        << " ms, one network thread" << std::endl;
+
+    runMode<BenchmarkEventsDispatcher>("network thread", 12401, fastClients, seconds);
+    runMode<tau_additional::util::OffloadingEventsDispatcher<BenchmarkEventsDispatcher> >(
+        "offloaded     ", 12402, fastClients, seconds);
+    return 0;
+}
@@ -0,0 +1,116 @@
+// This source file is part of the 'tau' open source project.
+// Copyright (c) 2016, Yuriy Vosel.
+// Licensed under Boost Software License.
+// See LICENSE.txt for the licence information.
+
+// Measures how fast the received data is parsed, when it is fed into the parser in the
+// recv()-sized chunks: the old way (std::string per chunk) versus RawIncomingDataStreamParser.
+// Usage: benchmark_gcc_cpp11 <file with the raw client-to-server traffic> [chunk size] [repetitions]
+// The traffic file is the byte stream which a real client sends to the server
+// (for example, dumped from the tcp session with the tcpflow tool).
+
+#include <tau/util/basic_events_dispatcher.h>
+#include <tau/communications_handling/incoming_data_stream_parser.h>
+#include <tau_additional/communications_handling/raw_incoming_data_stream_parser.h>
+#include <tau_additional/util/monotonic_clock.h>
+#include <fstream>
+#include <iterator>
+#include <stdlib.h>
+
+class NullOutgoingPacketsGenerator :
+    public tau::communications_handling::OutgiongPacketsGenerator
+{
+public:
+    virtual void sendData(std::string const & data) {}
+    virtual void close_connection() {}
+};
+
+class CountingEventsDispatcher : public tau::util::BasicEventsDispatcher
+{
+public:
+    size_t m_eventsCount;
+    CountingEventsDispatcher(
+        tau::communications_handling::OutgiongPacketsGenerator & outgoingGeneratorToUse):
+            tau::util::BasicEventsDispatcher(outgoingGeneratorToUse), m_eventsCount(0)
+        {};
+
+    virtual void packetReceived_buttonClick(tau::common::ElementID const & buttonID) {
+        ++m_eventsCount;
+    }
+    virtual void packetReceived_layoutPageSwitched(
+        tau::common::LayoutPageID const & newActiveLayoutPageID) {
+        ++m_eventsCount;
+    }
+    virtual void packetReceived_boolValueUpdate(
+        tau::common::ElementID const & inputBoxID, bool new_value, bool is_automatic_update) {
+        ++m_eventsCount;
+    }
+    virtual void packetReceived_textValueUpdate(
+        tau::common::ElementID const & inputBoxID,
+        std::string const & new_value, bool is_automatic_update) {
+        ++m_eventsCount;
+    }
+};
+
+namespace {
+    void printResult(char const * name, size_t bytes, uint64_t nanoseconds, size_t events) {
+        double seconds = double(nanoseconds) / 1e9;
+        std::cout << name << ": " << (double(bytes) / (1024 * 1024)) / seconds << " MB/s, "
+            << events << " events in " << seconds << " s\n";
+    }
+};
+
+int main(int argc, char ** argv)
+{
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <traffic file> [chunk size] [repetitions]\n";
+        return -1;
+    }
+    std::ifstream input(argv[1], std::ios::binary);
+    std::string traffic((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+    if (traffic.empty()) {
+        std::cerr << "Can't read the traffic file (or it is empty). Exiting.\n";
+        return -2;
+    }
+    size_t chunkSize = (argc > 2) ? strtoul(argv[2], NULL, 10) : 1024;
+    size_t repetitions = (argc > 3) ? strtoul(argv[3], NULL, 10) : 100;
+    if (chunkSize == 0 || repetitions == 0) {
+        std::cerr << "Chunk size and repetitions should be positive. Exiting.\n";
+        return -3;
+    }
+    size_t totalBytes = traffic.size() * repetitions;
+    std::cout << "Traffic: " << traffic.size() << " bytes, chunk size: " << chunkSize
+        << ", repetitions: " << repetitions << "\n";
+
+    NullOutgoingPacketsGenerator outgoingPacketsGenerator;
+    {
+        CountingEventsDispatcher dispatcher(outgoingPacketsGenerator);
+        tau::communications_handling::IncomingDataStreamParser parser;
+        uint64_t start = tau_additional::util::getMonotonicNanoseconds();
+        for (size_t i = 0; i < repetitions; ++i) {
+            for (size_t offset = 0; offset < traffic.size(); offset += chunkSize) {
+                std::string received_data(traffic.data() + offset,
+                    std::min(chunkSize, traffic.size() - offset));
+                parser.newData(received_data,
+                    dispatcher.getIncomingPacketsHandler(),
+                    dispatcher.getCommunicationIssuesHandler());
+            }
+        }
+        printResult("std::string per chunk", totalBytes,
+            tau_additional::util::getMonotonicNanoseconds() - start, dispatcher.m_eventsCount);
+    }
+    {
+        CountingEventsDispatcher dispatcher(outgoingPacketsGenerator);
+        tau_additional::communications_handling::RawIncomingDataStreamParser parser(chunkSize);
+        uint64_t start = tau_additional::util::getMonotonicNanoseconds();
+        for (size_t i = 0; i < repetitions; ++i) {
+            for (size_t offset = 0; offset < traffic.size(); offset += chunkSize) {
+                parser.newData(traffic.data() + offset,
+                    std::min(chunkSize, traffic.size() - offset), dispatcher);
+            }
+        }
+        printResult("RawIncomingDataStreamParser", totalBytes,
+            tau_additional::util::getMonotonicNanoseconds() - start, dispatcher.m_eventsCount);
+    }
+    return 0;
+}
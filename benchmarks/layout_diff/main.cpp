@@ -0,0 +1,101 @@
+// This source file is part of the 'tau' open source project.
+// Copyright (c) 2016, Yuriy Vosel.
+// Licensed under Boost Software License.
+// See LICENSE.txt for the licence information.
+
+// Simulates the dashboard, which rebuilds its layout on every data tick: 100 value labels
+// and a text input, a few labels change per tick. Compares the bytes sent with the layout
+// reset on every tick versus the LayoutUpdatesGenerator, and measures the diff time.
+// Usage: benchmark_gcc_cpp11 [ticks] [labels changed per tick]
+
+#include <tau/layout_generation/layout_info.h>
+#include <tau_additional/layout_generation/layout_diff.h>
+#include <tau_additional/util/monotonic_clock.h>
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <stdlib.h>
+
+namespace {
+    size_t const LABELS_COUNT = 100;
+    size_t const LABELS_PER_ROW = 10;
+
+    std::string makeID(char const * prefix, size_t index) {
+        std::stringstream id;
+        id << prefix << index;
+        return id.str();
+    }
+
+    std::string buildDashboardLayout(std::vector<int> const & values, std::string const & comment, bool extraButton) {
+        using namespace tau::layout_generation;
+        EvenlySplitLayoutElementsContainer rows(true);
+        for (size_t row = 0; row < LABELS_COUNT / LABELS_PER_ROW; ++row) {
+            EvenlySplitLayoutElementsContainer columns(false);
+            for (size_t column = 0; column < LABELS_PER_ROW; ++column) {
+                size_t index = row * LABELS_PER_ROW + column;
+                std::stringstream text;
+                text << "sensor " << index << ": " << values[index];
+                columns.push(LabelElement(text.str()).ID(tau::common::ElementID(makeID("VALUE_", index))));
+            }
+            rows.push(columns);
+        }
+        EvenlySplitLayoutElementsContainer controls(false);
+        controls.push(TextInputLayoutElement().ID(tau::common::ElementID("COMMENT")).initialValue(comment));
+        if (extraButton) {
+            controls.push(ButtonLayoutElement().note("acknowledge").ID(tau::common::ElementID("ACK")));
+        }
+        rows.push(controls);
+        LayoutInfo result;
+        result.pushLayoutPage(LayoutPage(tau::common::LayoutPageID("DASHBOARD"), rows));
+        return result.getJson();
+    }
+};
+
+int main(int argc, char ** argv)
+{
+    size_t ticksCount = (argc > 1) ? strtoul(argv[1], NULL, 10) : 10000;
+    size_t changesPerTick = (argc > 2) ? strtoul(argv[2], NULL, 10) : 5;
+    std::vector<int> values(LABELS_COUNT, 0);
+    srand(12345);
+
+    std::vector<std::string> layouts;
+    for (size_t tick = 0; tick < ticksCount; ++tick) {
+        for (size_t i = 0; i < changesPerTick; ++i) {
+            values[rand() % LABELS_COUNT] = rand() % 1000;
+        }
+        // Every 1000 ticks the structure changes (the 'acknowledge' button appears/disappears)
+        // and every 100 ticks the comment text is updated.
+        std::string comment = makeID("comment ", tick / 100);
+        layouts.push_back(buildDashboardLayout(values, comment, (tick / 1000) % 2 == 1));
+    }
+
+    tau_additional::communications_handling::PacketSerializer serializer;
+    uint64_t resetBytes = 0;
+    uint64_t start = tau_additional::util::getMonotonicNanoseconds();
+    for (size_t i = 0; i < layouts.size(); ++i) {
+        resetBytes += serializer.resetLayout(layouts[i]).size();
+    }
+    uint64_t resetTime = tau_additional::util::getMonotonicNanoseconds() - start;
+
+    tau_additional::layout_generation::LayoutUpdatesGenerator generator;
+    uint64_t deltaBytes = 0;
+    start = tau_additional::util::getMonotonicNanoseconds();
+    for (size_t i = 0; i < layouts.size(); ++i) {
+        deltaBytes += generator.makeUpdatePackets(layouts[i]).size();
+    }
+    uint64_t deltaTime = tau_additional::util::getMonotonicNanoseconds() - start;
+
+    tau_additional::layout_generation::LayoutUpdatesGenerator::Statistics const & statistics =
+        generator.getStatistics();
+    std::cout << "layout size: " << layouts.back().size() << " bytes, "
+        << ticksCount << " ticks, " << changesPerTick << " label changes per tick\n"
+        << "reset on every tick: " << resetBytes << " bytes, "
+        << double(resetTime) / ticksCount / 1000 << " us/tick\n"
+        << "delta updates: " << deltaBytes << " bytes, "
+        << double(deltaTime) / ticksCount / 1000 << " us/tick ("
+        << statistics.deltaUpdates << " delta, " << statistics.layoutResets << " resets, "
+        << statistics.unchangedLayouts << " unchanged, "
+        << statistics.elementChangesSent << " element changes)\n"
+        << "traffic reduction: " << double(resetBytes) / (deltaBytes ? deltaBytes : 1) << "x\n";
+    return 0;
+}
@@ -0,0 +1,3 @@
+#!/bin/bash
+ADDITIONAL_LIBRARY_LOCATION=../../src/cpp/
+g++ -std=c++11 -O2 -pthread -I $ADDITIONAL_LIBRARY_LOCATION main.cpp -o benchmark_gcc_cpp11
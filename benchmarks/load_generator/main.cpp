@@ -0,0 +1,618 @@
+// This source file is part of the 'tau' open source project.
+// Copyright (c) 2016, Yuriy Vosel.
+// Licensed under Boost Software License.
+// See LICENSE.txt for the licence information.
+
+// Headless load generator: opens many concurrent connections to the tau server over the loopback,
+// replays the scripted client packets on every connection and reports the throughput and the
+// request-to-response latency percentiles (p50/p99/p999).
+// Usage: benchmark_gcc_cpp11 <script> [port] [connections] [seconds] [threads] [host]
+// (see the scenarios directory for the scripts and run_against_samples.sh for the sample servers).
+//
+// The script is a text file with one step per line (the empty lines and the '#' comments are skipped).
+// The client packets of the tau protocol:
+//     info "<device info>" ["<reply>"] - the client device info packet
+//     click <element id> ["<reply>"]   - the button click
+//     text <element id> "<value>" ["<reply>"] - the text input value update
+//     bool <element id> 0|1 ["<reply>"] - the boolean input value update
+//     page <layout page id> ["<reply>"] - the layout page switch
+// If the <reply> is given, the generator waits until the server's reply contains it (the empty
+// string - any data); this is one latency sample. Otherwise the packet is sent without waiting.
+// Any other data:
+//     send "<bytes>"                  - sends the bytes, does not wait for anything
+//     request "<bytes>" ["<reply>"]   - sends the bytes and waits for the reply (any data, if omitted)
+// The bytes are written as the C string literal (\n, \r, \t, \\, \", \xHH escapes), so the packets,
+// dumped from the real client's tcp session (for example, with the tcpflow tool), can be replayed.
+// The other steps:
+//     sleep <milliseconds>
+//     loop [<count>]                  - the steps before this line are executed once (the handshake,
+//                                       for example the client device info packet); the steps after it
+//                                       are repeated <count> times or, if it is omitted, until the time
+//                                       is over. The run ends, when all the connections are done.
+
+#include <tau_additional/util/monotonic_clock.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+    uint64_t const REQUEST_TIMEOUT_NANOSECONDS = 5000000000ULL;
+
+    struct Step
+    {
+        enum Kind {
+            SEND,
+            REQUEST,
+            SLEEP
+        };
+        Step(): kind(SEND), sleepNanoseconds(0) {};
+        Kind kind;
+        std::string payload;
+        std::string expectedReply;
+        uint64_t sleepNanoseconds;
+    };
+
+    struct Script
+    {
+        Script(): loopCount(0) {};
+        std::vector<Step> handshake;
+        std::vector<Step> loop;
+        size_t loopCount; // 0 - until the time is over
+    };
+
+    // The client side of the tau protocol: the packets, which the tau client sends
+    // (the library's IncomingDataStreamParser reads them on the server side).
+    namespace client_packets {
+        std::string makePacket(char const * type, std::string const & first, std::string const * second = NULL) {
+            std::string result(type);
+            result += '|';
+            result += first;
+            if (second != NULL) {
+                result += '|';
+                result += *second;
+            }
+            result += '\n';
+            return result;
+        }
+
+        std::string clientDeviceInfo(std::string const & info) {
+            return makePacket("info", info);
+        }
+        std::string buttonClick(std::string const & buttonID) {
+            return makePacket("click", buttonID);
+        }
+        std::string textValueUpdate(std::string const & inputBoxID, std::string const & value) {
+            return makePacket("text", inputBoxID, &value);
+        }
+        std::string boolValueUpdate(std::string const & inputBoxID, bool value) {
+            std::string valueString(value ? "1" : "0");
+            return makePacket("bool", inputBoxID, &valueString);
+        }
+        std::string layoutPageSwitched(std::string const & layoutPageID) {
+            return makePacket("page", layoutPageID);
+        }
+    };
+
+    int hexDigitValue(char c) {
+        if (c >= '0' && c <= '9') {
+            return c - '0';
+        } else if (c >= 'a' && c <= 'f') {
+            return c - 'a' + 10;
+        } else if (c >= 'A' && c <= 'F') {
+            return c - 'A' + 10;
+        }
+        return -1;
+    }
+
+    // Parses the quoted C string literal, starting at the position (leading spaces are skipped).
+    bool parseQuoted(std::string const & line, size_t & position, std::string & result) {
+        position = line.find_first_not_of(" \t", position);
+        if (position == std::string::npos || line[position] != '"') {
+            return false;
+        }
+        result.clear();
+        for (++position; position < line.size(); ++position) {
+            char c = line[position];
+            if (c == '"') {
+                ++position;
+                return true;
+            }
+            if (c != '\\') {
+                result += c;
+                continue;
+            }
+            if (++position >= line.size()) {
+                return false;
+            }
+            switch (line[position]) {
+                case 'n': result += '\n'; break;
+                case 'r': result += '\r'; break;
+                case 't': result += '\t'; break;
+                case '0': result += '\0'; break;
+                case '\\': result += '\\'; break;
+                case '"': result += '"'; break;
+                case 'x': {
+                    int high = (position + 1 < line.size()) ? hexDigitValue(line[position + 1]) : -1;
+                    int low = (position + 2 < line.size()) ? hexDigitValue(line[position + 2]) : -1;
+                    if (high < 0 || low < 0) {
+                        return false;
+                    }
+                    result += char(high * 16 + low);
+                    position += 2;
+                    break;
+                }
+                default:
+                    return false;
+            }
+        }
+        return false;
+    }
+
+    // Reads the next word (the element id, the number), leading spaces are skipped.
+    bool parseWord(std::string const & line, size_t & position, std::string & result) {
+        size_t start = line.find_first_not_of(" \t\r", position);
+        if (start == std::string::npos || line[start] == '"') {
+            return false;
+        }
+        position = line.find_first_of(" \t\r", start);
+        if (position == std::string::npos) {
+            position = line.size();
+        }
+        result = line.substr(start, position - start);
+        return true;
+    }
+
+    // The protocol packet step: the arguments of the packet, then the optional reply to wait for.
+    bool parsePacketStep(std::string const & command, std::string const & line, size_t & position, Step & step) {
+        std::string id;
+        if (command == "info") {
+            if (!parseQuoted(line, position, id)) {
+                return false;
+            }
+            step.payload = client_packets::clientDeviceInfo(id);
+        } else if (!parseWord(line, position, id)) {
+            return false;
+        } else if (command == "click") {
+            step.payload = client_packets::buttonClick(id);
+        } else if (command == "page") {
+            step.payload = client_packets::layoutPageSwitched(id);
+        } else if (command == "text") {
+            std::string value;
+            if (!parseQuoted(line, position, value)) {
+                return false;
+            }
+            step.payload = client_packets::textValueUpdate(id, value);
+        } else if (command == "bool") {
+            std::string value;
+            if (!parseWord(line, position, value) || (value != "0" && value != "1")) {
+                return false;
+            }
+            step.payload = client_packets::boolValueUpdate(id, value == "1");
+        } else {
+            return false;
+        }
+        step.kind = Step::SEND;
+        if (line.find('"', position) != std::string::npos) {
+            step.kind = Step::REQUEST;
+            return parseQuoted(line, position, step.expectedReply);
+        }
+        return true;
+    }
+
+    bool loadScript(char const * fileName, Script & script, std::string & error) {
+        std::ifstream input(fileName);
+        if (!input) {
+            error = "can't open the file";
+            return false;
+        }
+        std::vector<Step> * steps = &script.handshake;
+        std::string line;
+        for (size_t lineNumber = 1; std::getline(input, line); ++lineNumber) {
+            std::stringstream location;
+            location << "line " << lineNumber << ": ";
+            size_t start = line.find_first_not_of(" \t\r");
+            if (start == std::string::npos || line[start] == '#') {
+                continue;
+            }
+            size_t end = line.find_first_of(" \t\r", start);
+            std::string command = line.substr(start, (end == std::string::npos) ? std::string::npos : end - start);
+            size_t position = (end == std::string::npos) ? line.size() : end;
+            Step step;
+            if (command == "loop") {
+                steps = &script.loop;
+                script.loopCount = strtoul(line.c_str() + position, NULL, 10);
+                continue;
+            } else if (command == "info" || command == "click" || command == "text" || command == "bool"
+                || command == "page") {
+                if (!parsePacketStep(command, line, position, step)) {
+                    error = location.str() + "bad arguments of '" + command + "'";
+                    return false;
+                }
+            } else if (command == "send" || command == "request") {
+                step.kind = (command == "send") ? Step::SEND : Step::REQUEST;
+                if (!parseQuoted(line, position, step.payload)) {
+                    error = location.str() + "bad quoted string";
+                    return false;
+                }
+                if (step.kind == Step::REQUEST && line.find('"', position) != std::string::npos
+                    && !parseQuoted(line, position, step.expectedReply)) {
+                    error = location.str() + "bad quoted reply";
+                    return false;
+                }
+            } else if (command == "sleep") {
+                step.kind = Step::SLEEP;
+                step.sleepNanoseconds = strtoull(line.c_str() + position, NULL, 10) * 1000000;
+            } else {
+                error = location.str() + "unknown command '" + command + "'";
+                return false;
+            }
+            steps->push_back(step);
+        }
+        if (script.handshake.empty() && script.loop.empty()) {
+            error = "the script is empty";
+            return false;
+        }
+        return true;
+    }
+
+    struct Results
+    {
+        Results(): requests(0), timeouts(0), bytesSent(0), bytesReceived(0), failedConnections(0) {};
+        std::vector<uint64_t> latencies;
+        uint64_t requests;
+        uint64_t timeouts;
+        uint64_t bytesSent;
+        uint64_t bytesReceived;
+        uint64_t failedConnections;
+
+        void merge(Results const & other) {
+            latencies.insert(latencies.end(), other.latencies.begin(), other.latencies.end());
+            requests += other.requests;
+            timeouts += other.timeouts;
+            bytesSent += other.bytesSent;
+            bytesReceived += other.bytesReceived;
+            failedConnections += other.failedConnections;
+        }
+    };
+
+    struct ClientConnection
+    {
+        enum State {
+            CONNECTING,
+            RUNNING,          // executes the steps
+            WAITING_REPLY,
+            SLEEPING,
+            FINISHED          // the script has no loop, or the connection failed
+        };
+        ClientConnection():
+            socketHandle(-1), state(CONNECTING), inLoop(false), step(0), loopPasses(0),
+            outgoingOffset(0), requestTime(0), wakeUpTime(0), expectedReply(NULL)
+        {};
+        int socketHandle;
+        State state;
+        bool inLoop;
+        size_t step;
+        size_t loopPasses;
+        std::string outgoing;
+        size_t outgoingOffset;
+        std::string received;
+        uint64_t requestTime;
+        uint64_t wakeUpTime;
+        std::string const * expectedReply;
+    };
+
+    // Serves a part of the connections with its own epoll instance.
+    class Worker
+    {
+        Script const & m_script;
+        sockaddr_in m_serverAddr;
+        uint64_t m_endTime;
+        int m_epollHandle;
+        std::vector<ClientConnection> m_connections;
+        std::vector<char> m_receiveBuffer;
+        pthread_t m_thread;
+    public:
+        Results m_results;
+
+        Worker(Script const & script, sockaddr_in const & serverAddr, size_t connectionsCount, uint64_t endTime):
+            m_script(script), m_serverAddr(serverAddr), m_endTime(endTime), m_epollHandle(-1), m_connections(connectionsCount), m_receiveBuffer(64 * 1024)
+        {};
+
+        void start() {
+            pthread_create(&m_thread, NULL, &Worker::threadFunction, this);
+        }
+        void join() {
+            pthread_join(m_thread, NULL);
+        }
+    private:
+        static void * threadFunction(void * worker) {
+            static_cast<Worker *>(worker)->run();
+            return NULL;
+        }
+
+        void run() {
+            m_epollHandle = epoll_create1(0);
+            for (size_t i = 0; i < m_connections.size(); ++i) {
+                openConnection(m_connections[i]);
+            }
+            std::vector<epoll_event> events(256);
+            while (true) {
+                uint64_t now = tau_additional::util::getMonotonicNanoseconds();
+                if (now >= m_endTime || isFinished()) {
+                    break;
+                }
+                int eventsCount = epoll_wait(m_epollHandle, &events[0], int(events.size()), 1);
+                for (int i = 0; i < eventsCount; ++i) {
+                    processEvent(*static_cast<ClientConnection *>(events[i].data.ptr), events[i].events);
+                }
+                now = tau_additional::util::getMonotonicNanoseconds();
+                for (size_t i = 0; i < m_connections.size(); ++i) {
+                    checkTimers(m_connections[i], now);
+                }
+            }
+            for (size_t i = 0; i < m_connections.size(); ++i) {
+                if (m_connections[i].socketHandle != -1) {
+                    close(m_connections[i].socketHandle);
+                }
+            }
+            close(m_epollHandle);
+        }
+
+        bool isFinished() const {
+            for (size_t i = 0; i < m_connections.size(); ++i) {
+                if (m_connections[i].state != ClientConnection::FINISHED) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        void openConnection(ClientConnection & connection) {
+            connection.socketHandle = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+            int noDelay = 1;
+            setsockopt(connection.socketHandle, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+            int result = connect(connection.socketHandle, (sockaddr *)(&m_serverAddr), sizeof(m_serverAddr));
+            if (result == -1 && errno != EINPROGRESS) {
+                failConnection(connection);
+                return;
+            }
+            epoll_event event;
+            event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+            event.data.ptr = &connection;
+            epoll_ctl(m_epollHandle, EPOLL_CTL_ADD, connection.socketHandle, &event);
+        }
+
+        void failConnection(ClientConnection & connection) {
+            ++m_results.failedConnections;
+            if (connection.socketHandle != -1) {
+                close(connection.socketHandle);
+                connection.socketHandle = -1;
+            }
+            connection.state = ClientConnection::FINISHED;
+        }
+
+        void processEvent(ClientConnection & connection, uint32_t events) {
+            if (connection.socketHandle == -1) {
+                return;
+            }
+            if (connection.state == ClientConnection::CONNECTING) {
+                int error = 0;
+                socklen_t errorSize = sizeof(error);
+                getsockopt(connection.socketHandle, SOL_SOCKET, SO_ERROR, &error, &errorSize);
+                if (error != 0 || (events & (EPOLLERR | EPOLLHUP))) {
+                    failConnection(connection);
+                    return;
+                }
+                connection.state = ClientConnection::RUNNING;
+                executeSteps(connection);
+            }
+            if ((events & EPOLLOUT) && !writeOutgoing(connection)) {
+                return;
+            }
+            if (events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+                readIncoming(connection);
+            }
+        }
+
+        // Returns false if the connection failed.
+        bool writeOutgoing(ClientConnection & connection) {
+            while (connection.outgoingOffset < connection.outgoing.size()) {
+                ssize_t result = send(connection.socketHandle, connection.outgoing.data() + connection.outgoingOffset,
+                    connection.outgoing.size() - connection.outgoingOffset, MSG_NOSIGNAL);
+                if (result == -1) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                    if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                        return true;
+                    }
+                    failConnection(connection);
+                    return false;
+                }
+                connection.outgoingOffset += result;
+                m_results.bytesSent += result;
+            }
+            connection.outgoing.clear();
+            connection.outgoingOffset = 0;
+            return true;
+        }
+
+        void readIncoming(ClientConnection & connection) {
+            while (connection.socketHandle != -1) {
+                ssize_t result = recv(connection.socketHandle, &m_receiveBuffer[0], m_receiveBuffer.size(), 0);
+                if (result > 0) {
+                    m_results.bytesReceived += result;
+                    if (connection.state == ClientConnection::WAITING_REPLY) {
+                        connection.received.append(&m_receiveBuffer[0], result);
+                        checkReply(connection);
+                    }
+                } else if (result == -1 && errno == EINTR) {
+                    continue;
+                } else if (result == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                    return;
+                } else {
+                    failConnection(connection); // closed by the server
+                    return;
+                }
+            }
+        }
+
+        void checkReply(ClientConnection & connection) {
+            std::string const & expected = *connection.expectedReply;
+            if (connection.received.find(expected) == std::string::npos) {
+                // Keep only the tail, which can be the beginning of the expected reply
+                if (connection.received.size() > expected.size()) {
+                    connection.received.erase(0, connection.received.size() - expected.size());
+                }
+                return;
+            }
+            ++m_results.requests;
+            m_results.latencies.push_back(tau_additional::util::getMonotonicNanoseconds() - connection.requestTime);
+            connection.received.clear();
+            connection.state = ClientConnection::RUNNING;
+            executeSteps(connection);
+        }
+
+        void checkTimers(ClientConnection & connection, uint64_t now) {
+            if (connection.state == ClientConnection::SLEEPING && now >= connection.wakeUpTime) {
+                connection.state = ClientConnection::RUNNING;
+                executeSteps(connection);
+            } else if (connection.state == ClientConnection::WAITING_REPLY
+                && now - connection.requestTime > REQUEST_TIMEOUT_NANOSECONDS) {
+                ++m_results.timeouts;
+                connection.received.clear();
+                connection.state = ClientConnection::RUNNING;
+                executeSteps(connection);
+            } else if (connection.state == ClientConnection::RUNNING) {
+                executeSteps(connection);
+            }
+        }
+
+        // Runs the steps until the connection has to wait for something. At most one pass over
+        // the loop is made per call, so the script without the waits does not block the worker.
+        void executeSteps(ClientConnection & connection) {
+            for (size_t executed = 0; connection.state == ClientConnection::RUNNING; ++executed) {
+                if (!connection.inLoop && connection.step >= m_script.handshake.size()) {
+                    connection.inLoop = true;
+                    connection.step = 0;
+                }
+                std::vector<Step> const & steps = connection.inLoop ? m_script.loop : m_script.handshake;
+                if (steps.empty()) {
+                    connection.state = ClientConnection::FINISHED;
+                    return;
+                }
+                if (connection.inLoop && connection.step == 0 && m_script.loopCount != 0
+                    && connection.loopPasses == m_script.loopCount) {
+                    connection.state = ClientConnection::FINISHED;
+                    return;
+                }
+                if (connection.inLoop && executed >= steps.size()) {
+                    return; // continued on the next worker loop turn
+                }
+                Step const & step = steps[connection.step];
+                connection.step = connection.inLoop ? (connection.step + 1) % steps.size() : connection.step + 1;
+                if (connection.inLoop && connection.step == 0) {
+                    ++connection.loopPasses;
+                }
+                if (step.kind == Step::SLEEP) {
+                    connection.wakeUpTime = tau_additional::util::getMonotonicNanoseconds() + step.sleepNanoseconds;
+                    connection.state = ClientConnection::SLEEPING;
+                    return;
+                }
+                if (step.kind == Step::REQUEST) {
+                    connection.received.clear();
+                    connection.expectedReply = &step.expectedReply;
+                    connection.requestTime = tau_additional::util::getMonotonicNanoseconds();
+                    connection.state = ClientConnection::WAITING_REPLY;
+                }
+                connection.outgoing.append(step.payload);
+                if (!writeOutgoing(connection)) {
+                    return;
+                }
+            }
+        }
+    };
+
+    uint64_t getPercentile(std::vector<uint64_t> const & sorted, double percentile) {
+        if (sorted.empty()) {
+            return 0;
+        }
+        size_t index = size_t(percentile / 100.0 * (sorted.size() - 1) + 0.5);
+        return sorted[std::min(index, sorted.size() - 1)];
+    }
+};
+
+int main(int argc, char ** argv)
+{
+    if (argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <script> [port] [connections] [seconds] [threads] [host]\n";
+        return -1;
+    }
+    int port = (argc > 2) ? atoi(argv[2]) : 12345;
+    size_t connectionsCount = (argc > 3) ? strtoul(argv[3], NULL, 10) : 100;
+    double seconds = (argc > 4) ? atof(argv[4]) : 10.0;
+    size_t threadsCount = (argc > 5) ? strtoul(argv[5], NULL, 10) : 1;
+    char const * host = (argc > 6) ? argv[6] : "127.0.0.1";
+    if (threadsCount == 0) {
+        threadsCount = 1;
+    }
+
+    Script script;
+    std::string error;
+    if (!loadScript(argv[1], script, error)) {
+        std::cerr << "Can't load the script " << argv[1] << ": " << error << "\n";
+        return -1;
+    }
+    sockaddr_in serverAddr;
+    memset(&serverAddr, 0, sizeof(serverAddr));
+    serverAddr.sin_family = AF_INET;
+    serverAddr.sin_port = htons(port);
+    if (inet_pton(AF_INET, host, &serverAddr.sin_addr) != 1) {
+        std::cerr << "Bad host address: " << host << "\n";
+        return -1;
+    }
+
+    uint64_t start = tau_additional::util::getMonotonicNanoseconds();
+    uint64_t end = start + uint64_t(seconds * 1e9);
+    std::vector<Worker *> workers;
+    for (size_t i = 0; i < threadsCount; ++i) {
+        size_t count = connectionsCount / threadsCount + ((i < connectionsCount % threadsCount) ? 1 : 0);
+        workers.push_back(new Worker(script, serverAddr, count, end));
+        workers.back()->start();
+    }
+    Results results;
+    for (size_t i = 0; i < workers.size(); ++i) {
+        workers[i]->join();
+        results.merge(workers[i]->m_results);
+        delete workers[i];
+    }
+    double elapsed = double(tau_additional::util::getMonotonicNanoseconds() - start) / 1e9;
+
+    std::sort(results.latencies.begin(), results.latencies.end());
+    std::cout << connectionsCount << " connections, " << threadsCount << " threads, "
+        << elapsed << " s\n"
+        << "requests: " << results.requests << " (" << results.requests / elapsed << " per second), "
+        << "timeouts: " << results.timeouts << ", failed connections: " << results.failedConnections << "\n"
+        << "sent: " << results.bytesSent << " bytes, received: " << results.bytesReceived << " bytes\n"
+        << "latency, us: p50 " << getPercentile(results.latencies, 50) / 1000.0
+        << ", p99 " << getPercentile(results.latencies, 99) / 1000.0
+        << ", p999 " << getPercentile(results.latencies, 99.9) / 1000.0
+        << ", max " << (results.latencies.empty() ? 0 : results.latencies.back()) / 1000.0 << "\n";
+    return 0;
+}
@@ -0,0 +1,32 @@
+#!/bin/bash
+# Builds the POSIX and boost::asio servers of the sample, runs the load generator
+# against each of them and prints the results one after another.
+# Usage: run_against_samples.sh [script] [sample directory] [connections] [seconds] [threads]
+# Without the script, all the scenarios of the scenarios directory are run.
+cd "$(dirname "$0")"
+if [ -n "$1" ]; then
+    SCRIPTS=$(readlink -f "$1")
+else
+    SCRIPTS=$(ls $(pwd)/scenarios/*.txt)
+fi
+SAMPLE_DIR=${2:-../../habr_article_01/sample02-extendedDemo}
+CONNECTIONS=${3:-100}
+SECONDS_TO_RUN=${4:-10}
+THREADS=${5:-1}
+PORT=12345
+bash compile_gcc.sh || exit 1
+for SERVER in posix boost_asio; do
+    (cd $SAMPLE_DIR/$SERVER && bash compile_gcc_cpp11.sh) || exit 1
+    SERVER_BINARY=$(ls $SAMPLE_DIR/$SERVER/demo_gcc_* | head -1)
+    $SERVER_BINARY > /dev/null &
+    SERVER_PID=$!
+    sleep 1
+    for SCRIPT in $SCRIPTS; do
+        echo "=== $SAMPLE_DIR/$SERVER, $(basename $SCRIPT)"
+        ./benchmark_gcc_cpp11 $SCRIPT $PORT $CONNECTIONS $SECONDS_TO_RUN $THREADS
+    done
+    kill $SERVER_PID
+    wait $SERVER_PID 2>/dev/null
+    rm -f $SERVER_BINARY
+done
+rm -f benchmark_gcc_cpp11
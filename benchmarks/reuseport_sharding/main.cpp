@@ -0,0 +1,186 @@
+// This source file is part of the 'tau' open source project.
+// Copyright (c) 2016, Yuriy Vosel.
+// Licensed under Boost Software License.
+// See LICENSE.txt for the licence information.
+
+// The accept storm (as after a network outage, when all the clients reconnect at once) against the
+// ShardedServer with the different shards counts: all the connections are opened at once, every one
+// sends the request packet and waits for the reply. Reports the time till every client has got its
+// reply and how the kernel has spread the connections between the shards (SO_REUSEPORT).
+// The shards are pinned to the CPUs, so the time scales with the shards count only up to the CPUs count.
+// Usage: benchmark_gcc_cpp11 <file with the request packet> [connections] [max shards] [port]
+// The request packet is the one, which the real client sends (for example, a button click, dumped from
+// the tcp session with the tcpflow tool).
+
+#include <tau/util/basic_events_dispatcher.h>
+#include <tau_additional/util/epoll_server.h>
+#include <tau_additional/util/monotonic_clock.h>
+#include <tau_additional/util/sharded_server.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <vector>
+
+// Replies to every packet, which the client can send
+class ReplyingEventsDispatcher : public tau::util::BasicEventsDispatcher
+{
+public:
+    ReplyingEventsDispatcher(tau::communications_handling::OutgiongPacketsGenerator & outgoingGeneratorToUse):
+        tau::util::BasicEventsDispatcher(outgoingGeneratorToUse)
+    {};
+    virtual void packetReceived_clientDeviceInfo(tau::communications_handling::ClientDeviceInfo const & info) {
+        reply();
+    }
+    virtual void packetReceived_buttonClick(tau::common::ElementID const & buttonID) {
+        reply();
+    }
+    virtual void packetReceived_layoutPageSwitched(tau::common::LayoutPageID const & pageID) {
+        reply();
+    }
+    virtual void packetReceived_boolValueUpdate(tau::common::ElementID const & inputBoxID,
+        bool new_value, bool is_automatic_update) {
+        reply();
+    }
+    virtual void packetReceived_textValueUpdate(tau::common::ElementID const & inputBoxID,
+        std::string const & new_value, bool is_automatic_update) {
+        reply();
+    }
+private:
+    void reply() {
+        sendPacket_changeElementNote(tau::common::ElementID("REPLY_LABEL"), "reply");
+    }
+};
+
+typedef tau_additional::util::ShardedServer<tau_additional::util::EpollServer<ReplyingEventsDispatcher> > Server;
+
+namespace {
+    void * runServer(void * serverPointer) {
+        static_cast<Server *>(serverPointer)->run();
+        return NULL;
+    }
+
+    // Opens all the connections at once (the non-blocking connect), sends the request on every one,
+    // when it is connected. Returns the number of the clients, which have got the reply.
+    size_t runAcceptStorm(unsigned short port, std::string const & request, size_t connectionsCount) {
+        sockaddr_in address;
+        memset(&address, 0, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        address.sin_port = htons(port);
+        int epollHandle = epoll_create1(0);
+        std::vector<int> handles;
+        for (size_t i = 0; i < connectionsCount; ++i) {
+            int handle = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+            if (handle == -1) {
+                std::cerr << "Can't create the socket: " << strerror(errno) << "\n";
+                break;
+            }
+            if (connect(handle, (sockaddr*)(&address), sizeof(address)) == -1 && errno != EINPROGRESS) {
+                close(handle);
+                continue;
+            }
+            epoll_event event;
+            event.events = EPOLLOUT | EPOLLIN;
+            event.data.u64 = handles.size();
+            epoll_ctl(epollHandle, EPOLL_CTL_ADD, handle, &event);
+            handles.push_back(handle);
+        }
+        size_t replied = 0;
+        size_t failed = 0;
+        std::vector<epoll_event> events(256);
+        char buffer[4096];
+        while (replied + failed < handles.size()) {
+            int eventsCount = epoll_wait(epollHandle, &events[0], int(events.size()), 5000);
+            if (eventsCount <= 0) {
+                if (eventsCount == -1 && errno == EINTR) {
+                    continue;
+                }
+                break; // no progress for too long
+            }
+            for (int i = 0; i < eventsCount; ++i) {
+                int handle = handles[events[i].data.u64];
+                if (events[i].events & EPOLLERR) {
+                    ++failed;
+                    epoll_ctl(epollHandle, EPOLL_CTL_DEL, handle, NULL);
+                } else if (events[i].events & EPOLLIN) {
+                    if (recv(handle, buffer, sizeof(buffer), 0) > 0) {
+                        ++replied;
+                    } else {
+                        ++failed;
+                    }
+                    epoll_ctl(epollHandle, EPOLL_CTL_DEL, handle, NULL);
+                } else if (events[i].events & EPOLLOUT) {
+                    // Connected: the request is sent once, then only the reply is waited for
+                    send(handle, request.data(), request.size(), MSG_NOSIGNAL);
+                    epoll_event event = events[i];
+                    event.events = EPOLLIN;
+                    epoll_ctl(epollHandle, EPOLL_CTL_MOD, handle, &event);
+                }
+            }
+        }
+        for (size_t i = 0; i < handles.size(); ++i) {
+            close(handles[i]);
+        }
+        close(epollHandle);
+        return replied;
+    }
+
+    void runBenchmark(size_t shardsCount, unsigned short port, std::string const & request, size_t connectionsCount) {
+        Server server(port, tau_additional::util::EpollServerSettings(), shardsCount);
+        if (!server.start()) {
+            std::cerr << server.getLastError() << "\n";
+            return;
+        }
+        pthread_t thread;
+        pthread_create(&thread, NULL, runServer, &server);
+        uint64_t start = tau_additional::util::getMonotonicNanoseconds();
+        size_t replied = runAcceptStorm(port, request, connectionsCount);
+        uint64_t elapsed = tau_additional::util::getMonotonicNanoseconds() - start;
+        std::cout << shardsCount << " shard(s): " << replied << " of " << connectionsCount << " clients replied in "
+            << double(elapsed) / 1000000 << " ms; accepted by the shards:";
+        size_t minAccepted = connectionsCount;
+        size_t maxAccepted = 0;
+        for (size_t i = 0; i < server.getShardsCount(); ++i) {
+            size_t accepted = server.getShardAcceptedConnectionsCount(i);
+            minAccepted = (accepted < minAccepted) ? accepted : minAccepted;
+            maxAccepted = (accepted > maxAccepted) ? accepted : maxAccepted;
+            std::cout << " " << accepted << " (cpu " << server.getShardCpu(i) << ")";
+        }
+        std::cout << ", max/min " << (minAccepted ? double(maxAccepted) / minAccepted : 0) << "\n";
+        server.stop();
+        pthread_join(thread, NULL);
+    }
+};
+
+int main(int argc, char ** argv)
+{
+    if (argc < 2) {
+        std::cerr << "Usage: benchmark_gcc_cpp11 <file with the request packet> [connections] [max shards] [port]\n";
+        return -1;
+    }
+    std::ifstream input(argv[1], std::ios::binary);
+    std::string request((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+    size_t connectionsCount = (argc > 2) ? strtoul(argv[2], NULL, 10) : 2000;
+    size_t maxShards = (argc > 3) ? strtoul(argv[3], NULL, 10) : 8;
+    unsigned short port = (argc > 4) ? (unsigned short)(atoi(argv[4])) : 12348;
+    if (request.empty() || connectionsCount == 0 || maxShards == 0) {
+        std::cerr << "Nothing to send\n";
+        return -1;
+    }
+    std::cout << "CPUs online: " << sysconf(_SC_NPROCESSORS_ONLN) << "\n";
+    for (size_t shards = 1; shards <= maxShards; shards *= 2) {
+        runBenchmark(shards, port, request, connectionsCount);
+    }
+    return 0;
+}
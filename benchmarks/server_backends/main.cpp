@@ -0,0 +1,320 @@
+// This source file is part of the 'tau' open source project.
+// Copyright (c) 2016, Yuriy Vosel.
+// Licensed under Boost Software License.
+// See LICENSE.txt for the licence information.
+
+// Compares the server loops on the loopback: the blocking one (a thread per connection with the blocking
+// recv() and write() of every packet, as in the POSIX samples), the EpollServer and the IoUringServer.
+// The server runs in its own thread; the client keeps many connections open and sends the request packet
+// on every connection as soon as the reply to the previous one has arrived. The server replies to every
+// packet with a note change. Reports the requests per second, the mean request-to-reply time and, for
+// io_uring, the io_uring_enter() calls per request (to see the system calls of the other loops,
+// run the benchmark under 'strace -f -c').
+// Usage: benchmark_gcc_cpp11 <file with the request packet> [connections] [requests per connection] [port]
+// The request packet is the one, which the real client sends (for example, a button click, dumped from
+// the tcp session with the tcpflow tool).
+
+#include <tau/util/basic_events_dispatcher.h>
+#include <tau_additional/communications_handling/periodic_call.h>
+#include <tau_additional/communications_handling/raw_incoming_data_stream_parser.h>
+#include <tau_additional/util/epoll_server.h>
+#include <tau_additional/util/io_uring_server.h>
+#include <tau_additional/util/monotonic_clock.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <vector>
+
+// Replies to every packet, which the client can send
+class ReplyingEventsDispatcher : public tau::util::BasicEventsDispatcher
+{
+public:
+    ReplyingEventsDispatcher(tau::communications_handling::OutgiongPacketsGenerator & outgoingGeneratorToUse):
+        tau::util::BasicEventsDispatcher(outgoingGeneratorToUse)
+    {};
+    virtual void packetReceived_clientDeviceInfo(tau::communications_handling::ClientDeviceInfo const & info) {
+        reply();
+    }
+    virtual void packetReceived_buttonClick(tau::common::ElementID const & buttonID) {
+        reply();
+    }
+    virtual void packetReceived_layoutPageSwitched(tau::common::LayoutPageID const & pageID) {
+        reply();
+    }
+    virtual void packetReceived_boolValueUpdate(tau::common::ElementID const & inputBoxID,
+        bool new_value, bool is_automatic_update) {
+        reply();
+    }
+    virtual void packetReceived_textValueUpdate(tau::common::ElementID const & inputBoxID,
+        std::string const & new_value, bool is_automatic_update) {
+        reply();
+    }
+private:
+    void reply() {
+        sendPacket_changeElementNote(tau::common::ElementID("REPLY_LABEL"), "reply");
+    }
+};
+
+namespace {
+    volatile int g_stopRequested = 0;
+
+    // Stops the event loop server from its own thread
+    template <typename ServerType>
+    class StopChecker : public tau_additional::communications_handling::DelayedCallsScheduler::Callback
+    {
+        ServerType & m_server;
+    public:
+        StopChecker(ServerType & server): m_server(server) {};
+        virtual void onDelayedCall() {
+            if (__sync_fetch_and_add(&g_stopRequested, 0) != 0) {
+                m_server.stop();
+            }
+        }
+    };
+
+    template <typename ServerType, typename SettingsType>
+    struct EventLoopServerThread
+    {
+        static void * run(void * portPointer) {
+            SettingsType settings;
+            ServerType server(*static_cast<unsigned short *>(portPointer), settings);
+            if (!server.start()) {
+                std::cerr << server.getLastError() << "\n";
+                return NULL;
+            }
+            StopChecker<ServerType> stopChecker(server);
+            tau_additional::communications_handling::PeriodicCall stopChecks(
+                server.getScheduler(), stopChecker, uint64_t(10) * 1000000);
+            stopChecks.start();
+            server.run();
+            report(server);
+            return NULL;
+        }
+        static void report(tau_additional::util::EpollServer<ReplyingEventsDispatcher> const &) {}
+#ifdef TAU_ADDITIONAL_IO_URING_AVAILABLE
+        static void report(tau_additional::util::IoUringServer<ReplyingEventsDispatcher> const & server) {
+            tau_additional::util::IoUringServer<ReplyingEventsDispatcher>::Statistics statistics = server.getStatistics();
+            std::cout << "    io_uring: " << statistics.enterCalls << " io_uring_enter() calls, "
+                << statistics.completions << " completions, " << statistics.submittedEntries << " submissions\n";
+        }
+#endif
+    };
+
+    // The way of the POSIX samples: every packet is written right away
+    class ImmediateOutgoingPacketsGenerator : public tau::communications_handling::OutgiongPacketsGenerator
+    {
+        int m_socketHandle;
+    public:
+        ImmediateOutgoingPacketsGenerator(int socketHandle): m_socketHandle(socketHandle) {};
+        virtual void sendData(std::string const & data) {
+            send(m_socketHandle, data.data(), data.size(), MSG_NOSIGNAL);
+        }
+        virtual void close_connection() {
+            shutdown(m_socketHandle, SHUT_RDWR);
+        }
+    };
+
+    void * serveBlockingConnection(void * handlePointer) {
+        int handle = int(reinterpret_cast<intptr_t>(handlePointer));
+        ImmediateOutgoingPacketsGenerator generator(handle);
+        ReplyingEventsDispatcher dispatcher(generator);
+        tau_additional::communications_handling::RawIncomingDataStreamParser parser;
+        std::vector<char> buffer(64 * 1024);
+        ssize_t received;
+        while ((received = recv(handle, &buffer[0], buffer.size(), 0)) > 0) {
+            parser.newData(&buffer[0], received, dispatcher);
+        }
+        close(handle);
+        return NULL;
+    }
+
+    int g_blockingListenHandle = -1;
+
+    void * runBlockingServer(void * portPointer) {
+        std::vector<pthread_t> threads;
+        while (true) {
+            int handle = accept(g_blockingListenHandle, NULL, NULL);
+            if (handle == -1) {
+                if (errno == EINTR || errno == ECONNABORTED) {
+                    continue;
+                }
+                break; // the listening socket is shut down
+            }
+            pthread_t thread;
+            if (pthread_create(&thread, NULL, serveBlockingConnection, reinterpret_cast<void *>(intptr_t(handle))) == 0) {
+                threads.push_back(thread);
+            } else {
+                close(handle);
+            }
+        }
+        for (size_t i = 0; i < threads.size(); ++i) {
+            pthread_join(threads[i], NULL);
+        }
+        return NULL;
+    }
+
+    bool startBlockingServer(unsigned short port) {
+        g_blockingListenHandle = socket(AF_INET, SOCK_STREAM, 0);
+        int reuseAddr = 1;
+        setsockopt(g_blockingListenHandle, SOL_SOCKET, SO_REUSEADDR, &reuseAddr, sizeof(reuseAddr));
+        sockaddr_in address;
+        memset(&address, 0, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = INADDR_ANY;
+        address.sin_port = htons(port);
+        return bind(g_blockingListenHandle, (sockaddr*)(&address), sizeof(address)) == 0
+            && listen(g_blockingListenHandle, SOMAXCONN) == 0;
+    }
+
+    int connectToServer(unsigned short port) {
+        sockaddr_in address;
+        memset(&address, 0, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        address.sin_port = htons(port);
+        for (int attempt = 0; attempt < 100; ++attempt) {
+            int handle = socket(AF_INET, SOCK_STREAM, 0);
+            if (connect(handle, (sockaddr*)(&address), sizeof(address)) == 0) {
+                int noDelay = 1;
+                setsockopt(handle, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+                return handle;
+            }
+            close(handle);
+            usleep(10000); // the server thread is starting
+        }
+        return -1;
+    }
+
+    // Every connection has one request in flight; any received data is the reply.
+    // Returns false if the server has not replied.
+    bool runClient(unsigned short port, std::string const & request, size_t connectionsCount,
+        size_t requestsPerConnection, double & requestsPerSecond, double & meanMicroseconds)
+    {
+        std::vector<int> handles;
+        std::vector<size_t> requestsLeft(connectionsCount, requestsPerConnection);
+        std::vector<uint64_t> requestStart(connectionsCount, 0);
+        int epollHandle = epoll_create1(0);
+        for (size_t i = 0; i < connectionsCount; ++i) {
+            int handle = connectToServer(port);
+            if (handle == -1) {
+                std::cerr << "Can't connect: " << strerror(errno) << "\n";
+                return false;
+            }
+            handles.push_back(handle);
+            epoll_event event;
+            event.events = EPOLLIN;
+            event.data.u64 = i;
+            epoll_ctl(epollHandle, EPOLL_CTL_ADD, handle, &event);
+        }
+        uint64_t start = tau_additional::util::getMonotonicNanoseconds();
+        for (size_t i = 0; i < connectionsCount; ++i) {
+            requestStart[i] = tau_additional::util::getMonotonicNanoseconds();
+            send(handles[i], request.data(), request.size(), MSG_NOSIGNAL);
+        }
+        size_t activeConnections = connectionsCount;
+        uint64_t totalLatency = 0;
+        uint64_t repliesCount = 0;
+        std::vector<epoll_event> events(256);
+        std::vector<char> buffer(64 * 1024);
+        while (activeConnections > 0) {
+            int eventsCount = epoll_wait(epollHandle, &events[0], int(events.size()), 5000);
+            if (eventsCount <= 0) {
+                if (eventsCount == -1 && errno == EINTR) {
+                    continue;
+                }
+                break; // no replies for too long
+            }
+            for (int i = 0; i < eventsCount; ++i) {
+                size_t connection = size_t(events[i].data.u64);
+                if (recv(handles[connection], &buffer[0], buffer.size(), 0) <= 0) {
+                    activeConnections = 0;
+                    break;
+                }
+                uint64_t now = tau_additional::util::getMonotonicNanoseconds();
+                totalLatency += now - requestStart[connection];
+                ++repliesCount;
+                if (--requestsLeft[connection] == 0) {
+                    --activeConnections;
+                    continue;
+                }
+                requestStart[connection] = now;
+                send(handles[connection], request.data(), request.size(), MSG_NOSIGNAL);
+            }
+        }
+        uint64_t elapsed = tau_additional::util::getMonotonicNanoseconds() - start;
+        for (size_t i = 0; i < handles.size(); ++i) {
+            close(handles[i]);
+        }
+        close(epollHandle);
+        requestsPerSecond = double(repliesCount) * 1e9 / double(elapsed ? elapsed : 1);
+        meanMicroseconds = repliesCount ? double(totalLatency) / repliesCount / 1000 : 0;
+        return repliesCount == connectionsCount * requestsPerConnection;
+    }
+
+    void runBenchmark(char const * name, void * (* serverThread)(void *), unsigned short port,
+        std::string const & request, size_t connectionsCount, size_t requestsPerConnection)
+    {
+        __sync_lock_test_and_set(&g_stopRequested, 0);
+        pthread_t thread;
+        pthread_create(&thread, NULL, serverThread, &port);
+        double requestsPerSecond = 0;
+        double meanMicroseconds = 0;
+        bool completed = runClient(port, request, connectionsCount, requestsPerConnection,
+            requestsPerSecond, meanMicroseconds);
+        std::cout << name << requestsPerSecond << " requests/s, " << meanMicroseconds << " us per request"
+            << (completed ? "" : " (NOT ALL REPLIES RECEIVED)") << "\n";
+        __sync_lock_test_and_set(&g_stopRequested, 1);
+        if (serverThread == runBlockingServer) {
+            shutdown(g_blockingListenHandle, SHUT_RDWR);
+        }
+        pthread_join(thread, NULL);
+        if (serverThread == runBlockingServer) {
+            close(g_blockingListenHandle);
+        }
+    }
+};
+
+int main(int argc, char ** argv)
+{
+    if (argc < 2) {
+        std::cerr << "Usage: benchmark_gcc_cpp11 <file with the request packet> [connections] "
+            "[requests per connection] [port]\n";
+        return -1;
+    }
+    std::ifstream input(argv[1], std::ios::binary);
+    std::string request((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+    size_t connectionsCount = (argc > 2) ? strtoul(argv[2], NULL, 10) : 100;
+    size_t requestsPerConnection = (argc > 3) ? strtoul(argv[3], NULL, 10) : 200;
+    unsigned short port = (argc > 4) ? (unsigned short)(atoi(argv[4])) : 12347;
+    if (request.empty() || connectionsCount == 0 || requestsPerConnection == 0) {
+        std::cerr << "Nothing to send\n";
+        return -1;
+    }
+    std::cout << connectionsCount << " connections, " << requestsPerConnection << " requests each\n";
+
+    if (startBlockingServer(port)) {
+        runBenchmark("blocking: ", runBlockingServer, port, request, connectionsCount, requestsPerConnection);
+    } else {
+        std::cerr << "Can't start the blocking server: " << strerror(errno) << "\n";
+    }
+    runBenchmark("epoll:    ", EventLoopServerThread<tau_additional::util::EpollServer<ReplyingEventsDispatcher>,
+        tau_additional::util::EpollServerSettings>::run, port, request, connectionsCount, requestsPerConnection);
+#ifdef TAU_ADDITIONAL_IO_URING_AVAILABLE
+    runBenchmark("io_uring: ", EventLoopServerThread<tau_additional::util::IoUringServer<ReplyingEventsDispatcher>,
+        tau_additional::util::IoUringServerSettings>::run, port, request, connectionsCount, requestsPerConnection);
+#else
+    std::cout << "io_uring: not supported by this build\n";
+#endif
+    return 0;
+}
@@ -0,0 +1,119 @@
+// This source file is part of the 'tau' open source project.
+// Copyright (c) 2016, Yuriy Vosel.
+// Licensed under Boost Software License.
+// See LICENSE.txt for the licence information.
+
+// The layout of the sample02-extendedDemo, defined with the compile-time static_layout DSL.
+// Checks that the result is the same as the one of the runtime layout builder, and compares
+// the handshake cost: building and serializing the layout for every client versus sending
+// the constant packet.
+// Usage: benchmark_gcc_cpp11 [handshakes]
+
+#include <tau/layout_generation/layout_info.h>
+#include <tau_additional/layout_generation/static_layout.h>
+#include <tau_additional/communications_handling/packet_serializer.h>
+#include <tau_additional/util/monotonic_clock.h>
+#include <iostream>
+#include <stdlib.h>
+
+namespace {
+    namespace sl = tau_additional::layout_generation::static_layout;
+
+    constexpr char INITIAL_TEXT_VALUE[] = "initial text";
+
+    constexpr auto SAMPLE_LAYOUT = sl::layout("LAYOUT_PAGE_1",
+        sl::page("LAYOUT_PAGE_1", sl::evenlySplit(true,
+            sl::evenlySplit(false,
+                sl::booleanInput(true, INITIAL_TEXT_VALUE, "BOOL_INPUT"),
+                sl::button(INITIAL_TEXT_VALUE, "BUTTON_WITH_NOTE_TO_REPLACE")),
+            sl::textInput("TEXT_INPUT", INITIAL_TEXT_VALUE),
+            sl::emptySpace(),
+            sl::emptySpace(),
+            sl::emptySpace(),
+            sl::evenlySplit(false,
+                sl::button("reset notes", "BUTTON_TO_RESET_NOTES"),
+                sl::emptySpace(),
+                sl::button("go to page 2", "BUTTON_TO_PG2").switchToPage("LAYOUT_PAGE_2")))),
+        sl::page("LAYOUT_PAGE_2", sl::evenlySplit(true,
+            sl::evenlySplit(false,
+                sl::button("1", "BUTTON_1"),
+                sl::button("2", "BUTTON_2")),
+            sl::evenlySplit(false,
+                sl::button("3", "BUTTON_3"),
+                sl::button("4", "BUTTON_4")),
+            sl::evenlySplit(true,
+                sl::label("", "LABEL_ON_PAGE2"),
+                sl::button("back to page 1", "BUTTON_TO_PG1")))));
+    TAU_STATIC_LAYOUT_CHECK(SAMPLE_LAYOUT);
+    // Any of these would fail the compilation:
+    //     sl::button("5", "BUTTON_1")                           - duplicate element id
+    //     sl::button("x", "BUTTON_TO_PG3").switchToPage("LAYOUT_PAGE_3") - no such page
+
+    // Same layout, as it is built in the sample
+    std::string buildLayoutJson()
+    {
+        using namespace tau::layout_generation;
+        LayoutInfo resultLayout;
+        resultLayout.pushLayoutPage(LayoutPage(tau::common::LayoutPageID("LAYOUT_PAGE_1"),
+            EvenlySplitLayoutElementsContainer(true)
+                .push(EvenlySplitLayoutElementsContainer(false)
+                    .push(BooleanInputLayoutElement(true).note(INITIAL_TEXT_VALUE)
+                        .ID(tau::common::ElementID("BOOL_INPUT")))
+                    .push(ButtonLayoutElement().note(INITIAL_TEXT_VALUE)
+                        .ID(tau::common::ElementID("BUTTON_WITH_NOTE_TO_REPLACE"))))
+                .push(TextInputLayoutElement().ID(tau::common::ElementID("TEXT_INPUT"))
+                    .initialValue(INITIAL_TEXT_VALUE))
+                .push(EmptySpace())
+                .push(EmptySpace())
+                .push(EmptySpace())
+                .push(EvenlySplitLayoutElementsContainer(false)
+                    .push(ButtonLayoutElement().note("reset notes").ID(tau::common::ElementID("BUTTON_TO_RESET_NOTES")))
+                    .push(EmptySpace())
+                    .push(ButtonLayoutElement().note("go to page 2").ID(tau::common::ElementID("BUTTON_TO_PG2"))
+                        .switchToAnotherLayoutPageOnClick(tau::common::LayoutPageID("LAYOUT_PAGE_2"))))
+        ));
+        resultLayout.pushLayoutPage(LayoutPage(tau::common::LayoutPageID("LAYOUT_PAGE_2"),
+            EvenlySplitLayoutElementsContainer(true)
+                .push(EvenlySplitLayoutElementsContainer(false)
+                    .push(ButtonLayoutElement().note("1").ID(tau::common::ElementID("BUTTON_1")))
+                    .push(ButtonLayoutElement().note("2").ID(tau::common::ElementID("BUTTON_2"))))
+                .push(EvenlySplitLayoutElementsContainer(false)
+                    .push(ButtonLayoutElement().note("3").ID(tau::common::ElementID("BUTTON_3")))
+                    .push(ButtonLayoutElement().note("4").ID(tau::common::ElementID("BUTTON_4"))))
+                .push(EvenlySplitLayoutElementsContainer(true)
+                    .push(LabelElement("").ID(tau::common::ElementID("LABEL_ON_PAGE2")))
+                    .push(ButtonLayoutElement().note("back to page 1").ID(tau::common::ElementID("BUTTON_TO_PG1"))))
+        ));
+        resultLayout.setStartLayoutPage(tau::common::LayoutPageID("LAYOUT_PAGE_1"));
+        return resultLayout.getJson();
+    }
+};
+
+int main(int argc, char ** argv)
+{
+    size_t handshakesCount = (argc > 1) ? strtoul(argv[1], NULL, 10) : 100000;
+    tau_additional::util::SharedBuffer const constantPacket = sl::makeResetLayoutPacket(SAMPLE_LAYOUT);
+    tau_additional::communications_handling::PacketSerializer serializer;
+    std::cout << "same JSON as the runtime builder: "
+        << ((sl::getJson(SAMPLE_LAYOUT) == buildLayoutJson()) ? "yes" : "NO") << ", packet size: "
+        << constantPacket.size() << " bytes\n";
+
+    size_t bytes = 0;
+    uint64_t start = tau_additional::util::getMonotonicNanoseconds();
+    for (size_t i = 0; i < handshakesCount; ++i) {
+        bytes += serializer.resetLayout(buildLayoutJson()).size();
+    }
+    uint64_t runtimeTime = tau_additional::util::getMonotonicNanoseconds() - start;
+
+    start = tau_additional::util::getMonotonicNanoseconds();
+    for (size_t i = 0; i < handshakesCount; ++i) {
+        tau_additional::util::SharedBuffer packet(constantPacket); // what the connection queues
+        bytes += packet.size();
+    }
+    uint64_t constantTime = tau_additional::util::getMonotonicNanoseconds() - start;
+
+    std::cout << handshakesCount << " handshakes: built at runtime "
+        << double(runtimeTime) / handshakesCount << " ns/handshake, constant packet "
+        << double(constantTime) / handshakesCount << " ns/handshake (" << bytes << " bytes)\n";
+    return 0;
+}
@@ -0,0 +1,4 @@
+#!/bin/bash
+LIBRARY_LOCATION=../../../src/cpp/
+ADDITIONAL_LIBRARY_LOCATION=../../src/cpp/
+g++ -std=c++11 -O2 -D TAU_HEADERONLY -I $LIBRARY_LOCATION -I $ADDITIONAL_LIBRARY_LOCATION main.cpp -o benchmark_gcc_cpp11 -lz
@@ -0,0 +1,185 @@
+// This source file is part of the 'tau' open source project.
+// Copyright (c) 2016, Yuriy Vosel.
+// Licensed under Boost Software License.
+// See LICENSE.txt for the licence information.
+
+// What the StreamCompressor does to the layout resets and to the small packets of one connection:
+// the wire size of the first reset (the cold compression context) and of the repeated one (the warm
+// context), the compression time, and the transfer time over a slow link. The synthetic layouts are
+// 'production-like': rows of buttons, inputs and labels with the unique ids. Every compressed stream
+// is unpacked by the StreamDecompressor and compared with the original packets.
+// Usage: benchmark_gcc_cpp11 [link kbit/s] [repetitions]
+
+#include <tau/layout_generation/layout_info.h>
+#include <tau/util/basic_events_dispatcher.h>
+#include <tau_additional/communications_handling/packet_serializer.h>
+#include <tau_additional/communications_handling/stream_compression.h>
+#include <tau_additional/util/monotonic_clock.h>
+#include <iostream>
+#include <sstream>
+#include <stdlib.h>
+
+namespace {
+    std::string getElementName(char const * prefix, size_t index) {
+        std::ostringstream result;
+        result << prefix << index;
+        return result.str();
+    }
+
+    // Pages of 10 rows, 10 elements each: buttons, text and boolean inputs, labels, empty spaces
+    std::string buildLayoutJson(size_t elementsCount)
+    {
+        using namespace tau::layout_generation;
+        static const size_t ELEMENTS_PER_ROW = 10;
+        static const size_t ROWS_PER_PAGE = 10;
+        LayoutInfo resultLayout;
+        size_t element = 0;
+        for (size_t page = 0; element < elementsCount; ++page) {
+            EvenlySplitLayoutElementsContainer rows(true);
+            for (size_t row = 0; row < ROWS_PER_PAGE && element < elementsCount; ++row) {
+                EvenlySplitLayoutElementsContainer columns(false);
+                for (size_t column = 0; column < ELEMENTS_PER_ROW && element < elementsCount; ++column, ++element) {
+                    tau::common::ElementID id(getElementName("ELEMENT_", element));
+                    switch (element % 5) {
+                        case 0: columns.push(ButtonLayoutElement().note(getElementName("Button ", element)).ID(id)); break;
+                        case 1: columns.push(TextInputLayoutElement().ID(id).initialValue("")); break;
+                        case 2: columns.push(BooleanInputLayoutElement(false).note("enabled").ID(id)); break;
+                        case 3: columns.push(LabelElement(getElementName("Value ", element)).ID(id)); break;
+                        default: columns.push(EmptySpace()); break;
+                    }
+                }
+                rows.push(columns);
+            }
+            resultLayout.pushLayoutPage(LayoutPage(tau::common::LayoutPageID(getElementName("PAGE_", page)), rows));
+        }
+        resultLayout.setStartLayoutPage(tau::common::LayoutPageID("PAGE_0"));
+        return resultLayout.getJson();
+    }
+
+    // The reset layout packet, as the BasicEventsDispatcher sends it
+    class PacketCapture : public tau::communications_handling::OutgiongPacketsGenerator
+    {
+    public:
+        std::string m_data;
+        virtual void sendData(std::string const & data) {
+            m_data += data;
+        }
+        virtual void close_connection() {}
+    };
+    class ResetLayoutSender : public tau::util::BasicEventsDispatcher
+    {
+    public:
+        ResetLayoutSender(tau::communications_handling::OutgiongPacketsGenerator & outgoingGeneratorToUse):
+            tau::util::BasicEventsDispatcher(outgoingGeneratorToUse)
+        {};
+        void send(std::string const & layoutJson) {
+            sendPacket_resetLayout(layoutJson);
+        }
+    };
+
+    std::string getResetLayoutPacket(std::string const & layoutJson) {
+        PacketCapture capture;
+        ResetLayoutSender(capture).send(layoutJson);
+        return capture.m_data;
+    }
+
+    double getTransferMilliseconds(size_t bytes, unsigned linkKbits) {
+        return double(bytes) * 8 / linkKbits;
+    }
+
+    void runLayoutBenchmark(size_t elementsCount, unsigned linkKbits, size_t repetitions)
+    {
+        using namespace tau_additional::communications_handling;
+        std::string packet = getResetLayoutPacket(buildLayoutJson(elementsCount));
+
+        StreamCompressor compressor;
+        StreamDecompressor decompressor;
+        std::string stream;
+        compressor.appendStreamHeader(stream);
+        size_t streamSize = stream.size();
+        compressor.compress(packet.data(), packet.size(), stream);
+        size_t coldSize = stream.size() - streamSize;
+        streamSize = stream.size();
+        compressor.compress(packet.data(), packet.size(), stream);
+        size_t warmSize = stream.size() - streamSize;
+        std::string unpacked;
+        bool roundTrip = decompressor.decompress(stream.data(), stream.size(), unpacked) && (unpacked == packet + packet);
+
+        // The resets one after another, on the same (warm) connection
+        std::string output;
+        uint64_t start = tau_additional::util::getMonotonicNanoseconds();
+        for (size_t i = 0; i < repetitions; ++i) {
+            output.clear();
+            compressor.compress(packet.data(), packet.size(), output);
+        }
+        uint64_t compressTime = tau_additional::util::getMonotonicNanoseconds() - start;
+
+        std::cout << elementsCount << " elements: reset " << packet.size() << " bytes ("
+            << getTransferMilliseconds(packet.size(), linkKbits) << " ms), first compressed " << coldSize << " bytes ("
+            << getTransferMilliseconds(coldSize, linkKbits) << " ms, x" << double(packet.size()) / coldSize
+            << "), repeated " << warmSize << " bytes (x" << double(packet.size()) / warmSize << "), "
+            << double(compressTime) / repetitions / 1000 << " us per reset, round trip "
+            << (roundTrip ? "ok" : "FAILED") << "\n";
+    }
+
+    void runSmallPacketsBenchmark(size_t packetsCount)
+    {
+        using namespace tau_additional::communications_handling;
+        PacketSerializer serializer;
+        StreamCompressor compressor(0); // every packet compressed
+        StreamCompressor defaultCompressor;
+        StreamDecompressor decompressor;
+        std::string original;
+        uint64_t packetsBytes = 0;
+        uint64_t compressedBytes = 0;
+        uint64_t passedBytes = 0;
+        uint64_t compressTime = 0;
+        for (size_t i = 0; i < packetsCount; ++i) {
+            std::string packet = serializer.changeElementNote(
+                tau::common::ElementID(getElementName("ELEMENT_", (i * 7) % 1000)), getElementName("Value ", i));
+            std::string frame;
+            uint64_t start = tau_additional::util::getMonotonicNanoseconds();
+            compressor.compress(packet.data(), packet.size(), frame);
+            compressTime += tau_additional::util::getMonotonicNanoseconds() - start;
+            packetsBytes += packet.size();
+            compressedBytes += frame.size();
+            std::string passedFrame;
+            defaultCompressor.compress(packet.data(), packet.size(), passedFrame);
+            passedBytes += passedFrame.size();
+            if (i < 1000) {
+                original += packet;
+            }
+        }
+        // The first packets are compressed once more, as the complete stream, and unpacked
+        StreamCompressor checkCompressor(0);
+        std::string checkStream;
+        checkCompressor.appendStreamHeader(checkStream);
+        for (size_t i = 0; i < 1000 && i < packetsCount; ++i) {
+            std::string packet = serializer.changeElementNote(
+                tau::common::ElementID(getElementName("ELEMENT_", (i * 7) % 1000)), getElementName("Value ", i));
+            checkCompressor.compress(packet.data(), packet.size(), checkStream);
+        }
+        std::string unpacked;
+        bool roundTrip = decompressor.decompress(checkStream.data(), checkStream.size(), unpacked) && (unpacked == original);
+
+        std::cout << "note packets: " << double(packetsBytes) / packetsCount << " bytes, compressed "
+            << double(compressedBytes) / packetsCount << " bytes (" << double(compressTime) / packetsCount
+            << " ns), below the default threshold " << double(passedBytes) / packetsCount << " bytes, round trip "
+            << (roundTrip ? "ok" : "FAILED") << "\n";
+    }
+};
+
+int main(int argc, char ** argv)
+{
+    unsigned linkKbits = (argc > 1) ? unsigned(atoi(argv[1])) : 256;
+    size_t repetitions = (argc > 2) ? strtoul(argv[2], NULL, 10) : 200;
+    if (linkKbits == 0) {
+        linkKbits = 256;
+    }
+    std::cout << "link: " << linkKbits << " kbit/s\n";
+    runLayoutBenchmark(100, linkKbits, repetitions * 10);
+    runLayoutBenchmark(400, linkKbits, repetitions);
+    runLayoutBenchmark(1000, linkKbits, repetitions);
+    runSmallPacketsBenchmark(repetitions * 500);
+    return 0;
+}
@@ -0,0 +1,192 @@
+// This source file is part of the 'tau' open source project.
+// Copyright (c) 2016, Yuriy Vosel.
+// Licensed under Boost Software License.
+// See LICENSE.txt for the licence information.
+
+// Sends the big layout (200000 elements by default: pages of 10 rows, 10 elements each) to the client
+// over the loopback, as the 'reset layout' packet, in two ways: serialized into one string at once
+// (sendPacket_resetLayout(layout.getJson()), as the tau samples do) and streamed (sendLayoutReset(),
+// the layout is serialized chunk by chunk into the connection's outgoing queue, while it is sent).
+// Reports the time to the first byte and to the last byte of the packet, as the client sees them, and
+// the peak RSS of the process over the RSS after the layout is built (every way is measured in its
+// own process, so the peaks do not hide each other).
+// The dispatcher sends a note after the layout: the client checks that it comes after the whole packet.
+// Usage: benchmark_gcc_cpp11 [elements] [chunk size] [port]
+
+#include <tau/util/basic_events_dispatcher.h>
+#include <tau_additional/communications_handling/packet_serializer.h>
+#include <tau_additional/layout_generation/arena_layout_builder.h>
+#include <tau_additional/layout_generation/streaming_layout_writer.h>
+#include <tau_additional/util/epoll_server.h>
+#include <tau_additional/util/monotonic_arena.h>
+#include <tau_additional/util/monotonic_clock.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+namespace {
+    static const size_t ELEMENTS_PER_ROW = 10;
+    static const size_t ROWS_PER_PAGE = 10;
+
+    tau_additional::layout_generation::ArenaLayoutBuilder * g_layout = NULL;
+    bool g_streamed = false;
+    size_t g_chunkSize = tau_additional::layout_generation::LayoutResetStream::DEFAULT_CHUNK_SIZE;
+};
+
+// Sends the layout, when the client sends its device info
+class LayoutSendingDispatcher : public tau::util::BasicEventsDispatcher
+{
+    tau::communications_handling::OutgiongPacketsGenerator & m_outgoingGenerator;
+public:
+    LayoutSendingDispatcher(tau::communications_handling::OutgiongPacketsGenerator & outgoingGeneratorToUse):
+        tau::util::BasicEventsDispatcher(outgoingGeneratorToUse), m_outgoingGenerator(outgoingGeneratorToUse)
+    {};
+    virtual void packetReceived_clientDeviceInfo(tau::communications_handling::ClientDeviceInfo const & info) {
+        if (g_streamed) {
+            tau_additional::layout_generation::sendLayoutReset(m_outgoingGenerator, *g_layout, g_chunkSize);
+        } else {
+            sendPacket_resetLayout(g_layout->getJson());
+        }
+        sendPacket_changeElementNote(tau::common::ElementID("STATUS_LABEL"), "layout sent");
+    }
+};
+
+typedef tau_additional::util::EpollServer<LayoutSendingDispatcher> Server;
+
+namespace {
+    void * runServer(void * serverPointer) {
+        static_cast<Server *>(serverPointer)->run();
+        return NULL;
+    }
+
+    std::string getElementName(char const * prefix, size_t index) {
+        std::ostringstream result;
+        result << prefix << index;
+        return result.str();
+    }
+
+    void buildLayout(tau_additional::layout_generation::ArenaLayoutBuilder & layout, size_t elementsCount) {
+        size_t pagesCount = (elementsCount + ELEMENTS_PER_ROW * ROWS_PER_PAGE - 1) / (ELEMENTS_PER_ROW * ROWS_PER_PAGE);
+        size_t element = 0;
+        for (size_t page = 0; page < pagesCount; ++page) {
+            tau_additional::layout_generation::ArenaLayoutBuilder::Element rows = layout.evenlySplit(false);
+            for (size_t row = 0; row < ROWS_PER_PAGE && element < elementsCount; ++row) {
+                tau_additional::layout_generation::ArenaLayoutBuilder::Element columns = layout.evenlySplit(true);
+                for (size_t column = 0; column < ELEMENTS_PER_ROW && element < elementsCount; ++column, ++element) {
+                    columns.push(layout.button().note(getElementName("Element #", element))
+                        .ID(tau::common::ElementID(getElementName("ELEMENT_", element))));
+                }
+                rows.push(columns);
+            }
+            layout.pushLayoutPage(tau::common::LayoutPageID(getElementName("PAGE_", page)), rows);
+        }
+        layout.setStartLayoutPage(tau::common::LayoutPageID("PAGE_0"));
+    }
+
+    // VmRSS or VmHWM from /proc/self/status, in KB
+    size_t getMemoryStatus(char const * name) {
+        std::ifstream status("/proc/self/status");
+        std::string line;
+        while (std::getline(status, line)) {
+            if (line.compare(0, strlen(name), name) == 0 && line.size() > strlen(name) && line[strlen(name)] == ':') {
+                return strtoul(line.c_str() + strlen(name) + 1, NULL, 10);
+            }
+        }
+        return 0;
+    }
+
+    // Runs in its own process: the server thread and the client in the main thread
+    int runMeasurement(unsigned short port) {
+        std::ofstream("/proc/self/clear_refs") << "5"; // resets VmHWM (Linux 4.0+)
+        size_t baselineKilobytes = getMemoryStatus("VmRSS");
+        std::string note = tau_additional::communications_handling::PacketSerializer()
+            .changeElementNote(tau::common::ElementID("STATUS_LABEL"), "layout sent");
+        size_t expectedSize = tau_additional::communications_handling::PacketSerializer().resetLayout("").size()
+            + g_layout->getJsonSize() + note.size();
+        Server server(port, tau_additional::util::EpollServerSettings());
+        if (!server.start()) {
+            std::cerr << server.getLastError() << "\n";
+            return -1;
+        }
+        pthread_t thread;
+        pthread_create(&thread, NULL, runServer, &server);
+        sockaddr_in address;
+        memset(&address, 0, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        address.sin_port = htons(port);
+        int handle = socket(AF_INET, SOCK_STREAM, 0);
+        if (connect(handle, (sockaddr*)(&address), sizeof(address)) == -1) {
+            std::cerr << "Can't connect: " << strerror(errno) << "\n";
+            return -1;
+        }
+        std::string request = "info|benchmark\n";
+        uint64_t start = tau_additional::util::getMonotonicNanoseconds();
+        send(handle, request.data(), request.size(), MSG_NOSIGNAL);
+        uint64_t firstByteTime = 0;
+        size_t received = 0;
+        std::string tail; // the end of the data, to check the note
+        char buffer[64 * 1024];
+        while (received < expectedSize) {
+            ssize_t result = recv(handle, buffer, sizeof(buffer), 0);
+            if (result <= 0) {
+                break;
+            }
+            if (received == 0) {
+                firstByteTime = tau_additional::util::getMonotonicNanoseconds();
+            }
+            received += size_t(result);
+            tail.append(buffer, size_t(result));
+            if (tail.size() > note.size()) {
+                tail.erase(0, tail.size() - note.size());
+            }
+        }
+        uint64_t lastByteTime = tau_additional::util::getMonotonicNanoseconds();
+        close(handle);
+        server.stop();
+        pthread_join(thread, NULL);
+        std::cout << (g_streamed ? "Streamed:     " : "One string:   ")
+            << "first byte " << double(firstByteTime - start) / 1000000 << " ms, last byte "
+            << double(lastByteTime - start) / 1000000 << " ms, peak RSS over the layout "
+            << (getMemoryStatus("VmHWM") - baselineKilobytes) / 1024.0 << " MB"
+            << ((received == expectedSize && tail == note) ? "" : " (the packets are broken)") << "\n";
+        return 0;
+    }
+};
+
+int main(int argc, char ** argv)
+{
+    size_t elementsCount = (argc > 1) ? strtoul(argv[1], NULL, 10) : 200000;
+    if (argc > 2) {
+        g_chunkSize = strtoul(argv[2], NULL, 10);
+    }
+    unsigned short port = (argc > 3) ? (unsigned short)(atoi(argv[3])) : 12350;
+    tau_additional::util::MonotonicArena arena;
+    tau_additional::layout_generation::ArenaLayoutBuilder layout(arena);
+    buildLayout(layout, elementsCount);
+    g_layout = &layout;
+    std::cout << elementsCount << " elements, the layout JSON is " << layout.getJsonSize() / 1024.0 / 1024.0
+        << " MB, chunk size " << g_chunkSize << "\n";
+    for (int streamed = 0; streamed < 2; ++streamed) {
+        std::cout.flush();
+        pid_t child = fork();
+        if (child == 0) {
+            g_streamed = (streamed != 0);
+            return runMeasurement(port);
+        }
+        int status = 0;
+        waitpid(child, &status, 0);
+    }
+    return 0;
+}
@@ -0,0 +1,126 @@
+// This source file is part of the 'tau' open source project.
+// Copyright (c) 2016, Yuriy Vosel.
+// Licensed under Boost Software License.
+// See LICENSE.txt for the licence information.
+
+// Compares the periodic timers cost: the TimingWheel (used by the servers for the delayed calls)
+// versus the ordered std::multimap of the deadlines (the previous EpollServer implementation).
+// Every timer refreshes a dashboard element with its own period (100..1000 ms), the simulated
+// time goes by 1 ms ticks; the time of the scheduling and the expiration handling is measured.
+// Usage: benchmark_gcc_cpp11 [simulated seconds]
+
+#include <tau_additional/util/timing_wheel.h>
+#include <tau_additional/util/monotonic_clock.h>
+#include <iostream>
+#include <map>
+#include <vector>
+#include <stdlib.h>
+
+namespace {
+    uint64_t const MILLISECOND = 1000000;
+
+    class PeriodicWheelTimer : public tau_additional::util::TimingWheel::Timer
+    {
+        tau_additional::util::TimingWheel * m_wheel;
+        uint64_t m_period;
+        uint64_t m_deadline;
+    public:
+        size_t m_firedCount;
+        PeriodicWheelTimer(): m_wheel(NULL), m_period(0), m_deadline(0), m_firedCount(0) {};
+
+        void start(tau_additional::util::TimingWheel & wheel, uint64_t period, uint64_t now) {
+            m_wheel = &wheel;
+            m_period = period;
+            m_deadline = now + period;
+            wheel.schedule(*this, m_deadline);
+        }
+        virtual void onTimerExpired() {
+            ++m_firedCount;
+            m_deadline += m_period;
+            m_wheel->schedule(*this, m_deadline);
+        }
+    };
+
+    struct MapTimer
+    {
+        MapTimer(): period(0), firedCount(0) {};
+        uint64_t period;
+        size_t firedCount;
+    };
+    typedef std::multimap<uint64_t, MapTimer *> MapTimers;
+
+    std::vector<uint64_t> makePeriods(size_t count) {
+        std::vector<uint64_t> result(count);
+        srand(12345);
+        for (size_t i = 0; i < count; ++i) {
+            result[i] = (100 + rand() % 901) * MILLISECOND;
+        }
+        return result;
+    }
+
+    // Returns the measured nanoseconds, the fired timers count is stored to the firedCount
+    uint64_t runWheel(std::vector<uint64_t> const & periods, uint64_t duration, size_t & firedCount) {
+        uint64_t now = 0;
+        tau_additional::util::TimingWheel wheel(MILLISECOND, now);
+        std::vector<PeriodicWheelTimer> timers(periods.size());
+        uint64_t start = tau_additional::util::getMonotonicNanoseconds();
+        for (size_t i = 0; i < timers.size(); ++i) {
+            timers[i].start(wheel, periods[i], now);
+        }
+        for (now = MILLISECOND; now <= duration; now += MILLISECOND) {
+            wheel.advance(now);
+        }
+        uint64_t result = tau_additional::util::getMonotonicNanoseconds() - start;
+        firedCount = 0;
+        for (size_t i = 0; i < timers.size(); ++i) {
+            firedCount += timers[i].m_firedCount;
+        }
+        return result;
+    }
+
+    uint64_t runMultimap(std::vector<uint64_t> const & periods, uint64_t duration, size_t & firedCount) {
+        uint64_t now = 0;
+        MapTimers deadlines;
+        std::vector<MapTimer> timers(periods.size());
+        uint64_t start = tau_additional::util::getMonotonicNanoseconds();
+        for (size_t i = 0; i < timers.size(); ++i) {
+            timers[i].period = periods[i];
+            deadlines.insert(std::make_pair(now + periods[i], &timers[i]));
+        }
+        for (now = MILLISECOND; now <= duration; now += MILLISECOND) {
+            while (!deadlines.empty() && deadlines.begin()->first <= now) {
+                MapTimers::iterator due = deadlines.begin();
+                uint64_t deadline = due->first;
+                MapTimer * timer = due->second;
+                deadlines.erase(due);
+                ++timer->firedCount;
+                deadlines.insert(std::make_pair(deadline + timer->period, timer));
+            }
+        }
+        uint64_t result = tau_additional::util::getMonotonicNanoseconds() - start;
+        firedCount = 0;
+        for (size_t i = 0; i < timers.size(); ++i) {
+            firedCount += timers[i].firedCount;
+        }
+        return result;
+    }
+};
+
+int main(int argc, char ** argv)
+{
+    uint64_t seconds = (argc > 1) ? strtoul(argv[1], NULL, 10) : 10;
+    uint64_t duration = seconds * 1000 * MILLISECOND;
+    size_t timerCounts[] = {1000, 10000, 100000, 1000000};
+    for (size_t c = 0; c < sizeof(timerCounts) / sizeof(timerCounts[0]); ++c) {
+        std::vector<uint64_t> periods = makePeriods(timerCounts[c]);
+        size_t wheelFired = 0;
+        uint64_t wheelTime = runWheel(periods, duration, wheelFired);
+        size_t multimapFired = 0;
+        uint64_t multimapTime = runMultimap(periods, duration, multimapFired);
+        std::cout << timerCounts[c] << " timers, " << seconds << " s: timing wheel "
+            << double(wheelTime) / wheelFired << " ns/expiration, multimap "
+            << double(multimapTime) / multimapFired << " ns/expiration (fired "
+            << wheelFired << "/" << multimapFired << ")\n";
+    }
+    return 0;
+}
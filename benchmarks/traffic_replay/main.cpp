@@ -0,0 +1,202 @@
+// This source file is part of the 'tau' open source project.
+// Copyright (c) 2016, Yuriy Vosel.
+// Licensed under Boost Software License.
+// See LICENSE.txt for the licence information.
+
+// The replay of the captured traffic (see TrafficCapture and TrafficReplayer) for the performance
+// regression testing: the same real traffic is passed to the dispatcher before and after the change,
+// without the network and the clients, so the results are comparable between the runs.
+// Usage:
+//   benchmark_gcc_cpp11 capture <capture file> [connections] [requests per connection] [port]
+//     runs the EpollServer with the capture enabled and the loopback clients, which open the session
+//     ("info" packet) and click the button; the capture of a real server can be used instead
+//     (for example, the one, which the sample02 posix demo writes with the file name argument).
+//   benchmark_gcc_cpp11 replay <capture file> [speed]
+//     replays the capture as fast as possible, then (if the speed is given) at the original pacing,
+//     scaled by the speed (2 - twice as fast). Reports the throughput, the per-chunk latency and
+//     whether the dispatcher has sent the same bytes, as during the capture.
+// The ExampleEventsDispatcher stands for the application's dispatcher: to replay the capture of the
+// real server, replay it against that server's dispatcher type.
+
+#include <tau/util/basic_events_dispatcher.h>
+#include <tau_additional/communications_handling/traffic_capture.h>
+#include <tau_additional/communications_handling/traffic_replay.h>
+#include <tau_additional/util/epoll_server.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Sends the layout, when the session is opened, and counts the clicks
+class ExampleEventsDispatcher : public tau::util::BasicEventsDispatcher
+{
+    unsigned m_clicks;
+public:
+    ExampleEventsDispatcher(tau::communications_handling::OutgiongPacketsGenerator & outgoingGeneratorToUse):
+        tau::util::BasicEventsDispatcher(outgoingGeneratorToUse), m_clicks(0)
+    {};
+    virtual void packetReceived_clientDeviceInfo(tau::communications_handling::ClientDeviceInfo const & info) {
+        sendPacket_resetLayout("{\"pages\":[{\"id\":\"MAIN\",\"elements\":[{\"type\":\"button\",\"id\":\"BUTTON\"},"
+            "{\"type\":\"label\",\"id\":\"CLICKS_LABEL\",\"text\":\"No clicks yet\"}]}]}");
+    }
+    virtual void packetReceived_buttonClick(tau::common::ElementID const & buttonID) {
+        std::ostringstream note;
+        note << "Clicks: " << ++m_clicks;
+        sendPacket_changeElementNote(tau::common::ElementID("CLICKS_LABEL"), note.str());
+    }
+    virtual void packetReceived_textValueUpdate(tau::common::ElementID const & inputBoxID,
+        std::string const & new_value, bool is_automatic_update) {
+        sendPacket_changeElementNote(inputBoxID, new_value);
+    }
+};
+
+typedef tau_additional::util::EpollServer<ExampleEventsDispatcher> Server;
+
+namespace {
+    void * runServer(void * serverPointer) {
+        static_cast<Server *>(serverPointer)->run();
+        return NULL;
+    }
+
+    // Every reply of the ExampleEventsDispatcher is one line
+    bool sendAndWaitForReply(int handle, std::string const & request) {
+        if (send(handle, request.data(), request.size(), MSG_NOSIGNAL) != ssize_t(request.size())) {
+            return false;
+        }
+        char buffer[4096];
+        for (;;) {
+            ssize_t received = recv(handle, buffer, sizeof(buffer), 0);
+            if (received <= 0) {
+                return false;
+            }
+            if (buffer[received - 1] == '\n') {
+                return true;
+            }
+        }
+    }
+
+    int runCapture(std::string const & path, size_t connectionsCount, size_t requestsCount, unsigned short port) {
+        tau_additional::communications_handling::TrafficCapture capture;
+        if (!capture.open(path)) {
+            std::cerr << capture.getLastError() << "\n";
+            return -1;
+        }
+        tau_additional::util::EpollServerSettings settings;
+        settings.trafficCapture = &capture;
+        Server server(port, settings);
+        if (!server.start()) {
+            std::cerr << server.getLastError() << "\n";
+            return -1;
+        }
+        pthread_t thread;
+        pthread_create(&thread, NULL, runServer, &server);
+        sockaddr_in address;
+        memset(&address, 0, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        address.sin_port = htons(port);
+        std::vector<int> handles;
+        size_t requests = 0;
+        for (size_t i = 0; i < connectionsCount; ++i) {
+            int handle = socket(AF_INET, SOCK_STREAM, 0);
+            int noDelay = 1;
+            setsockopt(handle, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+            if (connect(handle, (sockaddr*)(&address), sizeof(address)) == -1) {
+                std::cerr << "Can't connect: " << strerror(errno) << "\n";
+                close(handle);
+                break;
+            }
+            std::ostringstream info;
+            info << "info|token" << i << "\n";
+            if (sendAndWaitForReply(handle, info.str())) {
+                ++requests;
+            }
+            handles.push_back(handle);
+        }
+        // The clicks of the different clients are interleaved, as on the real server
+        for (size_t request = 0; request < requestsCount; ++request) {
+            for (size_t i = 0; i < handles.size(); ++i) {
+                if (sendAndWaitForReply(handles[i], "click|BUTTON\n")) {
+                    ++requests;
+                }
+            }
+        }
+        for (size_t i = 0; i < handles.size(); ++i) {
+            close(handles[i]);
+        }
+        usleep(100000); // the server should see the connections closed
+        server.stop();
+        pthread_join(thread, NULL);
+        capture.close();
+        tau_additional::communications_handling::TrafficCapture::Statistics statistics = capture.getStatistics();
+        std::cout << "Captured " << requests << " requests of " << handles.size() << " connections: "
+            << statistics.records << " records, " << statistics.bytesWritten << " bytes";
+        if (statistics.writeFailures != 0) {
+            std::cout << " (" << statistics.writeFailures << " records are lost: " << capture.getLastError() << ")";
+        }
+        std::cout << "\n";
+        return 0;
+    }
+
+    void printResults(char const * title,
+        tau_additional::communications_handling::TrafficReplayer<ExampleEventsDispatcher>::Results const & results) {
+        std::cout << title << ": " << results.incomingChunks << " chunks (" << results.incomingBytes << " bytes) of "
+            << results.connections << " connections in " << double(results.elapsedNanoseconds) / 1000000 << " ms ("
+            << double(results.capturedDuration) / 1000000 << " ms captured), "
+            << results.getChunksPerSecond() << " chunks/s, " << results.getBytesPerSecond() / 1000000 << " MB/s\n"
+            << "  latency per chunk (ns): mean " << results.latencyMean << ", p50 " << results.latencyP50
+            << ", p99 " << results.latencyP99 << ", max " << results.latencyMax << "\n"
+            << "  outgoing bytes: captured " << results.capturedOutgoingBytes << ", replayed "
+            << results.replayedOutgoingBytes << ", mismatched connections " << results.mismatchedConnections << "\n";
+        if (results.maxLagNanoseconds != 0) {
+            std::cout << "  max lag behind the original pacing: " << double(results.maxLagNanoseconds) / 1000000 << " ms\n";
+        }
+        if (results.truncated) {
+            std::cout << "  the capture ends with the incomplete record\n";
+        }
+    }
+
+    int runReplay(std::string const & path, double speed) {
+        tau_additional::communications_handling::TrafficCaptureReader reader;
+        if (!reader.open(path)) {
+            std::cerr << reader.getLastError() << "\n";
+            return -1;
+        }
+        tau_additional::communications_handling::TrafficReplayer<ExampleEventsDispatcher> replayer(reader);
+        printResults("As fast as possible", replayer.replay());
+        if (speed > 0) {
+            std::ostringstream title;
+            title << "Original pacing (speed " << speed << ")";
+            printResults(title.str().c_str(),
+                replayer.replay(tau_additional::communications_handling::REPLAY_ORIGINAL_PACING, speed));
+        }
+        return 0;
+    }
+};
+
+int main(int argc, char ** argv)
+{
+    std::string mode = (argc > 1) ? argv[1] : "";
+    if (argc < 3 || (mode != "capture" && mode != "replay")) {
+        std::cerr << "Usage: benchmark_gcc_cpp11 capture <capture file> [connections] [requests per connection] [port]\n"
+            << "       benchmark_gcc_cpp11 replay <capture file> [speed]\n";
+        return -1;
+    }
+    if (mode == "capture") {
+        size_t connectionsCount = (argc > 3) ? strtoul(argv[3], NULL, 10) : 100;
+        size_t requestsCount = (argc > 4) ? strtoul(argv[4], NULL, 10) : 100;
+        unsigned short port = (argc > 5) ? (unsigned short)(atoi(argv[5])) : 12349;
+        return runCapture(argv[2], connectionsCount, requestsCount, port);
+    }
+    return runReplay(argv[2], (argc > 3) ? atof(argv[3]) : 0);
+}
@@ -11,7 +11,9 @@
 #include <arpa/inet.h>
 #include <unistd.h>
 #include <tau/communications_handling/outgiong_packets_generator.h>
-#include <tau/communications_handling/incoming_data_stream_parser.h>
+#include <tau_additional/communications_handling/raw_incoming_data_stream_parser.h>
+#include <stdlib.h>
+#include <vector>
 
 class MyEventsDispatcher : public tau::util::BasicEventsDispatcher
 {
@@ -96,22 +98,21 @@ int main(int argc, char ** argv)
     }
     std::cout << "Connection accepted.";
     int read_bufSize;
-    const int BUFSIZE = 1024;
-    char buffer[BUFSIZE];
+    // The receive buffer size can be passed as the first command line argument
+    size_t receiveBufferSize = (argc > 1) ? strtoul(argv[1], NULL, 10) : 0;
+    if (receiveBufferSize == 0) {
+        receiveBufferSize = 64 * 1024;
+    }
+    std::vector<char> buffer(receiveBufferSize);
     MyOutgoingPacketsGenerator outgoingPacketsGenerator(client_handle);
     MyEventsDispatcher myServerLogic(outgoingPacketsGenerator);
-    tau::communications_handling::IncomingDataStreamParser incomingDataStreamParser;
+    tau_additional::communications_handling::RawIncomingDataStreamParser incomingDataStreamParser;
     
     tau::communications_handling::ClientConnectionInfo connectionInfo(getAddrString(client), ntohs(client.sin_port), getAddrString(serverAddr), ntohs(serverAddr.sin_port));
     myServerLogic.onClientConnected(connectionInfo); //Notify the user code about the connection details
     
-    while((read_bufSize = recv(client_handle, buffer, BUFSIZE, 0)) > 0) {
-        std::string received_data(buffer, read_bufSize);
-        incomingDataStreamParser.newData(
-                received_data, 
-                myServerLogic.getIncomingPacketsHandler(), 
-                myServerLogic.getCommunicationIssuesHandler()
-            );
+    while((read_bufSize = recv(client_handle, &buffer[0], buffer.size(), 0)) > 0) {
+        incomingDataStreamParser.newData(&buffer[0], read_bufSize, myServerLogic);
     }
     myServerLogic.onConnectionClosed();
     if (read_bufSize == 0) {
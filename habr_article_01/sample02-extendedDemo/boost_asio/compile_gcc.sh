@@ -1,3 +1,4 @@
 #!/bin/bash
 LIBRARY_LOCATION=../../../../src/cpp/
-g++ -std=c++03 -D TAU_HEADERONLY -D TAU_CPP_03_COMPATIBILITY -lboost_system -pthread -lboost_thread -I $LIBRARY_LOCATION main.cpp -o demo_gcc_cpp03_boost
\ No newline at end of file
+ADDITIONAL_LIBRARY_LOCATION=../../../src/cpp/
+g++ -std=c++03 -D TAU_HEADERONLY -D TAU_CPP_03_COMPATIBILITY -pthread -I $LIBRARY_LOCATION -I $ADDITIONAL_LIBRARY_LOCATION main.cpp -o demo_gcc_cpp03_boost -lboost_system -lboost_thread
\ No newline at end of file
@@ -5,61 +5,56 @@
 
 #include <tau/layout_generation/layout_info.h>
 #include <tau/util/basic_events_dispatcher.h>
-#include <sys/types.h>
-#include <sys/socket.h>
-#include <netinet/in.h>
-#include <arpa/inet.h>
-#include <unistd.h>
-#include <tau/communications_handling/outgiong_packets_generator.h>
-#include <tau/communications_handling/incoming_data_stream_parser.h>
+#include <tau_additional/common/interned_id.h>
+#include <tau_additional/layout_generation/layout_cache.h>
+#include <tau_additional/util/routing_events_dispatcher.h>
+#include <tau_additional/communications_handling/shared_buffer_sender.h>
+#include <tau_additional/communications_handling/binary_encoding.h>
+#include <tau_additional/communications_handling/packet_serializer.h>
+#include <tau_additional/communications_handling/session_registry.h>
+#include <tau_additional/communications_handling/coalescing_element_updates_sender.h>
+#include <tau_additional/communications_handling/periodic_call.h>
+#include <tau_additional/communications_handling/resumable_session_store.h>
+#include <tau_additional/communications_handling/stream_compression.h>
+#include <tau_additional/communications_handling/traffic_capture.h>
+#include <tau_additional/util/coalescing_events_dispatcher.h>
+#include <tau_additional/util/metered_events_dispatcher.h>
+#include <tau_additional/util/metrics_exporter.h>
+#include <tau_additional/util/async_logger.h>
+#include <tau_additional/util/io_uring_server.h>
+#include <tau_additional/util/monotonic_clock.h>
+#include <stdlib.h>
+#include <sstream>
 
 
 namespace {
     std::string const INITIAL_TEXT_VALUE("initial text");    
     tau::common::LayoutID const LAYOUT_ID("SAMPLE_LAYOUT_ID");
-    tau::common::LayoutPageID const LAYOUT_PAGE1_ID("LAYOUT_PAGE_1");
-    tau::common::LayoutPageID const LAYOUT_PAGE2_ID("LAYOUT_PAGE_2");
-    tau::common::ElementID const BUTTON_WITH_NOTE_TO_REPLACE_ID("BUTTON_WITH_NOTE_TO_REPLACE");
-    tau::common::ElementID const BUTTON_TO_RESET_VALUES_ID("BUTTON_TO_RESET_NOTES");
-    tau::common::ElementID const BUTTON_TO_PAGE_1_ID("BUTTON_TO_PG1");
-    tau::common::ElementID const BUTTON_TO_PAGE_2_ID("BUTTON_TO_PG2");
-    tau::common::ElementID const BUTTON_1_ID("BUTTON_1");
-    tau::common::ElementID const BUTTON_2_ID("BUTTON_2");
-    tau::common::ElementID const BUTTON_3_ID("BUTTON_3");
-    tau::common::ElementID const BUTTON_4_ID("BUTTON_4");
-    tau::common::ElementID const TEXT_INPUT_ID("TEXT_INPUT");
-    tau::common::ElementID const BOOL_INPUT_ID("BOOL_INPUT");
-    tau::common::ElementID const LABEL_ON_PAGE2_ID("LABEL_ON_PAGE2");
-};
+    tau_additional::common::InternedLayoutPageID const LAYOUT_PAGE1_ID("LAYOUT_PAGE_1");
+    tau_additional::common::InternedLayoutPageID const LAYOUT_PAGE2_ID("LAYOUT_PAGE_2");
+    tau_additional::common::InternedElementID const BUTTON_WITH_NOTE_TO_REPLACE_ID("BUTTON_WITH_NOTE_TO_REPLACE");
+    tau_additional::common::InternedElementID const BUTTON_TO_RESET_VALUES_ID("BUTTON_TO_RESET_NOTES");
+    tau_additional::common::InternedElementID const BUTTON_TO_PAGE_1_ID("BUTTON_TO_PG1");
+    tau_additional::common::InternedElementID const BUTTON_TO_PAGE_2_ID("BUTTON_TO_PG2");
+    tau_additional::common::InternedElementID const BUTTON_1_ID("BUTTON_1");
+    tau_additional::common::InternedElementID const BUTTON_2_ID("BUTTON_2");
+    tau_additional::common::InternedElementID const BUTTON_3_ID("BUTTON_3");
+    tau_additional::common::InternedElementID const BUTTON_4_ID("BUTTON_4");
+    tau_additional::common::InternedElementID const TEXT_INPUT_ID("TEXT_INPUT");
+    tau_additional::common::InternedElementID const BOOL_INPUT_ID("BOOL_INPUT");
+    tau_additional::common::InternedElementID const LABEL_ON_PAGE2_ID("LABEL_ON_PAGE2");
+    tau_additional::common::InternedElementID const SERVER_UPTIME_LABEL_ID("SERVER_UPTIME_LABEL");
+    std::string const LAYOUT_CACHE_KEY("SAMPLE_LAYOUT");
+    std::string const PAGE2_VIEWERS_GROUP("PAGE2_VIEWERS");
 
-class MyEventsDispatcher : public tau::util::BasicEventsDispatcher
-{
-public:
-    MyEventsDispatcher(
-        tau::communications_handling::OutgiongPacketsGenerator & outgoingGeneratorToUse): 
-            tau::util::BasicEventsDispatcher(outgoingGeneratorToUse)
-        {};
+    tau_additional::layout_generation::LayoutCache layoutCache;
+    tau_additional::communications_handling::SessionRegistry sessions;
+    // The clients, which reconnect within a minute, keep their page and the entered values
+    tau_additional::communications_handling::ResumableSessionStore resumableSessions(60);
 
-    virtual void packetReceived_requestProcessingError(
-		std::string const & layoutID, std::string const & additionalData)
-    {
-        std::cout << "Error received from client:\nLayouID: "
-			<< layoutID << "\nError: " << additionalData << "\n";
-    }
-
-    virtual void onClientConnected(
-        tau::communications_handling::ClientConnectionInfo const & connectionInfo)
-    {
-        std::cout << "Client connected: remoteAddr: "
-            << connectionInfo.getRemoteAddrDump()
-            << ", localAddr : "
-            << connectionInfo.getLocalAddrDump() << "\n";
-    }
-    virtual void packetReceived_clientDeviceInfo(
-        tau::communications_handling::ClientDeviceInfo const & info)
+    std::string buildLayoutJson()
     {
         using namespace tau::layout_generation;
-        std::cout << "Received client information packet\n";
         LayoutInfo resultLayout;
         resultLayout.pushLayoutPage(LayoutPage(LAYOUT_PAGE1_ID, 
             EvenlySplitLayoutElementsContainer(true)
@@ -89,123 +84,265 @@ public:
                     .push(ButtonLayoutElement().note("4").ID(BUTTON_4_ID)))
                 .push(EvenlySplitLayoutElementsContainer(true)
                     .push(LabelElement("").ID(LABEL_ON_PAGE2_ID))
+                    .push(LabelElement("").ID(SERVER_UPTIME_LABEL_ID))
                     .push(ButtonLayoutElement().note("back to page 1").ID(BUTTON_TO_PAGE_1_ID)))
         ));
         resultLayout.setStartLayoutPage(LAYOUT_PAGE1_ID);
-        sendPacket_resetLayout(resultLayout.getJson());
+        return resultLayout.getJson();
+    }
+};
+
+// Pushes the server uptime to everyone, who is looking at the page 2, once a second
+// (the packet is serialized once for the whole group).
+class UptimeBroadcaster : public tau_additional::communications_handling::DelayedCallsScheduler::Callback
+{
+    uint64_t m_startTime;
+public:
+    UptimeBroadcaster(): m_startTime(tau_additional::util::getMonotonicNanoseconds()) {};
+
+    virtual void onDelayedCall()
+    {
+        if (sessions.getGroupSize(PAGE2_VIEWERS_GROUP) == 0) {
+            return;
+        }
+        std::ostringstream note;
+        note << "Server uptime: " << (tau_additional::util::getMonotonicNanoseconds() - m_startTime) / 1000000000 << " s";
+        sessions.broadcastNoteToGroup(PAGE2_VIEWERS_GROUP, SERVER_UPTIME_LABEL_ID, note.str());
+    }
+};
+
+// The capture is written, when its buffer is full, or on the next record after a second;
+// this makes the capture of the idle server complete too.
+class CaptureFlusher : public tau_additional::communications_handling::DelayedCallsScheduler::Callback
+{
+    tau_additional::communications_handling::TrafficCapture & m_capture;
+public:
+    CaptureFlusher(tau_additional::communications_handling::TrafficCapture & capture): m_capture(capture) {};
+
+    virtual void onDelayedCall()
+    {
+        m_capture.flush();
+    }
+};
+
+// The events are logged asynchronously (see AsyncLogger): the console output does not slow
+// the network thread down. Build with -D TAU_ADDITIONAL_LOG_LEVEL=TAU_ADDITIONAL_LOG_LEVEL_WARNING
+// to compile the per-event records out.
+class MyEventsDispatcher : public tau_additional::util::RoutingEventsDispatcher<MyEventsDispatcher>
+{
+    tau::communications_handling::OutgiongPacketsGenerator & m_outgoingGenerator;
+    tau_additional::communications_handling::CoalescingElementUpdatesSender m_elementUpdates;
+    tau_additional::communications_handling::ClientView m_clientView;
+    std::string m_clientAddress;
+    std::string m_clientToken;
+public:
+    MyEventsDispatcher(
+        tau::communications_handling::OutgiongPacketsGenerator & outgoingGeneratorToUse): 
+            tau_additional::util::RoutingEventsDispatcher<MyEventsDispatcher>(outgoingGeneratorToUse),
+            m_outgoingGenerator(outgoingGeneratorToUse),
+            m_elementUpdates(outgoingGeneratorToUse),
+            m_clientView(outgoingGeneratorToUse)
+        {};
+
+    virtual void packetReceived_requestProcessingError(
+		std::string const & layoutID, std::string const & additionalData)
+    {
+        TAU_ADDITIONAL_LOG_WARNING(tau_additional::util::LogRecord("Error received from client")
+            .field("connection", m_clientAddress).field("layout", layoutID).field("error", additionalData));
+    }
+
+    virtual void onClientConnected(
+        tau::communications_handling::ClientConnectionInfo const & connectionInfo)
+    {
+        m_clientAddress = connectionInfo.getRemoteAddrDump();
+        TAU_ADDITIONAL_LOG_INFO(tau_additional::util::LogRecord("Client connected")
+            .field("connection", m_clientAddress).field("local", connectionInfo.getLocalAddrDump()));
+        sessions.addSession(m_outgoingGenerator, m_clientView);
+    }
+    virtual void onConnectionClosed()
+    {
+        TAU_ADDITIONAL_LOG_INFO(tau_additional::util::LogRecord("Client disconnected")
+            .field("connection", m_clientAddress));
+        sessions.removeSession(m_outgoingGenerator);
+        resumableSessions.park(m_clientToken, m_clientView.getState());
+    }
+    virtual void packetReceived_clientDeviceInfo(
+        tau::communications_handling::ClientDeviceInfo const & info)
+    {
+        TAU_ADDITIONAL_LOG_INFO(tau_additional::util::LogRecord("Received client information packet")
+            .field("connection", m_clientAddress));
+        // The clients on the slow links ask for the compressed stream: the layout shrinks the most
+        if (tau_additional::communications_handling::startCompressionIfNegotiated(m_outgoingGenerator, info)) {
+            TAU_ADDITIONAL_LOG_INFO(tau_additional::util::LogRecord("Compression started")
+                .field("connection", m_clientAddress));
+        }
+        // After the compression: the packets are converted to the binary ones before they are compressed
+        if (tau_additional::communications_handling::startBinaryEncodingIfNegotiated(m_outgoingGenerator, info)) {
+            TAU_ADDITIONAL_LOG_INFO(tau_additional::util::LogRecord("Binary encoding started")
+                .field("connection", m_clientAddress));
+        }
+        m_clientToken = tau_additional::communications_handling::getClientToken(info);
+        if (resumableSessions.resume(m_clientToken, LAYOUT_CACHE_KEY, m_clientView)) {
+            // The client may be a new process: it gets the layout with its page and values
+            m_clientView.resendLayout(layoutCache.getResetLayoutPacket(LAYOUT_CACHE_KEY, &buildLayoutJson));
+            std::string activePageID = m_clientView.getActivePageID();
+            TAU_ADDITIONAL_LOG_INFO(tau_additional::util::LogRecord("Session resumed")
+                .field("connection", m_clientAddress).field("page", activePageID));
+            if (activePageID == tau_additional::common::getIdString(LAYOUT_PAGE2_ID)) {
+                sessions.joinGroup(m_outgoingGenerator, PAGE2_VIEWERS_GROUP);
+            }
+            return;
+        }
+        // The layout is the same for all the clients, so it is built and serialized only once
+        m_clientView.resetLayout(LAYOUT_CACHE_KEY,
+            layoutCache.getResetLayoutPacket(LAYOUT_CACHE_KEY, &buildLayoutJson), LAYOUT_PAGE1_ID);
+    }
+    // The click and value update handlers are looked up in the routing table
+    static void registerEventRoutes(RoutingTable & table)
+    {
+        table.onButtonClick(BUTTON_TO_RESET_VALUES_ID, &MyEventsDispatcher::resetTextValue)
+            .onButtonClick(BUTTON_TO_PAGE_1_ID, &MyEventsDispatcher::goToPage1)
+            .onButtonClick(BUTTON_1_ID, &MyEventsDispatcher::button1Pressed)
+            .onButtonClick(BUTTON_2_ID, &MyEventsDispatcher::button2Pressed)
+            .onButtonClick(BUTTON_3_ID, &MyEventsDispatcher::button3Pressed)
+            .onButtonClick(BUTTON_4_ID, &MyEventsDispatcher::button4Pressed)
+            .onTextValueUpdate(TEXT_INPUT_ID, &MyEventsDispatcher::textInputUpdated);
     }
     virtual void packetReceived_buttonClick(
         tau::common::ElementID const & buttonID)
     {
-        std::cout << "event: buttonClick, id=" << buttonID << "\n";
-        if (buttonID == BUTTON_TO_RESET_VALUES_ID) {
-            sendPacket_updateTextValue(TEXT_INPUT_ID, INITIAL_TEXT_VALUE);
-        } else if (buttonID == BUTTON_TO_PAGE_1_ID) {
-            sendPacket_changeShownLayoutPage(LAYOUT_PAGE1_ID);
-        } else if (buttonID == BUTTON_1_ID) {
-            sendPacket_changeElementNote(LABEL_ON_PAGE2_ID, "Button 1 pressed");
-        } else if (buttonID == BUTTON_2_ID) {
-            sendPacket_changeElementNote(LABEL_ON_PAGE2_ID, "Button 2 pressed");
-        } else if (buttonID == BUTTON_3_ID) {
-            sendPacket_changeElementNote(LABEL_ON_PAGE2_ID, "Button 3 pressed");
-        } else if (buttonID == BUTTON_4_ID) {
-            sendPacket_changeElementNote(LABEL_ON_PAGE2_ID, "Button 4 pressed");
-        }
+        TAU_ADDITIONAL_LOG_INFO(tau_additional::util::LogRecord("event: buttonClick")
+            .field("connection", m_clientAddress).field("element", tau_additional::common::getIdString(buttonID)));
+        tau_additional::util::RoutingEventsDispatcher<MyEventsDispatcher>::packetReceived_buttonClick(buttonID);
     }
     virtual void packetReceived_layoutPageSwitched(
         tau::common::LayoutPageID const & newActiveLayoutPageID)
     {
-        std::cout << "event: layoutPageSwitch, id=" << newActiveLayoutPageID << "\n";
+        TAU_ADDITIONAL_LOG_INFO(tau_additional::util::LogRecord("event: layoutPageSwitch")
+            .field("connection", m_clientAddress)
+            .field("page", tau_additional::common::getIdString(newActiveLayoutPageID)));
+        m_clientView.pageSwitchedByClient(newActiveLayoutPageID);
+        if (newActiveLayoutPageID == LAYOUT_PAGE2_ID.getID()) {
+            sessions.joinGroup(m_outgoingGenerator, PAGE2_VIEWERS_GROUP);
+        } else {
+            sessions.leaveGroup(m_outgoingGenerator, PAGE2_VIEWERS_GROUP);
+        }
     }
     virtual void packetReceived_boolValueUpdate(
         tau::common::ElementID const & inputBoxID,
         bool new_value, bool is_automatic_update)
     {
-        std::cout << "event: boolValueUpdate, id="
-            << inputBoxID << ", value=" << new_value << "\n";
+        TAU_ADDITIONAL_LOG_INFO(tau_additional::util::LogRecord("event: boolValueUpdate")
+            .field("connection", m_clientAddress).field("element", tau_additional::common::getIdString(inputBoxID))
+            .field("value", new_value));
+        m_clientView.boolValueChangedByClient(inputBoxID, new_value);
     }
     virtual void packetReceived_textValueUpdate(
         tau::common::ElementID const & inputBoxID,
         std::string const & new_value, bool is_automatic_update)
     {
-        std::cout << "event: textValueUpdate, id="
-            << inputBoxID << ",\n\tvalue=" << new_value << "\n";
-        sendPacket_changeElementNote(BOOL_INPUT_ID, new_value);
-        sendPacket_changeElementNote(BUTTON_WITH_NOTE_TO_REPLACE_ID, new_value);
+        TAU_ADDITIONAL_LOG_INFO(tau_additional::util::LogRecord("event: textValueUpdate")
+            .field("connection", m_clientAddress).field("element", tau_additional::common::getIdString(inputBoxID))
+            .field("value", new_value));
+        m_clientView.textValueChangedByClient(inputBoxID, new_value);
+        tau_additional::util::RoutingEventsDispatcher<MyEventsDispatcher>::packetReceived_textValueUpdate(
+            inputBoxID, new_value, is_automatic_update);
     }
-};
-class MyOutgoingPacketsGenerator : 
-    public tau::communications_handling::OutgiongPacketsGenerator
-{
-    int m_socketHandle;
-public:
-    MyOutgoingPacketsGenerator(int output_socket_handle): m_socketHandle(output_socket_handle)
-    {};
-    virtual void sendData(std::string const & data) {
-        write(m_socketHandle, data.c_str(), data.size());
+private:
+    void resetTextValue(tau::common::ElementID const & buttonID)
+    {
+        m_clientView.updateTextValue(TEXT_INPUT_ID, INITIAL_TEXT_VALUE);
+    }
+    void goToPage1(tau::common::ElementID const & buttonID)
+    {
+        m_clientView.changeShownLayoutPage(LAYOUT_PAGE1_ID);
+    }
+    void button1Pressed(tau::common::ElementID const & buttonID)
+    {
+        updatePage2Label("Button 1 pressed");
+    }
+    void button2Pressed(tau::common::ElementID const & buttonID)
+    {
+        updatePage2Label("Button 2 pressed");
+    }
+    void button3Pressed(tau::common::ElementID const & buttonID)
+    {
+        updatePage2Label("Button 3 pressed");
+    }
+    void button4Pressed(tau::common::ElementID const & buttonID)
+    {
+        updatePage2Label("Button 4 pressed");
+    }
+    // The label is shared by all the clients: the update is serialized once
+    // and sent to everyone, who is looking at the page 2 now
+    void updatePage2Label(std::string const & text)
+    {
+        // The client, which pressed the button, is on the page 2 for sure
+        sessions.joinGroup(m_outgoingGenerator, PAGE2_VIEWERS_GROUP);
+        sessions.broadcastNoteToGroup(PAGE2_VIEWERS_GROUP, LABEL_ON_PAGE2_ID, text);
     }
-    virtual void close_connection() {
-        close(m_socketHandle);
+    void textInputUpdated(tau::common::ElementID const & inputBoxID,
+        std::string const & new_value, bool is_automatic_update)
+    {
+        // Only the last note of every element is sent, if several updates are handled in one go
+        m_elementUpdates.changeElementNote(BOOL_INPUT_ID, new_value);
+        m_elementUpdates.changeElementNote(BUTTON_WITH_NOTE_TO_REPLACE_ID, new_value);
+        m_clientView.elementNoteSentDirectly(BOOL_INPUT_ID, new_value);
+        m_clientView.elementNoteSentDirectly(BUTTON_WITH_NOTE_TO_REPLACE_ID, new_value);
     }
 };
-std::string getAddrString(sockaddr_in const & toConvert) {
-	int buflen = INET_ADDRSTRLEN;
-	char buf[buflen];
-	return inet_ntop(AF_INET, &(toConvert.sin_addr), buf, buflen);
-}
-
 int main(int argc, char ** argv)
 {
-    int socket_handle = socket(AF_INET, SOCK_STREAM, 0);
-    if (socket_handle == -1) {
-        std::cerr << "Can't create the socket. Exiting.\n";
+    int listenPort = 12345;
+    unsigned short metricsPort = 12346;
+    tau_additional::util::IoUringServerSettings settings;
+    // The receive buffer size can be passed as the first command line argument
+    if (argc > 1) {
+        settings.receiveBufferSize = strtoul(argv[1], NULL, 10);
+        settings.providedBufferSize = unsigned(settings.receiveBufferSize);
+    }
+    settings.compressionEnabled = true;
+    // The traffic can be captured for the replay (see benchmarks/traffic_replay):
+    // the capture file name is the second command line argument
+    tau_additional::communications_handling::TrafficCapture capture;
+    if (argc > 2) {
+        if (!capture.open(argv[2])) {
+            std::cerr << capture.getLastError() << ". Exiting.\n";
+            return -1;
+        }
+        settings.trafficCapture = &capture;
+    }
+    // The automatic text updates (sent while the user types) reach the dispatcher at most every 50 ms.
+    // The packets and the handlers time are counted before the coalescing.
+    // io_uring on the kernels, which support it, epoll on the other ones
+    tau_additional::util::IoUringOrEpollServer<tau_additional::util::MeteredEventsDispatcher<
+        tau_additional::util::CoalescingEventsDispatcher<MyEventsDispatcher> > > server(listenPort, settings);
+    if (!server.start()) {
+        std::cerr << server.getLastError() << ". Exiting.\n";
         return -1;
     }
-    std::cout << "Socket created. ";
-    int listenPort = 12345;
-    sockaddr_in serverAddr;
-    serverAddr.sin_family = AF_INET;
-    serverAddr.sin_addr.s_addr = INADDR_ANY;
-    serverAddr.sin_port = htons(listenPort);
-
-    if (bind(socket_handle, (sockaddr*)(&serverAddr), sizeof(serverAddr)) < 0) {
-        std::cerr << "Can't bind the socket. Exiting.\n";
-        return -2;
+    if (!server.isIoUringUsed()) {
+        std::cout << "Using epoll (" << server.getFallbackReason() << ")\n";
+    }
+    UptimeBroadcaster uptimeBroadcaster;
+    tau_additional::communications_handling::PeriodicCall uptimeUpdates(
+        server.getScheduler(), uptimeBroadcaster, uint64_t(1000) * 1000000);
+    uptimeUpdates.start();
+    CaptureFlusher captureFlusher(capture);
+    tau_additional::communications_handling::PeriodicCall captureFlushes(
+        server.getScheduler(), captureFlusher, uint64_t(1000) * 1000000);
+    if (capture.isOpen()) {
+        captureFlushes.start();
     }
-    std::cout << "bind() succeded. Starting to listen on the socket (port " << listenPort << ")...\n";
-    listen(socket_handle, 5);
-    sockaddr_in client;
-    int client_socket_size = sizeof(sockaddr_in);
-    int client_handle = accept(socket_handle, (sockaddr*)(&client), (socklen_t*)&client_socket_size);
-    if (client_handle < 0) {
-        std::cerr << "Accept failed. Exiting.\n";
-        return -3;
-    }
-    std::cout << "Connection accepted.";
-    int read_bufSize;
-    const int BUFSIZE = 1024;
-    char buffer[BUFSIZE];
-    MyOutgoingPacketsGenerator outgoingPacketsGenerator(client_handle);
-    MyEventsDispatcher myServerLogic(outgoingPacketsGenerator);
-    tau::communications_handling::IncomingDataStreamParser incomingDataStreamParser;
-    
-    tau::communications_handling::ClientConnectionInfo connectionInfo(getAddrString(client), ntohs(client.sin_port), getAddrString(serverAddr), ntohs(serverAddr.sin_port));
-    myServerLogic.onClientConnected(connectionInfo); //Notify the user code about the connection details
-    
-    while((read_bufSize = recv(client_handle, buffer, BUFSIZE, 0)) > 0) {
-        std::string received_data(buffer, read_bufSize);
-        incomingDataStreamParser.newData(
-                received_data, 
-                myServerLogic.getIncomingPacketsHandler(), 
-                myServerLogic.getCommunicationIssuesHandler()
-            );
-    }
-    myServerLogic.onConnectionClosed();
-    if (read_bufSize == 0) {
-        std::cout << "Client disconnected. Exiting.\n";
-    } else if (read_bufSize == -1) {
-        std::cout << "recv() failed. Exiting.\n";
-        return -4;
+    // The metrics snapshot: curl http://127.0.0.1:12346/
+    tau_additional::util::MetricsTextEndpoint metricsEndpoint(metricsPort);
+    if (!metricsEndpoint.start()) {
+        std::cerr << "Metrics are not available: " << metricsEndpoint.getLastError() << "\n";
+    }
+    std::cout << "Listening on the socket (port " << listenPort << "), waiting for clients...\n";
+    if (!server.run()) {
+        std::cerr << server.getLastError() << ". Exiting.\n";
+        return -2;
     }
     return 0;
 }
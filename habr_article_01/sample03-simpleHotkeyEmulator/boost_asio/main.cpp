@@ -6,6 +6,8 @@
 #include <tau/layout_generation/layout_info.h>
 #include <tau/util/basic_events_dispatcher.h>
 #include <tau/util/boost_asio_server.h>
+#include <tau_additional/communications_handling/shared_buffer_sender.h>
+#include <tau_additional/layout_generation/static_layout.h>
 #include <windows.h>
 
 namespace {
@@ -69,14 +71,26 @@ namespace {
         //sendSimpleHotkey(VK_CONTROL, 'v');
     }
 };
-tau::common::ElementID const COPY_BUTTON("COPY");
-tau::common::ElementID const PASTE_BUTTON("PASTE");
+namespace sl = tau_additional::layout_generation::static_layout;
+constexpr char COPY_BUTTON_ID[] = "COPY";
+constexpr char PASTE_BUTTON_ID[] = "PASTE";
+// The layout is static: it is checked by the compiler and serialized once, for all the clients
+constexpr auto LAYOUT = sl::layout("LAYOUT_PAGE_ID",
+    sl::page("LAYOUT_PAGE_ID", sl::evenlySplit(true,
+        sl::button("copy", COPY_BUTTON_ID),
+        sl::button("paste", PASTE_BUTTON_ID))));
+TAU_STATIC_LAYOUT_CHECK(LAYOUT);
+tau_additional::util::SharedBuffer const LAYOUT_PACKET = sl::makeResetLayoutPacket(LAYOUT);
+tau::common::ElementID const COPY_BUTTON(COPY_BUTTON_ID);
+tau::common::ElementID const PASTE_BUTTON(PASTE_BUTTON_ID);
 class MyEventsDispatcher : public tau::util::BasicEventsDispatcher
 {
+    tau::communications_handling::OutgiongPacketsGenerator & m_outgoingGenerator;
 public:
     MyEventsDispatcher(
         tau::communications_handling::OutgiongPacketsGenerator & outgoingGeneratorToUse): 
-            tau::util::BasicEventsDispatcher(outgoingGeneratorToUse)
+            tau::util::BasicEventsDispatcher(outgoingGeneratorToUse),
+            m_outgoingGenerator(outgoingGeneratorToUse)
         {};
 
     virtual void packetReceived_requestProcessingError(
@@ -95,12 +109,7 @@ public:
             << connectionInfo.getLocalAddrDump() << "\n";
     }
     virtual void packetReceived_clientDeviceInfo(tau::communications_handling::ClientDeviceInfo const & info) {
-        using namespace tau::layout_generation;
-        std::string layoutInfo = LayoutInfo().pushLayoutPage(LayoutPage(tau::common::LayoutPageID("LAYOUT_PAGE_ID"), 
-            EvenlySplitLayoutElementsContainer(true)
-                .push(ButtonLayoutElement().note("copy").ID(COPY_BUTTON))
-                .push(ButtonLayoutElement().note("paste").ID(PASTE_BUTTON)))).getJson();
-        sendPacket_resetLayout(layoutInfo);
+        tau_additional::communications_handling::sendSharedBuffer(m_outgoingGenerator, LAYOUT_PACKET);
     };
 
     virtual void packetReceived_buttonClick(tau::common::ElementID const & buttonID) {
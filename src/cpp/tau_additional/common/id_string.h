@@ -0,0 +1,23 @@
+// This source file is part of the 'tau' open source project.
+// Copyright (c) 2016, Yuriy Vosel.
+// Licensed under Boost Software License.
+// See LICENSE.txt for the licence information.
+
+#ifndef TAU_ADDITIONAL_COMMON_ID_STRING_H
+#define TAU_ADDITIONAL_COMMON_ID_STRING_H
+
+#include <string>
+
+namespace tau_additional {
+namespace common {
+
+// The tau ids (ElementID, LayoutPageID, LayoutID) are thin wrappers around std::string.
+// This is the single place, which depends on how the string is accessed.
+template <typename IdType>
+inline std::string const & getIdString(IdType const & id) {
+    return id.getValue();
+}
+
+}
+}
+#endif
@@ -0,0 +1,161 @@
+// This source file is part of the 'tau' open source project.
+// Copyright (c) 2016, Yuriy Vosel.
+// Licensed under Boost Software License.
+// See LICENSE.txt for the licence information.
+
+#ifndef TAU_ADDITIONAL_COMMON_INTERNED_ID_H
+#define TAU_ADDITIONAL_COMMON_INTERNED_ID_H
+
+#include <tau/util/basic_events_dispatcher.h>
+#include <tau_additional/common/id_string.h>
+#include <tau_additional/util/mutex.h>
+#include <tau_additional/util/unordered_map.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <deque>
+#include <string>
+
+namespace tau_additional {
+namespace common {
+
+// Process-wide registry, which assigns a small integer handle to every id value (one registry per id type).
+// The registry only grows: the handles and the stored id objects stay valid until the program exits.
+template <typename IdType>
+class IdInterner
+{
+    typedef typename tau_additional::util::UnorderedMap<std::string, uint32_t>::type Handles;
+
+    Handles m_handles;
+    std::deque<IdType> m_ids; // deque: push_back() does not move the already stored objects
+    mutable tau_additional::util::ReadWriteMutex m_mutex;
+
+    IdInterner() {};
+    IdInterner(IdInterner const &);
+    IdInterner & operator = (IdInterner const &);
+public:
+    // Constructed on the first use, so the interned constants can be defined at the namespace scope.
+    static IdInterner & getInstance() {
+        static IdInterner instance;
+        return instance;
+    }
+
+    // Returns the handle of the id (registers the id, if it is new).
+    uint32_t intern(IdType const & id, IdType const ** storedID) {
+        std::string const & idString = getIdString(id);
+        {
+            tau_additional::util::ScopedReadLock lock(m_mutex);
+            typename Handles::const_iterator found = m_handles.find(idString);
+            if (found != m_handles.end()) {
+                *storedID = &m_ids[found->second];
+                return found->second;
+            }
+        }
+        tau_additional::util::ScopedWriteLock lock(m_mutex);
+        typename Handles::const_iterator found = m_handles.find(idString);
+        if (found != m_handles.end()) {
+            *storedID = &m_ids[found->second];
+            return found->second;
+        }
+        uint32_t handle = uint32_t(m_ids.size());
+        m_ids.push_back(id);
+        m_handles.insert(std::make_pair(idString, handle));
+        *storedID = &m_ids.back();
+        return handle;
+    }
+
+    // Looks the id up without registering it (so the ids from the network can't grow the registry).
+    bool find(IdType const & id, uint32_t * handle, IdType const ** storedID) const {
+        tau_additional::util::ScopedReadLock lock(m_mutex);
+        typename Handles::const_iterator found = m_handles.find(getIdString(id));
+        if (found == m_handles.end()) {
+            return false;
+        }
+        *handle = found->second;
+        *storedID = &m_ids[found->second];
+        return true;
+    }
+
+    size_t getSize() const {
+        tau_additional::util::ScopedReadLock lock(m_mutex);
+        return m_ids.size();
+    }
+};
+
+// Compact id: the integer handle plus the pointer to the interned id object.
+// Comparison and hashing are integer operations; the object converts to the
+// original id type, so it can be passed to the layout builder and to the sendPacket_* methods.
+template <typename IdType>
+class InternedID
+{
+    uint32_t m_handle;
+    IdType const * m_id;
+public:
+    static const uint32_t INVALID_HANDLE = 0xFFFFFFFFu;
+
+    InternedID(): m_handle(INVALID_HANDLE), m_id(NULL) {};
+
+    explicit InternedID(IdType const & id) {
+        m_handle = IdInterner<IdType>::getInstance().intern(id, &m_id);
+    };
+
+    explicit InternedID(std::string const & idString) {
+        m_handle = IdInterner<IdType>::getInstance().intern(IdType(idString), &m_id);
+    };
+
+    // Returns the invalid InternedID if the id was never interned.
+    static InternedID find(IdType const & id) {
+        InternedID result;
+        if (!IdInterner<IdType>::getInstance().find(id, &result.m_handle, &result.m_id)) {
+            result = InternedID();
+        }
+        return result;
+    }
+
+    bool isValid() const {
+        return m_handle != INVALID_HANDLE;
+    }
+    uint32_t getHandle() const {
+        return m_handle;
+    }
+    // Should not be called for the invalid InternedID.
+    IdType const & getID() const {
+        return *m_id;
+    }
+    operator IdType const & () const {
+        return *m_id;
+    }
+
+    bool operator == (InternedID const & other) const {
+        return m_handle == other.m_handle;
+    }
+    bool operator != (InternedID const & other) const {
+        return m_handle != other.m_handle;
+    }
+    bool operator < (InternedID const & other) const {
+        return m_handle < other.m_handle;
+    }
+};
+
+template <typename IdType>
+const uint32_t InternedID<IdType>::INVALID_HANDLE;
+
+// Hash functor for the unordered containers.
+struct InternedIDHash
+{
+    template <typename IdType>
+    size_t operator () (InternedID<IdType> const & id) const {
+        return id.getHandle();
+    }
+};
+
+typedef InternedID<tau::common::ElementID> InternedElementID;
+typedef InternedID<tau::common::LayoutPageID> InternedLayoutPageID;
+
+template <typename IdType>
+inline std::string const & getIdString(InternedID<IdType> const & id) {
+    return getIdString(id.getID());
+}
+
+}
+}
+#endif
@@ -0,0 +1,865 @@
+// This source file is part of the 'tau' open source project.
+// Copyright (c) 2016, Yuriy Vosel.
+// Licensed under Boost Software License.
+// See LICENSE.txt for the licence information.
+
+#ifndef TAU_ADDITIONAL_COMMUNICATIONS_HANDLING_BINARY_ENCODING_H
+#define TAU_ADDITIONAL_COMMUNICATIONS_HANDLING_BINARY_ENCODING_H
+
+#include <tau/util/basic_events_dispatcher.h>
+#include <tau_additional/common/id_string.h>
+#include <tau_additional/communications_handling/client_device_info.h>
+#include <tau_additional/communications_handling/packet_serializer.h>
+#include <tau_additional/util/json_value.h>
+#include <tau_additional/util/unordered_map.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Compact binary alternative to the JSON layouts and the text packets, for the clients, which
+// advertise it in the device info packet (see isBinaryEncodingNegotiated()).
+//
+// Every packet is a frame: varint payload length, then the payload, which starts with the packet type.
+//   RESET_LAYOUT       binary layout: 'T' 'B' version, varint strings count, the strings, the value tree
+//   ELEMENT_NOTE       id, string           TEXT_VALUE         id, string
+//   BOOL_VALUE         id, byte (0/1)       SHOW_PAGE          id
+//   BUTTON_CLICK       id                   PAGE_SWITCHED      id
+//   BOOL_VALUE_UPDATE  id, flags            TEXT_VALUE_UPDATE  id, flags, string
+// The strings are varint length + bytes. The flags are bit 0 - the bool value, bit 1 - automatic update.
+// The id is a varint: N > 0 - the string N - 1 of the layout's string table (both sides have it
+// after the RESET_LAYOUT), 0 - the string follows. The varints are LEB128 (7 bits per byte, low first).
+// The value tree of the layout: the tag byte (null, false, true, number, string, array, object);
+// the number and the string are the string table indices (the number is kept as its text);
+// the array is the count and the values; the object is the count and the pairs of key index and value.
+
+namespace tau_additional {
+namespace communications_handling {
+
+namespace binary_encoding_details {
+    enum ValueTag {
+        TAG_NULL,
+        TAG_FALSE,
+        TAG_TRUE,
+        TAG_NUMBER,
+        TAG_STRING,
+        TAG_ARRAY,
+        TAG_OBJECT
+    };
+
+    static const size_t MAX_DEPTH = 256;
+
+    inline void appendVarint(std::string & output, uint64_t value) {
+        while (value >= 0x80) {
+            output += char((value & 0x7F) | 0x80);
+            value >>= 7;
+        }
+        output += char(value);
+    }
+
+    inline void appendString(std::string & output, std::string const & value) {
+        appendVarint(output, value.size());
+        output.append(value);
+    }
+
+    class Reader
+    {
+        unsigned char const * m_data;
+        size_t m_size;
+        size_t m_position;
+    public:
+        Reader(char const * data, size_t size):
+            m_data(reinterpret_cast<unsigned char const *>(data)), m_size(size), m_position(0)
+        {};
+
+        bool readByte(unsigned char & result) {
+            if (m_position >= m_size) {
+                return false;
+            }
+            result = m_data[m_position++];
+            return true;
+        }
+        bool readVarint(uint64_t & result) {
+            result = 0;
+            for (unsigned shift = 0; shift < 64 && m_position < m_size; shift += 7) {
+                unsigned char byte = m_data[m_position++];
+                result |= uint64_t(byte & 0x7F) << shift;
+                if ((byte & 0x80) == 0) {
+                    return true;
+                }
+            }
+            return false;
+        }
+        bool readString(std::string & result) {
+            uint64_t length;
+            if (!readVarint(length) || length > m_size - m_position) {
+                return false;
+            }
+            result.assign(reinterpret_cast<char const *>(m_data + m_position), size_t(length));
+            m_position += size_t(length);
+            return true;
+        }
+        bool isAtEnd() const {
+            return m_position == m_size;
+        }
+        size_t getPosition() const {
+            return m_position;
+        }
+        size_t getRemainingSize() const {
+            return m_size - m_position;
+        }
+    };
+};
+
+// String table of the binary layout: every distinct key, string and number text of the layout
+// once, the most frequent ones first (they get the one-byte indices). The element and page ids
+// of the later packets are sent as the indices in this table.
+class BinaryLayoutDictionary
+{
+    typedef tau_additional::util::UnorderedMap<std::string, uint64_t>::type Indices;
+
+    std::vector<std::string> m_strings;
+    Indices m_indices;
+public:
+    void clear() {
+        m_strings.clear();
+        m_indices.clear();
+    }
+    void add(std::string const & value) {
+        if (m_indices.insert(std::make_pair(value, uint64_t(m_strings.size()))).second) {
+            m_strings.push_back(value);
+        }
+    }
+    bool find(std::string const & value, uint64_t & index) const {
+        Indices::const_iterator found = m_indices.find(value);
+        if (found == m_indices.end()) {
+            return false;
+        }
+        index = found->second;
+        return true;
+    }
+    // NULL if there is no such index
+    std::string const * get(uint64_t index) const {
+        return (index < m_strings.size()) ? &m_strings[size_t(index)] : NULL;
+    }
+    size_t getSize() const {
+        return m_strings.size();
+    }
+};
+
+// Converts the layouts (the JSON documents, which LayoutInfo::getJson() produces) to the binary form
+// and back. The structure is kept exactly, so decode(encode(layout)) gives the same JSON text.
+class BinaryLayoutCodec
+{
+    typedef binary_encoding_details::Reader Reader;
+    // The first position is kept, so the strings of the same frequency stay in their document order
+    typedef tau_additional::util::UnorderedMap<std::string, std::pair<uint64_t, size_t> >::type StringFrequencies;
+
+    struct FrequencyOrder
+    {
+        bool operator () (std::pair<std::string, std::pair<uint64_t, size_t> > const & left,
+            std::pair<std::string, std::pair<uint64_t, size_t> > const & right) const
+        {
+            if (left.second.first != right.second.first) {
+                return left.second.first > right.second.first;
+            }
+            return left.second.second < right.second.second;
+        }
+    };
+public:
+    static const unsigned char FORMAT_VERSION = 1;
+
+    // The dictionary (if not NULL) gets the string table of the result.
+    static void encode(tau_additional::util::JsonValue const & layout, std::string & output,
+        BinaryLayoutDictionary * dictionary = NULL)
+    {
+        StringFrequencies frequencies;
+        countStrings(layout, frequencies);
+        std::vector<std::pair<std::string, std::pair<uint64_t, size_t> > > ordered(frequencies.begin(), frequencies.end());
+        std::sort(ordered.begin(), ordered.end(), FrequencyOrder());
+
+        BinaryLayoutDictionary localDictionary;
+        BinaryLayoutDictionary & table = (dictionary != NULL) ? *dictionary : localDictionary;
+        table.clear();
+        output += 'T';
+        output += 'B';
+        output += char(FORMAT_VERSION);
+        binary_encoding_details::appendVarint(output, ordered.size());
+        for (size_t i = 0; i < ordered.size(); ++i) {
+            table.add(ordered[i].first);
+            binary_encoding_details::appendString(output, ordered[i].first);
+        }
+        encodeValue(layout, table, output);
+    }
+
+    // Returns false if the text is not a valid JSON document.
+    static bool encodeJson(std::string const & layoutJson, std::string & output,
+        BinaryLayoutDictionary * dictionary = NULL)
+    {
+        tau_additional::util::JsonValue layout;
+        if (!tau_additional::util::JsonValue::parse(layoutJson, layout)) {
+            return false;
+        }
+        encode(layout, output, dictionary);
+        return true;
+    }
+
+    // Returns false if the data is not a complete binary layout of the supported version.
+    static bool decode(char const * data, size_t size, tau_additional::util::JsonValue & result,
+        BinaryLayoutDictionary * dictionary = NULL)
+    {
+        Reader reader(data, size);
+        unsigned char magic1, magic2, version;
+        if (!reader.readByte(magic1) || !reader.readByte(magic2) || !reader.readByte(version)
+            || magic1 != 'T' || magic2 != 'B' || version != FORMAT_VERSION)
+        {
+            return false;
+        }
+        uint64_t stringsCount;
+        if (!reader.readVarint(stringsCount) || stringsCount > size) {
+            return false;
+        }
+        BinaryLayoutDictionary localDictionary;
+        BinaryLayoutDictionary & table = (dictionary != NULL) ? *dictionary : localDictionary;
+        table.clear();
+        std::string value;
+        for (uint64_t i = 0; i < stringsCount; ++i) {
+            if (!reader.readString(value)) {
+                return false;
+            }
+            table.add(value);
+            if (table.getSize() != i + 1) {
+                return false; // duplicate string: the indices would be shifted
+            }
+        }
+        return decodeValue(reader, table, result, 0) && reader.isAtEnd();
+    }
+
+    // JSON text in, JSON text out (what the client, which does not build the document, would do)
+    static bool decodeToJson(char const * data, size_t size, std::string & layoutJson) {
+        tau_additional::util::JsonValue layout;
+        if (!decode(data, size, layout)) {
+            return false;
+        }
+        layout.write(layoutJson);
+        return true;
+    }
+private:
+    static void countString(std::string const & value, StringFrequencies & frequencies) {
+        std::pair<StringFrequencies::iterator, bool> inserted = frequencies.insert(
+            std::make_pair(value, std::make_pair(uint64_t(1), frequencies.size())));
+        if (!inserted.second) {
+            ++inserted.first->second.first;
+        }
+    }
+
+    static void countStrings(tau_additional::util::JsonValue const & value, StringFrequencies & frequencies) {
+        typedef tau_additional::util::JsonValue JsonValue;
+        switch (value.getType()) {
+            case JsonValue::TYPE_NUMBER:
+            case JsonValue::TYPE_STRING:
+                countString(value.getString(), frequencies);
+                break;
+            case JsonValue::TYPE_ARRAY:
+                for (size_t i = 0; i < value.getItems().size(); ++i) {
+                    countStrings(value.getItems()[i], frequencies);
+                }
+                break;
+            case JsonValue::TYPE_OBJECT:
+                for (size_t i = 0; i < value.getMembers().size(); ++i) {
+                    countString(value.getMembers()[i].first, frequencies);
+                    countStrings(value.getMembers()[i].second, frequencies);
+                }
+                break;
+            default:
+                break;
+        }
+    }
+
+    static void appendStringIndex(std::string const & value, BinaryLayoutDictionary const & table, std::string & output) {
+        uint64_t index = 0;
+        table.find(value, index);
+        binary_encoding_details::appendVarint(output, index);
+    }
+
+    static void encodeValue(tau_additional::util::JsonValue const & value, BinaryLayoutDictionary const & table,
+        std::string & output)
+    {
+        typedef tau_additional::util::JsonValue JsonValue;
+        switch (value.getType()) {
+            case JsonValue::TYPE_NULL:
+                output += char(binary_encoding_details::TAG_NULL);
+                break;
+            case JsonValue::TYPE_BOOL:
+                output += char(value.getBool() ? binary_encoding_details::TAG_TRUE : binary_encoding_details::TAG_FALSE);
+                break;
+            case JsonValue::TYPE_NUMBER:
+                output += char(binary_encoding_details::TAG_NUMBER);
+                appendStringIndex(value.getString(), table, output);
+                break;
+            case JsonValue::TYPE_STRING:
+                output += char(binary_encoding_details::TAG_STRING);
+                appendStringIndex(value.getString(), table, output);
+                break;
+            case JsonValue::TYPE_ARRAY:
+                output += char(binary_encoding_details::TAG_ARRAY);
+                binary_encoding_details::appendVarint(output, value.getItems().size());
+                for (size_t i = 0; i < value.getItems().size(); ++i) {
+                    encodeValue(value.getItems()[i], table, output);
+                }
+                break;
+            case JsonValue::TYPE_OBJECT:
+                output += char(binary_encoding_details::TAG_OBJECT);
+                binary_encoding_details::appendVarint(output, value.getMembers().size());
+                for (size_t i = 0; i < value.getMembers().size(); ++i) {
+                    appendStringIndex(value.getMembers()[i].first, table, output);
+                    encodeValue(value.getMembers()[i].second, table, output);
+                }
+                break;
+        }
+    }
+
+    static std::string const * readStringIndex(Reader & reader, BinaryLayoutDictionary const & table) {
+        uint64_t index;
+        return reader.readVarint(index) ? table.get(index) : NULL;
+    }
+
+    static bool decodeValue(Reader & reader, BinaryLayoutDictionary const & table,
+        tau_additional::util::JsonValue & result, size_t depth)
+    {
+        unsigned char tag;
+        if (depth > binary_encoding_details::MAX_DEPTH || !reader.readByte(tag)) {
+            return false;
+        }
+        std::string const * string = NULL;
+        uint64_t count = 0;
+        switch (tag) {
+            case binary_encoding_details::TAG_NULL:
+                result.setNull();
+                return true;
+            case binary_encoding_details::TAG_FALSE:
+            case binary_encoding_details::TAG_TRUE:
+                result.setBool(tag == binary_encoding_details::TAG_TRUE);
+                return true;
+            case binary_encoding_details::TAG_NUMBER:
+            case binary_encoding_details::TAG_STRING:
+                string = readStringIndex(reader, table);
+                if (string == NULL) {
+                    return false;
+                }
+                if (tag == binary_encoding_details::TAG_NUMBER) {
+                    result.setNumber(*string);
+                } else {
+                    result.setString(*string);
+                }
+                return true;
+            case binary_encoding_details::TAG_ARRAY:
+                // Every item takes at least one byte, so the count can't be larger than the data
+                if (!reader.readVarint(count) || count > reader.getRemainingSize()) {
+                    return false;
+                }
+                result.setArray();
+                result.reserveChildren(size_t(count));
+                for (uint64_t i = 0; i < count; ++i) {
+                    if (!decodeValue(reader, table, result.addItem(), depth + 1)) {
+                        return false;
+                    }
+                }
+                return true;
+            case binary_encoding_details::TAG_OBJECT:
+                if (!reader.readVarint(count) || count > reader.getRemainingSize()) {
+                    return false;
+                }
+                result.setObject();
+                result.reserveChildren(size_t(count));
+                for (uint64_t i = 0; i < count; ++i) {
+                    string = readStringIndex(reader, table);
+                    if (string == NULL || !decodeValue(reader, table, result.addMember(*string), depth + 1)) {
+                        return false;
+                    }
+                }
+                return true;
+            default:
+                return false;
+        }
+    }
+};
+
+// The binary packets. The ids are sent as the string table indices, when the dictionary
+// of the client's layout is given (see BinaryLayoutCodec::encode()).
+class BinaryPacketSerializer
+{
+public:
+    enum PacketType {
+        RESET_LAYOUT = 0x01,
+        ELEMENT_NOTE = 0x02,
+        TEXT_VALUE = 0x03,
+        BOOL_VALUE = 0x04,
+        SHOW_PAGE = 0x05,
+        BUTTON_CLICK = 0x11,
+        PAGE_SWITCHED = 0x12,
+        BOOL_VALUE_UPDATE = 0x13,
+        TEXT_VALUE_UPDATE = 0x14
+    };
+    enum Flags {
+        FLAG_VALUE = 0x01,
+        FLAG_AUTOMATIC_UPDATE = 0x02
+    };
+private:
+    BinaryLayoutDictionary const * m_dictionary;
+    std::string m_payload;
+public:
+    explicit BinaryPacketSerializer(BinaryLayoutDictionary const * dictionary = NULL):
+        m_dictionary(dictionary)
+    {};
+
+    void setDictionary(BinaryLayoutDictionary const * dictionary) {
+        m_dictionary = dictionary;
+    }
+
+    // The binaryLayout is the BinaryLayoutCodec::encode() result
+    std::string resetLayout(std::string const & binaryLayout) {
+        startPacket(RESET_LAYOUT);
+        m_payload.append(binaryLayout);
+        return finishPacket();
+    }
+    std::string changeElementNote(tau::common::ElementID const & elementID, std::string const & note) {
+        startPacket(ELEMENT_NOTE);
+        appendID(tau_additional::common::getIdString(elementID));
+        binary_encoding_details::appendString(m_payload, note);
+        return finishPacket();
+    }
+    std::string updateTextValue(tau::common::ElementID const & elementID, std::string const & value) {
+        startPacket(TEXT_VALUE);
+        appendID(tau_additional::common::getIdString(elementID));
+        binary_encoding_details::appendString(m_payload, value);
+        return finishPacket();
+    }
+    std::string updateBooleanValue(tau::common::ElementID const & elementID, bool value) {
+        startPacket(BOOL_VALUE);
+        appendID(tau_additional::common::getIdString(elementID));
+        m_payload += char(value ? 1 : 0);
+        return finishPacket();
+    }
+    std::string changeShownLayoutPage(tau::common::LayoutPageID const & layoutPageID) {
+        startPacket(SHOW_PAGE);
+        appendID(tau_additional::common::getIdString(layoutPageID));
+        return finishPacket();
+    }
+
+    // The client's packets (for the clients and the tests)
+    std::string buttonClick(tau::common::ElementID const & buttonID) {
+        startPacket(BUTTON_CLICK);
+        appendID(tau_additional::common::getIdString(buttonID));
+        return finishPacket();
+    }
+    std::string layoutPageSwitched(tau::common::LayoutPageID const & layoutPageID) {
+        startPacket(PAGE_SWITCHED);
+        appendID(tau_additional::common::getIdString(layoutPageID));
+        return finishPacket();
+    }
+    std::string boolValueUpdate(tau::common::ElementID const & inputBoxID, bool value, bool isAutomaticUpdate) {
+        startPacket(BOOL_VALUE_UPDATE);
+        appendID(tau_additional::common::getIdString(inputBoxID));
+        m_payload += char((value ? FLAG_VALUE : 0) | (isAutomaticUpdate ? FLAG_AUTOMATIC_UPDATE : 0));
+        return finishPacket();
+    }
+    std::string textValueUpdate(tau::common::ElementID const & inputBoxID, std::string const & value, bool isAutomaticUpdate) {
+        startPacket(TEXT_VALUE_UPDATE);
+        appendID(tau_additional::common::getIdString(inputBoxID));
+        m_payload += char(isAutomaticUpdate ? FLAG_AUTOMATIC_UPDATE : 0);
+        binary_encoding_details::appendString(m_payload, value);
+        return finishPacket();
+    }
+private:
+    void startPacket(PacketType type) {
+        m_payload.clear();
+        m_payload += char(type);
+    }
+    void appendID(std::string const & id) {
+        uint64_t index;
+        if (m_dictionary != NULL && m_dictionary->find(id, index)) {
+            binary_encoding_details::appendVarint(m_payload, index + 1);
+        } else {
+            m_payload += char(0);
+            binary_encoding_details::appendString(m_payload, id);
+        }
+    }
+    std::string finishPacket() {
+        std::string result;
+        result.reserve(m_payload.size() + 5);
+        binary_encoding_details::appendVarint(result, m_payload.size());
+        result.append(m_payload);
+        return result;
+    }
+};
+
+// Splits the incoming data of the binary client into the packets and calls the dispatcher
+// (the same callbacks, which the text packets lead to). The frames may be split between the
+// newData() calls arbitrarily.
+class BinaryPacketParser
+{
+    static const size_t MAX_PACKET_SIZE = 1024 * 1024;
+
+    BinaryLayoutDictionary const * m_dictionary;
+    std::string m_incompleteData;
+    std::string m_id;
+    std::string m_value;
+public:
+    explicit BinaryPacketParser(BinaryLayoutDictionary const * dictionary = NULL):
+        m_dictionary(dictionary)
+    {};
+
+    void setDictionary(BinaryLayoutDictionary const * dictionary) {
+        m_dictionary = dictionary;
+    }
+
+    // Returns false if the data is malformed (the connection should be closed).
+    bool newData(char const * data, size_t size, tau::util::BasicEventsDispatcher & dispatcher) {
+        if (!m_incompleteData.empty()) {
+            m_incompleteData.append(data, size);
+            std::string buffered;
+            buffered.swap(m_incompleteData);
+            return parseFrames(buffered.data(), buffered.size(), dispatcher);
+        }
+        return parseFrames(data, size, dispatcher);
+    }
+private:
+    bool parseFrames(char const * data, size_t size, tau::util::BasicEventsDispatcher & dispatcher) {
+        size_t position = 0;
+        while (position < size) {
+            binary_encoding_details::Reader header(data + position, size - position);
+            uint64_t payloadSize;
+            if (!header.readVarint(payloadSize)) {
+                if (size - position >= 10) {
+                    return false;
+                }
+                break; // the length is incomplete
+            }
+            if (payloadSize == 0 || payloadSize > MAX_PACKET_SIZE) {
+                return false;
+            }
+            if (payloadSize > size - position - header.getPosition()) {
+                break;
+            }
+            if (!parsePacket(data + position + header.getPosition(), size_t(payloadSize), dispatcher)) {
+                return false;
+            }
+            position += header.getPosition() + size_t(payloadSize);
+        }
+        m_incompleteData.assign(data + position, size - position);
+        return true;
+    }
+
+    bool readID(binary_encoding_details::Reader & reader) {
+        uint64_t reference;
+        if (!reader.readVarint(reference)) {
+            return false;
+        }
+        if (reference == 0) {
+            return reader.readString(m_id);
+        }
+        std::string const * id = (m_dictionary != NULL) ? m_dictionary->get(reference - 1) : NULL;
+        if (id == NULL) {
+            return false;
+        }
+        m_id = *id;
+        return true;
+    }
+
+    bool parsePacket(char const * payload, size_t size, tau::util::BasicEventsDispatcher & dispatcher) {
+        binary_encoding_details::Reader reader(payload, size);
+        unsigned char type;
+        unsigned char flags = 0;
+        if (!reader.readByte(type) || !readID(reader)) {
+            return false;
+        }
+        switch (type) {
+            case BinaryPacketSerializer::BUTTON_CLICK:
+                if (!reader.isAtEnd()) {
+                    return false;
+                }
+                dispatcher.packetReceived_buttonClick(tau::common::ElementID(m_id));
+                return true;
+            case BinaryPacketSerializer::PAGE_SWITCHED:
+                if (!reader.isAtEnd()) {
+                    return false;
+                }
+                dispatcher.packetReceived_layoutPageSwitched(tau::common::LayoutPageID(m_id));
+                return true;
+            case BinaryPacketSerializer::BOOL_VALUE_UPDATE:
+                if (!reader.readByte(flags) || !reader.isAtEnd()) {
+                    return false;
+                }
+                dispatcher.packetReceived_boolValueUpdate(tau::common::ElementID(m_id),
+                    (flags & BinaryPacketSerializer::FLAG_VALUE) != 0,
+                    (flags & BinaryPacketSerializer::FLAG_AUTOMATIC_UPDATE) != 0);
+                return true;
+            case BinaryPacketSerializer::TEXT_VALUE_UPDATE:
+                if (!reader.readByte(flags) || !reader.readString(m_value) || !reader.isAtEnd()) {
+                    return false;
+                }
+                dispatcher.packetReceived_textValueUpdate(tau::common::ElementID(m_id), m_value,
+                    (flags & BinaryPacketSerializer::FLAG_AUTOMATIC_UPDATE) != 0);
+                return true;
+            default:
+                return false;
+        }
+    }
+};
+
+namespace binary_encoding_details {
+    inline size_t findText(char const * data, size_t size, size_t from, std::string const & text) {
+        char const * found = std::search(data + from, data + size, text.begin(), text.end());
+        return (found == data + size) ? std::string::npos : size_t(found - data);
+    }
+};
+
+// Converts the text packets, which the dispatchers send (the library's serialization, see PacketSerializer),
+// to the binary packets, for the connection, which has switched to the binary encoding.
+// The framing of every kind of the text packets is learned from the library itself: the packet is
+// serialized twice, with the markers of different lengths in place of the id and the value, and the text
+// around them should be the same both times. The layout of the reset packet is encoded with the
+// BinaryLayoutCodec, and its string table is used for the ids of the later packets of both directions
+// (see getDictionary()). The packets may be split between the calls arbitrarily (the streamed layout
+// is collected whole, before it is encoded). The values should not contain the text, which ends them
+// in the text packets: the text clients could not parse such packets either.
+class TextPacketsTranscoder
+{
+    enum PacketKind
+    {
+        KIND_RESET_LAYOUT,
+        KIND_ELEMENT_NOTE,
+        KIND_TEXT_VALUE,
+        KIND_BOOL_FALSE,
+        KIND_BOOL_TRUE,
+        KIND_SHOW_PAGE,
+        KINDS_COUNT
+    };
+
+    TextPacketFraming m_framings[KINDS_COUNT];
+    bool m_valid;
+    bool m_failed;
+    std::string m_incompleteData;
+    BinaryLayoutDictionary m_dictionary;
+    BinaryPacketSerializer m_serializer;
+    std::string m_binaryLayout;
+
+    TextPacketsTranscoder(TextPacketsTranscoder const &);
+    TextPacketsTranscoder & operator = (TextPacketsTranscoder const &);
+public:
+    TextPacketsTranscoder():
+        m_valid(false),
+        m_failed(false),
+        m_serializer(&m_dictionary)
+    {
+        m_valid = learnFramings();
+    };
+
+    // False if the library's packets can't be recognized: the connection should not be switched then.
+    bool isValid() const {
+        return m_valid;
+    }
+
+    // Appends the binary packets of the complete text packets to the output; the rest is kept till the
+    // next call. Returns false if the data is not a text packet of the known kinds (the connection
+    // should be closed); all the later calls return false as well.
+    bool transcode(char const * data, size_t size, std::string & output) {
+        if (m_failed || !m_valid) {
+            return false;
+        }
+        if (!m_incompleteData.empty()) {
+            m_incompleteData.append(data, size);
+            std::string buffered;
+            buffered.swap(m_incompleteData);
+            return transcodePackets(buffered.data(), buffered.size(), output);
+        }
+        return transcodePackets(data, size, output);
+    }
+
+    // The string table of the last layout, which was sent (empty before the first one).
+    BinaryLayoutDictionary const & getDictionary() const {
+        return m_dictionary;
+    }
+private:
+    bool learnFramings() {
+        // The markers are not valid JSON, so they can't be confused with the framing
+        std::string const firstID("\x01id\x01");
+        std::string const secondID("\x01#the second id#\x01");
+        std::string const firstValue("\x01value\x01");
+        std::string const secondValue("\x01#the second value#\x01");
+        PacketSerializer serializer;
+        TextPacketFraming second;
+        return splitTextPacket(serializer.resetLayout(firstValue), firstValue, NULL, m_framings[KIND_RESET_LAYOUT])
+            && splitTextPacket(serializer.resetLayout(secondValue), secondValue, NULL, second)
+            && isSameFraming(m_framings[KIND_RESET_LAYOUT], second)
+            && splitTextPacket(serializer.changeElementNote(tau::common::ElementID(firstID), firstValue),
+                firstID, &firstValue, m_framings[KIND_ELEMENT_NOTE])
+            && splitTextPacket(serializer.changeElementNote(tau::common::ElementID(secondID), secondValue),
+                secondID, &secondValue, second)
+            && isSameFraming(m_framings[KIND_ELEMENT_NOTE], second)
+            && splitTextPacket(serializer.updateTextValue(tau::common::ElementID(firstID), firstValue),
+                firstID, &firstValue, m_framings[KIND_TEXT_VALUE])
+            && splitTextPacket(serializer.updateTextValue(tau::common::ElementID(secondID), secondValue),
+                secondID, &secondValue, second)
+            && isSameFraming(m_framings[KIND_TEXT_VALUE], second)
+            && splitTextPacket(serializer.updateBooleanValue(tau::common::ElementID(firstID), false),
+                firstID, NULL, m_framings[KIND_BOOL_FALSE])
+            && splitTextPacket(serializer.updateBooleanValue(tau::common::ElementID(secondID), false),
+                secondID, NULL, second)
+            && isSameFraming(m_framings[KIND_BOOL_FALSE], second)
+            && splitTextPacket(serializer.updateBooleanValue(tau::common::ElementID(firstID), true),
+                firstID, NULL, m_framings[KIND_BOOL_TRUE])
+            && splitTextPacket(serializer.updateBooleanValue(tau::common::ElementID(secondID), true),
+                secondID, NULL, second)
+            && isSameFraming(m_framings[KIND_BOOL_TRUE], second)
+            && m_framings[KIND_BOOL_TRUE].suffix != m_framings[KIND_BOOL_FALSE].suffix
+            && splitTextPacket(serializer.changeShownLayoutPage(tau::common::LayoutPageID(firstID)),
+                firstID, NULL, m_framings[KIND_SHOW_PAGE])
+            && splitTextPacket(serializer.changeShownLayoutPage(tau::common::LayoutPageID(secondID)),
+                secondID, NULL, second)
+            && isSameFraming(m_framings[KIND_SHOW_PAGE], second)
+            && arePrefixesDistinct();
+    }
+
+    // The kind of the packet is told by its prefix; the bool packets differ by the suffix only
+    bool arePrefixesDistinct() const {
+        for (int first = 0; first < KINDS_COUNT; ++first) {
+            for (int second = 0; second < KINDS_COUNT; ++second) {
+                std::string const & left = m_framings[first].prefix;
+                std::string const & right = m_framings[second].prefix;
+                bool isBoolPair = (first == KIND_BOOL_FALSE || first == KIND_BOOL_TRUE)
+                    && (second == KIND_BOOL_FALSE || second == KIND_BOOL_TRUE);
+                if (first != second && !isBoolPair && right.compare(0, left.size(), left) == 0) {
+                    return false;
+                }
+            }
+        }
+        return m_framings[KIND_BOOL_FALSE].prefix == m_framings[KIND_BOOL_TRUE].prefix;
+    }
+
+    bool transcodePackets(char const * data, size_t size, std::string & output) {
+        size_t position = 0;
+        while (position < size) {
+            size_t end = transcodePacket(data, size, position, output);
+            if (m_failed) {
+                return false;
+            }
+            if (end == std::string::npos) {
+                break; // the packet is incomplete
+            }
+            position = end;
+        }
+        m_incompleteData.assign(data + position, size - position);
+        return true;
+    }
+
+    // Returns the end of the packet, or npos if it is incomplete (m_failed is set, if it is unknown).
+    size_t transcodePacket(char const * data, size_t size, size_t position, std::string & output) {
+        using binary_encoding_details::findText;
+        bool incomplete = false;
+        int kind = KINDS_COUNT;
+        for (int candidate = 0; candidate < KINDS_COUNT && kind == KINDS_COUNT; ++candidate) {
+            std::string const & prefix = m_framings[candidate].prefix;
+            size_t available = (size - position < prefix.size()) ? (size - position) : prefix.size();
+            if (prefix.compare(0, available, data + position, available) == 0) {
+                if (available < prefix.size()) {
+                    incomplete = true;
+                } else {
+                    kind = candidate;
+                }
+            }
+        }
+        if (kind == KINDS_COUNT) {
+            m_failed = !incomplete;
+            return std::string::npos;
+        }
+        size_t partStart = position + m_framings[kind].prefix.size();
+        if (kind == KIND_ELEMENT_NOTE || kind == KIND_TEXT_VALUE) {
+            size_t idEnd = findText(data, size, partStart, m_framings[kind].infix);
+            size_t valueStart = idEnd + m_framings[kind].infix.size();
+            size_t valueEnd = (idEnd == std::string::npos) ? idEnd : findText(data, size, valueStart, m_framings[kind].suffix);
+            if (valueEnd == std::string::npos) {
+                return valueEnd;
+            }
+            tau::common::ElementID elementID(std::string(data + partStart, idEnd - partStart));
+            std::string value(data + valueStart, valueEnd - valueStart);
+            output += (kind == KIND_ELEMENT_NOTE) ? m_serializer.changeElementNote(elementID, value)
+                : m_serializer.updateTextValue(elementID, value);
+            return valueEnd + m_framings[kind].suffix.size();
+        }
+        if (kind == KIND_BOOL_FALSE || kind == KIND_BOOL_TRUE) {
+            // The one of the two suffixes, which comes first
+            size_t falseEnd = findText(data, size, partStart, m_framings[KIND_BOOL_FALSE].suffix);
+            size_t trueEnd = findText(data, size, partStart, m_framings[KIND_BOOL_TRUE].suffix);
+            bool value = (trueEnd < falseEnd);
+            size_t idEnd = value ? trueEnd : falseEnd;
+            if (idEnd == std::string::npos) {
+                return idEnd;
+            }
+            output += m_serializer.updateBooleanValue(
+                tau::common::ElementID(std::string(data + partStart, idEnd - partStart)), value);
+            return idEnd + m_framings[value ? KIND_BOOL_TRUE : KIND_BOOL_FALSE].suffix.size();
+        }
+        size_t partEnd = findText(data, size, partStart, m_framings[kind].suffix);
+        if (partEnd == std::string::npos) {
+            return partEnd;
+        }
+        std::string part(data + partStart, partEnd - partStart);
+        if (kind == KIND_SHOW_PAGE) {
+            output += m_serializer.changeShownLayoutPage(tau::common::LayoutPageID(part));
+        } else {
+            m_binaryLayout.clear();
+            if (!BinaryLayoutCodec::encodeJson(part, m_binaryLayout, &m_dictionary)) {
+                m_failed = true;
+                return std::string::npos;
+            }
+            output += m_serializer.resetLayout(m_binaryLayout);
+        }
+        return partEnd + m_framings[kind].suffix.size();
+    }
+};
+
+// Implemented by the outgoing packets generators, which can switch their connection to the binary
+// encoding (both the outgoing packets and the incoming ones, see TextPacketsTranscoder).
+class BinaryEncodingSwitch
+{
+public:
+    virtual ~BinaryEncodingSwitch() {};
+    // The packets, which are sent after the call, are binary; the client's data is parsed as the binary
+    // packets from the next received chunk. Returns false (and changes nothing) if the connection
+    // can't be switched.
+    virtual bool startBinaryEncoding() = 0;
+};
+
+// The name of the encoding in the 'encodings' field of the device info.
+inline char const * getBinaryEncodingName() {
+    return "binary1";
+}
+
+// The binary encoding is used for the client, which lists it in the device info;
+// the others get the JSON layouts and the text packets, as usual.
+inline bool isBinaryEncodingNegotiated(tau::communications_handling::ClientDeviceInfo const & info) {
+    return isEncodingSupportedByClient(info, getBinaryEncodingName());
+}
+
+// Switches the connection to the binary encoding, if the client has asked for it and the generator
+// supports it. Should be called in packetReceived_clientDeviceInfo, before the layout is sent; the
+// client sends its binary packets after it gets the layout. If the stream is compressed too, the
+// compression should be started first: the client sees the compressed stream header before the binary packets.
+inline bool startBinaryEncodingIfNegotiated(
+    tau::communications_handling::OutgiongPacketsGenerator & generator,
+    tau::communications_handling::ClientDeviceInfo const & info)
+{
+    if (!isBinaryEncodingNegotiated(info)) {
+        return false;
+    }
+    BinaryEncodingSwitch * binaryEncodingSwitch = dynamic_cast<BinaryEncodingSwitch *>(&generator);
+    return (binaryEncodingSwitch != NULL) && binaryEncodingSwitch->startBinaryEncoding();
+}
+
+}
+}
+#endif
@@ -0,0 +1,351 @@
+// This source file is part of the 'tau' open source project.
+// Copyright (c) 2016, Yuriy Vosel.
+// Licensed under Boost Software License.
+// See LICENSE.txt for the licence information.
+
+#ifndef TAU_ADDITIONAL_COMMUNICATIONS_HANDLING_BUFFERED_OUTGOING_PACKETS_GENERATOR_H
+#define TAU_ADDITIONAL_COMMUNICATIONS_HANDLING_BUFFERED_OUTGOING_PACKETS_GENERATOR_H
+
+#include <tau/communications_handling/outgiong_packets_generator.h>
+#include <tau_additional/communications_handling/shared_buffer_sender.h>
+#include <tau_additional/communications_handling/streaming_sender.h>
+#include <tau_additional/util/metrics.h>
+#include <tau_additional/util/shared_buffer.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <errno.h>
+#include <string.h>
+#include <stdint.h>
+#include <deque>
+#include <string>
+
+namespace tau_additional {
+namespace communications_handling {
+
+// Outgoing packets generator, which does not write the packets right away.
+// The packets are queued and written with one sendmsg() (scatter/gather) call on flush().
+// The socket is expected to be non-blocking: the partially written data stays in the
+// queue, and the next flush() continues from the place where the previous one stopped.
+// The already serialized packets (SharedBuffer) are queued without copying.
+// The streamed data (see StreamingSender) is taken from its source chunk by chunk, when the queue
+// gets shorter than STREAM_QUEUED_BYTES, so it is produced while the previous chunks are written.
+// The written bytes and the queue size at every flush() are recorded in the current MetricsRegistry
+// (outgoing_data.bytes, outgoing_data.queued_bytes), when the data path metrics are enabled.
+class BufferedOutgoingPacketsGenerator :
+    public tau::communications_handling::OutgiongPacketsGenerator,
+    public SharedBufferSender,
+    public StreamingSender
+{
+public:
+    struct Statistics
+    {
+        Statistics():
+            packetsQueued(0), bytesQueued(0), packetsWritten(0), bytesWritten(0), writeSyscalls(0)
+        {};
+        uint64_t packetsQueued;
+        uint64_t bytesQueued;
+        uint64_t packetsWritten;
+        uint64_t bytesWritten;
+        uint64_t writeSyscalls;
+
+        // Number of the write() calls, which would have been made without the batching.
+        uint64_t getSyscallsSaved() const {
+            return (packetsWritten > writeSyscalls) ? (packetsWritten - writeSyscalls) : 0;
+        }
+    };
+
+    static const size_t DEFAULT_HIGH_WATER_MARK = 1024 * 1024;
+    static const size_t MAX_BUFFERS_PER_SYSCALL = 64;
+    static const size_t STREAM_QUEUED_BYTES = 64 * 1024;
+private:
+    // The packet or the stream, which is sent after the current stream
+    struct PendingItem
+    {
+        tau_additional::util::SharedBuffer data;
+        OutgoingDataSource * source;
+    };
+
+    int m_socketHandle;
+    std::deque<tau_additional::util::SharedBuffer> m_queue;
+    size_t m_firstPacketOffset;
+    size_t m_queuedBytes;
+    size_t m_highWaterMark;
+    bool m_flushRequested;
+    bool m_closeRequested;
+    bool m_writeFailed;
+    OutgoingDataSource * m_source; // the stream, which is being sent
+    std::deque<PendingItem> m_pendingItems;
+    size_t m_deferredBytes; // the data of the pending items
+    bool m_producing;
+    Statistics m_statistics;
+    tau_additional::util::MetricsCounter & m_writtenBytesMetric;
+    tau_additional::util::MetricsHistogram & m_queuedBytesMetric;
+public:
+    BufferedOutgoingPacketsGenerator(int output_socket_handle,
+        size_t highWaterMark = DEFAULT_HIGH_WATER_MARK):
+        m_socketHandle(output_socket_handle),
+        m_firstPacketOffset(0),
+        m_queuedBytes(0),
+        m_highWaterMark(highWaterMark),
+        m_flushRequested(false),
+        m_closeRequested(false),
+        m_writeFailed(false),
+        m_source(NULL),
+        m_deferredBytes(0),
+        m_producing(false),
+        m_writtenBytesMetric(tau_additional::util::MetricsRegistry::getCurrent().getCounter("outgoing_data.bytes")),
+        m_queuedBytesMetric(tau_additional::util::MetricsRegistry::getCurrent().getHistogram("outgoing_data.queued_bytes"))
+    {};
+    virtual ~BufferedOutgoingPacketsGenerator() {
+        dropStreams();
+    }
+
+    virtual void sendData(std::string const & data) {
+        if (m_writeFailed || data.empty()) {
+            return;
+        }
+        if (isSendingDeferred()) {
+            deferSending(tau_additional::util::SharedBuffer(data));
+            return;
+        }
+        enqueue(tau_additional::util::SharedBuffer(data));
+    }
+    virtual void sendSharedBuffer(tau_additional::util::SharedBuffer const & data) {
+        if (m_writeFailed || data.empty()) {
+            return;
+        }
+        if (isSendingDeferred()) {
+            deferSending(data);
+            return;
+        }
+        enqueue(data);
+    }
+    virtual void sendStream(OutgoingDataSource * source) {
+        if (m_writeFailed) {
+            delete source;
+            return;
+        }
+        if (m_source != NULL) {
+            PendingItem item;
+            item.source = source;
+            m_pendingItems.push_back(item);
+            return;
+        }
+        m_source = source;
+        pullStream();
+    }
+    virtual void close_connection() {
+        m_closeRequested = true;
+        if (!m_flushRequested) {
+            m_flushRequested = true;
+            onFlushNeeded();
+        }
+    }
+
+    // Writes as much of the queued data as the socket accepts.
+    // Returns true when there is nothing left to write.
+    bool flush() {
+        m_flushRequested = false;
+        if (!m_queue.empty() && !m_writeFailed && tau_additional::util::areDataPathMetricsEnabled()) {
+            m_queuedBytesMetric.record(m_queuedBytes);
+        }
+        while (!m_queue.empty() && !m_writeFailed) {
+            iovec buffers[MAX_BUFFERS_PER_SYSCALL];
+            size_t requestedBytes = 0;
+            size_t buffersCount = fillBuffers(buffers, MAX_BUFFERS_PER_SYSCALL, requestedBytes);
+            msghdr message;
+            memset(&message, 0, sizeof(message));
+            message.msg_iov = buffers;
+            message.msg_iovlen = buffersCount;
+            ssize_t result = sendmsg(m_socketHandle, &message, MSG_NOSIGNAL);
+            if (result == -1) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                    m_writeFailed = true;
+                }
+                break;
+            }
+            ++m_statistics.writeSyscalls;
+            consume(result);
+            if (size_t(result) < requestedBytes) {
+                break; // the socket buffer is full
+            }
+        }
+        return m_queue.empty();
+    }
+
+    // For the owners, which write the queued data themselves (for example, with io_uring) instead of
+    // flush(): fills the buffers with the queued data and returns their count (0 - nothing to write).
+    // The data stays in the queue (and valid) until completeWrite() is called.
+    size_t prepareWrite(iovec * buffers, size_t maxCount) {
+        m_flushRequested = false;
+        if (m_queue.empty() || m_writeFailed) {
+            return 0;
+        }
+        if (tau_additional::util::areDataPathMetricsEnabled()) {
+            m_queuedBytesMetric.record(m_queuedBytes);
+        }
+        size_t requestedBytes = 0;
+        return fillBuffers(buffers, maxCount, requestedBytes);
+    }
+    // The result of the write of the prepared buffers: the written bytes count, or negative on failure.
+    void completeWrite(ssize_t result) {
+        if (result < 0) {
+            m_writeFailed = true;
+            return;
+        }
+        ++m_statistics.writeSyscalls;
+        consume(result);
+    }
+
+    // After the socket is closed by the owner, the generator just drops everything it gets.
+    void detachSocket() {
+        m_writeFailed = true;
+        m_socketHandle = -1;
+        dropStreams();
+    }
+
+    size_t getQueuedBytes() const {
+        return m_queuedBytes;
+    }
+    // The packets, which wait for the stream to end (see isSendingDeferred()): they are not queued yet,
+    // but they are counted for the high water mark. The streams, which wait, are not counted.
+    size_t getDeferredBytes() const {
+        return m_deferredBytes;
+    }
+    bool hasQueuedData() const {
+        return !m_queue.empty() && !m_writeFailed;
+    }
+    // When the queued and the deferred data is above the high water mark, the owner should stop
+    // producing new packets for this connection (for example, stop reading the client requests).
+    bool isAboveHighWaterMark() const {
+        return m_queuedBytes + m_deferredBytes > m_highWaterMark;
+    }
+    bool isCloseRequested() const {
+        return m_closeRequested;
+    }
+    // Not all the data of the stream is queued yet: the connection should not be closed,
+    // even if the queue is empty for the moment.
+    bool isStreaming() const {
+        return m_source != NULL;
+    }
+    bool isWriteFailed() const {
+        return m_writeFailed;
+    }
+    int getSocketHandle() const {
+        return m_socketHandle;
+    }
+    Statistics const & getStatistics() const {
+        return m_statistics;
+    }
+protected:
+    // Called when the first packet is queued after the last flush().
+    // Override it to schedule the flush (for example, at the end of the event loop turn).
+    virtual void onFlushNeeded() {}
+
+    // While the stream is being sent, the other packets wait for its end. The derived generators,
+    // which transform the data (for example, compress it), check it before the transformation:
+    // the chunks of the stream are passed to sendSharedBuffer() too, when it is their turn.
+    bool isSendingDeferred() const {
+        return m_source != NULL && !m_producing;
+    }
+    void deferSending(tau_additional::util::SharedBuffer const & data) {
+        PendingItem item;
+        item.data = data;
+        item.source = NULL;
+        m_pendingItems.push_back(item);
+        m_deferredBytes += data.size();
+    }
+private:
+    // Takes the chunks of the stream, while the queue is short; when the stream ends,
+    // sends the packets, which have waited for it (up to the next stream).
+    void pullStream() {
+        if (m_producing) {
+            return;
+        }
+        m_producing = true;
+        while (m_source != NULL && m_queuedBytes < STREAM_QUEUED_BYTES && !m_writeFailed) {
+            tau_additional::util::SharedBuffer chunk = m_source->getNextChunk();
+            if (!chunk.empty()) {
+                sendSharedBuffer(chunk);
+                continue;
+            }
+            delete m_source;
+            m_source = NULL;
+            while (!m_pendingItems.empty() && m_source == NULL) {
+                PendingItem item = m_pendingItems.front();
+                m_pendingItems.pop_front();
+                if (item.source != NULL) {
+                    m_source = item.source;
+                } else {
+                    m_deferredBytes -= item.data.size();
+                    sendSharedBuffer(item.data);
+                }
+            }
+        }
+        m_producing = false;
+        if (m_writeFailed) {
+            dropStreams();
+        }
+    }
+
+    void dropStreams() {
+        delete m_source;
+        m_source = NULL;
+        for (size_t i = 0; i < m_pendingItems.size(); ++i) {
+            delete m_pendingItems[i].source;
+        }
+        m_pendingItems.clear();
+        m_deferredBytes = 0;
+    }
+
+    void enqueue(tau_additional::util::SharedBuffer const & data) {
+        m_queue.push_back(data);
+        m_queuedBytes += data.size();
+        ++m_statistics.packetsQueued;
+        m_statistics.bytesQueued += data.size();
+        if (!m_flushRequested) {
+            m_flushRequested = true;
+            onFlushNeeded();
+        }
+    }
+
+    size_t fillBuffers(iovec * buffers, size_t maxCount, size_t & requestedBytes) const {
+        size_t buffersCount = 0;
+        for (std::deque<tau_additional::util::SharedBuffer>::const_iterator it = m_queue.begin();
+            (it != m_queue.end()) && (buffersCount < maxCount); ++it, ++buffersCount) {
+            size_t offset = (buffersCount == 0) ? m_firstPacketOffset : 0;
+            buffers[buffersCount].iov_base = const_cast<char *>(it->data() + offset);
+            buffers[buffersCount].iov_len = it->size() - offset;
+            requestedBytes += buffers[buffersCount].iov_len;
+        }
+        return buffersCount;
+    }
+
+    void consume(size_t bytes) {
+        m_queuedBytes -= bytes;
+        m_statistics.bytesWritten += bytes;
+        if (tau_additional::util::areDataPathMetricsEnabled()) {
+            m_writtenBytesMetric.add(bytes);
+        }
+        while (bytes > 0) {
+            size_t leftInFirstPacket = m_queue.front().size() - m_firstPacketOffset;
+            if (bytes < leftInFirstPacket) {
+                m_firstPacketOffset += bytes;
+                return;
+            }
+            bytes -= leftInFirstPacket;
+            m_queue.pop_front();
+            m_firstPacketOffset = 0;
+            ++m_statistics.packetsWritten;
+        }
+        pullStream();
+    }
+};
+
+}
+}
+#endif
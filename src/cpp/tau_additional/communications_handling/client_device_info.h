@@ -0,0 +1,79 @@
+// This source file is part of the 'tau' open source project.
+// Copyright (c) 2016, Yuriy Vosel.
+// Licensed under Boost Software License.
+// See LICENSE.txt for the licence information.
+
+#ifndef TAU_ADDITIONAL_COMMUNICATIONS_HANDLING_CLIENT_DEVICE_INFO_H
+#define TAU_ADDITIONAL_COMMUNICATIONS_HANDLING_CLIENT_DEVICE_INFO_H
+
+#include <tau/communications_handling/outgiong_packets_generator.h>
+#include <stddef.h>
+#include <string>
+
+namespace tau_additional {
+namespace communications_handling {
+
+// The text, which the client reports in its device info packet.
+// This is the single place, which depends on how the ClientDeviceInfo is accessed.
+inline std::string const & getClientDeviceInfoText(tau::communications_handling::ClientDeviceInfo const & info) {
+    return info.m_s;
+}
+
+// The device info text is a list of the 'name=value' fields, separated with ';'
+// (for example, "token=4f2a9c;encodings=binary1"). Returns false if there is no such field.
+inline bool getClientDeviceInfoField(tau::communications_handling::ClientDeviceInfo const & info,
+    std::string const & name, std::string & value)
+{
+    std::string const & text = getClientDeviceInfoText(info);
+    size_t fieldStart = 0;
+    while (fieldStart <= text.size()) {
+        size_t fieldEnd = text.find(';', fieldStart);
+        if (fieldEnd == std::string::npos) {
+            fieldEnd = text.size();
+        }
+        size_t separator = text.find('=', fieldStart);
+        if (separator < fieldEnd && separator - fieldStart == name.size()
+            && text.compare(fieldStart, name.size(), name) == 0)
+        {
+            value.assign(text, separator + 1, fieldEnd - separator - 1);
+            return true;
+        }
+        fieldStart = fieldEnd + 1;
+    }
+    return false;
+}
+
+// The resume token (see ResumableSessionStore): the 'token' field, empty if there is none.
+// The rest of the device info (the browser, the device model) is the same for many clients,
+// so it is never used as the token.
+inline std::string getClientToken(tau::communications_handling::ClientDeviceInfo const & info) {
+    std::string result;
+    getClientDeviceInfoField(info, "token", result);
+    return result;
+}
+
+// True if the 'encodings' field (a comma separated list) contains the encoding.
+inline bool isEncodingSupportedByClient(tau::communications_handling::ClientDeviceInfo const & info,
+    std::string const & encoding)
+{
+    std::string encodings;
+    if (!getClientDeviceInfoField(info, "encodings", encodings)) {
+        return false;
+    }
+    size_t start = 0;
+    while (start <= encodings.size()) {
+        size_t end = encodings.find(',', start);
+        if (end == std::string::npos) {
+            end = encodings.size();
+        }
+        if (encodings.compare(start, end - start, encoding) == 0) {
+            return true;
+        }
+        start = end + 1;
+    }
+    return false;
+}
+
+}
+}
+#endif
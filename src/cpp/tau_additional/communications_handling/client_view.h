@@ -0,0 +1,214 @@
+// This source file is part of the 'tau' open source project.
+// Copyright (c) 2016, Yuriy Vosel.
+// Licensed under Boost Software License.
+// See LICENSE.txt for the licence information.
+
+#ifndef TAU_ADDITIONAL_COMMUNICATIONS_HANDLING_CLIENT_VIEW_H
+#define TAU_ADDITIONAL_COMMUNICATIONS_HANDLING_CLIENT_VIEW_H
+
+#include <tau/communications_handling/outgiong_packets_generator.h>
+#include <tau_additional/common/id_string.h>
+#include <tau_additional/communications_handling/packet_serializer.h>
+#include <tau_additional/communications_handling/shared_buffer_sender.h>
+#include <tau_additional/util/mutex.h>
+#include <tau_additional/util/shared_buffer.h>
+#include <map>
+#include <string>
+#include <utility>
+
+namespace tau_additional {
+namespace communications_handling {
+
+// What the client shows, as far as the server knows: the layout, the active page and the
+// element notes/values, which were sent by the server or entered by the user.
+struct ClientViewState
+{
+    typedef std::map<std::string, std::string> StringValues;
+    typedef std::map<std::string, bool> BoolValues;
+
+    std::string layoutKey; // empty - no layout was sent
+    std::string activePageID;
+    StringValues notes;
+    StringValues textValues;
+    BoolValues boolValues;
+
+    void clear() {
+        layoutKey.clear();
+        activePageID.clear();
+        notes.clear();
+        textValues.clear();
+        boolValues.clear();
+    }
+    void swap(ClientViewState & other) {
+        layoutKey.swap(other.layoutKey);
+        activePageID.swap(other.activePageID);
+        notes.swap(other.notes);
+        textValues.swap(other.textValues);
+        boolValues.swap(other.boolValues);
+    }
+};
+
+// Sends the layout and the element updates to one client, remembering what the client shows.
+// The update, which the client already shows, is not sent again.
+// The values, which the user changes, should be reported by the dispatcher (the ...ByClient methods);
+// the broadcasts reach the view through the SessionRegistry (see SessionRegistry::addSession()),
+// so everything, which the client is sent, is remembered.
+// The packets are the text ones: the connection converts them, if the client has negotiated
+// the binary encoding (see BinaryEncodingSwitch).
+// Thread-safe: the broadcasts may come from the other threads (the PooledBoostAsioServer).
+class ClientView
+{
+    tau::communications_handling::OutgiongPacketsGenerator & m_outgoingGenerator;
+    PacketSerializer m_serializer;
+    ClientViewState m_state;
+    mutable tau_additional::util::Mutex m_mutex;
+
+    ClientView(ClientView const &);
+    ClientView & operator = (ClientView const &);
+public:
+    explicit ClientView(tau::communications_handling::OutgiongPacketsGenerator & outgoingGeneratorToUse):
+        m_outgoingGenerator(outgoingGeneratorToUse)
+    {};
+
+    // Always sent: the client drops all its state. The layoutKey identifies the layout version and
+    // its encoding (for example, the LayoutCache key and variant), the start page is the one,
+    // which the layout opens on.
+    void resetLayout(std::string const & layoutKey, tau_additional::util::SharedBuffer const & resetLayoutPacket,
+        tau::common::LayoutPageID const & startPageID)
+    {
+        tau_additional::util::ScopedLock lock(m_mutex);
+        m_state.clear();
+        m_state.layoutKey = layoutKey;
+        m_state.activePageID = tau_additional::common::getIdString(startPageID);
+        sendSharedBuffer(m_outgoingGenerator, resetLayoutPacket);
+    }
+    void changeShownLayoutPage(tau::common::LayoutPageID const & pageID) {
+        tau_additional::util::ScopedLock lock(m_mutex);
+        std::string const & page = tau_additional::common::getIdString(pageID);
+        if (m_state.activePageID != page) {
+            m_state.activePageID = page;
+            sendPageSwitch(pageID);
+        }
+    }
+    void changeElementNote(tau::common::ElementID const & elementID, std::string const & note) {
+        tau_additional::util::ScopedLock lock(m_mutex);
+        if (updateValue(m_state.notes, elementID, note)) {
+            sendNote(elementID, note);
+        }
+    }
+    // The packet is the same note, serialized once for many clients (see SessionRegistry::broadcastNote()):
+    // it is sent as is.
+    void changeElementNote(tau::common::ElementID const & elementID, std::string const & note,
+        tau_additional::util::SharedBuffer const & serializedNote)
+    {
+        tau_additional::util::ScopedLock lock(m_mutex);
+        if (updateValue(m_state.notes, elementID, note)) {
+            sendSharedBuffer(m_outgoingGenerator, serializedNote);
+        }
+    }
+    void updateTextValue(tau::common::ElementID const & elementID, std::string const & value) {
+        tau_additional::util::ScopedLock lock(m_mutex);
+        if (updateValue(m_state.textValues, elementID, value)) {
+            sendTextValue(elementID, value);
+        }
+    }
+    void updateBooleanValue(tau::common::ElementID const & elementID, bool value) {
+        tau_additional::util::ScopedLock lock(m_mutex);
+        if (updateValue(m_state.boolValues, elementID, value)) {
+            sendBooleanValue(elementID, value);
+        }
+    }
+
+    void pageSwitchedByClient(tau::common::LayoutPageID const & pageID) {
+        tau_additional::util::ScopedLock lock(m_mutex);
+        m_state.activePageID = tau_additional::common::getIdString(pageID);
+    }
+    void textValueChangedByClient(tau::common::ElementID const & elementID, std::string const & value) {
+        tau_additional::util::ScopedLock lock(m_mutex);
+        updateValue(m_state.textValues, elementID, value);
+    }
+    void boolValueChangedByClient(tau::common::ElementID const & elementID, bool value) {
+        tau_additional::util::ScopedLock lock(m_mutex);
+        updateValue(m_state.boolValues, elementID, value);
+    }
+    // The note, which was sent to the client bypassing the view (for example, by the
+    // CoalescingElementUpdatesSender), is only remembered.
+    void elementNoteSentDirectly(tau::common::ElementID const & elementID, std::string const & note) {
+        tau_additional::util::ScopedLock lock(m_mutex);
+        updateValue(m_state.notes, elementID, note);
+    }
+
+    // Nothing is sent (see resendLayout()).
+    void restore(ClientViewState const & state) {
+        tau_additional::util::ScopedLock lock(m_mutex);
+        m_state = state;
+    }
+    // After restore(): the client may be a new process, which shows nothing, so the layout is sent
+    // again, followed by the remembered page, notes and values. The packet should be the one of the
+    // remembered layout (see ClientViewState::layoutKey).
+    void resendLayout(tau_additional::util::SharedBuffer const & resetLayoutPacket) {
+        tau_additional::util::ScopedLock lock(m_mutex);
+        sendSharedBuffer(m_outgoingGenerator, resetLayoutPacket);
+        if (!m_state.activePageID.empty()) {
+            sendPageSwitch(tau::common::LayoutPageID(m_state.activePageID));
+        }
+        for (ClientViewState::StringValues::const_iterator it = m_state.notes.begin(); it != m_state.notes.end(); ++it) {
+            sendNote(tau::common::ElementID(it->first), it->second);
+        }
+        for (ClientViewState::StringValues::const_iterator it = m_state.textValues.begin();
+            it != m_state.textValues.end(); ++it)
+        {
+            sendTextValue(tau::common::ElementID(it->first), it->second);
+        }
+        for (ClientViewState::BoolValues::const_iterator it = m_state.boolValues.begin();
+            it != m_state.boolValues.end(); ++it)
+        {
+            sendBooleanValue(tau::common::ElementID(it->first), it->second);
+        }
+    }
+
+    ClientViewState getState() const {
+        tau_additional::util::ScopedLock lock(m_mutex);
+        return m_state;
+    }
+    std::string getActivePageID() const {
+        tau_additional::util::ScopedLock lock(m_mutex);
+        return m_state.activePageID;
+    }
+    bool hasLayout() const {
+        tau_additional::util::ScopedLock lock(m_mutex);
+        return !m_state.layoutKey.empty();
+    }
+private:
+    void sendPageSwitch(tau::common::LayoutPageID const & pageID) {
+        m_outgoingGenerator.sendData(m_serializer.changeShownLayoutPage(pageID));
+    }
+    void sendNote(tau::common::ElementID const & elementID, std::string const & note) {
+        m_outgoingGenerator.sendData(m_serializer.changeElementNote(elementID, note));
+    }
+    void sendTextValue(tau::common::ElementID const & elementID, std::string const & value) {
+        m_outgoingGenerator.sendData(m_serializer.updateTextValue(elementID, value));
+    }
+    void sendBooleanValue(tau::common::ElementID const & elementID, bool value) {
+        m_outgoingGenerator.sendData(m_serializer.updateBooleanValue(elementID, value));
+    }
+
+    // Returns false if the client shows the value already.
+    template <typename ValuesType, typename ValueType>
+    static bool updateValue(ValuesType & values, tau::common::ElementID const & elementID, ValueType const & value) {
+        std::pair<typename ValuesType::iterator, bool> inserted = values.insert(
+            std::make_pair(tau_additional::common::getIdString(elementID), value));
+        if (inserted.second) {
+            return true;
+        }
+        if (inserted.first->second == value) {
+            return false;
+        }
+        inserted.first->second = value;
+        return true;
+    }
+};
+
+}
+}
+#endif
@@ -0,0 +1,136 @@
+// This source file is part of the 'tau' open source project.
+// Copyright (c) 2016, Yuriy Vosel.
+// Licensed under Boost Software License.
+// See LICENSE.txt for the licence information.
+
+#ifndef TAU_ADDITIONAL_COMMUNICATIONS_HANDLING_COALESCING_ELEMENT_UPDATES_SENDER_H
+#define TAU_ADDITIONAL_COMMUNICATIONS_HANDLING_COALESCING_ELEMENT_UPDATES_SENDER_H
+
+#include <tau/communications_handling/outgiong_packets_generator.h>
+#include <tau_additional/common/id_string.h>
+#include <tau_additional/communications_handling/delayed_calls_scheduler.h>
+#include <tau_additional/communications_handling/packet_serializer.h>
+#include <tau_additional/util/unordered_map.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace tau_additional {
+namespace communications_handling {
+
+// Sends the note and text value changes of one client, keeping only the last change of every
+// element until the connection writes its data out (one event loop turn for the EpollServer,
+// one handler for the PooledBoostAsioServer). Three note changes of the same element,
+// made while one request is handled, result in one packet.
+// The pending changes are sent in the order of the first change of every element, after the
+// packets, which were sent directly (sendPacket_* methods) during the same loop turn.
+// Without the delayed calls support in the connection, every change is sent immediately.
+class CoalescingElementUpdatesSender : private DelayedCallsScheduler::Callback
+{
+public:
+    struct Statistics
+    {
+        Statistics(): changesRequested(0), changesSent(0) {};
+        uint64_t changesRequested;
+        uint64_t changesSent;
+    };
+private:
+    enum UpdateKind {
+        ELEMENT_NOTE,
+        TEXT_VALUE
+    };
+    struct PendingUpdate
+    {
+        PendingUpdate(UpdateKind kind_, tau::common::ElementID const & elementID_, std::string const & value_):
+            kind(kind_), elementID(elementID_), value(value_)
+        {};
+        UpdateKind kind;
+        tau::common::ElementID elementID;
+        std::string value;
+    };
+    typedef tau_additional::util::UnorderedMap<std::string, size_t>::type PendingPositions;
+
+    tau::communications_handling::OutgiongPacketsGenerator & m_outgoingGenerator;
+    DelayedCallsScheduler * m_scheduler;
+    PacketSerializer m_serializer;
+    std::vector<PendingUpdate> m_pendingUpdates;
+    PendingPositions m_pendingPositions;
+    Statistics m_statistics;
+public:
+    explicit CoalescingElementUpdatesSender(
+        tau::communications_handling::OutgiongPacketsGenerator & outgoingGeneratorToUse):
+        m_outgoingGenerator(outgoingGeneratorToUse),
+        m_scheduler(NULL)
+    {};
+
+    virtual ~CoalescingElementUpdatesSender() {
+        if (m_scheduler != NULL && !m_pendingUpdates.empty()) {
+            m_scheduler->cancelDelayedCall(*this);
+        }
+    }
+
+    void changeElementNote(tau::common::ElementID const & elementID, std::string const & note) {
+        addUpdate(ELEMENT_NOTE, elementID, note);
+    }
+    void updateTextValue(tau::common::ElementID const & elementID, std::string const & value) {
+        addUpdate(TEXT_VALUE, elementID, value);
+    }
+
+    // Sends the pending changes right away (for example, before the layout reset).
+    void sendPendingUpdates() {
+        if (m_pendingUpdates.empty()) {
+            return;
+        }
+        if (m_scheduler != NULL) {
+            m_scheduler->cancelDelayedCall(*this);
+        }
+        onDelayedCall();
+    }
+
+    Statistics const & getStatistics() const {
+        return m_statistics;
+    }
+private:
+    void addUpdate(UpdateKind kind, tau::common::ElementID const & elementID, std::string const & value) {
+        ++m_statistics.changesRequested;
+        if (m_scheduler == NULL) {
+            m_scheduler = getDelayedCallsScheduler(m_outgoingGenerator);
+        }
+        if (m_scheduler == NULL) {
+            m_pendingUpdates.push_back(PendingUpdate(kind, elementID, value));
+            onDelayedCall();
+            return;
+        }
+        std::string key(1, (kind == ELEMENT_NOTE) ? 'N' : 'T');
+        key.append(tau_additional::common::getIdString(elementID));
+        std::pair<PendingPositions::iterator, bool> inserted =
+            m_pendingPositions.insert(std::make_pair(key, m_pendingUpdates.size()));
+        if (!inserted.second) {
+            m_pendingUpdates[inserted.first->second].value = value;
+            return;
+        }
+        m_pendingUpdates.push_back(PendingUpdate(kind, elementID, value));
+        if (m_pendingUpdates.size() == 1) {
+            m_scheduler->scheduleDelayedCall(*this, 0);
+        }
+    }
+
+    // The pending changes are serialized into one buffer
+    virtual void onDelayedCall() {
+        std::string packets;
+        for (size_t i = 0; i < m_pendingUpdates.size(); ++i) {
+            PendingUpdate const & update = m_pendingUpdates[i];
+            packets += (update.kind == ELEMENT_NOTE)
+                ? m_serializer.changeElementNote(update.elementID, update.value)
+                : m_serializer.updateTextValue(update.elementID, update.value);
+        }
+        m_statistics.changesSent += m_pendingUpdates.size();
+        m_pendingUpdates.clear();
+        m_pendingPositions.clear();
+        m_outgoingGenerator.sendData(packets);
+    }
+};
+
+}
+}
+#endif
@@ -0,0 +1,45 @@
+// This source file is part of the 'tau' open source project.
+// Copyright (c) 2016, Yuriy Vosel.
+// Licensed under Boost Software License.
+// See LICENSE.txt for the licence information.
+
+#ifndef TAU_ADDITIONAL_COMMUNICATIONS_HANDLING_CONNECTION_EXECUTOR_H
+#define TAU_ADDITIONAL_COMMUNICATIONS_HANDLING_CONNECTION_EXECUTOR_H
+
+#include <tau/communications_handling/outgiong_packets_generator.h>
+#include <stddef.h>
+
+namespace tau_additional {
+namespace communications_handling {
+
+// Implemented by the outgoing packets generators (connections), which can run the code
+// on their own thread when asked from any other thread. This is the way to reach the
+// connection from a foreign thread (see OffloadingEventsDispatcher): the task calls
+// sendData()/close_connection() of the connection as if it was a regular handler.
+class ConnectionExecutor
+{
+public:
+    class Task
+    {
+    public:
+        virtual ~Task() {};
+        // The connection is still alive during the call (but may be closed already).
+        virtual void run(tau::communications_handling::OutgiongPacketsGenerator & connection) = 0;
+    };
+
+    virtual ~ConnectionExecutor() {};
+    // Can be called from any thread. Takes the ownership of the task: it is run (in the
+    // order of the execute() calls) and deleted by the connection's thread.
+    virtual void execute(Task * task) = 0;
+};
+
+// Returns NULL if the connection of the generator can't run the tasks from the other threads.
+inline ConnectionExecutor * getConnectionExecutor(
+    tau::communications_handling::OutgiongPacketsGenerator & generator)
+{
+    return dynamic_cast<ConnectionExecutor *>(&generator);
+}
+
+}
+}
+#endif
@@ -0,0 +1,47 @@
+// This source file is part of the 'tau' open source project.
+// Copyright (c) 2016, Yuriy Vosel.
+// Licensed under Boost Software License.
+// See LICENSE.txt for the licence information.
+
+#ifndef TAU_ADDITIONAL_COMMUNICATIONS_HANDLING_DELAYED_CALLS_SCHEDULER_H
+#define TAU_ADDITIONAL_COMMUNICATIONS_HANDLING_DELAYED_CALLS_SCHEDULER_H
+
+#include <tau/communications_handling/outgiong_packets_generator.h>
+#include <stdint.h>
+
+namespace tau_additional {
+namespace communications_handling {
+
+// Implemented by the connections (outgoing packets generators), which can call the user code back
+// after a delay. The callback is executed by the thread, which serves the connection, so it never
+// runs concurrently with the events dispatcher callbacks.
+// The methods should be called from that thread too (for example, from the dispatcher callbacks).
+class DelayedCallsScheduler
+{
+public:
+    class Callback
+    {
+    public:
+        virtual ~Callback() {};
+        virtual void onDelayedCall() = 0;
+    };
+
+    virtual ~DelayedCallsScheduler() {};
+
+    // There is at most one pending call per callback object: scheduling it again replaces the deadline.
+    // The zero delay means 'before the data, which is sent now, is written to the socket'.
+    // The pending calls are dropped when the connection is closed.
+    virtual void scheduleDelayedCall(Callback & callback, uint64_t delayNanoseconds) = 0;
+    virtual void cancelDelayedCall(Callback & callback) = 0;
+};
+
+// Returns NULL if the connection does not support the delayed calls.
+inline DelayedCallsScheduler * getDelayedCallsScheduler(
+    tau::communications_handling::OutgiongPacketsGenerator & generator)
+{
+    return dynamic_cast<DelayedCallsScheduler *>(&generator);
+}
+
+}
+}
+#endif
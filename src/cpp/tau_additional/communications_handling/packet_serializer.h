@@ -0,0 +1,116 @@
+// This source file is part of the 'tau' open source project.
+// Copyright (c) 2016, Yuriy Vosel.
+// Licensed under Boost Software License.
+// See LICENSE.txt for the licence information.
+
+#ifndef TAU_ADDITIONAL_COMMUNICATIONS_HANDLING_PACKET_SERIALIZER_H
+#define TAU_ADDITIONAL_COMMUNICATIONS_HANDLING_PACKET_SERIALIZER_H
+
+#include <tau/util/basic_events_dispatcher.h>
+#include <tau/communications_handling/outgiong_packets_generator.h>
+#include <stddef.h>
+#include <string>
+
+namespace tau_additional {
+namespace communications_handling {
+
+namespace packet_serializer_details {
+    class CapturingPacketsGenerator :
+        public tau::communications_handling::OutgiongPacketsGenerator
+    {
+        std::string m_capturedData;
+    public:
+        virtual void sendData(std::string const & data) {
+            m_capturedData.append(data);
+        }
+        virtual void close_connection() {}
+
+        std::string takeCapturedData() {
+            std::string result;
+            result.swap(m_capturedData);
+            return result;
+        }
+    };
+
+    // Makes sure that the generator is constructed before the BasicEventsDispatcher base.
+    struct CapturingPacketsGeneratorHolder
+    {
+        CapturingPacketsGenerator m_capturingGenerator;
+    };
+};
+
+// Produces the bytes of the outgoing packets without sending them anywhere.
+// The library's sendPacket_* methods are used for the serialization, so the result is exactly
+// what the connection would have sent. The result can be cached or sent to many clients.
+class PacketSerializer :
+    private packet_serializer_details::CapturingPacketsGeneratorHolder,
+    private tau::util::BasicEventsDispatcher
+{
+public:
+    PacketSerializer():
+        tau::util::BasicEventsDispatcher(m_capturingGenerator)
+    {};
+
+    std::string resetLayout(std::string const & layoutJson) {
+        sendPacket_resetLayout(layoutJson);
+        return m_capturingGenerator.takeCapturedData();
+    }
+    std::string changeElementNote(tau::common::ElementID const & elementID, std::string const & note) {
+        sendPacket_changeElementNote(elementID, note);
+        return m_capturingGenerator.takeCapturedData();
+    }
+    std::string updateTextValue(tau::common::ElementID const & elementID, std::string const & value) {
+        sendPacket_updateTextValue(elementID, value);
+        return m_capturingGenerator.takeCapturedData();
+    }
+    std::string updateBooleanValue(tau::common::ElementID const & elementID, bool value) {
+        sendPacket_updateBooleanValue(elementID, value);
+        return m_capturingGenerator.takeCapturedData();
+    }
+    std::string changeShownLayoutPage(tau::common::LayoutPageID const & layoutPageID) {
+        sendPacket_changeShownLayoutPage(layoutPageID);
+        return m_capturingGenerator.takeCapturedData();
+    }
+};
+
+// The text around the parts (the id, the value) of one kind of the text packets.
+// It is learned from the library itself: the packet is serialized with the markers in place of the parts
+// (see splitTextPacket()), twice, with the markers of different lengths, and the framing should be
+// the same both times (see isSameFraming()); otherwise the library changes the parts somehow.
+struct TextPacketFraming
+{
+    std::string prefix; // before the first part
+    std::string infix;  // between the parts, if there are two
+    std::string suffix; // after the last part
+};
+
+// Finds the framing of the packet, which was serialized with the markers in place of the parts.
+inline bool splitTextPacket(std::string const & packet, std::string const & firstPart,
+    std::string const * secondPart, TextPacketFraming & result)
+{
+    size_t firstPosition = packet.find(firstPart);
+    if (firstPosition == std::string::npos) {
+        return false;
+    }
+    result.prefix.assign(packet, 0, firstPosition);
+    result.infix.clear();
+    size_t end = firstPosition + firstPart.size();
+    if (secondPart != NULL) {
+        size_t secondPosition = packet.find(*secondPart, end);
+        if (secondPosition == std::string::npos) {
+            return false;
+        }
+        result.infix.assign(packet, end, secondPosition - end);
+        end = secondPosition + secondPart->size();
+    }
+    result.suffix.assign(packet, end, std::string::npos);
+    return !result.prefix.empty() && !result.suffix.empty() && (secondPart == NULL || !result.infix.empty());
+}
+
+inline bool isSameFraming(TextPacketFraming const & left, TextPacketFraming const & right) {
+    return left.prefix == right.prefix && left.infix == right.infix && left.suffix == right.suffix;
+}
+
+}
+}
+#endif
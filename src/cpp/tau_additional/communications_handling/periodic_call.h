@@ -0,0 +1,88 @@
+// This source file is part of the 'tau' open source project.
+// Copyright (c) 2016, Yuriy Vosel.
+// Licensed under Boost Software License.
+// See LICENSE.txt for the licence information.
+
+#ifndef TAU_ADDITIONAL_COMMUNICATIONS_HANDLING_PERIODIC_CALL_H
+#define TAU_ADDITIONAL_COMMUNICATIONS_HANDLING_PERIODIC_CALL_H
+
+#include <tau_additional/communications_handling/delayed_calls_scheduler.h>
+#include <tau_additional/util/monotonic_clock.h>
+#include <stdint.h>
+
+namespace tau_additional {
+namespace communications_handling {
+
+// Calls the callback every periodNanoseconds with the DelayedCallsScheduler (one-shot delayed calls).
+// The calls keep the fixed rate: the next deadline is counted from the previous one, not from
+// the moment of the call, so the slow callbacks do not make the period drift. The periods,
+// which were missed completely (the thread was busy), are skipped, not called in a burst.
+//
+// Per connection (the scheduler of the connection, see getDelayedCallsScheduler()):
+//   PeriodicCall telemetryUpdates(*getDelayedCallsScheduler(generator), telemetryCallback, 100 * 1000000);
+// Per group (the server-wide scheduler; the callback broadcasts to the group, see SessionRegistry):
+//   PeriodicCall groupUpdates(server.getScheduler(), broadcastCallback, 1000 * 1000000);
+class PeriodicCall : private DelayedCallsScheduler::Callback
+{
+    DelayedCallsScheduler & m_scheduler;
+    DelayedCallsScheduler::Callback & m_callback;
+    uint64_t m_periodNanoseconds;
+    uint64_t m_nextDeadline; // 0 - stopped
+    uint64_t m_skippedCalls;
+
+    PeriodicCall(PeriodicCall const &);
+    PeriodicCall & operator = (PeriodicCall const &);
+public:
+    PeriodicCall(DelayedCallsScheduler & scheduler, DelayedCallsScheduler::Callback & callback,
+        uint64_t periodNanoseconds):
+        m_scheduler(scheduler),
+        m_callback(callback),
+        m_periodNanoseconds(periodNanoseconds > 0 ? periodNanoseconds : 1),
+        m_nextDeadline(0),
+        m_skippedCalls(0)
+    {};
+
+    virtual ~PeriodicCall() {
+        stop();
+    }
+
+    // The first call happens after the first period (or after initialDelayNanoseconds).
+    void start() {
+        start(m_periodNanoseconds);
+    }
+    void start(uint64_t initialDelayNanoseconds) {
+        m_nextDeadline = tau_additional::util::getMonotonicNanoseconds() + initialDelayNanoseconds;
+        m_scheduler.scheduleDelayedCall(*this, initialDelayNanoseconds);
+    }
+
+    void stop() {
+        if (m_nextDeadline != 0) {
+            m_nextDeadline = 0;
+            m_scheduler.cancelDelayedCall(*this);
+        }
+    }
+
+    bool isStarted() const {
+        return m_nextDeadline != 0;
+    }
+    uint64_t getSkippedCallsCount() const {
+        return m_skippedCalls;
+    }
+private:
+    virtual void onDelayedCall() {
+        uint64_t now = tau_additional::util::getMonotonicNanoseconds();
+        m_nextDeadline += m_periodNanoseconds;
+        if (m_nextDeadline <= now) {
+            uint64_t missedPeriods = (now - m_nextDeadline) / m_periodNanoseconds + 1;
+            m_skippedCalls += missedPeriods;
+            m_nextDeadline += missedPeriods * m_periodNanoseconds;
+        }
+        // Scheduled before the call, so the callback can stop() the periodic call
+        m_scheduler.scheduleDelayedCall(*this, m_nextDeadline - now);
+        m_callback.onDelayedCall();
+    }
+};
+
+}
+}
+#endif
@@ -0,0 +1,67 @@
+// This source file is part of the 'tau' open source project.
+// Copyright (c) 2016, Yuriy Vosel.
+// Licensed under Boost Software License.
+// See LICENSE.txt for the licence information.
+
+#ifndef TAU_ADDITIONAL_COMMUNICATIONS_HANDLING_RAW_INCOMING_DATA_STREAM_PARSER_H
+#define TAU_ADDITIONAL_COMMUNICATIONS_HANDLING_RAW_INCOMING_DATA_STREAM_PARSER_H
+
+#include <tau/communications_handling/incoming_data_stream_parser.h>
+#include <tau_additional/util/metrics.h>
+#include <tau_additional/util/monotonic_clock.h>
+#include <stdint.h>
+#include <string>
+
+namespace tau_additional {
+namespace communications_handling {
+
+// Wrapper around the tau::communications_handling::IncomingDataStreamParser, which accepts
+// the received data as a pointer/length pair (i.e. straight from the recv() buffer).
+// The library parser takes a std::string, so the data still has to be copied once, but the
+// string is reused between the calls: after the first few chunks its capacity is big enough
+// and no heap allocations happen on the receive path.
+// The received bytes and the parse time of every chunk are recorded in the current MetricsRegistry
+// (incoming_data.bytes, incoming_data.parse_time_ns). The time, spent in the handlers of the
+// MeteredEventsDispatcher, is not included; with the other dispatchers it is. Nothing is recorded
+// (and the clock is not read), until the data path metrics are enabled (see enableDataPathMetrics()).
+class RawIncomingDataStreamParser
+{
+    tau::communications_handling::IncomingDataStreamParser m_parser;
+    std::string m_chunk;
+    tau_additional::util::MetricsCounter & m_receivedBytes;
+    tau_additional::util::MetricsHistogram & m_parseTime;
+public:
+    RawIncomingDataStreamParser(size_t expectedChunkSize = 0):
+        m_receivedBytes(tau_additional::util::MetricsRegistry::getCurrent().getCounter("incoming_data.bytes")),
+        m_parseTime(tau_additional::util::MetricsRegistry::getCurrent().getHistogram("incoming_data.parse_time_ns"))
+    {
+        m_chunk.reserve(expectedChunkSize);
+    };
+
+    // The EventsDispatcherType is expected to provide getIncomingPacketsHandler()
+    // and getCommunicationIssuesHandler() (see tau::util::BasicEventsDispatcher).
+    template <typename EventsDispatcherType>
+    void newData(char const * data, size_t size, EventsDispatcherType & dispatcher) {
+        m_chunk.assign(data, size);
+        if (!tau_additional::util::areDataPathMetricsEnabled()) {
+            m_parser.newData(m_chunk, dispatcher.getIncomingPacketsHandler(), dispatcher.getCommunicationIssuesHandler());
+            return;
+        }
+        uint64_t & handlersNanoseconds = tau_additional::util::metrics_details::getHandlersNanoseconds();
+        uint64_t handlersNanosecondsBefore = handlersNanoseconds;
+        uint64_t start = tau_additional::util::getMonotonicNanoseconds();
+        m_parser.newData(
+                m_chunk,
+                dispatcher.getIncomingPacketsHandler(),
+                dispatcher.getCommunicationIssuesHandler()
+            );
+        uint64_t elapsed = tau_additional::util::getMonotonicNanoseconds() - start;
+        uint64_t spentInHandlers = handlersNanoseconds - handlersNanosecondsBefore;
+        m_receivedBytes.add(size);
+        m_parseTime.record((elapsed > spentInHandlers) ? (elapsed - spentInHandlers) : 0);
+    }
+};
+
+}
+}
+#endif
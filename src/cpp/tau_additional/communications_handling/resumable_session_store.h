@@ -0,0 +1,161 @@
+// This source file is part of the 'tau' open source project.
+// Copyright (c) 2016, Yuriy Vosel.
+// Licensed under Boost Software License.
+// See LICENSE.txt for the licence information.
+
+#ifndef TAU_ADDITIONAL_COMMUNICATIONS_HANDLING_RESUMABLE_SESSION_STORE_H
+#define TAU_ADDITIONAL_COMMUNICATIONS_HANDLING_RESUMABLE_SESSION_STORE_H
+
+#include <tau_additional/communications_handling/client_device_info.h>
+#include <tau_additional/communications_handling/client_view.h>
+#include <tau_additional/util/monotonic_clock.h>
+#include <tau_additional/util/mutex.h>
+#include <tau_additional/util/unordered_map.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <deque>
+#include <string>
+#include <utility>
+
+namespace tau_additional {
+namespace communications_handling {
+
+// Keeps the ClientViewState of the disconnected clients for the grace period, keyed by the client
+// token (see getClientToken()), so the client, which reconnects soon (flaky Wi-Fi, the app was in
+// the background), does not lose the active page and the entered text: it gets the layout again,
+// followed by its page and values (see ClientView::resendLayout()).
+//
+// Typical use (the dispatcher owns a ClientView):
+//   packetReceived_clientDeviceInfo: if (store.resume(token, layoutKey, m_clientView)) m_clientView.resendLayout(...);
+//                                    else m_clientView.resetLayout(...);
+//   onConnectionClosed:             store.park(token, m_clientView.getState());
+// The client should send an unguessable token: whoever presents it gets the parked state.
+// The empty token (the client, which sent no 'token' field) is never parked or resumed.
+// Thread-safe.
+class ResumableSessionStore
+{
+public:
+    struct Statistics
+    {
+        Statistics(): parked(0), resumed(0), expired(0), layoutChanged(0) {};
+        uint64_t parked;
+        uint64_t resumed;
+        uint64_t expired;       // not resumed during the grace period (or evicted by the newer ones)
+        uint64_t layoutChanged; // the token was found, but the client needed the new layout anyway
+    };
+private:
+    struct ParkedSession
+    {
+        ParkedSession(): expirationTime(0) {};
+        ClientViewState state;
+        uint64_t expirationTime;
+    };
+    typedef tau_additional::util::UnorderedMap<std::string, ParkedSession>::type ParkedSessions;
+    // The grace period is the same for all the sessions, so the expiration order is the parking order
+    typedef std::deque<std::pair<uint64_t, std::string> > ExpirationQueue;
+
+    uint64_t m_gracePeriodNanoseconds;
+    size_t m_maxSessionsCount;
+    tau_additional::util::Mutex m_mutex;
+    ParkedSessions m_sessions;
+    ExpirationQueue m_expirationQueue;
+    Statistics m_statistics;
+
+    ResumableSessionStore(ResumableSessionStore const &);
+    ResumableSessionStore & operator = (ResumableSessionStore const &);
+public:
+    // The oldest sessions are dropped, when there are more than maxSessionsCount parked ones.
+    explicit ResumableSessionStore(unsigned gracePeriodSeconds = 60, size_t maxSessionsCount = 10000):
+        m_gracePeriodNanoseconds(uint64_t(gracePeriodSeconds) * 1000000000),
+        m_maxSessionsCount(maxSessionsCount > 0 ? maxSessionsCount : 1)
+    {};
+
+    // Does nothing for the empty token, or if no layout was sent to the client.
+    void park(std::string const & token, ClientViewState const & state) {
+        if (token.empty() || state.layoutKey.empty()) {
+            return;
+        }
+        uint64_t now = tau_additional::util::getMonotonicNanoseconds();
+        tau_additional::util::ScopedLock lock(m_mutex);
+        removeExpiredSessions(now);
+        ParkedSession & session = m_sessions[token];
+        session.state = state;
+        session.expirationTime = now + m_gracePeriodNanoseconds;
+        m_expirationQueue.push_back(std::make_pair(session.expirationTime, token));
+        ++m_statistics.parked;
+        while (m_sessions.size() > m_maxSessionsCount) {
+            evictOldestSession();
+        }
+    }
+
+    // Restores the parked state into the view and forgets it. Returns false (the client needs the
+    // full layout) if there is no parked session, or it was parked with another layout.
+    bool resume(std::string const & token, std::string const & currentLayoutKey, ClientView & view) {
+        if (token.empty()) {
+            return false;
+        }
+        ClientViewState state;
+        {
+            uint64_t now = tau_additional::util::getMonotonicNanoseconds();
+            tau_additional::util::ScopedLock lock(m_mutex);
+            removeExpiredSessions(now);
+            ParkedSessions::iterator found = m_sessions.find(token);
+            if (found == m_sessions.end()) {
+                return false;
+            }
+            bool sameLayout = (found->second.state.layoutKey == currentLayoutKey);
+            if (sameLayout) {
+                state.swap(found->second.state);
+                ++m_statistics.resumed;
+            } else {
+                ++m_statistics.layoutChanged;
+            }
+            m_sessions.erase(found);
+            if (!sameLayout) {
+                return false;
+            }
+        }
+        view.restore(state);
+        return true;
+    }
+
+    size_t getParkedSessionsCount() {
+        tau_additional::util::ScopedLock lock(m_mutex);
+        removeExpiredSessions(tau_additional::util::getMonotonicNanoseconds());
+        return m_sessions.size();
+    }
+
+    Statistics getStatistics() {
+        tau_additional::util::ScopedLock lock(m_mutex);
+        return m_statistics;
+    }
+private:
+    // The queue entry is stale, if the session was resumed or parked again after it
+    void removeExpiredSessions(uint64_t now) {
+        while (!m_expirationQueue.empty() && m_expirationQueue.front().first <= now) {
+            ParkedSessions::iterator found = m_sessions.find(m_expirationQueue.front().second);
+            if (found != m_sessions.end() && found->second.expirationTime == m_expirationQueue.front().first) {
+                m_sessions.erase(found);
+                ++m_statistics.expired;
+            }
+            m_expirationQueue.pop_front();
+        }
+    }
+
+    void evictOldestSession() {
+        while (!m_expirationQueue.empty()) {
+            std::pair<uint64_t, std::string> oldest = m_expirationQueue.front();
+            m_expirationQueue.pop_front();
+            ParkedSessions::iterator found = m_sessions.find(oldest.second);
+            if (found != m_sessions.end() && found->second.expirationTime == oldest.first) {
+                m_sessions.erase(found);
+                ++m_statistics.expired;
+                return;
+            }
+        }
+    }
+};
+
+}
+}
+#endif
@@ -0,0 +1,245 @@
+// This source file is part of the 'tau' open source project.
+// Copyright (c) 2016, Yuriy Vosel.
+// Licensed under Boost Software License.
+// See LICENSE.txt for the licence information.
+
+#ifndef TAU_ADDITIONAL_COMMUNICATIONS_HANDLING_SESSION_REGISTRY_H
+#define TAU_ADDITIONAL_COMMUNICATIONS_HANDLING_SESSION_REGISTRY_H
+
+#include <tau/communications_handling/outgiong_packets_generator.h>
+#include <tau_additional/communications_handling/client_view.h>
+#include <tau_additional/communications_handling/packet_serializer.h>
+#include <tau_additional/communications_handling/shared_buffer_sender.h>
+#include <tau_additional/util/mutex.h>
+#include <tau_additional/util/shared_buffer.h>
+#include <tau_additional/util/unordered_map.h>
+#include <stddef.h>
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace tau_additional {
+namespace communications_handling {
+
+namespace session_registry_details {
+    // Set of the sessions, which is iterated as a plain vector (add/remove are O(1)).
+    class SessionsList
+    {
+        typedef tau::communications_handling::OutgiongPacketsGenerator * Session;
+        typedef tau_additional::util::UnorderedMap<Session, size_t>::type Positions;
+
+        std::vector<Session> m_sessions;
+        Positions m_positions;
+    public:
+        bool add(Session session) {
+            if (!m_positions.insert(std::make_pair(session, m_sessions.size())).second) {
+                return false;
+            }
+            m_sessions.push_back(session);
+            return true;
+        }
+        bool remove(Session session) {
+            Positions::iterator found = m_positions.find(session);
+            if (found == m_positions.end()) {
+                return false;
+            }
+            size_t position = found->second;
+            m_positions.erase(found);
+            if (position + 1 != m_sessions.size()) {
+                m_sessions[position] = m_sessions.back();
+                m_positions[m_sessions[position]] = position;
+            }
+            m_sessions.pop_back();
+            return true;
+        }
+        bool contains(Session session) const {
+            return m_positions.find(session) != m_positions.end();
+        }
+        std::vector<Session> const & getSessions() const {
+            return m_sessions;
+        }
+        size_t getSize() const {
+            return m_sessions.size();
+        }
+    };
+};
+
+// Registry of the connected clients (identified by their outgoing packets generators)
+// with the named groups, for sending one packet to many clients.
+// The packet is serialized once (see PacketSerializer) and the same SharedBuffer is queued
+// for every recipient, so the broadcast costs one reference counter increment per client.
+//
+// Typical use: the events dispatcher calls addSession(m_outgoingGenerator) in onClientConnected()
+// and removeSession(m_outgoingGenerator) in onConnectionClosed().
+// The dispatcher, which remembers what its client shows (see ClientView), registers the view too:
+// the notes, which are broadcast with broadcastNote*(), go through the view.
+//
+// The registry is thread-safe, but the packets are handed to the generators from the broadcasting
+// thread. The PooledBoostAsioServer connections pass them to their own threads; the EpollServer
+// generators should only be used from the event loop thread (for example, from the dispatchers).
+class SessionRegistry
+{
+    typedef tau::communications_handling::OutgiongPacketsGenerator * Session;
+    typedef tau_additional::util::UnorderedMap<Session, std::vector<std::string> >::type SessionGroups;
+    typedef std::map<std::string, session_registry_details::SessionsList> Groups;
+    typedef tau_additional::util::UnorderedMap<Session, ClientView *>::type Views;
+
+    session_registry_details::SessionsList m_allSessions;
+    SessionGroups m_sessionGroups;
+    Groups m_groups;
+    Views m_views;
+    mutable tau_additional::util::ReadWriteMutex m_mutex;
+public:
+    void addSession(tau::communications_handling::OutgiongPacketsGenerator & session) {
+        tau_additional::util::ScopedWriteLock lock(m_mutex);
+        m_allSessions.add(&session);
+    }
+    // The view should send through the same generator; it is used until removeSession() returns.
+    void addSession(tau::communications_handling::OutgiongPacketsGenerator & session, ClientView & view) {
+        tau_additional::util::ScopedWriteLock lock(m_mutex);
+        if (m_allSessions.add(&session)) {
+            m_views[&session] = &view;
+        }
+    }
+
+    // Also removes the session from all its groups. After this call returns,
+    // the registry does not use the session object anymore.
+    void removeSession(tau::communications_handling::OutgiongPacketsGenerator & session) {
+        tau_additional::util::ScopedWriteLock lock(m_mutex);
+        if (!m_allSessions.remove(&session)) {
+            return;
+        }
+        m_views.erase(&session);
+        SessionGroups::iterator found = m_sessionGroups.find(&session);
+        if (found == m_sessionGroups.end()) {
+            return;
+        }
+        std::vector<std::string> const & groups = found->second;
+        for (size_t i = 0; i < groups.size(); ++i) {
+            removeFromGroup(&session, groups[i]);
+        }
+        m_sessionGroups.erase(found);
+    }
+
+    // Returns false if the session is not registered or is already in the group.
+    bool joinGroup(tau::communications_handling::OutgiongPacketsGenerator & session, std::string const & group) {
+        tau_additional::util::ScopedWriteLock lock(m_mutex);
+        if (!m_allSessions.contains(&session) || !m_groups[group].add(&session)) {
+            return false;
+        }
+        m_sessionGroups[&session].push_back(group);
+        return true;
+    }
+
+    bool leaveGroup(tau::communications_handling::OutgiongPacketsGenerator & session, std::string const & group) {
+        tau_additional::util::ScopedWriteLock lock(m_mutex);
+        SessionGroups::iterator found = m_sessionGroups.find(&session);
+        if (found == m_sessionGroups.end()) {
+            return false;
+        }
+        std::vector<std::string> & groups = found->second;
+        std::vector<std::string>::iterator groupPosition = std::find(groups.begin(), groups.end(), group);
+        if (groupPosition == groups.end()) {
+            return false;
+        }
+        groups.erase(groupPosition);
+        removeFromGroup(&session, group);
+        return true;
+    }
+
+    // The broadcast* methods return the number of the sessions, which got the packet.
+    size_t broadcast(tau_additional::util::SharedBuffer const & packet) const {
+        tau_additional::util::ScopedReadLock lock(m_mutex);
+        return sendToAll(m_allSessions, packet, NULL);
+    }
+
+    size_t broadcastToGroup(std::string const & group, tau_additional::util::SharedBuffer const & packet) const {
+        tau_additional::util::ScopedReadLock lock(m_mutex);
+        Groups::const_iterator found = m_groups.find(group);
+        return (found == m_groups.end()) ? 0 : sendToAll(found->second, packet, NULL);
+    }
+
+    // Same as above, but the session, which caused the update, can be skipped.
+    size_t broadcastToGroupExcept(std::string const & group, tau_additional::util::SharedBuffer const & packet,
+        tau::communications_handling::OutgiongPacketsGenerator & excludedSession) const
+    {
+        tau_additional::util::ScopedReadLock lock(m_mutex);
+        Groups::const_iterator found = m_groups.find(group);
+        return (found == m_groups.end()) ? 0 : sendToAll(found->second, packet, &excludedSession);
+    }
+
+    // The note is serialized once too; the sessions with the views (see addSession()) get it through
+    // the views, so the views know, what their clients show (and don't send the note, which is shown).
+    size_t broadcastNote(tau::common::ElementID const & elementID, std::string const & note) const {
+        std::string serializedNote = PacketSerializer().changeElementNote(elementID, note);
+        tau_additional::util::SharedBuffer packet(tau_additional::util::SharedBuffer::adopt(serializedNote));
+        tau_additional::util::ScopedReadLock lock(m_mutex);
+        return sendNoteToAll(m_allSessions, elementID, note, packet);
+    }
+
+    size_t broadcastNoteToGroup(std::string const & group,
+        tau::common::ElementID const & elementID, std::string const & note) const
+    {
+        std::string serializedNote = PacketSerializer().changeElementNote(elementID, note);
+        tau_additional::util::SharedBuffer packet(tau_additional::util::SharedBuffer::adopt(serializedNote));
+        tau_additional::util::ScopedReadLock lock(m_mutex);
+        Groups::const_iterator found = m_groups.find(group);
+        return (found == m_groups.end()) ? 0 : sendNoteToAll(found->second, elementID, note, packet);
+    }
+
+    size_t getSessionsCount() const {
+        tau_additional::util::ScopedReadLock lock(m_mutex);
+        return m_allSessions.getSize();
+    }
+
+    size_t getGroupSize(std::string const & group) const {
+        tau_additional::util::ScopedReadLock lock(m_mutex);
+        Groups::const_iterator found = m_groups.find(group);
+        return (found == m_groups.end()) ? 0 : found->second.getSize();
+    }
+private:
+    void removeFromGroup(Session session, std::string const & group) {
+        Groups::iterator found = m_groups.find(group);
+        if (found != m_groups.end()) {
+            found->second.remove(session);
+            if (found->second.getSize() == 0) {
+                m_groups.erase(found);
+            }
+        }
+    }
+
+    static size_t sendToAll(session_registry_details::SessionsList const & recipients,
+        tau_additional::util::SharedBuffer const & packet, Session excludedSession)
+    {
+        std::vector<Session> const & sessions = recipients.getSessions();
+        size_t result = 0;
+        for (size_t i = 0; i < sessions.size(); ++i) {
+            if (sessions[i] != excludedSession) {
+                sendSharedBuffer(*sessions[i], packet);
+                ++result;
+            }
+        }
+        return result;
+    }
+
+    size_t sendNoteToAll(session_registry_details::SessionsList const & recipients,
+        tau::common::ElementID const & elementID, std::string const & note,
+        tau_additional::util::SharedBuffer const & packet) const
+    {
+        std::vector<Session> const & sessions = recipients.getSessions();
+        for (size_t i = 0; i < sessions.size(); ++i) {
+            Views::const_iterator view = m_views.find(sessions[i]);
+            if (view != m_views.end()) {
+                view->second->changeElementNote(elementID, note, packet);
+            } else {
+                sendSharedBuffer(*sessions[i], packet);
+            }
+        }
+        return sessions.size();
+    }
+};
+
+}
+}
+#endif
@@ -0,0 +1,40 @@
+// This source file is part of the 'tau' open source project.
+// Copyright (c) 2016, Yuriy Vosel.
+// Licensed under Boost Software License.
+// See LICENSE.txt for the licence information.
+
+#ifndef TAU_ADDITIONAL_COMMUNICATIONS_HANDLING_SHARED_BUFFER_SENDER_H
+#define TAU_ADDITIONAL_COMMUNICATIONS_HANDLING_SHARED_BUFFER_SENDER_H
+
+#include <tau/communications_handling/outgiong_packets_generator.h>
+#include <tau_additional/util/shared_buffer.h>
+
+namespace tau_additional {
+namespace communications_handling {
+
+// Implemented by the outgoing packets generators, which can queue the already
+// serialized data without copying it.
+class SharedBufferSender
+{
+public:
+    virtual ~SharedBufferSender() {};
+    virtual void sendSharedBuffer(tau_additional::util::SharedBuffer const & data) = 0;
+};
+
+// Sends the already serialized packet(s) through the given generator.
+// Falls back to the regular sendData() if the generator can't take the shared buffer.
+inline void sendSharedBuffer(
+    tau::communications_handling::OutgiongPacketsGenerator & generator,
+    tau_additional::util::SharedBuffer const & data)
+{
+    SharedBufferSender * sender = dynamic_cast<SharedBufferSender *>(&generator);
+    if (sender != NULL) {
+        sender->sendSharedBuffer(data);
+    } else {
+        generator.sendData(data.str());
+    }
+}
+
+}
+}
+#endif
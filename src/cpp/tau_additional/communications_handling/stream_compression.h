@@ -0,0 +1,426 @@
+// This source file is part of the 'tau' open source project.
+// Copyright (c) 2016, Yuriy Vosel.
+// Licensed under Boost Software License.
+// See LICENSE.txt for the licence information.
+
+#ifndef TAU_ADDITIONAL_COMMUNICATIONS_HANDLING_STREAM_COMPRESSION_H
+#define TAU_ADDITIONAL_COMMUNICATIONS_HANDLING_STREAM_COMPRESSION_H
+
+#include <tau/communications_handling/outgiong_packets_generator.h>
+#include <tau_additional/communications_handling/client_device_info.h>
+#include <tau_additional/util/metrics.h>
+#include <zlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+// Per-connection deflate compression of the packets stream, for the clients on the slow links.
+// The client asks for it in the device info packet ('deflate' in the 'encodings' field), and the
+// server, which has the compression enabled, switches the outgoing stream (see
+// startCompressionIfNegotiated()). The client may compress its own stream the same way, after it
+// gets the server's stream header: the data of the other clients is parsed as is.
+//
+// The compressed stream starts with the header: 0, 'T', 'Z', version. The zero byte never
+// appears in the text packets, so the header can follow any of them. The binary packets may contain
+// it: the header of the binary client is accepted only between its packets (see setBinaryFraming()),
+// where the zero would be the length of the empty packet. Then the frames follow:
+//   'D', varint length, the deflate data - the packet, compressed
+//   'P', varint length, the bytes        - the packet below the size threshold, as is
+// The deflate data of all the 'D' frames is one raw deflate stream, flushed at the end of every
+// frame (Z_SYNC_FLUSH, the 00 00 FF FF tail of the flush is not sent). So the compression context
+// stays warm for the whole connection, and the structure, which was sent already (the repeated
+// layout reset, the same element ids), costs a few bytes. The deflate window is 32 KB: the part of
+// the layout, which is further back than that, is not referenced.
+// The varint is LEB128 (7 bits per byte, low first).
+
+namespace tau_additional {
+namespace communications_handling {
+
+namespace stream_compression_details {
+    static const char STREAM_HEADER[] = { 0, 'T', 'Z', 1 };
+    static const size_t STREAM_HEADER_SIZE = sizeof(STREAM_HEADER);
+    static const char FRAME_DEFLATED = 'D';
+    static const char FRAME_PLAIN = 'P';
+    static const char SYNC_FLUSH_TAIL[] = { 0, 0, char(0xFF), char(0xFF) };
+    static const size_t SYNC_FLUSH_TAIL_SIZE = sizeof(SYNC_FLUSH_TAIL);
+    static const int WINDOW_BITS = 15; // negative in the init calls: the raw deflate, no zlib header
+
+    inline void appendVarint(std::string & output, uint64_t value) {
+        while (value >= 0x80) {
+            output += char((value & 0x7F) | 0x80);
+            value >>= 7;
+        }
+        output += char(value);
+    }
+
+    inline void appendFrame(std::string & output, char type, char const * data, size_t size) {
+        output += type;
+        appendVarint(output, size);
+        output.append(data, size);
+    }
+};
+
+// Compresses the outgoing packets of one connection. Not thread-safe (the connection owns it).
+// Uses about 256 KB of memory (the deflate window and the hash tables).
+class StreamCompressor
+{
+public:
+    struct Statistics
+    {
+        Statistics(): packetsCompressed(0), packetsPassed(0), inputBytes(0), outputBytes(0) {};
+        uint64_t packetsCompressed;
+        uint64_t packetsPassed; // below the threshold, sent as is
+        uint64_t inputBytes;    // the packets
+        uint64_t outputBytes;   // what was sent instead, with the frames and the stream header
+
+        double getCompressionRatio() const {
+            return (outputBytes > 0) ? double(inputBytes) / double(outputBytes) : 1.0;
+        }
+    };
+
+    static const size_t DEFAULT_THRESHOLD = 256;
+private:
+    z_stream m_stream;
+    bool m_initialized;
+    bool m_valid;
+    size_t m_threshold;
+    std::vector<char> m_buffer;
+    size_t m_deflatedSize;
+    Statistics m_statistics;
+    tau_additional::util::MetricsCounter & m_inputBytesMetric;
+    tau_additional::util::MetricsCounter & m_outputBytesMetric;
+
+    StreamCompressor(StreamCompressor const &);
+    StreamCompressor & operator = (StreamCompressor const &);
+public:
+    // The level is the zlib one (1 - fastest, 9 - best, Z_DEFAULT_COMPRESSION).
+    explicit StreamCompressor(size_t threshold = DEFAULT_THRESHOLD, int level = Z_DEFAULT_COMPRESSION):
+        m_initialized(false),
+        m_valid(false),
+        m_threshold(threshold),
+        m_deflatedSize(0),
+        m_inputBytesMetric(tau_additional::util::MetricsRegistry::getCurrent().getCounter("compression.input_bytes")),
+        m_outputBytesMetric(tau_additional::util::MetricsRegistry::getCurrent().getCounter("compression.output_bytes"))
+    {
+        memset(&m_stream, 0, sizeof(m_stream));
+        m_initialized = (deflateInit2(&m_stream, level, Z_DEFLATED, -stream_compression_details::WINDOW_BITS,
+            8, Z_DEFAULT_STRATEGY) == Z_OK);
+        m_valid = m_initialized;
+    };
+    ~StreamCompressor() {
+        if (m_initialized) {
+            deflateEnd(&m_stream);
+        }
+    }
+
+    // False if zlib could not be initialized: the stream should not be switched then.
+    bool isValid() const {
+        return m_valid;
+    }
+
+    void appendStreamHeader(std::string & output) {
+        output.append(stream_compression_details::STREAM_HEADER, stream_compression_details::STREAM_HEADER_SIZE);
+        m_statistics.outputBytes += stream_compression_details::STREAM_HEADER_SIZE;
+        m_outputBytesMetric.add(stream_compression_details::STREAM_HEADER_SIZE);
+    }
+
+    // Appends the frame with the packet to the output.
+    void compress(char const * data, size_t size, std::string & output) {
+        size_t outputSizeBefore = output.size();
+        if (size < m_threshold || !m_valid || !deflatePacket(data, size)) {
+            stream_compression_details::appendFrame(output, stream_compression_details::FRAME_PLAIN, data, size);
+            ++m_statistics.packetsPassed;
+        } else {
+            stream_compression_details::appendFrame(output, stream_compression_details::FRAME_DEFLATED,
+                &m_buffer[0], m_deflatedSize);
+            ++m_statistics.packetsCompressed;
+        }
+        m_statistics.inputBytes += size;
+        m_statistics.outputBytes += output.size() - outputSizeBefore;
+        m_inputBytesMetric.add(size);
+        m_outputBytesMetric.add(output.size() - outputSizeBefore);
+    }
+
+    Statistics const & getStatistics() const {
+        return m_statistics;
+    }
+private:
+    // Leaves the deflate data in the m_buffer, m_deflatedSize bytes (the flush tail is cut off).
+    bool deflatePacket(char const * data, size_t size) {
+        // The sync flush adds a few bytes to the deflateBound(), the buffer grows if needed anyway
+        size_t capacity = deflateBound(&m_stream, uLong(size)) + 16;
+        if (m_buffer.size() < capacity) {
+            m_buffer.resize(capacity);
+        }
+        m_stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data));
+        m_stream.avail_in = uInt(size);
+        m_deflatedSize = 0;
+        for (;;) {
+            m_stream.next_out = reinterpret_cast<Bytef *>(&m_buffer[m_deflatedSize]);
+            m_stream.avail_out = uInt(m_buffer.size() - m_deflatedSize);
+            int result = deflate(&m_stream, Z_SYNC_FLUSH);
+            m_deflatedSize = m_buffer.size() - m_stream.avail_out;
+            if (result != Z_OK && result != Z_BUF_ERROR) {
+                m_valid = false; // the stream state is unknown: the rest goes uncompressed
+                return false;
+            }
+            if (m_stream.avail_out > 0) {
+                break;
+            }
+            m_buffer.resize(m_buffer.size() * 2);
+        }
+        if (m_deflatedSize < stream_compression_details::SYNC_FLUSH_TAIL_SIZE || memcmp(
+            &m_buffer[m_deflatedSize - stream_compression_details::SYNC_FLUSH_TAIL_SIZE],
+            stream_compression_details::SYNC_FLUSH_TAIL, stream_compression_details::SYNC_FLUSH_TAIL_SIZE) != 0)
+        {
+            m_valid = false;
+            return false;
+        }
+        m_deflatedSize -= stream_compression_details::SYNC_FLUSH_TAIL_SIZE;
+        return true;
+    }
+};
+
+// Gets the received data and gives the bytes of the packets: the data before the stream header
+// is passed as is, the frames after it are unpacked. Not thread-safe (the connection owns it).
+// The inflate state (about 40 KB) is allocated, when the stream header is received.
+class StreamDecompressor
+{
+public:
+    // The frame, which is bigger (before or after the decompression), breaks the stream
+    static const size_t MAX_FRAME_SIZE = 16 * 1024 * 1024;
+private:
+    z_stream m_stream;
+    bool m_inflateInitialized;
+    bool m_failed;
+    bool m_binaryFraming;
+    size_t m_headerBytesReceived;
+    // The binary packet before the header: its length (the varint may be split between the calls)
+    // and the bytes of it, which are not received yet
+    uint64_t m_plainPacketSize;
+    unsigned m_plainPacketSizeShift;
+    uint64_t m_plainPacketBytesLeft;
+    std::string m_pendingData;
+    std::vector<char> m_buffer;
+
+    StreamDecompressor(StreamDecompressor const &);
+    StreamDecompressor & operator = (StreamDecompressor const &);
+public:
+    StreamDecompressor():
+        m_inflateInitialized(false),
+        m_failed(false),
+        m_binaryFraming(false),
+        m_headerBytesReceived(0),
+        m_plainPacketSize(0),
+        m_plainPacketSizeShift(0),
+        m_plainPacketBytesLeft(0)
+    {
+        memset(&m_stream, 0, sizeof(m_stream));
+    };
+    ~StreamDecompressor() {
+        if (m_inflateInitialized) {
+            inflateEnd(&m_stream);
+        }
+    }
+
+    // Appends the packets data to the output. Returns false if the stream is broken
+    // (the connection should be closed); all the later calls return false as well.
+    bool decompress(char const * data, size_t size, std::string & output) {
+        while (!m_failed && !isCompressed() && size > 0) {
+            if (m_headerBytesReceived == 0) {
+                size_t plainSize = m_binaryFraming ?
+                    findBinaryHeaderStart(data, size) : findTextHeaderStart(data, size);
+                output.append(data, plainSize);
+                data += plainSize;
+                size -= plainSize;
+                if (m_failed || size == 0) {
+                    break;
+                }
+            }
+            if (*data != stream_compression_details::STREAM_HEADER[m_headerBytesReceived]) {
+                m_failed = true;
+                break;
+            }
+            ++data;
+            --size;
+            if (++m_headerBytesReceived == stream_compression_details::STREAM_HEADER_SIZE) {
+                m_failed = (inflateInit2(&m_stream, -stream_compression_details::WINDOW_BITS) != Z_OK);
+                m_inflateInitialized = !m_failed;
+            }
+        }
+        if (m_failed || size == 0) {
+            return !m_failed;
+        }
+        m_pendingData.append(data, size);
+        size_t position = 0;
+        while (!m_failed) {
+            size_t frameStart = position;
+            uint64_t frameSize = 0;
+            if (!readFrameHeader(position, frameSize)) {
+                position = frameStart; // wait for the rest of the header
+                break;
+            }
+            if (m_pendingData.size() - position < frameSize) {
+                position = frameStart; // wait for the rest of the frame
+                break;
+            }
+            char type = m_pendingData[frameStart];
+            if (type == stream_compression_details::FRAME_PLAIN) {
+                output.append(m_pendingData, position, size_t(frameSize));
+            } else if (type == stream_compression_details::FRAME_DEFLATED) {
+                m_failed = !inflateFrame(m_pendingData.data() + position, size_t(frameSize), output);
+            } else {
+                m_failed = true;
+            }
+            position += size_t(frameSize);
+        }
+        m_pendingData.erase(0, position);
+        return !m_failed;
+    }
+
+    bool isCompressed() const {
+        return m_inflateInitialized;
+    }
+
+    // The data, which is passed after the call, is the binary packets (see binary_encoding.h), till
+    // the stream header. Should be set at the packet boundary: when the connection is switched.
+    void setBinaryFraming() {
+        m_binaryFraming = true;
+    }
+private:
+    // Returns the size of the data before the header start (the whole size, if there is no header)
+    size_t findTextHeaderStart(char const * data, size_t size) const {
+        char const * headerStart = static_cast<char const *>(memchr(data, 0, size));
+        return (headerStart == NULL) ? size : size_t(headerStart - data);
+    }
+
+    // The same, but the zero byte starts the header only in place of the packet's length
+    size_t findBinaryHeaderStart(char const * data, size_t size) {
+        size_t position = 0;
+        while (position < size) {
+            if (m_plainPacketBytesLeft > 0) {
+                size_t packetPart = (m_plainPacketBytesLeft < size - position) ?
+                    size_t(m_plainPacketBytesLeft) : size - position;
+                position += packetPart;
+                m_plainPacketBytesLeft -= packetPart;
+                continue;
+            }
+            unsigned char byte = static_cast<unsigned char>(data[position]);
+            if (byte == 0 && m_plainPacketSizeShift == 0) {
+                break;
+            }
+            ++position;
+            m_plainPacketSize |= uint64_t(byte & 0x7F) << m_plainPacketSizeShift;
+            if ((byte & 0x80) != 0) {
+                m_plainPacketSizeShift += 7;
+                m_failed = (m_plainPacketSizeShift > 28);
+                if (m_failed) {
+                    break;
+                }
+                continue;
+            }
+            m_plainPacketBytesLeft = m_plainPacketSize;
+            m_plainPacketSize = 0;
+            m_plainPacketSizeShift = 0;
+        }
+        return position;
+    }
+
+    // Returns false if the header is incomplete; sets m_failed if it is broken.
+    bool readFrameHeader(size_t & position, uint64_t & frameSize) {
+        if (position >= m_pendingData.size()) {
+            return false;
+        }
+        ++position; // the type is checked by the caller
+        unsigned shift = 0;
+        for (;;) {
+            if (position >= m_pendingData.size()) {
+                return false;
+            }
+            unsigned char byte = static_cast<unsigned char>(m_pendingData[position++]);
+            frameSize |= uint64_t(byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0) {
+                break;
+            }
+            shift += 7;
+            if (shift > 28) {
+                m_failed = true;
+                return false;
+            }
+        }
+        if (frameSize > MAX_FRAME_SIZE) {
+            m_failed = true;
+            return false;
+        }
+        return true;
+    }
+
+    bool inflateFrame(char const * data, size_t size, std::string & output) {
+        if (!inflateData(data, size, output)) {
+            return false;
+        }
+        // The sender has cut the flush tail off: the inflater needs it to emit the last bytes
+        return inflateData(stream_compression_details::SYNC_FLUSH_TAIL,
+            stream_compression_details::SYNC_FLUSH_TAIL_SIZE, output);
+    }
+
+    bool inflateData(char const * data, size_t size, std::string & output) {
+        if (m_buffer.empty()) {
+            m_buffer.resize(64 * 1024);
+        }
+        m_stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data));
+        m_stream.avail_in = uInt(size);
+        size_t outputLimit = output.size() + MAX_FRAME_SIZE;
+        do {
+            m_stream.next_out = reinterpret_cast<Bytef *>(&m_buffer[0]);
+            m_stream.avail_out = uInt(m_buffer.size());
+            int result = inflate(&m_stream, Z_SYNC_FLUSH);
+            if (result != Z_OK && result != Z_BUF_ERROR) {
+                return false;
+            }
+            size_t produced = m_buffer.size() - m_stream.avail_out;
+            if (result == Z_BUF_ERROR && produced == 0 && m_stream.avail_in > 0) {
+                return false;
+            }
+            output.append(&m_buffer[0], produced);
+            if (output.size() > outputLimit) {
+                return false;
+            }
+        } while (m_stream.avail_in > 0 || m_stream.avail_out == 0);
+        return true;
+    }
+};
+
+// Implemented by the outgoing packets generators, which can compress their stream.
+class CompressionSwitch
+{
+public:
+    virtual ~CompressionSwitch() {};
+    // Sends the stream header; the packets, which are sent after it, are compressed.
+    // Returns false (and changes nothing) if the compression is not enabled for the connection.
+    virtual bool startCompression() = 0;
+};
+
+inline std::string getCompressionName() {
+    return "deflate";
+}
+
+// Switches the outgoing stream to the compressed one, if the client has asked for it and the
+// generator supports it. Should be called in packetReceived_clientDeviceInfo, before the layout
+// is sent: the layout is the packet, which gains the most.
+inline bool startCompressionIfNegotiated(
+    tau::communications_handling::OutgiongPacketsGenerator & generator,
+    tau::communications_handling::ClientDeviceInfo const & info)
+{
+    if (!isEncodingSupportedByClient(info, getCompressionName())) {
+        return false;
+    }
+    CompressionSwitch * compressionSwitch = dynamic_cast<CompressionSwitch *>(&generator);
+    return (compressionSwitch != NULL) && compressionSwitch->startCompression();
+}
+
+}
+}
+#endif
@@ -0,0 +1,60 @@
+// This source file is part of the 'tau' open source project.
+// Copyright (c) 2016, Yuriy Vosel.
+// Licensed under Boost Software License.
+// See LICENSE.txt for the licence information.
+
+#ifndef TAU_ADDITIONAL_COMMUNICATIONS_HANDLING_STREAMING_SENDER_H
+#define TAU_ADDITIONAL_COMMUNICATIONS_HANDLING_STREAMING_SENDER_H
+
+#include <tau/communications_handling/outgiong_packets_generator.h>
+#include <tau_additional/communications_handling/shared_buffer_sender.h>
+#include <tau_additional/util/shared_buffer.h>
+
+namespace tau_additional {
+namespace communications_handling {
+
+// The data, which is produced chunk by chunk, while it is sent (for example, the big packet,
+// which is serialized straight into the connection's outgoing queue).
+class OutgoingDataSource
+{
+public:
+    virtual ~OutgoingDataSource() {};
+    // The next chunk of the data; the empty one, when everything is produced.
+    virtual tau_additional::util::SharedBuffer getNextChunk() = 0;
+};
+
+// Implemented by the outgoing packets generators, which take the next chunks from the source
+// only when the previous ones are (almost) written, so the memory, used for the data, which is
+// not sent yet, does not depend on the size of the whole data.
+class StreamingSender
+{
+public:
+    virtual ~StreamingSender() {};
+    // Takes the ownership of the source. The packets, which are sent after this call,
+    // are sent after all the data of the source.
+    virtual void sendStream(OutgoingDataSource * source) = 0;
+};
+
+// Sends the data of the source (and deletes it) through the given generator.
+// If the generator can't stream, all the chunks are produced and sent at once.
+inline void sendStream(tau::communications_handling::OutgiongPacketsGenerator & generator,
+    OutgoingDataSource * source)
+{
+    StreamingSender * sender = dynamic_cast<StreamingSender *>(&generator);
+    if (sender != NULL) {
+        sender->sendStream(source);
+        return;
+    }
+    for (;;) {
+        tau_additional::util::SharedBuffer chunk = source->getNextChunk();
+        if (chunk.empty()) {
+            break;
+        }
+        sendSharedBuffer(generator, chunk);
+    }
+    delete source;
+}
+
+}
+}
+#endif
@@ -0,0 +1,413 @@
+// This source file is part of the 'tau' open source project.
+// Copyright (c) 2016, Yuriy Vosel.
+// Licensed under Boost Software License.
+// See LICENSE.txt for the licence information.
+
+#ifndef TAU_ADDITIONAL_COMMUNICATIONS_HANDLING_TRAFFIC_CAPTURE_H
+#define TAU_ADDITIONAL_COMMUNICATIONS_HANDLING_TRAFFIC_CAPTURE_H
+
+#include <tau_additional/util/monotonic_clock.h>
+#include <tau_additional/util/mutex.h>
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+namespace tau_additional {
+namespace communications_handling {
+
+// The capture file format: the 8 bytes header "TAUCAP1\n", then the records, one after another:
+//   type (1 byte), connection id (varint), nanoseconds since the previous record (varint)
+//   and, for the data records, the size (varint) and the bytes.
+// The varint is LEB128 (7 bits per byte, low first). The file is only appended to, so the one,
+// which was cut short (the process was killed), is readable up to the last complete record.
+namespace traffic_capture_details {
+    static char const FILE_HEADER[] = "TAUCAP1\n";
+    static const size_t FILE_HEADER_SIZE = 8;
+    static const size_t MAX_VARINT_SIZE = 10;
+
+    inline size_t writeVarint(char * output, uint64_t value) {
+        size_t size = 0;
+        while (value >= 0x80) {
+            output[size++] = char((value & 0x7F) | 0x80);
+            value >>= 7;
+        }
+        output[size++] = char(value);
+        return size;
+    }
+};
+
+enum TrafficRecordType
+{
+    TRAFFIC_CONNECTION_OPENED = 1,
+    TRAFFIC_INCOMING_DATA,       // the bytes, which were passed to the incoming data stream parser
+    TRAFFIC_OUTGOING_DATA,       // the bytes, which the server has sent (before the compression)
+    TRAFFIC_CONNECTION_CLOSED
+};
+
+// Writes the traffic of the server's connections into the capture file (see the EpollServerSettings
+// trafficCapture). Thread-safe: several servers (for example, the shards) can share one capture.
+// The records are buffered and written, when the buffer is full or the last write was longer ago
+// than the flush interval; flush() writes them at once (for example, from a periodic call, so the capture
+// of the idle server is complete too).
+// The buffer is swapped under the lock and written outside it: while one thread writes, the others
+// keep adding the records (the writing thread takes them too, if they fill the buffer), so the slow
+// disk does not stall the other threads. The data, which failed to be written, is kept and written
+// first next time, so the file stays readable; the new records are dropped (see Statistics), only
+// when MAX_BUFFERED_SIZE bytes are waiting to be written.
+class TrafficCapture
+{
+public:
+    struct Statistics
+    {
+        Statistics(): records(0), bytesWritten(0), writeFailures(0) {};
+        uint64_t records;
+        uint64_t bytesWritten;
+        uint64_t writeFailures; // the records, which are lost
+    };
+
+    static const size_t BUFFER_SIZE = 64 * 1024;
+    static const size_t MAX_BUFFERED_SIZE = 64 * 1024 * 1024;
+    static const uint64_t FLUSH_INTERVAL = uint64_t(1000) * 1000000;
+private:
+    tau_additional::util::Mutex m_mutex; // the buffer, the statistics and the file handle
+    tau_additional::util::Mutex m_writeMutex; // the writing thread: the write buffer, the writes order
+    int m_fileHandle;
+    std::vector<char> m_buffer;
+    size_t m_bufferedRecords;
+    std::vector<char> m_writeBuffer; // the records, which are being written (or failed to be)
+    size_t m_writeBufferRecords;
+    size_t m_unwrittenSize; // the write buffer size, as the records adding threads see it
+    uint64_t m_lastRecordTime;
+    uint64_t m_lastFlushTime;
+    volatile uint64_t m_nextConnectionID;
+    Statistics m_statistics;
+    std::string m_lastError;
+
+    TrafficCapture(TrafficCapture const &);
+    TrafficCapture & operator = (TrafficCapture const &);
+public:
+    TrafficCapture():
+        m_fileHandle(-1),
+        m_bufferedRecords(0),
+        m_writeBufferRecords(0),
+        m_unwrittenSize(0),
+        m_lastRecordTime(0),
+        m_lastFlushTime(0),
+        m_nextConnectionID(1)
+    {
+        m_buffer.reserve(BUFFER_SIZE);
+    };
+    ~TrafficCapture() {
+        close();
+    }
+
+    // Creates (or truncates) the capture file. Returns false (see getLastError()) if it failed.
+    bool open(std::string const & path) {
+        tau_additional::util::ScopedLock writeLock(m_writeMutex);
+        {
+            tau_additional::util::ScopedLock lock(m_mutex);
+            m_fileHandle = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0644);
+            if (m_fileHandle == -1) {
+                m_lastError = "Can't open " + path + ": " + strerror(errno);
+                return false;
+            }
+            m_buffer.assign(traffic_capture_details::FILE_HEADER,
+                traffic_capture_details::FILE_HEADER + traffic_capture_details::FILE_HEADER_SIZE);
+            m_lastRecordTime = m_lastFlushTime = tau_additional::util::getMonotonicNanoseconds();
+        }
+        return writeBuffered();
+    }
+
+    void close() {
+        tau_additional::util::ScopedLock writeLock(m_writeMutex);
+        if (m_fileHandle == -1) { // changed only under the m_writeMutex
+            return;
+        }
+        writeBuffered();
+        tau_additional::util::ScopedLock lock(m_mutex);
+        ::close(m_fileHandle);
+        m_fileHandle = -1;
+        // What is still not written, is lost
+        m_statistics.writeFailures += m_bufferedRecords + m_writeBufferRecords;
+        m_buffer.clear();
+        m_bufferedRecords = 0;
+        m_writeBuffer.clear();
+        m_writeBufferRecords = 0;
+        m_unwrittenSize = 0;
+    }
+
+    bool isOpen() {
+        tau_additional::util::ScopedLock lock(m_mutex);
+        return m_fileHandle != -1;
+    }
+
+    // Returns the id of the new connection (unique within the capture)
+    uint64_t connectionOpened() {
+        uint64_t connectionID = __sync_fetch_and_add(&m_nextConnectionID, 1);
+        record(TRAFFIC_CONNECTION_OPENED, connectionID, NULL, 0);
+        return connectionID;
+    }
+    void incomingData(uint64_t connectionID, char const * data, size_t size) {
+        record(TRAFFIC_INCOMING_DATA, connectionID, data, size);
+    }
+    void outgoingData(uint64_t connectionID, char const * data, size_t size) {
+        record(TRAFFIC_OUTGOING_DATA, connectionID, data, size);
+    }
+    void connectionClosed(uint64_t connectionID) {
+        record(TRAFFIC_CONNECTION_CLOSED, connectionID, NULL, 0);
+    }
+
+    // Waits for the thread, which is writing, and writes the rest of the records.
+    // Returns false (see getLastError()) if the write failed (the records are kept for the next one).
+    bool flush() {
+        tau_additional::util::ScopedLock writeLock(m_writeMutex);
+        return m_fileHandle == -1 || writeBuffered();
+    }
+
+    Statistics getStatistics() {
+        tau_additional::util::ScopedLock lock(m_mutex);
+        return m_statistics;
+    }
+    // The error of the last write (empty, if it succeeded)
+    std::string getLastError() {
+        tau_additional::util::ScopedLock lock(m_mutex);
+        return m_lastError;
+    }
+private:
+    // The time is taken under the lock, so the records of all the threads are in order.
+    void record(TrafficRecordType type, uint64_t connectionID, char const * data, size_t size) {
+        {
+            tau_additional::util::ScopedLock lock(m_mutex);
+            if (m_fileHandle == -1) {
+                return;
+            }
+            if (m_buffer.size() + m_unwrittenSize >= MAX_BUFFERED_SIZE) {
+                ++m_statistics.writeFailures;
+                return;
+            }
+            uint64_t now = tau_additional::util::getMonotonicNanoseconds();
+            uint64_t delay = (now > m_lastRecordTime) ? (now - m_lastRecordTime) : 0;
+            m_lastRecordTime = now;
+            char header[1 + 3 * traffic_capture_details::MAX_VARINT_SIZE];
+            size_t headerSize = 0;
+            header[headerSize++] = char(type);
+            headerSize += traffic_capture_details::writeVarint(header + headerSize, connectionID);
+            headerSize += traffic_capture_details::writeVarint(header + headerSize, delay);
+            bool hasData = (type == TRAFFIC_INCOMING_DATA || type == TRAFFIC_OUTGOING_DATA);
+            if (hasData) {
+                headerSize += traffic_capture_details::writeVarint(header + headerSize, size);
+            }
+            m_buffer.insert(m_buffer.end(), header, header + headerSize);
+            if (hasData) {
+                m_buffer.insert(m_buffer.end(), data, data + size);
+            }
+            ++m_bufferedRecords;
+            if (m_buffer.size() < BUFFER_SIZE && now - m_lastFlushTime < FLUSH_INTERVAL) {
+                return;
+            }
+        }
+        // The thread, which is writing already, takes these records too
+        if (m_writeMutex.tryLock()) {
+            writeBuffered();
+            m_writeMutex.unlock();
+        }
+    }
+
+    // Under the m_writeMutex. Writes the buffered records, then the ones, which have filled the buffer
+    // during the write.
+    bool writeBuffered() {
+        bool result = true;
+        for (bool first = true; result; first = false) {
+            {
+                tau_additional::util::ScopedLock lock(m_mutex);
+                if (first ? (m_buffer.empty() && m_writeBuffer.empty()) : (m_buffer.size() < BUFFER_SIZE)) {
+                    break;
+                }
+                if (m_writeBuffer.empty()) {
+                    m_writeBuffer.swap(m_buffer);
+                } else { // after the failed write: the kept data goes first
+                    m_writeBuffer.insert(m_writeBuffer.end(), m_buffer.begin(), m_buffer.end());
+                    m_buffer.clear();
+                }
+                m_writeBufferRecords += m_bufferedRecords;
+                m_bufferedRecords = 0;
+                m_unwrittenSize = m_writeBuffer.size();
+                m_lastFlushTime = tau_additional::util::getMonotonicNanoseconds();
+            }
+            result = writeWriteBuffer();
+        }
+        return result;
+    }
+
+    // Under the m_writeMutex (the file handle is not changed, while it is held)
+    bool writeWriteBuffer() {
+        size_t written = 0;
+        int error = 0;
+        while (written < m_writeBuffer.size()) {
+            ssize_t result = write(m_fileHandle, &m_writeBuffer[written], m_writeBuffer.size() - written);
+            if (result == -1 && errno == EINTR) {
+                continue;
+            }
+            if (result <= 0) {
+                error = (result == 0) ? EIO : errno;
+                break;
+            }
+            written += size_t(result);
+        }
+        tau_additional::util::ScopedLock lock(m_mutex);
+        m_statistics.bytesWritten += written;
+        if (error == 0) {
+            m_statistics.records += m_writeBufferRecords;
+            m_writeBuffer.clear();
+            m_writeBufferRecords = 0;
+            m_lastError.clear();
+        } else {
+            // The rest is written first next time (the record, which was cut, is completed)
+            m_writeBuffer.erase(m_writeBuffer.begin(), m_writeBuffer.begin() + written);
+            m_lastError = std::string("Can't write the capture file: ") + strerror(error);
+        }
+        m_unwrittenSize = m_writeBuffer.size();
+        return error == 0;
+    }
+};
+
+// Reads the capture file, which is mapped into the memory: the data of the records points into the
+// mapping (no copies), and stays valid while the reader exists.
+class TrafficCaptureReader
+{
+public:
+    struct Record
+    {
+        Record(): type(TRAFFIC_CONNECTION_OPENED), connectionID(0), time(0), data(NULL), size(0) {};
+        TrafficRecordType type;
+        uint64_t connectionID;
+        uint64_t time; // nanoseconds since the start of the capture
+        char const * data;
+        size_t size;
+    };
+private:
+    int m_fileHandle;
+    unsigned char const * m_data;
+    size_t m_size;
+    size_t m_position;
+    uint64_t m_time;
+    bool m_truncated;
+    std::string m_lastError;
+
+    TrafficCaptureReader(TrafficCaptureReader const &);
+    TrafficCaptureReader & operator = (TrafficCaptureReader const &);
+public:
+    TrafficCaptureReader():
+        m_fileHandle(-1), m_data(NULL), m_size(0), m_position(0), m_time(0), m_truncated(false)
+    {};
+    ~TrafficCaptureReader() {
+        if (m_data != NULL) {
+            munmap(const_cast<unsigned char *>(m_data), m_size);
+        }
+        if (m_fileHandle != -1) {
+            close(m_fileHandle);
+        }
+    }
+
+    // Returns false (see getLastError()) if the file can't be mapped or is not a capture file.
+    bool open(std::string const & path) {
+        m_fileHandle = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (m_fileHandle == -1) {
+            return setError("Can't open " + path);
+        }
+        struct stat fileStatus;
+        if (fstat(m_fileHandle, &fileStatus) == -1) {
+            return setError("Can't get the size of " + path);
+        }
+        if (size_t(fileStatus.st_size) < traffic_capture_details::FILE_HEADER_SIZE) {
+            errno = EINVAL;
+            return setError(path + " is not a capture file");
+        }
+        void * mapping = mmap(NULL, size_t(fileStatus.st_size), PROT_READ, MAP_PRIVATE, m_fileHandle, 0);
+        if (mapping == MAP_FAILED) {
+            return setError("Can't map " + path);
+        }
+        m_data = static_cast<unsigned char const *>(mapping);
+        m_size = size_t(fileStatus.st_size);
+        madvise(mapping, m_size, MADV_SEQUENTIAL);
+        if (memcmp(m_data, traffic_capture_details::FILE_HEADER, traffic_capture_details::FILE_HEADER_SIZE) != 0) {
+            errno = EINVAL;
+            return setError(path + " is not a capture file");
+        }
+        rewind();
+        return true;
+    }
+
+    void rewind() {
+        m_position = traffic_capture_details::FILE_HEADER_SIZE;
+        m_time = 0;
+        m_truncated = false;
+    }
+
+    // Returns false at the end of the capture (see isTruncated()).
+    bool next(Record & result) {
+        if (m_position >= m_size) {
+            return false;
+        }
+        size_t position = m_position + 1;
+        uint64_t connectionID;
+        uint64_t delay;
+        uint64_t size = 0;
+        TrafficRecordType type = TrafficRecordType(m_data[m_position]);
+        bool hasData = (type == TRAFFIC_INCOMING_DATA || type == TRAFFIC_OUTGOING_DATA);
+        if (type < TRAFFIC_CONNECTION_OPENED || type > TRAFFIC_CONNECTION_CLOSED
+            || !readVarint(position, connectionID) || !readVarint(position, delay)
+            || (hasData && !readVarint(position, size)) || size > m_size - position) {
+            m_truncated = true;
+            return false;
+        }
+        m_time += delay;
+        result.type = type;
+        result.connectionID = connectionID;
+        result.time = m_time;
+        result.data = reinterpret_cast<char const *>(m_data + position);
+        result.size = size_t(size);
+        m_position = position + size_t(size);
+        return true;
+    }
+
+    // The capture ends with an incomplete or broken record
+    bool isTruncated() const {
+        return m_truncated;
+    }
+    size_t getFileSize() const {
+        return m_size;
+    }
+    std::string const & getLastError() const {
+        return m_lastError;
+    }
+private:
+    bool setError(std::string const & message) {
+        m_lastError = message + ": " + strerror(errno);
+        return false;
+    }
+
+    bool readVarint(size_t & position, uint64_t & result) const {
+        result = 0;
+        for (unsigned shift = 0; shift < 64 && position < m_size; shift += 7) {
+            unsigned char byte = m_data[position++];
+            result |= uint64_t(byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+}
+}
+#endif
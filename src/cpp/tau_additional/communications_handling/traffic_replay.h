@@ -0,0 +1,252 @@
+// This source file is part of the 'tau' open source project.
+// Copyright (c) 2016, Yuriy Vosel.
+// Licensed under Boost Software License.
+// See LICENSE.txt for the licence information.
+
+#ifndef TAU_ADDITIONAL_COMMUNICATIONS_HANDLING_TRAFFIC_REPLAY_H
+#define TAU_ADDITIONAL_COMMUNICATIONS_HANDLING_TRAFFIC_REPLAY_H
+
+#include <tau/communications_handling/outgiong_packets_generator.h>
+#include <tau_additional/communications_handling/raw_incoming_data_stream_parser.h>
+#include <tau_additional/communications_handling/shared_buffer_sender.h>
+#include <tau_additional/communications_handling/traffic_capture.h>
+#include <tau_additional/util/metrics.h>
+#include <tau_additional/util/monotonic_clock.h>
+#include <tau_additional/util/unordered_map.h>
+#include <time.h>
+#include <errno.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+namespace tau_additional {
+namespace communications_handling {
+
+namespace traffic_replay_details {
+    static const uint64_t HASH_OFFSET_BASIS = 14695981039346656037ULL;
+    static const uint64_t HASH_PRIME = 1099511628211ULL;
+
+    // FNV-1a, continued from the previous value
+    inline uint64_t updateHash(uint64_t hash, char const * data, size_t size) {
+        for (size_t i = 0; i < size; ++i) {
+            hash = (hash ^ uint64_t(static_cast<unsigned char>(data[i]))) * HASH_PRIME;
+        }
+        return hash;
+    }
+
+    // Counts (and hashes) the replayed outgoing data instead of sending it
+    class ReplayWriter : public tau::communications_handling::OutgiongPacketsGenerator, public SharedBufferSender
+    {
+    public:
+        ReplayWriter(): bytes(0), hash(HASH_OFFSET_BASIS), closeRequested(false) {};
+        virtual void sendData(std::string const & data) {
+            add(data.data(), data.size());
+        }
+        virtual void sendSharedBuffer(tau_additional::util::SharedBuffer const & data) {
+            add(data.data(), data.size());
+        }
+        virtual void close_connection() {
+            closeRequested = true;
+        }
+        void add(char const * data, size_t size) {
+            bytes += size;
+            hash = updateHash(hash, data, size);
+        }
+        uint64_t bytes;
+        uint64_t hash;
+        bool closeRequested;
+    };
+
+    inline void sleepUntil(uint64_t monotonicNanoseconds) {
+        timespec deadline;
+        deadline.tv_sec = time_t(monotonicNanoseconds / 1000000000ULL);
+        deadline.tv_nsec = long(monotonicNanoseconds % 1000000000ULL);
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) == EINTR) {
+        }
+    }
+};
+
+enum TrafficReplayPacing
+{
+    REPLAY_AS_FAST_AS_POSSIBLE,
+    REPLAY_ORIGINAL_PACING      // the records are replayed at their captured times (see the speed)
+};
+
+// Replays the captured traffic (see TrafficCapture) against the events dispatchers, without the
+// network: every captured connection gets its own EventsDispatcherType (constructible from the
+// OutgiongPacketsGenerator reference, as for the servers) and the incoming data stream parser, and
+// the captured incoming chunks are passed to the parser exactly as they were received.
+// The latency is the time, which the chunk takes to be parsed and handled by the dispatcher.
+// The outgoing data of the dispatchers is not sent anywhere, but it is compared with the captured
+// one: the connection, which has sent other bytes, than during the capture, is "mismatched" (the
+// handling is not deterministic, or the code has changed its output).
+// The delayed calls and the compression are not available to the replayed dispatchers.
+template <typename EventsDispatcherType>
+class TrafficReplayer
+{
+    struct Connection
+    {
+        Connection(): dispatcher(writer), capturedBytes(0), capturedHash(traffic_replay_details::HASH_OFFSET_BASIS) {};
+        traffic_replay_details::ReplayWriter writer;
+        EventsDispatcherType dispatcher;
+        RawIncomingDataStreamParser parser;
+        uint64_t capturedBytes;
+        uint64_t capturedHash;
+    private:
+        Connection(Connection const &);
+        Connection & operator = (Connection const &);
+    };
+    typedef typename tau_additional::util::UnorderedMap<uint64_t, Connection *>::type ConnectionsMap;
+public:
+    struct Results
+    {
+        Results():
+            connections(0), mismatchedConnections(0), incomingChunks(0), incomingBytes(0),
+            capturedOutgoingBytes(0), replayedOutgoingBytes(0), capturedDuration(0), elapsedNanoseconds(0),
+            maxLagNanoseconds(0), latencyMean(0), latencyP50(0), latencyP99(0), latencyMax(0), truncated(false)
+        {};
+        uint64_t connections;
+        uint64_t mismatchedConnections;
+        uint64_t incomingChunks;
+        uint64_t incomingBytes;
+        uint64_t capturedOutgoingBytes;
+        uint64_t replayedOutgoingBytes;
+        uint64_t capturedDuration;      // nanoseconds between the first and the last captured record
+        uint64_t elapsedNanoseconds;    // the replay time
+        uint64_t maxLagNanoseconds;     // REPLAY_ORIGINAL_PACING: how late the records were replayed
+        uint64_t latencyMean;           // nanoseconds per incoming chunk
+        uint64_t latencyP50;
+        uint64_t latencyP99;
+        uint64_t latencyMax;
+        bool truncated;                 // the capture ends with the incomplete record
+
+        double getChunksPerSecond() const {
+            return elapsedNanoseconds ? double(incomingChunks) * 1e9 / double(elapsedNanoseconds) : 0;
+        }
+        double getBytesPerSecond() const {
+            return elapsedNanoseconds ? double(incomingBytes) * 1e9 / double(elapsedNanoseconds) : 0;
+        }
+    };
+private:
+    TrafficCaptureReader & m_reader;
+    ConnectionsMap m_connections;
+    uint64_t m_replayedOutgoingBytes;
+    uint64_t m_mismatchedConnections;
+
+    TrafficReplayer(TrafficReplayer const &);
+    TrafficReplayer & operator = (TrafficReplayer const &);
+public:
+    explicit TrafficReplayer(TrafficCaptureReader & reader):
+        m_reader(reader), m_replayedOutgoingBytes(0), m_mismatchedConnections(0)
+    {};
+    ~TrafficReplayer() {
+        closeAllConnections();
+    }
+
+    // Replays the whole capture (from its start). With REPLAY_ORIGINAL_PACING the speed scales the
+    // captured delays (2.0 - twice as fast, as it was captured).
+    Results replay(TrafficReplayPacing pacing = REPLAY_AS_FAST_AS_POSSIBLE, double speed = 1.0) {
+        Results results;
+        tau_additional::util::MetricsHistogram latency;
+        m_replayedOutgoingBytes = 0;
+        m_mismatchedConnections = 0;
+        m_reader.rewind();
+        uint64_t start = tau_additional::util::getMonotonicNanoseconds();
+        TrafficCaptureReader::Record record;
+        while (m_reader.next(record)) {
+            results.capturedDuration = record.time;
+            if (pacing == REPLAY_ORIGINAL_PACING && speed > 0) {
+                uint64_t due = start + uint64_t(double(record.time) / speed);
+                uint64_t now = tau_additional::util::getMonotonicNanoseconds();
+                if (due > now) {
+                    traffic_replay_details::sleepUntil(due);
+                } else if (now - due > results.maxLagNanoseconds) {
+                    results.maxLagNanoseconds = now - due;
+                }
+            }
+            switch (record.type) {
+                case TRAFFIC_CONNECTION_OPENED:
+                    openConnection(record.connectionID);
+                    ++results.connections;
+                    break;
+                case TRAFFIC_INCOMING_DATA: {
+                    Connection * connection = findConnection(record.connectionID);
+                    if (connection != NULL && !connection->writer.closeRequested) {
+                        uint64_t chunkStart = tau_additional::util::getMonotonicNanoseconds();
+                        connection->parser.newData(record.data, record.size, connection->dispatcher);
+                        latency.record(tau_additional::util::getMonotonicNanoseconds() - chunkStart);
+                        ++results.incomingChunks;
+                        results.incomingBytes += record.size;
+                    }
+                    break;
+                }
+                case TRAFFIC_OUTGOING_DATA: {
+                    Connection * connection = findConnection(record.connectionID);
+                    if (connection != NULL) {
+                        connection->capturedBytes += record.size;
+                        connection->capturedHash = traffic_replay_details::updateHash(
+                            connection->capturedHash, record.data, record.size);
+                    }
+                    results.capturedOutgoingBytes += record.size;
+                    break;
+                }
+                case TRAFFIC_CONNECTION_CLOSED:
+                    closeConnection(record.connectionID);
+                    break;
+            }
+        }
+        closeAllConnections(); // the ones, which were still open, when the capture has ended
+        results.elapsedNanoseconds = tau_additional::util::getMonotonicNanoseconds() - start;
+        results.replayedOutgoingBytes = m_replayedOutgoingBytes;
+        results.mismatchedConnections = m_mismatchedConnections;
+        results.truncated = m_reader.isTruncated();
+        tau_additional::util::MetricsHistogram::Snapshot snapshot;
+        latency.getSnapshot(snapshot);
+        results.latencyMean = snapshot.getMean();
+        results.latencyP50 = snapshot.getPercentile(0.5);
+        results.latencyP99 = snapshot.getPercentile(0.99);
+        results.latencyMax = snapshot.max;
+        return results;
+    }
+private:
+    void openConnection(uint64_t connectionID) {
+        closeConnection(connectionID); // not expected: the ids are unique within the capture
+        Connection * connection = new Connection();
+        m_connections[connectionID] = connection;
+        connection->dispatcher.onClientConnected(
+            tau::communications_handling::ClientConnectionInfo("127.0.0.1", 0, "127.0.0.1", 0));
+    }
+
+    Connection * findConnection(uint64_t connectionID) {
+        typename ConnectionsMap::iterator found = m_connections.find(connectionID);
+        return (found != m_connections.end()) ? found->second : NULL;
+    }
+
+    void closeConnection(uint64_t connectionID) {
+        typename ConnectionsMap::iterator found = m_connections.find(connectionID);
+        if (found != m_connections.end()) {
+            finishConnection(found->second);
+            m_connections.erase(found);
+        }
+    }
+
+    void closeAllConnections() {
+        for (typename ConnectionsMap::iterator it = m_connections.begin(); it != m_connections.end(); ++it) {
+            finishConnection(it->second);
+        }
+        m_connections.clear();
+    }
+
+    void finishConnection(Connection * connection) {
+        connection->dispatcher.onConnectionClosed();
+        m_replayedOutgoingBytes += connection->writer.bytes;
+        if (connection->writer.bytes != connection->capturedBytes || connection->writer.hash != connection->capturedHash) {
+            ++m_mismatchedConnections;
+        }
+        delete connection;
+    }
+};
+
+}
+}
+#endif
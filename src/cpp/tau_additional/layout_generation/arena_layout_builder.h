@@ -0,0 +1,408 @@
+// This source file is part of the 'tau' open source project.
+// Copyright (c) 2016, Yuriy Vosel.
+// Licensed under Boost Software License.
+// See LICENSE.txt for the licence information.
+
+#ifndef TAU_ADDITIONAL_LAYOUT_GENERATION_ARENA_LAYOUT_BUILDER_H
+#define TAU_ADDITIONAL_LAYOUT_GENERATION_ARENA_LAYOUT_BUILDER_H
+
+#include <tau/common/ids.h>
+#include <tau_additional/common/id_string.h>
+#include <tau_additional/util/monotonic_arena.h>
+#include <stddef.h>
+#include <string.h>
+#include <string>
+
+namespace tau_additional {
+namespace layout_generation {
+
+namespace arena_layout_builder_details {
+    enum NodeType {
+        NODE_EMPTY_SPACE,
+        NODE_BUTTON,
+        NODE_BOOLEAN_INPUT,
+        NODE_TEXT_INPUT,
+        NODE_LABEL,
+        NODE_CONTAINER
+    };
+
+    // Points into the arena (or to a literal); not zero-terminated
+    struct ArenaString
+    {
+        char const * data;
+        size_t size;
+        bool isSet;
+    };
+
+    struct Node
+    {
+        NodeType type;
+        ArenaString id;
+        ArenaString note;
+        ArenaString value;      // the text input value, the page to switch to for the button
+        bool boolValue;         // the boolean input value, 'horizontal' for the container
+        Node * firstChild;
+        Node * lastChild;
+        Node * nextSibling;
+    };
+
+    struct Page
+    {
+        ArenaString id;
+        Node * root;
+        Page * next;
+    };
+
+    // Counts the bytes: the first pass of the serialization
+    class SizeCounter
+    {
+        size_t m_size;
+    public:
+        SizeCounter(): m_size(0) {};
+        void append(char const * data, size_t size) {
+            (void)data;
+            m_size += size;
+        }
+        void append(char) {
+            ++m_size;
+        }
+        size_t getSize() const {
+            return m_size;
+        }
+    };
+
+    // Writes to the buffer of the size, which the SizeCounter has found
+    class BufferWriter
+    {
+        char * m_position;
+    public:
+        explicit BufferWriter(char * buffer): m_position(buffer) {};
+        void append(char const * data, size_t size) {
+            memcpy(m_position, data, size);
+            m_position += size;
+        }
+        void append(char value) {
+            *m_position++ = value;
+        }
+    };
+
+    template <typename OutputType, size_t size>
+    inline void appendLiteral(OutputType & output, char const (&literal)[size]) {
+        output.append(literal, size - 1);
+    }
+
+    // The same escaping, as in the library's layout JSON
+    template <typename OutputType>
+    inline void appendQuoted(OutputType & output, ArenaString const & value) {
+        output.append('"');
+        size_t plainStart = 0;
+        for (size_t i = 0; i < value.size; ++i) {
+            if (value.data[i] == '"' || value.data[i] == '\\') {
+                output.append(value.data + plainStart, i - plainStart);
+                output.append('\\');
+                plainStart = i;
+            }
+        }
+        output.append(value.data + plainStart, value.size - plainStart);
+        output.append('"');
+    }
+
+    // The parts of the layout JSON: the recursive writer and the StreamingLayoutWriter share them
+
+    template <typename OutputType>
+    inline void writePageStart(OutputType & output, Page const * page) {
+        appendLiteral(output, "{\"id\":");
+        appendQuoted(output, page->id);
+        appendLiteral(output, ",\"root\":");
+    }
+
+    template <typename OutputType>
+    inline void writeLayoutEnd(OutputType & output, ArenaString const & startPage) {
+        output.append(']');
+        if (startPage.size > 0) {
+            appendLiteral(output, ",\"start\":");
+            appendQuoted(output, startPage);
+        }
+        output.append('}');
+    }
+
+    // The children and "]}" follow
+    template <typename OutputType>
+    inline void writeContainerStart(OutputType & output, Node const * node) {
+        appendLiteral(output, "{\"type\":\"container\",\"horizontal\":");
+        if (node->boolValue) {
+            appendLiteral(output, "true");
+        } else {
+            appendLiteral(output, "false");
+        }
+        appendLiteral(output, ",\"children\":[");
+    }
+
+    // Any element, but the container. The empty id and note are omitted, as the library does
+    template <typename OutputType>
+    inline void writeElement(OutputType & output, Node const * node) {
+        switch (node->type) {
+            case NODE_EMPTY_SPACE:
+                appendLiteral(output, "{\"type\":\"empty\"}");
+                return;
+            case NODE_BUTTON:
+                appendLiteral(output, "{\"type\":\"button\"");
+                break;
+            case NODE_BOOLEAN_INPUT:
+                appendLiteral(output, "{\"type\":\"bool\"");
+                break;
+            case NODE_TEXT_INPUT:
+                appendLiteral(output, "{\"type\":\"text\"");
+                break;
+            case NODE_LABEL:
+            default:
+                appendLiteral(output, "{\"type\":\"label\"");
+                break;
+        }
+        if (node->id.size > 0) {
+            appendLiteral(output, ",\"id\":");
+            appendQuoted(output, node->id);
+        }
+        if (node->note.size > 0) {
+            appendLiteral(output, ",\"note\":");
+            appendQuoted(output, node->note);
+        }
+        if (node->type == NODE_BUTTON && node->value.isSet) {
+            appendLiteral(output, ",\"switch_to\":");
+            appendQuoted(output, node->value);
+        } else if (node->type == NODE_BOOLEAN_INPUT) {
+            if (node->boolValue) {
+                appendLiteral(output, ",\"value\":true");
+            } else {
+                appendLiteral(output, ",\"value\":false");
+            }
+        } else if (node->type == NODE_TEXT_INPUT && node->value.isSet) {
+            appendLiteral(output, ",\"value\":");
+            appendQuoted(output, node->value);
+        }
+        output.append('}');
+    }
+};
+
+class StreamingLayoutWriter;
+
+// Runtime layout builder, which keeps the whole tree in the MonotonicArena and writes the layout JSON
+// straight into one buffer of the exact size. The library's builder (LayoutInfo, LayoutPage and the
+// element classes) keeps the JSON text of every element and copies it into the parent on every push(),
+// so a big layout costs thousands of heap allocations; this one allocates a few arena blocks (none,
+// when the arena is reused) and the result string.
+// The API follows the library's builder, the JSON is the same, as LayoutInfo::getJson() gives:
+//
+//     tau_additional::util::MonotonicArena arena;
+//     ArenaLayoutBuilder layout(arena);
+//     layout.pushLayoutPage(PAGE_1_ID, layout.evenlySplit(true)
+//         .push(layout.button().note("go to page 2").ID(BUTTON_ID).switchToAnotherLayoutPageOnClick(PAGE_2_ID))
+//         .push(layout.textInput().ID(TEXT_INPUT_ID).initialValue("initial text")));
+//     layout.setStartLayoutPage(PAGE_1_ID);
+//     std::string json = layout.getJson();
+//
+// The elements are the handles of the arena nodes: push() links the child into the parent, nothing is
+// copied (so the rvalue overloads would save nothing, and there are none). The element should be pushed
+// once. The strings are copied into the arena; the builder and its elements should not outlive the arena.
+class ArenaLayoutBuilder
+{
+    friend class StreamingLayoutWriter;
+
+    typedef arena_layout_builder_details::Node Node;
+    typedef arena_layout_builder_details::Page Page;
+    typedef arena_layout_builder_details::ArenaString ArenaString;
+public:
+    class Element
+    {
+        friend class ArenaLayoutBuilder;
+
+        ArenaLayoutBuilder * m_builder;
+        Node * m_node;
+
+        Element(ArenaLayoutBuilder & builder, Node * node): m_builder(&builder), m_node(node) {};
+    public:
+        // The button, the boolean input (its label) and the label (its text)
+        Element & note(std::string const & text) {
+            m_node->note = m_builder->copyString(text.data(), text.size());
+            return *this;
+        }
+        Element & note(char const * text) {
+            m_node->note = m_builder->copyString(text, strlen(text));
+            return *this;
+        }
+        Element & ID(tau::common::ElementID const & id) {
+            std::string const & idString = tau_additional::common::getIdString(id);
+            m_node->id = m_builder->copyString(idString.data(), idString.size());
+            return *this;
+        }
+        // The button
+        Element & switchToAnotherLayoutPageOnClick(tau::common::LayoutPageID const & pageID) {
+            std::string const & pageString = tau_additional::common::getIdString(pageID);
+            m_node->value = m_builder->copyString(pageString.data(), pageString.size());
+            return *this;
+        }
+        // The text input
+        Element & initialValue(std::string const & text) {
+            m_node->value = m_builder->copyString(text.data(), text.size());
+            return *this;
+        }
+        Element & initialValue(char const * text) {
+            m_node->value = m_builder->copyString(text, strlen(text));
+            return *this;
+        }
+        // The container
+        Element & push(Element const & child) {
+            if (m_node->lastChild != NULL) {
+                m_node->lastChild->nextSibling = child.m_node;
+            } else {
+                m_node->firstChild = child.m_node;
+            }
+            m_node->lastChild = child.m_node;
+            return *this;
+        }
+    };
+private:
+    tau_additional::util::MonotonicArena & m_arena;
+    Page * m_firstPage;
+    Page * m_lastPage;
+    ArenaString m_startPage;
+
+    ArenaLayoutBuilder(ArenaLayoutBuilder const &);
+    ArenaLayoutBuilder & operator = (ArenaLayoutBuilder const &);
+public:
+    explicit ArenaLayoutBuilder(tau_additional::util::MonotonicArena & arena):
+        m_arena(arena),
+        m_firstPage(NULL),
+        m_lastPage(NULL),
+        m_startPage(getUnsetString())
+    {};
+
+    Element button() {
+        return Element(*this, createNode(arena_layout_builder_details::NODE_BUTTON));
+    }
+    Element booleanInput(bool value) {
+        Node * node = createNode(arena_layout_builder_details::NODE_BOOLEAN_INPUT);
+        node->boolValue = value;
+        return Element(*this, node);
+    }
+    Element textInput() {
+        return Element(*this, createNode(arena_layout_builder_details::NODE_TEXT_INPUT));
+    }
+    Element label(std::string const & text) {
+        return Element(*this, createNode(arena_layout_builder_details::NODE_LABEL)).note(text);
+    }
+    Element label(char const * text) {
+        return Element(*this, createNode(arena_layout_builder_details::NODE_LABEL)).note(text);
+    }
+    Element emptySpace() {
+        return Element(*this, createNode(arena_layout_builder_details::NODE_EMPTY_SPACE));
+    }
+    Element evenlySplit(bool horizontal) {
+        Node * node = createNode(arena_layout_builder_details::NODE_CONTAINER);
+        node->boolValue = horizontal;
+        return Element(*this, node);
+    }
+
+    ArenaLayoutBuilder & pushLayoutPage(tau::common::LayoutPageID const & pageID, Element const & root) {
+        Page * page = m_arena.create<Page>();
+        std::string const & pageString = tau_additional::common::getIdString(pageID);
+        page->id = copyString(pageString.data(), pageString.size());
+        page->root = root.m_node;
+        page->next = NULL;
+        if (m_lastPage != NULL) {
+            m_lastPage->next = page;
+        } else {
+            m_firstPage = page;
+        }
+        m_lastPage = page;
+        return *this;
+    }
+    ArenaLayoutBuilder & setStartLayoutPage(tau::common::LayoutPageID const & pageID) {
+        std::string const & pageString = tau_additional::common::getIdString(pageID);
+        m_startPage = copyString(pageString.data(), pageString.size());
+        return *this;
+    }
+
+    size_t getJsonSize() const {
+        arena_layout_builder_details::SizeCounter counter;
+        writeLayout(counter);
+        return counter.getSize();
+    }
+    // The buffer should have getJsonSize() bytes; the result is not zero-terminated.
+    void writeJson(char * buffer) const {
+        arena_layout_builder_details::BufferWriter writer(buffer);
+        writeLayout(writer);
+    }
+    // Appends the JSON to the output with one reallocation at most.
+    void appendJson(std::string & output) const {
+        size_t offset = output.size();
+        output.resize(offset + getJsonSize());
+        if (output.size() > offset) {
+            writeJson(&output[offset]);
+        }
+    }
+    std::string getJson() const {
+        std::string result;
+        appendJson(result);
+        return result;
+    }
+private:
+    static ArenaString getUnsetString() {
+        ArenaString result = { "", 0, false };
+        return result;
+    }
+
+    ArenaString copyString(char const * data, size_t size) {
+        ArenaString result = { m_arena.copyString(data, size), size, true };
+        return result;
+    }
+
+    Node * createNode(arena_layout_builder_details::NodeType type) {
+        Node * node = m_arena.create<Node>();
+        node->type = type;
+        node->id = getUnsetString();
+        node->note = getUnsetString();
+        node->value = getUnsetString();
+        node->boolValue = false;
+        node->firstChild = NULL;
+        node->lastChild = NULL;
+        node->nextSibling = NULL;
+        return node;
+    }
+
+    template <typename OutputType>
+    void writeLayout(OutputType & output) const {
+        using namespace arena_layout_builder_details;
+        appendLiteral(output, "{\"pages\":[");
+        for (Page const * page = m_firstPage; page != NULL; page = page->next) {
+            if (page != m_firstPage) {
+                output.append(',');
+            }
+            writePageStart(output, page);
+            writeNode(output, page->root);
+            output.append('}');
+        }
+        writeLayoutEnd(output, m_startPage);
+    }
+
+    template <typename OutputType>
+    static void writeNode(OutputType & output, Node const * node) {
+        using namespace arena_layout_builder_details;
+        if (node->type != NODE_CONTAINER) {
+            writeElement(output, node);
+            return;
+        }
+        writeContainerStart(output, node);
+        for (Node const * child = node->firstChild; child != NULL; child = child->nextSibling) {
+            if (child != node->firstChild) {
+                output.append(',');
+            }
+            writeNode(output, child);
+        }
+        appendLiteral(output, "]}");
+    }
+};
+
+}
+}
+#endif
@@ -0,0 +1,111 @@
+// This source file is part of the 'tau' open source project.
+// Copyright (c) 2016, Yuriy Vosel.
+// Licensed under Boost Software License.
+// See LICENSE.txt for the licence information.
+
+#ifndef TAU_ADDITIONAL_LAYOUT_GENERATION_LAYOUT_CACHE_H
+#define TAU_ADDITIONAL_LAYOUT_GENERATION_LAYOUT_CACHE_H
+
+#include <tau_additional/communications_handling/packet_serializer.h>
+#include <tau_additional/util/shared_buffer.h>
+#include <tau_additional/util/mutex.h>
+#include <stdint.h>
+#include <map>
+#include <string>
+#include <utility>
+
+namespace tau_additional {
+namespace layout_generation {
+
+// Cache of the ready-to-send 'reset layout' packets.
+// The entry is identified by the layout key and an optional variant key (for example, the screen
+// size class of the client device, if the application builds different layouts for different devices).
+// The cached packets are immutable and shared by all the connections; the cache is thread-safe.
+class LayoutCache
+{
+    typedef std::pair<std::string, std::string> Key;
+    typedef std::map<Key, tau_additional::util::SharedBuffer> Entries;
+    typedef std::map<std::string, uint64_t> Generations;
+
+    Entries m_entries;
+    // Bumped by invalidate(), so the packet, which was being built, while the layout was
+    // invalidated, is not stored (it may be built from the old data).
+    Generations m_generations;
+    uint64_t m_generation; // bumped by invalidateAll()
+    tau_additional::util::Mutex m_mutex;
+public:
+    LayoutCache():
+        m_generation(0)
+    {};
+
+    // Returns the cached 'reset layout' packet. On the cache miss, the layoutJsonBuilder()
+    // is called to get the layout JSON (for example, LayoutInfo::getJson() result)
+    // and the packet is serialized and stored.
+    template <typename LayoutJsonBuilderType>
+    tau_additional::util::SharedBuffer getResetLayoutPacket(
+        std::string const & layoutKey, LayoutJsonBuilderType layoutJsonBuilder,
+        std::string const & variantKey = std::string())
+    {
+        Key key(layoutKey, variantKey);
+        uint64_t generation = 0;
+        uint64_t layoutGeneration = 0;
+        {
+            tau_additional::util::ScopedLock lock(m_mutex);
+            Entries::const_iterator found = m_entries.find(key);
+            if (found != m_entries.end()) {
+                return found->second;
+            }
+            generation = m_generation;
+            layoutGeneration = getLayoutGeneration(layoutKey);
+        }
+        // The layout is built without holding the lock. If several threads miss at once,
+        // the layout is built several times, but only the first result is stored.
+        // If the layout is invalidated meanwhile, the result is returned, but not stored.
+        std::string packet = tau_additional::communications_handling::PacketSerializer()
+            .resetLayout(layoutJsonBuilder());
+        tau_additional::util::SharedBuffer result = tau_additional::util::SharedBuffer::adopt(packet);
+        tau_additional::util::ScopedLock lock(m_mutex);
+        if (generation != m_generation || layoutGeneration != getLayoutGeneration(layoutKey)) {
+            return result;
+        }
+        return m_entries.insert(std::make_pair(key, result)).first->second;
+    }
+
+    // Removes all the variants of the layout. The connections, which already
+    // hold the old packet, are not affected.
+    void invalidate(std::string const & layoutKey) {
+        tau_additional::util::ScopedLock lock(m_mutex);
+        ++m_generations[layoutKey];
+        Entries::iterator it = m_entries.lower_bound(Key(layoutKey, std::string()));
+        while (it != m_entries.end() && it->first.first == layoutKey) {
+            m_entries.erase(it++);
+        }
+    }
+
+    void invalidate(std::string const & layoutKey, std::string const & variantKey) {
+        tau_additional::util::ScopedLock lock(m_mutex);
+        ++m_generations[layoutKey]; // the other variants, which are being built, are not stored either
+        m_entries.erase(Key(layoutKey, variantKey));
+    }
+
+    void invalidateAll() {
+        tau_additional::util::ScopedLock lock(m_mutex);
+        ++m_generation;
+        m_entries.clear();
+    }
+
+    size_t getEntriesCount() {
+        tau_additional::util::ScopedLock lock(m_mutex);
+        return m_entries.size();
+    }
+private:
+    // Should be called under the lock
+    uint64_t getLayoutGeneration(std::string const & layoutKey) const {
+        Generations::const_iterator found = m_generations.find(layoutKey);
+        return (found != m_generations.end()) ? found->second : 0;
+    }
+};
+
+}
+}
+#endif
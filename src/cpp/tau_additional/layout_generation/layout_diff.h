@@ -0,0 +1,421 @@
+// This source file is part of the 'tau' open source project.
+// Copyright (c) 2016, Yuriy Vosel.
+// Licensed under Boost Software License.
+// See LICENSE.txt for the licence information.
+
+#ifndef TAU_ADDITIONAL_LAYOUT_GENERATION_LAYOUT_DIFF_H
+#define TAU_ADDITIONAL_LAYOUT_GENERATION_LAYOUT_DIFF_H
+
+#include <tau/layout_generation/layout_info.h>
+#include <tau_additional/communications_handling/packet_serializer.h>
+#include <tau_additional/util/json_value.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace tau_additional {
+namespace layout_generation {
+
+// Names of the layout JSON members, which can be changed on the client without the layout reset.
+// The names are not hardcoded: they are found (once) in the JSON, which the library's own
+// layout builder produces for a few probe elements. If the probing fails, the schema is invalid
+// and every layout change is treated as a structural one.
+class LayoutJsonSchema
+{
+    std::string m_idKey;
+    std::vector<std::string> m_noteKeys;      // button/boolean input notes, label texts
+    std::vector<std::string> m_textValueKeys; // text input values
+    std::vector<std::string> m_boolValueKeys; // boolean input values
+public:
+    static LayoutJsonSchema const & getInstance() {
+        static LayoutJsonSchema const instance(discover());
+        return instance;
+    }
+
+    bool isValid() const {
+        return !m_idKey.empty() && !m_noteKeys.empty();
+    }
+    std::string const & getIdKey() const {
+        return m_idKey;
+    }
+    bool isNoteKey(std::string const & key) const {
+        return contains(m_noteKeys, key);
+    }
+    bool isTextValueKey(std::string const & key) const {
+        return contains(m_textValueKeys, key);
+    }
+    bool isBoolValueKey(std::string const & key) const {
+        return contains(m_boolValueKeys, key);
+    }
+private:
+    static bool contains(std::vector<std::string> const & keys, std::string const & key) {
+        for (size_t i = 0; i < keys.size(); ++i) {
+            if (keys[i] == key) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    static void addKey(std::vector<std::string> & keys, std::string const & key) {
+        if (!key.empty() && !contains(keys, key)) {
+            keys.push_back(key);
+        }
+    }
+
+    // Returns the first object (depth-first), which has a string member with the given value.
+    static tau_additional::util::JsonValue const * findObjectWithValue(
+        tau_additional::util::JsonValue const & node, std::string const & value, std::string & key)
+    {
+        typedef tau_additional::util::JsonValue JsonValue;
+        if (node.getType() == JsonValue::TYPE_OBJECT) {
+            std::vector<JsonValue::Member> const & members = node.getMembers();
+            for (size_t i = 0; i < members.size(); ++i) {
+                if (members[i].second.getType() == JsonValue::TYPE_STRING
+                    && members[i].second.getString() == value) {
+                    key = members[i].first;
+                    return &node;
+                }
+            }
+            for (size_t i = 0; i < members.size(); ++i) {
+                JsonValue const * found = findObjectWithValue(members[i].second, value, key);
+                if (found != NULL) {
+                    return found;
+                }
+            }
+        } else if (node.getType() == JsonValue::TYPE_ARRAY) {
+            std::vector<JsonValue> const & items = node.getItems();
+            for (size_t i = 0; i < items.size(); ++i) {
+                JsonValue const * found = findObjectWithValue(items[i], value, key);
+                if (found != NULL) {
+                    return found;
+                }
+            }
+        }
+        return NULL;
+    }
+
+    // Finds the key of the probe value in the element, which has the probe id.
+    static std::string findElementKey(tau_additional::util::JsonValue const & layout,
+        std::string const & idKey, std::string const & probeID, std::string const & probeValue)
+    {
+        std::string key;
+        tau_additional::util::JsonValue const * element = findObjectWithValue(layout, probeID, key);
+        if (element == NULL || key != idKey) {
+            return std::string();
+        }
+        std::vector<tau_additional::util::JsonValue::Member> const & members = element->getMembers();
+        for (size_t i = 0; i < members.size(); ++i) {
+            if (members[i].second.getType() == tau_additional::util::JsonValue::TYPE_STRING
+                && members[i].second.getString() == probeValue) {
+                return members[i].first;
+            }
+        }
+        return std::string();
+    }
+
+    // Finds the key of the only boolean member of the element, which has the probe id.
+    static std::string findElementBoolKey(tau_additional::util::JsonValue const & layout,
+        std::string const & idKey, std::string const & probeID)
+    {
+        std::string key;
+        tau_additional::util::JsonValue const * element = findObjectWithValue(layout, probeID, key);
+        if (element == NULL || key != idKey) {
+            return std::string();
+        }
+        std::string result;
+        std::vector<tau_additional::util::JsonValue::Member> const & members = element->getMembers();
+        for (size_t i = 0; i < members.size(); ++i) {
+            if (members[i].second.getType() == tau_additional::util::JsonValue::TYPE_BOOL) {
+                if (!result.empty()) {
+                    return std::string(); // ambiguous
+                }
+                result = members[i].first;
+            }
+        }
+        return result;
+    }
+
+    static LayoutJsonSchema discover() {
+        using namespace tau::layout_generation;
+        std::string const BUTTON_ID("probe_button_id_8f3a");
+        std::string const BUTTON_NOTE("probe_button_note_8f3a");
+        std::string const LABEL_ID("probe_label_id_8f3a");
+        std::string const LABEL_TEXT("probe_label_text_8f3a");
+        std::string const TEXT_INPUT_ID("probe_text_input_id_8f3a");
+        std::string const TEXT_INPUT_VALUE("probe_text_input_value_8f3a");
+        std::string const BOOL_INPUT_ID("probe_bool_input_id_8f3a");
+
+        LayoutInfo probeLayout;
+        probeLayout.pushLayoutPage(LayoutPage(tau::common::LayoutPageID("probe_page_8f3a"),
+            EvenlySplitLayoutElementsContainer(true)
+                .push(ButtonLayoutElement().note(BUTTON_NOTE).ID(tau::common::ElementID(BUTTON_ID)))
+                .push(LabelElement(LABEL_TEXT).ID(tau::common::ElementID(LABEL_ID)))
+                .push(TextInputLayoutElement().ID(tau::common::ElementID(TEXT_INPUT_ID))
+                    .initialValue(TEXT_INPUT_VALUE))
+                .push(BooleanInputLayoutElement(true).ID(tau::common::ElementID(BOOL_INPUT_ID)))
+        ));
+        LayoutJsonSchema result;
+        tau_additional::util::JsonValue layout;
+        if (!tau_additional::util::JsonValue::parse(probeLayout.getJson(), layout)
+            || findObjectWithValue(layout, BUTTON_ID, result.m_idKey) == NULL) {
+            return LayoutJsonSchema();
+        }
+        addKey(result.m_noteKeys, findElementKey(layout, result.m_idKey, BUTTON_ID, BUTTON_NOTE));
+        addKey(result.m_noteKeys, findElementKey(layout, result.m_idKey, LABEL_ID, LABEL_TEXT));
+        addKey(result.m_textValueKeys, findElementKey(layout, result.m_idKey, TEXT_INPUT_ID, TEXT_INPUT_VALUE));
+        addKey(result.m_boolValueKeys, findElementBoolKey(layout, result.m_idKey, BOOL_INPUT_ID));
+        return result;
+    }
+};
+
+// One change, which can be applied with the fine-grained packet.
+struct LayoutElementChange
+{
+    enum Kind {
+        ELEMENT_NOTE,
+        TEXT_VALUE,
+        BOOL_VALUE  // the value is "true" or "false"
+    };
+    LayoutElementChange(Kind kind_, std::string const & elementID_, std::string const & value_):
+        kind(kind_), elementID(elementID_), value(value_)
+    {};
+    Kind kind;
+    std::string elementID;
+    std::string value;
+};
+
+namespace layout_diff_details {
+    inline bool diffNodes(tau_additional::util::JsonValue const & previous,
+        tau_additional::util::JsonValue const & next, LayoutJsonSchema const & schema,
+        std::vector<LayoutElementChange> & changes);
+
+    // The library omits the empty notes and text values, so the missing member is the empty string.
+    inline bool getStringMember(tau_additional::util::JsonValue const * member, std::string & value) {
+        if (member == NULL) {
+            value.clear();
+            return true;
+        }
+        if (member->getType() != tau_additional::util::JsonValue::TYPE_STRING) {
+            return false;
+        }
+        value = member->getString();
+        return true;
+    }
+
+    // Compares the member of the element, which is missing (NULL) in one of the layouts or in none.
+    inline bool diffElementMember(std::string const & key, std::string const & elementID,
+        tau_additional::util::JsonValue const * previous, tau_additional::util::JsonValue const * next,
+        LayoutJsonSchema const & schema, std::vector<LayoutElementChange> & changes)
+    {
+        typedef tau_additional::util::JsonValue JsonValue;
+        if (!elementID.empty()) {
+            bool isNote = schema.isNoteKey(key);
+            std::string previousValue;
+            std::string nextValue;
+            if ((isNote || schema.isTextValueKey(key))
+                && getStringMember(previous, previousValue) && getStringMember(next, nextValue)) {
+                if (previousValue != nextValue) {
+                    changes.push_back(LayoutElementChange(
+                        isNote ? LayoutElementChange::ELEMENT_NOTE : LayoutElementChange::TEXT_VALUE,
+                        elementID, nextValue));
+                }
+                return true;
+            }
+            if (schema.isBoolValueKey(key) && previous != NULL && next != NULL
+                && previous->getType() == JsonValue::TYPE_BOOL && next->getType() == JsonValue::TYPE_BOOL) {
+                if (previous->getBool() != next->getBool()) {
+                    changes.push_back(LayoutElementChange(LayoutElementChange::BOOL_VALUE,
+                        elementID, next->getBool() ? "true" : "false"));
+                }
+                return true;
+            }
+        }
+        return previous != NULL && next != NULL && diffNodes(*previous, *next, schema, changes);
+    }
+
+    // Returns false if the layouts differ in something else than the notes and the input values.
+    inline bool diffNodes(tau_additional::util::JsonValue const & previous,
+        tau_additional::util::JsonValue const & next, LayoutJsonSchema const & schema,
+        std::vector<LayoutElementChange> & changes)
+    {
+        typedef tau_additional::util::JsonValue JsonValue;
+        if (previous.getType() != next.getType()) {
+            return false;
+        }
+        switch (previous.getType()) {
+            case JsonValue::TYPE_NULL:
+                return true;
+            case JsonValue::TYPE_BOOL:
+                return previous.getBool() == next.getBool();
+            case JsonValue::TYPE_NUMBER:
+            case JsonValue::TYPE_STRING:
+                return previous.getString() == next.getString();
+            case JsonValue::TYPE_ARRAY: {
+                std::vector<JsonValue> const & previousItems = previous.getItems();
+                std::vector<JsonValue> const & nextItems = next.getItems();
+                if (previousItems.size() != nextItems.size()) {
+                    return false;
+                }
+                for (size_t i = 0; i < previousItems.size(); ++i) {
+                    if (!diffNodes(previousItems[i], nextItems[i], schema, changes)) {
+                        return false;
+                    }
+                }
+                return true;
+            }
+            case JsonValue::TYPE_OBJECT: {
+                std::vector<JsonValue::Member> const & previousMembers = previous.getMembers();
+                std::vector<JsonValue::Member> const & nextMembers = next.getMembers();
+                // The notes and the values can only be changed in the element with the id
+                // (and the id itself must be the same in both layouts).
+                std::string elementID;
+                JsonValue const * previousID = previous.findMember(schema.getIdKey());
+                if (previousID != NULL && previousID->getType() == JsonValue::TYPE_STRING) {
+                    elementID = previousID->getString();
+                }
+                // The members are matched by the key: the empty note or value can be missing on one side.
+                for (size_t i = 0; i < previousMembers.size(); ++i) {
+                    if (!diffElementMember(previousMembers[i].first, elementID, &previousMembers[i].second,
+                        next.findMember(previousMembers[i].first), schema, changes)) {
+                        return false;
+                    }
+                }
+                for (size_t i = 0; i < nextMembers.size(); ++i) {
+                    if (previous.findMember(nextMembers[i].first) == NULL
+                        && !diffElementMember(nextMembers[i].first, elementID, NULL,
+                            &nextMembers[i].second, schema, changes)) {
+                        return false;
+                    }
+                }
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+// Compares two parsed layouts. Returns false if the structure changed (the layout reset is needed),
+// otherwise fills the changes, which turn the previous layout into the next one.
+inline bool diffLayouts(tau_additional::util::JsonValue const & previous,
+    tau_additional::util::JsonValue const & next, std::vector<LayoutElementChange> & changes,
+    LayoutJsonSchema const & schema = LayoutJsonSchema::getInstance())
+{
+    changes.clear();
+    if (!schema.isValid()) {
+        return false;
+    }
+    return layout_diff_details::diffNodes(previous, next, schema, changes);
+}
+
+// Per-connection state: remembers the last layout sent to the client and turns the next
+// layout into the packets to send. When only the notes and the input values changed,
+// the result is the changeElementNote/updateTextValue/updateBooleanValue packets; otherwise
+// it is one resetLayout packet. The reset is also used when it happens to be shorter than the changes.
+//
+// Usage (for example, in the data tick handler of the dashboard):
+//     std::string packets = m_layoutUpdatesGenerator.makeUpdatePackets(buildDashboardLayout().getJson());
+//     if (!packets.empty()) {
+//         m_outgoingGenerator.sendData(packets);
+//     }
+class LayoutUpdatesGenerator
+{
+public:
+    struct Statistics
+    {
+        Statistics():
+            layoutResets(0), deltaUpdates(0), unchangedLayouts(0),
+            elementChangesSent(0), bytesGenerated(0), resetBytesAvoided(0)
+        {};
+        uint64_t layoutResets;
+        uint64_t deltaUpdates;
+        uint64_t unchangedLayouts;
+        uint64_t elementChangesSent;
+        uint64_t bytesGenerated;
+        // The size of the reset packets, which were not sent because of the delta updates,
+        // minus the size of the delta updates.
+        uint64_t resetBytesAvoided;
+    };
+private:
+    bool m_hasPreviousLayout;
+    std::string m_previousLayoutJson;
+    tau_additional::util::JsonValue m_previousLayout;
+    std::vector<LayoutElementChange> m_changes;
+    tau_additional::communications_handling::PacketSerializer m_serializer;
+    Statistics m_statistics;
+public:
+    LayoutUpdatesGenerator(): m_hasPreviousLayout(false) {};
+
+    // Returns the packets, which bring the client to the newLayoutJson
+    // (empty string, if the layout did not change).
+    std::string makeUpdatePackets(std::string const & newLayoutJson) {
+        if (m_hasPreviousLayout && newLayoutJson == m_previousLayoutJson) {
+            ++m_statistics.unchangedLayouts;
+            return std::string();
+        }
+        tau_additional::util::JsonValue newLayout;
+        bool parsed = tau_additional::util::JsonValue::parse(newLayoutJson, newLayout);
+        std::string result;
+        bool isDelta = parsed && m_hasPreviousLayout && diffLayouts(m_previousLayout, newLayout, m_changes);
+        if (isDelta && m_changes.empty()) {
+            // The text differs, but the layout is the same
+            ++m_statistics.unchangedLayouts;
+            m_previousLayoutJson = newLayoutJson;
+            return std::string();
+        }
+        std::string resetPacket = m_serializer.resetLayout(newLayoutJson);
+        if (isDelta) {
+            for (size_t i = 0; i < m_changes.size() && result.size() < resetPacket.size(); ++i) {
+                result += makeChangePacket(m_changes[i]);
+            }
+        }
+        if (result.empty() || result.size() >= resetPacket.size()) {
+            result.swap(resetPacket);
+            ++m_statistics.layoutResets;
+        } else {
+            ++m_statistics.deltaUpdates;
+            m_statistics.elementChangesSent += m_changes.size();
+            m_statistics.resetBytesAvoided += resetPacket.size() - result.size();
+        }
+        m_statistics.bytesGenerated += result.size();
+        m_previousLayoutJson = newLayoutJson;
+        m_previousLayout.swap(newLayout);
+        m_hasPreviousLayout = parsed;
+        return result;
+    }
+
+    // Should be called when the layout was sent to the client some other way
+    // (for example, from the LayoutCache), so the next update is diffed against it.
+    void setSentLayout(std::string const & layoutJson) {
+        m_previousLayoutJson = layoutJson;
+        m_hasPreviousLayout = tau_additional::util::JsonValue::parse(layoutJson, m_previousLayout);
+    }
+
+    // The next update will be the layout reset (for example, after the client reconnected).
+    void forgetSentLayout() {
+        m_hasPreviousLayout = false;
+        m_previousLayoutJson.clear();
+        m_previousLayout = tau_additional::util::JsonValue();
+    }
+
+    Statistics const & getStatistics() const {
+        return m_statistics;
+    }
+private:
+    std::string makeChangePacket(LayoutElementChange const & change) {
+        tau::common::ElementID elementID(change.elementID);
+        switch (change.kind) {
+            case LayoutElementChange::ELEMENT_NOTE:
+                return m_serializer.changeElementNote(elementID, change.value);
+            case LayoutElementChange::TEXT_VALUE:
+                return m_serializer.updateTextValue(elementID, change.value);
+            case LayoutElementChange::BOOL_VALUE:
+                return m_serializer.updateBooleanValue(elementID, change.value == "true");
+        }
+        return std::string();
+    }
+};
+
+}
+}
+#endif
@@ -0,0 +1,420 @@
+// This source file is part of the 'tau' open source project.
+// Copyright (c) 2016, Yuriy Vosel.
+// Licensed under Boost Software License.
+// See LICENSE.txt for the licence information.
+
+#ifndef TAU_ADDITIONAL_LAYOUT_GENERATION_STATIC_LAYOUT_H
+#define TAU_ADDITIONAL_LAYOUT_GENERATION_STATIC_LAYOUT_H
+
+// MSVC reports 199711L without /Zc:__cplusplus, but supports C++11 since 2015
+#if __cplusplus < 201103L && !(defined(_MSC_VER) && _MSC_VER >= 1900)
+#error "static_layout.h needs C++11 (use the compile_gcc_cpp11.sh build)"
+#endif
+
+#include <tau/layout_generation/layout_info.h>
+#include <tau_additional/communications_handling/packet_serializer.h>
+#include <tau_additional/util/shared_buffer.h>
+#include <stddef.h>
+#include <string>
+
+namespace tau_additional {
+namespace layout_generation {
+
+// Compile-time description of the static layout (constant ids, notes and nesting).
+// The layout is a constexpr object, so its consistency is checked by the compiler:
+//
+//     constexpr auto MY_LAYOUT = static_layout::layout("PAGE_1",
+//         static_layout::page("PAGE_1", static_layout::evenlySplit(true,
+//             static_layout::label("Hello", "LABEL"),
+//             static_layout::button("next", "TO_PAGE_2").switchToPage("PAGE_2"))),
+//         static_layout::page("PAGE_2", static_layout::emptySpace()));
+//     TAU_STATIC_LAYOUT_CHECK(MY_LAYOUT); // duplicate ids, unknown pages - compilation errors
+//
+// The JSON itself is produced by the library's layout builder (so it is exactly the same as
+// for the runtime-built layout), once, with makeResetLayoutPacket(); the result is sent
+// to every client without rebuilding.
+// The layout objects should be defined at the namespace scope (or be static),
+// so they can be used in the static_assert.
+namespace static_layout {
+
+// Elements. The arguments go in the order of the library's builder calls (for example,
+// ButtonLayoutElement().note(...).ID(...)). The null id means 'no id' (the element can't be
+// addressed by the server); the null note, text or value is the empty one.
+struct Button
+{
+    constexpr Button(char const * note_, char const * id_, char const * targetPage_ = nullptr):
+        note(note_), id(id_), targetPage(targetPage_) {}
+    // Same as ButtonLayoutElement::switchToAnotherLayoutPageOnClick()
+    constexpr Button switchToPage(char const * page) const {
+        return Button(note, id, page);
+    }
+    char const * note;
+    char const * id;
+    char const * targetPage;
+};
+
+struct Label
+{
+    constexpr Label(char const * text_, char const * id_): text(text_), id(id_) {}
+    char const * text;
+    char const * id;
+};
+
+struct BooleanInput
+{
+    constexpr BooleanInput(bool value_, char const * note_, char const * id_):
+        value(value_), note(note_), id(id_) {}
+    bool value;
+    char const * note;
+    char const * id;
+};
+
+struct TextInput
+{
+    constexpr TextInput(char const * id_, char const * initialValue_):
+        id(id_), initialValue(initialValue_) {}
+    char const * id;
+    char const * initialValue;
+};
+
+struct EmptySpace
+{
+    constexpr EmptySpace() {}
+};
+
+// Compile-time list of the heterogeneous children.
+struct EmptyList
+{
+    constexpr EmptyList() {}
+};
+
+template <typename HeadType, typename TailType>
+struct List
+{
+    constexpr List(HeadType const & head_, TailType const & tail_): head(head_), tail(tail_) {}
+    HeadType head;
+    TailType tail;
+};
+
+template <typename... Items>
+struct ListType;
+
+template <>
+struct ListType<>
+{
+    typedef EmptyList type;
+};
+
+template <typename HeadType, typename... TailTypes>
+struct ListType<HeadType, TailTypes...>
+{
+    typedef List<HeadType, typename ListType<TailTypes...>::type> type;
+};
+
+constexpr EmptyList makeList() {
+    return EmptyList();
+}
+
+template <typename HeadType, typename... TailTypes>
+constexpr typename ListType<HeadType, TailTypes...>::type makeList(HeadType const & head, TailTypes const &... tail) {
+    return typename ListType<HeadType, TailTypes...>::type(head, makeList(tail...));
+}
+
+template <typename ChildrenType>
+struct EvenlySplitContainer
+{
+    constexpr EvenlySplitContainer(bool horizontal_, ChildrenType const & children_):
+        horizontal(horizontal_), children(children_) {}
+    bool horizontal;
+    ChildrenType children;
+};
+
+template <typename RootType>
+struct Page
+{
+    constexpr Page(char const * id_, RootType const & root_): id(id_), root(root_) {}
+    char const * id;
+    RootType root;
+};
+
+template <typename PagesType>
+struct Layout
+{
+    constexpr Layout(char const * startPage_, PagesType const & pages_): startPage(startPage_), pages(pages_) {}
+    char const * startPage;
+    PagesType pages;
+};
+
+// Factory functions (the names follow the library's builder classes)
+constexpr Button button(char const * note, char const * id = nullptr) {
+    return Button(note, id);
+}
+constexpr Label label(char const * text, char const * id = nullptr) {
+    return Label(text, id);
+}
+constexpr BooleanInput booleanInput(bool value, char const * note, char const * id = nullptr) {
+    return BooleanInput(value, note, id);
+}
+constexpr TextInput textInput(char const * id, char const * initialValue) {
+    return TextInput(id, initialValue);
+}
+constexpr EmptySpace emptySpace() {
+    return EmptySpace();
+}
+template <typename... ChildrenTypes>
+constexpr EvenlySplitContainer<typename ListType<ChildrenTypes...>::type> evenlySplit(
+    bool horizontal, ChildrenTypes const &... children) {
+    return EvenlySplitContainer<typename ListType<ChildrenTypes...>::type>(horizontal, makeList(children...));
+}
+template <typename RootType>
+constexpr Page<RootType> page(char const * id, RootType const & root) {
+    return Page<RootType>(id, root);
+}
+// The null startPage means 'the first page'
+template <typename... PagesTypes>
+constexpr Layout<typename ListType<PagesTypes...>::type> layout(char const * startPage, PagesTypes const &... pages) {
+    return Layout<typename ListType<PagesTypes...>::type>(startPage, makeList(pages...));
+}
+
+// Compile-time checks
+constexpr bool isSameId(char const * first, char const * second) {
+    return (first == nullptr || second == nullptr)
+        ? false
+        : (*first == *second && (*first == '\0' || isSameId(first + 1, second + 1)));
+}
+
+constexpr size_t countElementId(Button const & element, char const * id) {
+    return isSameId(element.id, id) ? 1 : 0;
+}
+constexpr size_t countElementId(Label const & element, char const * id) {
+    return isSameId(element.id, id) ? 1 : 0;
+}
+constexpr size_t countElementId(BooleanInput const & element, char const * id) {
+    return isSameId(element.id, id) ? 1 : 0;
+}
+constexpr size_t countElementId(TextInput const & element, char const * id) {
+    return isSameId(element.id, id) ? 1 : 0;
+}
+constexpr size_t countElementId(EmptySpace const &, char const *) {
+    return 0;
+}
+constexpr size_t countElementId(EmptyList const &, char const *) {
+    return 0;
+}
+template <typename HeadType, typename TailType>
+constexpr size_t countElementId(List<HeadType, TailType> const & list, char const * id) {
+    return countElementId(list.head, id) + countElementId(list.tail, id);
+}
+template <typename ChildrenType>
+constexpr size_t countElementId(EvenlySplitContainer<ChildrenType> const & container, char const * id) {
+    return countElementId(container.children, id);
+}
+template <typename RootType>
+constexpr size_t countElementId(Page<RootType> const & page, char const * id) {
+    return countElementId(page.root, id);
+}
+template <typename PagesType>
+constexpr size_t countElementId(Layout<PagesType> const & layout, char const * id) {
+    return countElementId(layout.pages, id);
+}
+
+constexpr size_t countPageId(EmptyList const &, char const *) {
+    return 0;
+}
+template <typename RootType, typename TailType>
+constexpr size_t countPageId(List<Page<RootType>, TailType> const & pages, char const * id) {
+    return (isSameId(pages.head.id, id) ? 1 : 0) + countPageId(pages.tail, id);
+}
+
+// Every element id is used once in the whole layout (the ids are global for the client).
+template <typename LayoutType>
+constexpr bool elementIdIsUnique(char const * id, LayoutType const & layout) {
+    return id == nullptr || countElementId(layout, id) == 1;
+}
+template <typename LayoutType>
+constexpr bool hasUniqueElementIds(Button const & element, LayoutType const & layout) {
+    return elementIdIsUnique(element.id, layout);
+}
+template <typename LayoutType>
+constexpr bool hasUniqueElementIds(Label const & element, LayoutType const & layout) {
+    return elementIdIsUnique(element.id, layout);
+}
+template <typename LayoutType>
+constexpr bool hasUniqueElementIds(BooleanInput const & element, LayoutType const & layout) {
+    return elementIdIsUnique(element.id, layout);
+}
+template <typename LayoutType>
+constexpr bool hasUniqueElementIds(TextInput const & element, LayoutType const & layout) {
+    return elementIdIsUnique(element.id, layout);
+}
+template <typename LayoutType>
+constexpr bool hasUniqueElementIds(EmptySpace const &, LayoutType const &) {
+    return true;
+}
+template <typename LayoutType>
+constexpr bool hasUniqueElementIds(EmptyList const &, LayoutType const &) {
+    return true;
+}
+template <typename HeadType, typename TailType, typename LayoutType>
+constexpr bool hasUniqueElementIds(List<HeadType, TailType> const & list, LayoutType const & layout) {
+    return hasUniqueElementIds(list.head, layout) && hasUniqueElementIds(list.tail, layout);
+}
+template <typename ChildrenType, typename LayoutType>
+constexpr bool hasUniqueElementIds(EvenlySplitContainer<ChildrenType> const & container, LayoutType const & layout) {
+    return hasUniqueElementIds(container.children, layout);
+}
+template <typename RootType, typename LayoutType>
+constexpr bool hasUniqueElementIds(Page<RootType> const & page, LayoutType const & layout) {
+    return hasUniqueElementIds(page.root, layout);
+}
+template <typename PagesType>
+constexpr bool hasUniqueElementIds(Layout<PagesType> const & layout) {
+    return hasUniqueElementIds(layout.pages, layout);
+}
+
+template <typename PagesType>
+constexpr bool hasUniquePageIds(EmptyList const &, PagesType const &) {
+    return true;
+}
+template <typename RootType, typename TailType, typename PagesType>
+constexpr bool hasUniquePageIds(List<Page<RootType>, TailType> const & list, PagesType const & pages) {
+    return list.head.id != nullptr && countPageId(pages, list.head.id) == 1 && hasUniquePageIds(list.tail, pages);
+}
+template <typename PagesType>
+constexpr bool hasUniquePageIds(Layout<PagesType> const & layout) {
+    return hasUniquePageIds(layout.pages, layout.pages);
+}
+
+// The buttons switch to the existing pages, the start page exists.
+template <typename PagesType>
+constexpr bool hasValidPageReferences(Button const & element, PagesType const & pages) {
+    return element.targetPage == nullptr || countPageId(pages, element.targetPage) == 1;
+}
+template <typename ElementType, typename PagesType>
+constexpr bool hasValidPageReferences(ElementType const &, PagesType const &) {
+    return true;
+}
+template <typename PagesType>
+constexpr bool hasValidPageReferences(EmptyList const &, PagesType const &) {
+    return true;
+}
+template <typename HeadType, typename TailType, typename PagesType>
+constexpr bool hasValidPageReferences(List<HeadType, TailType> const & list, PagesType const & pages) {
+    return hasValidPageReferences(list.head, pages) && hasValidPageReferences(list.tail, pages);
+}
+template <typename ChildrenType, typename PagesType>
+constexpr bool hasValidPageReferences(EvenlySplitContainer<ChildrenType> const & container, PagesType const & pages) {
+    return hasValidPageReferences(container.children, pages);
+}
+template <typename RootType, typename PagesType>
+constexpr bool hasValidPageReferences(Page<RootType> const & page, PagesType const & pages) {
+    return hasValidPageReferences(page.root, pages);
+}
+template <typename PagesType>
+constexpr bool hasValidPageReferences(Layout<PagesType> const & layout) {
+    return (layout.startPage == nullptr || countPageId(layout.pages, layout.startPage) == 1)
+        && hasValidPageReferences(layout.pages, layout.pages);
+}
+
+#define TAU_STATIC_LAYOUT_CHECK(layoutObject) \
+    static_assert(::tau_additional::layout_generation::static_layout::hasUniqueElementIds(layoutObject), \
+        #layoutObject ": the element ids should be unique"); \
+    static_assert(::tau_additional::layout_generation::static_layout::hasUniquePageIds(layoutObject), \
+        #layoutObject ": the page ids should be unique"); \
+    static_assert(::tau_additional::layout_generation::static_layout::hasValidPageReferences(layoutObject), \
+        #layoutObject ": the start page and the pages, which the buttons switch to, should exist")
+
+// Conversion to the library's layout builder objects
+inline std::string toString(char const * value) {
+    return (value != nullptr) ? std::string(value) : std::string();
+}
+
+inline tau::layout_generation::ButtonLayoutElement toLayoutElement(Button const & element) {
+    tau::layout_generation::ButtonLayoutElement result;
+    result.note(toString(element.note));
+    if (element.id != nullptr) {
+        result.ID(tau::common::ElementID(element.id));
+    }
+    if (element.targetPage != nullptr) {
+        result.switchToAnotherLayoutPageOnClick(tau::common::LayoutPageID(element.targetPage));
+    }
+    return result;
+}
+inline tau::layout_generation::LabelElement toLayoutElement(Label const & element) {
+    tau::layout_generation::LabelElement result(toString(element.text));
+    if (element.id != nullptr) {
+        result.ID(tau::common::ElementID(element.id));
+    }
+    return result;
+}
+inline tau::layout_generation::BooleanInputLayoutElement toLayoutElement(BooleanInput const & element) {
+    tau::layout_generation::BooleanInputLayoutElement result(element.value);
+    result.note(toString(element.note));
+    if (element.id != nullptr) {
+        result.ID(tau::common::ElementID(element.id));
+    }
+    return result;
+}
+inline tau::layout_generation::TextInputLayoutElement toLayoutElement(TextInput const & element) {
+    tau::layout_generation::TextInputLayoutElement result;
+    if (element.id != nullptr) {
+        result.ID(tau::common::ElementID(element.id));
+    }
+    result.initialValue(toString(element.initialValue));
+    return result;
+}
+inline tau::layout_generation::EmptySpace toLayoutElement(EmptySpace const &) {
+    return tau::layout_generation::EmptySpace();
+}
+
+inline void pushChildren(tau::layout_generation::EvenlySplitLayoutElementsContainer &, EmptyList const &) {
+}
+template <typename HeadType, typename TailType>
+void pushChildren(tau::layout_generation::EvenlySplitLayoutElementsContainer & container,
+    List<HeadType, TailType> const & children);
+
+template <typename ChildrenType>
+tau::layout_generation::EvenlySplitLayoutElementsContainer toLayoutElement(
+    EvenlySplitContainer<ChildrenType> const & element) {
+    tau::layout_generation::EvenlySplitLayoutElementsContainer result(element.horizontal);
+    pushChildren(result, element.children);
+    return result;
+}
+
+template <typename HeadType, typename TailType>
+void pushChildren(tau::layout_generation::EvenlySplitLayoutElementsContainer & container,
+    List<HeadType, TailType> const & children) {
+    container.push(toLayoutElement(children.head));
+    pushChildren(container, children.tail);
+}
+
+inline void pushPages(tau::layout_generation::LayoutInfo &, EmptyList const &) {
+}
+template <typename RootType, typename TailType>
+void pushPages(tau::layout_generation::LayoutInfo & layoutInfo, List<Page<RootType>, TailType> const & pages) {
+    layoutInfo.pushLayoutPage(tau::layout_generation::LayoutPage(
+        tau::common::LayoutPageID(pages.head.id), toLayoutElement(pages.head.root)));
+    pushPages(layoutInfo, pages.tail);
+}
+
+template <typename PagesType>
+std::string getJson(Layout<PagesType> const & layout) {
+    tau::layout_generation::LayoutInfo result;
+    pushPages(result, layout.pages);
+    if (layout.startPage != nullptr) {
+        result.setStartLayoutPage(tau::common::LayoutPageID(layout.startPage));
+    }
+    return result.getJson();
+}
+
+// The 'reset layout' packet, ready to be sent to any number of clients.
+template <typename PagesType>
+tau_additional::util::SharedBuffer makeResetLayoutPacket(Layout<PagesType> const & layout) {
+    std::string packet = tau_additional::communications_handling::PacketSerializer().resetLayout(getJson(layout));
+    return tau_additional::util::SharedBuffer::adopt(packet);
+}
+
+}
+}
+}
+#endif
@@ -0,0 +1,271 @@
+// This source file is part of the 'tau' open source project.
+// Copyright (c) 2016, Yuriy Vosel.
+// Licensed under Boost Software License.
+// See LICENSE.txt for the licence information.
+
+#ifndef TAU_ADDITIONAL_LAYOUT_GENERATION_STREAMING_LAYOUT_WRITER_H
+#define TAU_ADDITIONAL_LAYOUT_GENERATION_STREAMING_LAYOUT_WRITER_H
+
+#include <tau/communications_handling/outgiong_packets_generator.h>
+#include <tau_additional/communications_handling/packet_serializer.h>
+#include <tau_additional/communications_handling/streaming_sender.h>
+#include <tau_additional/layout_generation/arena_layout_builder.h>
+#include <tau_additional/util/shared_buffer.h>
+#include <stddef.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+namespace tau_additional {
+namespace layout_generation {
+
+namespace streaming_layout_writer_details {
+    // Writes into the chunk; what does not fit, goes to the overflow
+    class ChunkOutput
+    {
+        char * m_buffer;
+        size_t m_size;
+        size_t m_position;
+        std::string & m_overflow;
+    public:
+        ChunkOutput(char * buffer, size_t size, std::string & overflow):
+            m_buffer(buffer), m_size(size), m_position(0), m_overflow(overflow)
+        {};
+        void append(char const * data, size_t size) {
+            size_t fits = (size < m_size - m_position) ? size : (m_size - m_position);
+            memcpy(m_buffer + m_position, data, fits);
+            m_position += fits;
+            if (fits < size) {
+                m_overflow.append(data + fits, size - fits);
+            }
+        }
+        void append(char value) {
+            append(&value, 1);
+        }
+        bool isFull() const {
+            return m_position == m_size;
+        }
+        size_t getPosition() const {
+            return m_position;
+        }
+    };
+};
+
+// Writes the JSON of the ArenaLayoutBuilder's layout part by part, into the buffers of any size:
+// the tree is walked without the recursion, and the walk stops, when the buffer is full. The memory,
+// which is used besides the buffer, does not depend on the number of the elements: it is the stack
+// of the containers (the nesting depth) and the part of one element, which did not fit into the buffer.
+// The JSON is the same, as ArenaLayoutBuilder::getJson() gives. The layout should not be changed
+// (and its arena should not be reset), until the writer is finished.
+class StreamingLayoutWriter
+{
+    typedef arena_layout_builder_details::Node Node;
+    typedef arena_layout_builder_details::Page Page;
+
+    enum State
+    {
+        STATE_LAYOUT_START,
+        STATE_NODE,         // m_node is to be written
+        STATE_AFTER_NODE,   // m_node is written
+        STATE_LAYOUT_END,
+        STATE_FINISHED
+    };
+
+    ArenaLayoutBuilder const & m_layout;
+    State m_state;
+    Page const * m_page;
+    Node const * m_node;
+    std::vector<Node const *> m_openContainers;
+    std::string m_overflow;
+    size_t m_overflowOffset;
+
+    StreamingLayoutWriter(StreamingLayoutWriter const &);
+    StreamingLayoutWriter & operator = (StreamingLayoutWriter const &);
+public:
+    explicit StreamingLayoutWriter(ArenaLayoutBuilder const & layout):
+        m_layout(layout),
+        m_state(STATE_LAYOUT_START),
+        m_page(NULL),
+        m_node(NULL),
+        m_overflowOffset(0)
+    {};
+
+    // Writes the next part of the JSON; returns its size, which is less than the buffer size
+    // only at the end of the JSON (0 - everything is written).
+    size_t write(char * buffer, size_t size) {
+        size_t position = 0;
+        if (m_overflowOffset < m_overflow.size()) {
+            size_t left = m_overflow.size() - m_overflowOffset;
+            position = (left < size) ? left : size;
+            memcpy(buffer, m_overflow.data() + m_overflowOffset, position);
+            m_overflowOffset += position;
+            if (m_overflowOffset == m_overflow.size()) {
+                m_overflow.clear();
+                m_overflowOffset = 0;
+            }
+        }
+        if (position < size) {
+            streaming_layout_writer_details::ChunkOutput output(buffer + position, size - position, m_overflow);
+            while (!output.isFull() && m_state != STATE_FINISHED) {
+                step(output);
+            }
+            position += output.getPosition();
+        }
+        return position;
+    }
+
+    bool isFinished() const {
+        return m_state == STATE_FINISHED && m_overflow.empty();
+    }
+
+    void restart() {
+        m_state = STATE_LAYOUT_START;
+        m_page = NULL;
+        m_node = NULL;
+        m_openContainers.clear();
+        m_overflow.clear();
+        m_overflowOffset = 0;
+    }
+private:
+    // Writes one element (or the start or the end of the container, page or layout)
+    template <typename OutputType>
+    void step(OutputType & output) {
+        using namespace arena_layout_builder_details;
+        switch (m_state) {
+            case STATE_LAYOUT_START:
+                appendLiteral(output, "{\"pages\":[");
+                startPage(output, m_layout.m_firstPage);
+                break;
+            case STATE_NODE:
+                if (m_node->type != NODE_CONTAINER) {
+                    writeElement(output, m_node);
+                    m_state = STATE_AFTER_NODE;
+                } else if (m_node->firstChild != NULL) {
+                    writeContainerStart(output, m_node);
+                    m_openContainers.push_back(m_node);
+                    m_node = m_node->firstChild;
+                } else {
+                    writeContainerStart(output, m_node);
+                    appendLiteral(output, "]}");
+                    m_state = STATE_AFTER_NODE;
+                }
+                break;
+            case STATE_AFTER_NODE:
+                if (m_openContainers.empty()) {
+                    output.append('}'); // the page
+                    if (m_page->next != NULL) {
+                        output.append(',');
+                    }
+                    startPage(output, m_page->next);
+                } else if (m_node->nextSibling != NULL) {
+                    output.append(',');
+                    m_node = m_node->nextSibling;
+                    m_state = STATE_NODE;
+                } else {
+                    appendLiteral(output, "]}");
+                    m_node = m_openContainers.back();
+                    m_openContainers.pop_back();
+                }
+                break;
+            case STATE_LAYOUT_END:
+                writeLayoutEnd(output, m_layout.m_startPage);
+                m_state = STATE_FINISHED;
+                break;
+            case STATE_FINISHED:
+                break;
+        }
+    }
+
+    template <typename OutputType>
+    void startPage(OutputType & output, Page const * page) {
+        m_page = page;
+        if (page == NULL) {
+            m_state = STATE_LAYOUT_END;
+            return;
+        }
+        arena_layout_builder_details::writePageStart(output, page);
+        m_node = page->root;
+        m_state = STATE_NODE;
+    }
+};
+
+// The 'reset layout' packet, which is serialized chunk by chunk, while it is sent (see StreamingSender):
+// the connection's outgoing queue holds a few chunks at most, whatever the size of the layout is, and
+// the first bytes are sent before the rest of the layout is serialized.
+// The packet framing is taken from the library's serialization (see TextPacketFraming); if the library
+// changes the layout JSON, while putting it into the packet (for example, writes its length), the whole
+// packet is serialized at once.
+class LayoutResetStream : public tau_additional::communications_handling::OutgoingDataSource
+{
+    StreamingLayoutWriter m_writer;
+    ArenaLayoutBuilder const & m_layout;
+    size_t m_chunkSize;
+    std::string m_packetStart;
+    std::string m_packetEnd;
+    bool m_framingKnown;
+    bool m_started;
+    bool m_finished;
+public:
+    static const size_t DEFAULT_CHUNK_SIZE = 16 * 1024;
+
+    explicit LayoutResetStream(ArenaLayoutBuilder const & layout, size_t chunkSize = DEFAULT_CHUNK_SIZE):
+        m_writer(layout),
+        m_layout(layout),
+        m_chunkSize(chunkSize ? chunkSize : DEFAULT_CHUNK_SIZE),
+        m_framingKnown(false),
+        m_started(false),
+        m_finished(false)
+    {
+        using tau_additional::communications_handling::splitTextPacket;
+        // The markers are not valid JSON, so they can't be confused with the framing
+        std::string const firstMarker("\x01#layout#\x01");
+        std::string const secondMarker("\x01#the second layout#\x01");
+        tau_additional::communications_handling::PacketSerializer serializer;
+        tau_additional::communications_handling::TextPacketFraming first;
+        tau_additional::communications_handling::TextPacketFraming second;
+        m_framingKnown = splitTextPacket(serializer.resetLayout(firstMarker), firstMarker, NULL, first)
+            && splitTextPacket(serializer.resetLayout(secondMarker), secondMarker, NULL, second)
+            && tau_additional::communications_handling::isSameFraming(first, second);
+        if (m_framingKnown) {
+            m_packetStart.swap(first.prefix);
+            m_packetEnd.swap(first.suffix);
+        }
+    };
+
+    virtual tau_additional::util::SharedBuffer getNextChunk() {
+        std::string chunk;
+        if (m_finished) {
+            return tau_additional::util::SharedBuffer();
+        }
+        if (!m_framingKnown) {
+            chunk = tau_additional::communications_handling::PacketSerializer().resetLayout(m_layout.getJson());
+            m_finished = true;
+            return tau_additional::util::SharedBuffer::adopt(chunk);
+        }
+        if (!m_started) {
+            chunk = m_packetStart;
+            m_started = true;
+        }
+        size_t offset = chunk.size();
+        chunk.resize((offset < m_chunkSize) ? m_chunkSize : offset + 1);
+        chunk.resize(offset + m_writer.write(&chunk[offset], chunk.size() - offset));
+        if (m_writer.isFinished()) {
+            chunk.append(m_packetEnd);
+            m_finished = true;
+        }
+        return tau_additional::util::SharedBuffer::adopt(chunk);
+    }
+};
+
+// Sends the 'reset layout' packet with the layout, which is serialized while it is sent (or at once,
+// if the generator can't stream). The layout should not be changed, until the packet is sent:
+// usually it is the layout, which is built once and kept for the server's lifetime.
+inline void sendLayoutReset(tau::communications_handling::OutgiongPacketsGenerator & generator,
+    ArenaLayoutBuilder const & layout, size_t chunkSize = LayoutResetStream::DEFAULT_CHUNK_SIZE)
+{
+    tau_additional::communications_handling::sendStream(generator, new LayoutResetStream(layout, chunkSize));
+}
+
+}
+}
+#endif
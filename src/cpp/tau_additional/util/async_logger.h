@@ -0,0 +1,465 @@
+// This source file is part of the 'tau' open source project.
+// Copyright (c) 2016, Yuriy Vosel.
+// Licensed under Boost Software License.
+// See LICENSE.txt for the licence information.
+
+#ifndef TAU_ADDITIONAL_UTIL_ASYNC_LOGGER_H
+#define TAU_ADDITIONAL_UTIL_ASYNC_LOGGER_H
+
+#include <tau_additional/util/byte_scanner.h>
+#include <tau_additional/util/metrics.h>
+#include <tau_additional/util/mutex.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <string>
+#include <vector>
+
+// The records below this level are compiled out (their arguments are not even evaluated):
+// g++ -D TAU_ADDITIONAL_LOG_LEVEL=TAU_ADDITIONAL_LOG_LEVEL_WARNING ...
+#define TAU_ADDITIONAL_LOG_LEVEL_DEBUG 0
+#define TAU_ADDITIONAL_LOG_LEVEL_INFO 1
+#define TAU_ADDITIONAL_LOG_LEVEL_WARNING 2
+#define TAU_ADDITIONAL_LOG_LEVEL_ERROR 3
+#define TAU_ADDITIONAL_LOG_LEVEL_NONE 4
+
+#ifndef TAU_ADDITIONAL_LOG_LEVEL
+#define TAU_ADDITIONAL_LOG_LEVEL TAU_ADDITIONAL_LOG_LEVEL_INFO
+#endif
+
+namespace tau_additional {
+namespace util {
+
+enum LogLevel {
+    LOG_LEVEL_DEBUG = TAU_ADDITIONAL_LOG_LEVEL_DEBUG,
+    LOG_LEVEL_INFO = TAU_ADDITIONAL_LOG_LEVEL_INFO,
+    LOG_LEVEL_WARNING = TAU_ADDITIONAL_LOG_LEVEL_WARNING,
+    LOG_LEVEL_ERROR = TAU_ADDITIONAL_LOG_LEVEL_ERROR
+};
+
+// One log line: the message and the structured fields (logfmt style: key=value, the values
+// with spaces are quoted). Formatted into the fixed size buffer, so building the record
+// does not allocate; the too long records are truncated.
+//   LogRecord("event: buttonClick").field("connection", address).field("element", id)
+class LogRecord
+{
+public:
+    static const size_t CAPACITY = 240;
+private:
+    char m_text[CAPACITY];
+    size_t m_length;
+    bool m_truncated;
+public:
+    explicit LogRecord(char const * message): m_length(0), m_truncated(false) {
+        append(message, strlen(message));
+    };
+    explicit LogRecord(std::string const & message): m_length(0), m_truncated(false) {
+        append(message.data(), message.size());
+    };
+
+    LogRecord & field(char const * name, std::string const & value) {
+        return appendField(name, value.data(), value.size());
+    }
+    LogRecord & field(char const * name, char const * value) {
+        return appendField(name, value, strlen(value));
+    }
+    LogRecord & field(char const * name, bool value) {
+        return appendField(name, value ? "true" : "false", value ? 4 : 5);
+    }
+    LogRecord & field(char const * name, int value) {
+        return field(name, int64_t(value));
+    }
+    LogRecord & field(char const * name, unsigned value) {
+        return field(name, uint64_t(value));
+    }
+    LogRecord & field(char const * name, int64_t value) {
+        char buffer[24];
+        int length = snprintf(buffer, sizeof(buffer), "%lld", (long long)value);
+        return appendField(name, buffer, size_t(length));
+    }
+    LogRecord & field(char const * name, uint64_t value) {
+        char buffer[24];
+        int length = snprintf(buffer, sizeof(buffer), "%llu", (unsigned long long)value);
+        return appendField(name, buffer, size_t(length));
+    }
+
+    char const * getText() const {
+        return m_text;
+    }
+    size_t getLength() const {
+        return m_length;
+    }
+    bool isTruncated() const {
+        return m_truncated;
+    }
+private:
+    LogRecord & appendField(char const * name, char const * value, size_t valueLength) {
+        append(" ", 1);
+        append(name, strlen(name));
+        append("=", 1);
+        static ByteSet const QUOTED = ByteSet(' ').add('"').add('=').add('\n');
+        static ByteSet const ESCAPED = ByteSet('"').add('\\').add('\n');
+        bool needQuotes = (valueLength == 0) || (findFirstOf(value, valueLength, QUOTED) != valueLength);
+        if (!needQuotes) {
+            append(value, valueLength);
+            return *this;
+        }
+        append("\"", 1);
+        for (size_t i = 0; i < valueLength; ++i) {
+            size_t runLength = findFirstOf(value + i, valueLength - i, ESCAPED);
+            append(value + i, runLength);
+            i += runLength;
+            if (i == valueLength) {
+                break;
+            }
+            if (value[i] == '"' || value[i] == '\\') {
+                append("\\", 1);
+                append(value + i, 1);
+            } else if (value[i] == '\n') {
+                append("\\n", 2);
+            } else {
+                append(value + i, 1);
+            }
+        }
+        append("\"", 1);
+        return *this;
+    }
+
+    void append(char const * data, size_t size) {
+        size_t available = CAPACITY - m_length;
+        if (size > available) {
+            size = available;
+            m_truncated = true;
+        }
+        memcpy(m_text + m_length, data, size);
+        m_length += size;
+    }
+};
+
+namespace async_logger_details {
+    struct LogSlot
+    {
+        timespec time;
+        LogLevel level;
+        size_t length;
+        bool truncated;
+        char text[LogRecord::CAPACITY];
+    };
+
+    // Single producer (the owner thread) / single consumer (the drain thread) ring.
+    // The producer only moves m_head, the consumer only moves m_tail, so no locks are needed.
+    class ThreadLogBuffer
+    {
+    public:
+        static const size_t SLOTS_COUNT = 1024;
+    private:
+        LogSlot m_slots[SLOTS_COUNT];
+        volatile uint64_t m_head;
+        volatile uint64_t m_tail;
+        volatile bool m_threadFinished;
+        unsigned m_threadIndex;
+    public:
+        explicit ThreadLogBuffer(unsigned threadIndex):
+            m_head(0), m_tail(0), m_threadFinished(false), m_threadIndex(threadIndex)
+        {};
+
+        // Returns false, if the ring is full (the record is dropped).
+        bool push(LogLevel level, LogRecord const & record) {
+            uint64_t head = m_head;
+            if (head - m_tail >= SLOTS_COUNT) {
+                return false;
+            }
+            LogSlot & slot = m_slots[head % SLOTS_COUNT];
+            clock_gettime(CLOCK_REALTIME, &slot.time);
+            slot.level = level;
+            slot.length = record.getLength();
+            slot.truncated = record.isTruncated();
+            memcpy(slot.text, record.getText(), record.getLength());
+            __sync_synchronize(); // the slot is filled before it is published
+            m_head = head + 1;
+            return true;
+        }
+
+        // Returns NULL, if there is nothing to read. The slot stays valid till pop().
+        LogSlot const * front() const {
+            if (m_tail == m_head) {
+                return NULL;
+            }
+            __sync_synchronize(); // the slot is read after the head, which published it
+            return &m_slots[m_tail % SLOTS_COUNT];
+        }
+        void pop() {
+            __sync_synchronize(); // the slot is read before it is given back to the producer
+            m_tail = m_tail + 1;
+        }
+
+        unsigned getThreadIndex() const {
+            return m_threadIndex;
+        }
+        void markThreadFinished() {
+            m_threadFinished = true;
+        }
+        bool canBeDeleted() const {
+            return m_threadFinished && (m_tail == m_head);
+        }
+    };
+
+    inline char const * getLevelName(LogLevel level) {
+        switch (level) {
+        case LOG_LEVEL_DEBUG: return "DEBUG";
+        case LOG_LEVEL_INFO: return "INFO";
+        case LOG_LEVEL_WARNING: return "WARNING";
+        default: return "ERROR";
+        }
+    }
+};
+
+// Logger, which never blocks the thread, that writes the records: every thread gets its own
+// lock-free ring, the records are formatted and written out (stdout by default) by the
+// background drain thread. When the ring is full (the output can't keep up), the records are
+// dropped and counted; the drain thread reports the number of the dropped records in the log
+// and in the 'log.records_dropped' metric.
+// The only lock on the writer's side is taken once per thread, when it writes its first record.
+//
+// Use the macros, so the levels below TAU_ADDITIONAL_LOG_LEVEL are compiled out:
+//   TAU_ADDITIONAL_LOG_INFO(LogRecord("event: buttonClick").field("element", id));
+class AsyncLogger
+{
+    typedef async_logger_details::ThreadLogBuffer ThreadLogBuffer;
+
+    static const size_t OUTPUT_BUFFER_SIZE = 64 * 1024;
+    static const long IDLE_SLEEP_NANOSECONDS = 1000000;
+
+    Mutex m_mutex;
+    std::vector<ThreadLogBuffer *> m_buffers;
+    unsigned m_lastThreadIndex;
+    pthread_key_t m_bufferKey;
+    pthread_t m_drainThread;
+    volatile int m_outputHandle;
+    volatile uint64_t m_droppedRecords;
+    volatile uint64_t m_finishedDrainPasses;
+    uint64_t m_reportedDroppedRecords;
+    MetricsCounter & m_droppedRecordsMetric;
+
+    AsyncLogger():
+        m_lastThreadIndex(0),
+        m_outputHandle(STDOUT_FILENO),
+        m_droppedRecords(0),
+        m_finishedDrainPasses(0),
+        m_reportedDroppedRecords(0),
+        m_droppedRecordsMetric(MetricsRegistry::getInstance().getCounter("log.records_dropped"))
+    {
+        pthread_key_create(&m_bufferKey, &AsyncLogger::onThreadFinished);
+        pthread_create(&m_drainThread, NULL, &AsyncLogger::drainThreadFunction, this);
+    };
+    AsyncLogger(AsyncLogger const &);
+    AsyncLogger & operator = (AsyncLogger const &);
+public:
+    // Never deleted: the drain thread keeps running till the process exit.
+    static AsyncLogger & getInstance() {
+        static AsyncLogger * instance = new AsyncLogger();
+        return *instance;
+    }
+
+    void write(LogLevel level, LogRecord const & record) {
+        if (!getThreadBuffer().push(level, record)) {
+            __sync_fetch_and_add(&m_droppedRecords, uint64_t(1));
+            m_droppedRecordsMetric.increment();
+        }
+    }
+
+    // The file handle is not closed by the logger.
+    void setOutputHandle(int handle) {
+        m_outputHandle = handle;
+    }
+
+    // Waits (up to the timeout) until the records, which were written before the call,
+    // are written out. Call it before the process exits.
+    bool flush(unsigned timeoutMilliseconds = 1000) {
+        unsigned waited = 0;
+        while (!areAllBuffersEmpty()) {
+            if (waited++ >= timeoutMilliseconds) {
+                return false;
+            }
+            sleepNanoseconds(IDLE_SLEEP_NANOSECONDS);
+        }
+        // The drain pass, which has taken the last records, writes them out before it ends
+        uint64_t passToWaitFor = m_finishedDrainPasses + 1;
+        while (m_finishedDrainPasses < passToWaitFor) {
+            if (waited++ >= timeoutMilliseconds) {
+                return false;
+            }
+            sleepNanoseconds(IDLE_SLEEP_NANOSECONDS);
+        }
+        return true;
+    }
+
+    uint64_t getDroppedRecordsCount() const {
+        return m_droppedRecords;
+    }
+private:
+    bool areAllBuffersEmpty() {
+        ScopedLock lock(m_mutex);
+        for (size_t i = 0; i < m_buffers.size(); ++i) {
+            if (m_buffers[i]->front() != NULL) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    ThreadLogBuffer & getThreadBuffer() {
+        ThreadLogBuffer * result = static_cast<ThreadLogBuffer *>(pthread_getspecific(m_bufferKey));
+        if (result == NULL) {
+            ScopedLock lock(m_mutex);
+            result = new ThreadLogBuffer(++m_lastThreadIndex);
+            m_buffers.push_back(result);
+            pthread_setspecific(m_bufferKey, result);
+        }
+        return *result;
+    }
+
+    // The buffer of the finished thread is deleted by the drain thread, when it is empty.
+    static void onThreadFinished(void * buffer) {
+        static_cast<ThreadLogBuffer *>(buffer)->markThreadFinished();
+    }
+
+    static void * drainThreadFunction(void * parameter) {
+        static_cast<AsyncLogger *>(parameter)->drain();
+        return NULL;
+    }
+
+    static void sleepNanoseconds(long nanoseconds) {
+        timespec duration;
+        duration.tv_sec = 0;
+        duration.tv_nsec = nanoseconds;
+        nanosleep(&duration, NULL);
+    }
+
+    void drain() {
+        std::vector<ThreadLogBuffer *> buffers;
+        std::vector<char> output;
+        output.reserve(OUTPUT_BUFFER_SIZE);
+        while (true) {
+            {
+                // The writers take this lock only to register, so it is held very briefly
+                ScopedLock lock(m_mutex);
+                deleteFinishedThreadsBuffers();
+                buffers = m_buffers;
+            }
+            bool anythingWritten = false;
+            for (size_t i = 0; i < buffers.size(); ++i) {
+                async_logger_details::LogSlot const * slot;
+                while ((slot = buffers[i]->front()) != NULL) {
+                    formatSlot(*slot, buffers[i]->getThreadIndex(), output);
+                    buffers[i]->pop();
+                    anythingWritten = true;
+                    if (output.size() + LogRecord::CAPACITY * 2 > OUTPUT_BUFFER_SIZE) {
+                        writeOutput(output);
+                    }
+                }
+            }
+            reportDroppedRecords(output);
+            writeOutput(output);
+            __sync_fetch_and_add(&m_finishedDrainPasses, uint64_t(1));
+            if (!anythingWritten) {
+                sleepNanoseconds(IDLE_SLEEP_NANOSECONDS);
+            }
+        }
+    }
+
+    void deleteFinishedThreadsBuffers() {
+        size_t kept = 0;
+        for (size_t i = 0; i < m_buffers.size(); ++i) {
+            if (m_buffers[i]->canBeDeleted()) {
+                delete m_buffers[i];
+            } else {
+                m_buffers[kept++] = m_buffers[i];
+            }
+        }
+        m_buffers.resize(kept);
+    }
+
+    // <local time> <level> [t<thread>] <message> <fields>
+    static void formatSlot(async_logger_details::LogSlot const & slot, unsigned threadIndex,
+        std::vector<char> & output)
+    {
+        tm localTime;
+        time_t seconds = slot.time.tv_sec;
+        localtime_r(&seconds, &localTime);
+        char prefix[64];
+        int prefixLength = snprintf(prefix, sizeof(prefix), "%04d-%02d-%02d %02d:%02d:%02d.%06ld %s [t%u] ",
+            localTime.tm_year + 1900, localTime.tm_mon + 1, localTime.tm_mday,
+            localTime.tm_hour, localTime.tm_min, localTime.tm_sec, long(slot.time.tv_nsec / 1000),
+            async_logger_details::getLevelName(slot.level), threadIndex);
+        output.insert(output.end(), prefix, prefix + prefixLength);
+        output.insert(output.end(), slot.text, slot.text + slot.length);
+        if (slot.truncated) {
+            output.insert(output.end(), "...", "..." + 3);
+        }
+        output.push_back('\n');
+    }
+
+    void reportDroppedRecords(std::vector<char> & output) {
+        uint64_t dropped = m_droppedRecords;
+        if (dropped == m_reportedDroppedRecords) {
+            return;
+        }
+        char message[96];
+        int length = snprintf(message, sizeof(message), "WARNING log records dropped: %llu\n",
+            (unsigned long long)(dropped - m_reportedDroppedRecords));
+        output.insert(output.end(), message, message + length);
+        m_reportedDroppedRecords = dropped;
+    }
+
+    void writeOutput(std::vector<char> & output) {
+        size_t written = 0;
+        while (written < output.size()) {
+            ssize_t result = ::write(m_outputHandle, &output[written], output.size() - written);
+            if (result == -1 && errno == EINTR) {
+                continue;
+            }
+            if (result <= 0) {
+                break; // nowhere to write, the records are lost
+            }
+            written += size_t(result);
+        }
+        output.clear();
+    }
+};
+
+}
+}
+
+#define TAU_ADDITIONAL_LOG_WITH_LEVEL(level, record) \
+    tau_additional::util::AsyncLogger::getInstance().write(level, record)
+
+#if TAU_ADDITIONAL_LOG_LEVEL <= TAU_ADDITIONAL_LOG_LEVEL_DEBUG
+#define TAU_ADDITIONAL_LOG_DEBUG(record) TAU_ADDITIONAL_LOG_WITH_LEVEL(tau_additional::util::LOG_LEVEL_DEBUG, record)
+#else
+#define TAU_ADDITIONAL_LOG_DEBUG(record) ((void)0)
+#endif
+
+#if TAU_ADDITIONAL_LOG_LEVEL <= TAU_ADDITIONAL_LOG_LEVEL_INFO
+#define TAU_ADDITIONAL_LOG_INFO(record) TAU_ADDITIONAL_LOG_WITH_LEVEL(tau_additional::util::LOG_LEVEL_INFO, record)
+#else
+#define TAU_ADDITIONAL_LOG_INFO(record) ((void)0)
+#endif
+
+#if TAU_ADDITIONAL_LOG_LEVEL <= TAU_ADDITIONAL_LOG_LEVEL_WARNING
+#define TAU_ADDITIONAL_LOG_WARNING(record) TAU_ADDITIONAL_LOG_WITH_LEVEL(tau_additional::util::LOG_LEVEL_WARNING, record)
+#else
+#define TAU_ADDITIONAL_LOG_WARNING(record) ((void)0)
+#endif
+
+#if TAU_ADDITIONAL_LOG_LEVEL <= TAU_ADDITIONAL_LOG_LEVEL_ERROR
+#define TAU_ADDITIONAL_LOG_ERROR(record) TAU_ADDITIONAL_LOG_WITH_LEVEL(tau_additional::util::LOG_LEVEL_ERROR, record)
+#else
+#define TAU_ADDITIONAL_LOG_ERROR(record) ((void)0)
+#endif
+
+#endif
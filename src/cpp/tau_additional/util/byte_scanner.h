@@ -0,0 +1,178 @@
+// This source file is part of the 'tau' open source project.
+// Copyright (c) 2016, Yuriy Vosel.
+// Licensed under Boost Software License.
+// See LICENSE.txt for the licence information.
+
+#ifndef TAU_ADDITIONAL_UTIL_BYTE_SCANNER_H
+#define TAU_ADDITIONAL_UTIL_BYTE_SCANNER_H
+
+#include <stddef.h>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__SSE2__) && defined(__GNUC__)
+#define TAU_ADDITIONAL_BYTE_SCANNER_X86
+#include <immintrin.h>
+#endif
+
+namespace tau_additional {
+namespace util {
+
+// The bytes to look for: up to 4 bytes and, optionally, all the control characters (below 0x20).
+class ByteSet
+{
+public:
+    static const size_t MAX_BYTES = 4;
+private:
+    unsigned char m_bytes[MAX_BYTES];
+    size_t m_count;
+    bool m_controlCharacters;
+public:
+    explicit ByteSet(char first): m_count(1), m_controlCharacters(false) {
+        for (size_t i = 0; i < MAX_BYTES; ++i) {
+            m_bytes[i] = static_cast<unsigned char>(first); // the unused slots repeat the first byte
+        }
+    };
+    // The bytes above MAX_BYTES are ignored
+    ByteSet & add(char value) {
+        if (m_count < MAX_BYTES) {
+            m_bytes[m_count++] = static_cast<unsigned char>(value);
+        }
+        return *this;
+    }
+    ByteSet & addControlCharacters() {
+        m_controlCharacters = true;
+        return *this;
+    }
+
+    bool contains(unsigned char value) const {
+        return (m_controlCharacters && value < 0x20) || value == m_bytes[0] || value == m_bytes[1]
+            || value == m_bytes[2] || value == m_bytes[3];
+    }
+    unsigned char getByte(size_t index) const {
+        return m_bytes[index];
+    }
+    bool hasControlCharacters() const {
+        return m_controlCharacters;
+    }
+};
+
+enum ByteScannerImplementation
+{
+    BYTE_SCANNER_SCALAR,
+    BYTE_SCANNER_SSE2,
+    BYTE_SCANNER_AVX2
+};
+
+namespace byte_scanner_details {
+    inline size_t findScalar(unsigned char const * data, size_t size, ByteSet const & set) {
+        for (size_t i = 0; i < size; ++i) {
+            if (set.contains(data[i])) {
+                return i;
+            }
+        }
+        return size;
+    }
+
+#ifdef TAU_ADDITIONAL_BYTE_SCANNER_X86
+    inline size_t findSse2(unsigned char const * data, size_t size, ByteSet const & set) {
+        __m128i const byte0 = _mm_set1_epi8(char(set.getByte(0)));
+        __m128i const byte1 = _mm_set1_epi8(char(set.getByte(1)));
+        __m128i const byte2 = _mm_set1_epi8(char(set.getByte(2)));
+        __m128i const byte3 = _mm_set1_epi8(char(set.getByte(3)));
+        __m128i const maxControlCharacter = _mm_set1_epi8(0x1F);
+        bool const controlCharacters = set.hasControlCharacters();
+        size_t i = 0;
+        for (; i + 16 <= size; i += 16) {
+            __m128i chunk = _mm_loadu_si128(reinterpret_cast<__m128i const *>(data + i));
+            __m128i found = _mm_or_si128(
+                _mm_or_si128(_mm_cmpeq_epi8(chunk, byte0), _mm_cmpeq_epi8(chunk, byte1)),
+                _mm_or_si128(_mm_cmpeq_epi8(chunk, byte2), _mm_cmpeq_epi8(chunk, byte3)));
+            if (controlCharacters) {
+                // unsigned chunk <= 0x1F: the minimum is the chunk itself
+                found = _mm_or_si128(found, _mm_cmpeq_epi8(_mm_min_epu8(chunk, maxControlCharacter), chunk));
+            }
+            int mask = _mm_movemask_epi8(found);
+            if (mask != 0) {
+                return i + __builtin_ctz(unsigned(mask));
+            }
+        }
+        return i + findScalar(data + i, size - i, set);
+    }
+
+    __attribute__((target("avx2")))
+    inline size_t findAvx2(unsigned char const * data, size_t size, ByteSet const & set) {
+        __m256i const byte0 = _mm256_set1_epi8(char(set.getByte(0)));
+        __m256i const byte1 = _mm256_set1_epi8(char(set.getByte(1)));
+        __m256i const byte2 = _mm256_set1_epi8(char(set.getByte(2)));
+        __m256i const byte3 = _mm256_set1_epi8(char(set.getByte(3)));
+        __m256i const maxControlCharacter = _mm256_set1_epi8(0x1F);
+        bool const controlCharacters = set.hasControlCharacters();
+        size_t i = 0;
+        for (; i + 32 <= size; i += 32) {
+            __m256i chunk = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(data + i));
+            __m256i found = _mm256_or_si256(
+                _mm256_or_si256(_mm256_cmpeq_epi8(chunk, byte0), _mm256_cmpeq_epi8(chunk, byte1)),
+                _mm256_or_si256(_mm256_cmpeq_epi8(chunk, byte2), _mm256_cmpeq_epi8(chunk, byte3)));
+            if (controlCharacters) {
+                found = _mm256_or_si256(found,
+                    _mm256_cmpeq_epi8(_mm256_min_epu8(chunk, maxControlCharacter), chunk));
+            }
+            unsigned mask = unsigned(_mm256_movemask_epi8(found));
+            if (mask != 0) {
+                return i + __builtin_ctz(mask);
+            }
+        }
+        return i + findSse2(data + i, size - i, set);
+    }
+#endif
+
+    inline ByteScannerImplementation detectBestImplementation() {
+#ifdef TAU_ADDITIONAL_BYTE_SCANNER_X86
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx2") ? BYTE_SCANNER_AVX2 : BYTE_SCANNER_SSE2;
+#else
+        return BYTE_SCANNER_SCALAR;
+#endif
+    }
+
+    inline ByteScannerImplementation & getSelectedImplementation() {
+        static ByteScannerImplementation selected = detectBestImplementation();
+        return selected;
+    }
+};
+
+// The best implementation, which the CPU supports (chosen once, at the first use).
+inline ByteScannerImplementation getByteScannerImplementation() {
+    return byte_scanner_details::getSelectedImplementation();
+}
+
+// Forces the implementation (for the benchmarks and the comparison of the results).
+// Returns false (and changes nothing) if the CPU or the build does not support it.
+// Should be called before the scanning starts in the other threads.
+inline bool setByteScannerImplementation(ByteScannerImplementation implementation) {
+    if (implementation > byte_scanner_details::detectBestImplementation()) {
+        return false;
+    }
+    byte_scanner_details::getSelectedImplementation() = implementation;
+    return true;
+}
+
+// Returns the position of the first byte from the set, or the size, if there is none.
+// Scans 32 (AVX2) or 16 (SSE2) bytes per step on the x86 CPUs; the short runs between the delimiters
+// cost about the same, as the byte-by-byte loop, the long ones - several times less.
+inline size_t findFirstOf(char const * data, size_t size, ByteSet const & set) {
+    unsigned char const * bytes = reinterpret_cast<unsigned char const *>(data);
+    switch (byte_scanner_details::getSelectedImplementation()) {
+#ifdef TAU_ADDITIONAL_BYTE_SCANNER_X86
+        case BYTE_SCANNER_AVX2:
+            return byte_scanner_details::findAvx2(bytes, size, set);
+        case BYTE_SCANNER_SSE2:
+            return byte_scanner_details::findSse2(bytes, size, set);
+#endif
+        default:
+            return byte_scanner_details::findScalar(bytes, size, set);
+    }
+}
+
+}
+}
+#endif
@@ -0,0 +1,206 @@
+// This source file is part of the 'tau' open source project.
+// Copyright (c) 2016, Yuriy Vosel.
+// Licensed under Boost Software License.
+// See LICENSE.txt for the licence information.
+
+#ifndef TAU_ADDITIONAL_UTIL_COALESCING_EVENTS_DISPATCHER_H
+#define TAU_ADDITIONAL_UTIL_COALESCING_EVENTS_DISPATCHER_H
+
+#include <tau/util/basic_events_dispatcher.h>
+#include <tau_additional/common/id_string.h>
+#include <tau_additional/communications_handling/delayed_calls_scheduler.h>
+#include <tau_additional/util/monotonic_clock.h>
+#include <tau_additional/util/unordered_map.h>
+#include <stdint.h>
+#include <string>
+
+namespace tau_additional {
+namespace util {
+
+// Rate limiting stage in front of the events dispatcher. The automatic value updates
+// (is_automatic_update == true, which the clients send while the user is typing) are
+// delivered to the EventsDispatcherType at most once per WINDOW_MILLISECONDS for every element:
+// the first update is delivered immediately, the ones, which arrive during the window,
+// replace each other and only the latest one is delivered at the end of the window.
+// The explicit (not automatic) updates are delivered immediately and cancel the pending ones.
+//
+// Usage: EpollServer<CoalescingEventsDispatcher<MyEventsDispatcher> > server(port);
+// The connection should support the delayed calls (EpollServer, PooledBoostAsioServer);
+// otherwise every update is delivered immediately.
+template <typename EventsDispatcherType, unsigned WINDOW_MILLISECONDS = 50>
+class CoalescingEventsDispatcher : public EventsDispatcherType
+{
+public:
+    struct Statistics
+    {
+        Statistics(): updatesReceived(0), updatesDelivered(0) {};
+        uint64_t updatesReceived;
+        uint64_t updatesDelivered;
+
+        uint64_t getUpdatesCoalesced() const {
+            return updatesReceived - updatesDelivered;
+        }
+    };
+private:
+    static const uint64_t WINDOW_NANOSECONDS = uint64_t(WINDOW_MILLISECONDS) * 1000000;
+
+    struct ElementState
+    {
+        ElementState(): windowEnd(0), textValuePending(false), boolValuePending(false), boolValue(false) {};
+        uint64_t windowEnd;
+        bool textValuePending;
+        bool boolValuePending;
+        bool boolValue;
+        std::string textValue;
+    };
+    typedef typename UnorderedMap<std::string, ElementState>::type ElementStates;
+
+    class DeliveryCallback : public tau_additional::communications_handling::DelayedCallsScheduler::Callback
+    {
+        CoalescingEventsDispatcher & m_owner;
+    public:
+        explicit DeliveryCallback(CoalescingEventsDispatcher & owner): m_owner(owner) {};
+        virtual void onDelayedCall() {
+            m_owner.deliverDueUpdates();
+        }
+    };
+
+    tau::communications_handling::OutgiongPacketsGenerator & m_outgoingGenerator;
+    ElementStates m_elementStates;
+    DeliveryCallback m_deliveryCallback;
+    uint64_t m_scheduledDelivery; // 0 - not scheduled
+    Statistics m_statistics;
+public:
+    CoalescingEventsDispatcher(
+        tau::communications_handling::OutgiongPacketsGenerator & outgoingGeneratorToUse):
+            EventsDispatcherType(outgoingGeneratorToUse),
+            m_outgoingGenerator(outgoingGeneratorToUse),
+            m_deliveryCallback(*this),
+            m_scheduledDelivery(0)
+        {};
+
+    virtual void packetReceived_boolValueUpdate(
+        tau::common::ElementID const & inputBoxID,
+        bool new_value, bool is_automatic_update)
+    {
+        ++m_statistics.updatesReceived;
+        ElementState * state = getStateToCoalesce(inputBoxID, is_automatic_update);
+        if (state != NULL) {
+            state->boolValuePending = true;
+            state->boolValue = new_value;
+            return;
+        }
+        deliverBoolValueUpdate(inputBoxID, new_value, is_automatic_update);
+    }
+
+    virtual void packetReceived_textValueUpdate(
+        tau::common::ElementID const & inputBoxID,
+        std::string const & new_value, bool is_automatic_update)
+    {
+        ++m_statistics.updatesReceived;
+        ElementState * state = getStateToCoalesce(inputBoxID, is_automatic_update);
+        if (state != NULL) {
+            state->textValuePending = true;
+            state->textValue = new_value;
+            return;
+        }
+        deliverTextValueUpdate(inputBoxID, new_value, is_automatic_update);
+    }
+
+    Statistics const & getCoalescingStatistics() const {
+        return m_statistics;
+    }
+private:
+    // Returns the element state, if the update should wait till the end of the window.
+    // Otherwise (the update is going to be delivered now) starts the new window.
+    ElementState * getStateToCoalesce(tau::common::ElementID const & inputBoxID, bool is_automatic_update) {
+        tau_additional::communications_handling::DelayedCallsScheduler * scheduler =
+            tau_additional::communications_handling::getDelayedCallsScheduler(m_outgoingGenerator);
+        if (scheduler == NULL) {
+            return NULL;
+        }
+        uint64_t now = getMonotonicNanoseconds();
+        ElementState & state = m_elementStates[tau_additional::common::getIdString(inputBoxID)];
+        if (is_automatic_update && now < state.windowEnd) {
+            return &state;
+        }
+        state.textValuePending = false;
+        state.boolValuePending = false;
+        state.windowEnd = now + WINDOW_NANOSECONDS;
+        scheduleDelivery(*scheduler, state.windowEnd, now);
+        return NULL;
+    }
+
+    void scheduleDelivery(tau_additional::communications_handling::DelayedCallsScheduler & scheduler,
+        uint64_t deadline, uint64_t now)
+    {
+        if (m_scheduledDelivery != 0 && m_scheduledDelivery <= deadline) {
+            return;
+        }
+        m_scheduledDelivery = deadline;
+        scheduler.scheduleDelayedCall(m_deliveryCallback, (deadline > now) ? (deadline - now) : 0);
+    }
+
+    // Delivers the pending updates of the elements, whose windows are over.
+    // The states of the idle elements are removed, so the map does not grow.
+    void deliverDueUpdates() {
+        m_scheduledDelivery = 0;
+        uint64_t now = getMonotonicNanoseconds();
+        uint64_t nextDeadline = 0;
+        typename ElementStates::iterator it = m_elementStates.begin();
+        while (it != m_elementStates.end()) {
+            ElementState & state = it->second;
+            if (now < state.windowEnd) {
+                if (nextDeadline == 0 || state.windowEnd < nextDeadline) {
+                    nextDeadline = state.windowEnd;
+                }
+                ++it;
+                continue;
+            }
+            if (!state.textValuePending && !state.boolValuePending) {
+                it = m_elementStates.erase(it);
+                continue;
+            }
+            // The delivered update starts the new window
+            state.windowEnd = now + WINDOW_NANOSECONDS;
+            if (nextDeadline == 0 || state.windowEnd < nextDeadline) {
+                nextDeadline = state.windowEnd;
+            }
+            tau::common::ElementID inputBoxID(it->first);
+            if (state.boolValuePending) {
+                state.boolValuePending = false;
+                deliverBoolValueUpdate(inputBoxID, state.boolValue, true);
+            }
+            if (state.textValuePending) {
+                state.textValuePending = false;
+                std::string value;
+                value.swap(state.textValue);
+                deliverTextValueUpdate(inputBoxID, value, true);
+            }
+            ++it;
+        }
+        tau_additional::communications_handling::DelayedCallsScheduler * scheduler =
+            tau_additional::communications_handling::getDelayedCallsScheduler(m_outgoingGenerator);
+        if (nextDeadline != 0 && scheduler != NULL) {
+            scheduleDelivery(*scheduler, nextDeadline, now);
+        }
+    }
+
+    void deliverBoolValueUpdate(tau::common::ElementID const & inputBoxID, bool new_value, bool is_automatic_update) {
+        ++m_statistics.updatesDelivered;
+        EventsDispatcherType::packetReceived_boolValueUpdate(inputBoxID, new_value, is_automatic_update);
+    }
+
+    void deliverTextValueUpdate(tau::common::ElementID const & inputBoxID,
+        std::string const & new_value, bool is_automatic_update) {
+        ++m_statistics.updatesDelivered;
+        EventsDispatcherType::packetReceived_textValueUpdate(inputBoxID, new_value, is_automatic_update);
+    }
+};
+
+template <typename EventsDispatcherType, unsigned WINDOW_MILLISECONDS>
+const uint64_t CoalescingEventsDispatcher<EventsDispatcherType, WINDOW_MILLISECONDS>::WINDOW_NANOSECONDS;
+
+}
+}
+#endif
@@ -0,0 +1,721 @@
+// This source file is part of the 'tau' open source project.
+// Copyright (c) 2016, Yuriy Vosel.
+// Licensed under Boost Software License.
+// See LICENSE.txt for the licence information.
+
+#ifndef TAU_ADDITIONAL_UTIL_EPOLL_SERVER_H
+#define TAU_ADDITIONAL_UTIL_EPOLL_SERVER_H
+
+#include <tau_additional/communications_handling/binary_encoding.h>
+#include <tau_additional/communications_handling/buffered_outgoing_packets_generator.h>
+#include <tau_additional/communications_handling/delayed_calls_scheduler.h>
+#include <tau_additional/communications_handling/raw_incoming_data_stream_parser.h>
+#include <tau_additional/communications_handling/stream_compression.h>
+#include <tau_additional/communications_handling/traffic_capture.h>
+#include <tau_additional/util/monotonic_clock.h>
+#include <tau_additional/util/timing_wheel.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <string.h>
+#include <limits.h>
+#include <string>
+#include <vector>
+
+namespace tau_additional {
+namespace util {
+
+namespace epoll_server_details {
+    inline std::string getAddrString(sockaddr_in const & toConvert) {
+        char buf[INET_ADDRSTRLEN];
+        char const * result = inet_ntop(AF_INET, &(toConvert.sin_addr), buf, INET_ADDRSTRLEN);
+        return (result != NULL) ? std::string(result) : std::string();
+    }
+
+    inline bool setNonBlocking(int handle) {
+        int flags = fcntl(handle, F_GETFL, 0);
+        return (flags != -1) && (fcntl(handle, F_SETFL, flags | O_NONBLOCK) != -1);
+    }
+};
+
+struct EpollServerSettings
+{
+    EpollServerSettings():
+        receiveBufferSize(64 * 1024),
+        outgoingHighWaterMark(
+            tau_additional::communications_handling::BufferedOutgoingPacketsGenerator::DEFAULT_HIGH_WATER_MARK),
+        maxEventsPerWait(256),
+        reusePort(false),
+        compressionEnabled(false),
+        compressionThreshold(tau_additional::communications_handling::StreamCompressor::DEFAULT_THRESHOLD),
+        compressionLevel(Z_DEFAULT_COMPRESSION),
+        trafficCapture(NULL)
+    {};
+    // The receive buffer is shared by all the connections (they are served by one thread),
+    // so it can be made big enough to drain the socket with a few recv() calls.
+    size_t receiveBufferSize;
+    // When this much data is queued for the client, the server stops reading its requests
+    // until the queue is written out.
+    size_t outgoingHighWaterMark;
+    int maxEventsPerWait;
+    // SO_REUSEPORT on the listening socket: several servers (for example, the shards of the ShardedServer)
+    // listen on the same port, and the kernel spreads the new connections between them.
+    bool reusePort;
+    // The clients, which ask for the compression, get it (see startCompressionIfNegotiated()).
+    // The packets, smaller than the threshold, are sent as is. Every such connection costs
+    // about 256 KB of memory for the compression context.
+    // The compressed data is accepted only from the clients, which have got the compressed stream:
+    // the data of the other clients is parsed as is.
+    bool compressionEnabled;
+    size_t compressionThreshold;
+    int compressionLevel;
+    // The traffic of all the connections is written into the capture (if it is not NULL and is open),
+    // for the replay (see TrafficReplayer). The capture is owned by the caller and should outlive the server.
+    tau_additional::communications_handling::TrafficCapture * trafficCapture;
+};
+
+// The outgoing packets generator of the server's connection: queues the packets (they are written
+// by the server's event loop, see BufferedOutgoingPacketsGenerator), schedules the delayed calls of
+// the connection on the server's TimingWheel, and compresses the stream and converts the packets to
+// the binary encoding, if the client asks for it.
+// When the first packet is queued, the connection is put into the server's flush queue.
+template <typename ConnectionType>
+class ServerConnectionWriter :
+    public tau_additional::communications_handling::BufferedOutgoingPacketsGenerator,
+    public tau_additional::communications_handling::DelayedCallsScheduler,
+    public tau_additional::communications_handling::CompressionSwitch,
+    public tau_additional::communications_handling::BinaryEncodingSwitch
+{
+    typedef tau_additional::communications_handling::BufferedOutgoingPacketsGenerator BufferedGenerator;
+
+    std::vector<ConnectionType *> & m_flushQueue;
+    TimingWheelCallsScheduler m_delayedCalls;
+    ConnectionType * m_connection;
+    EpollServerSettings const & m_settings;
+    tau_additional::communications_handling::StreamCompressor * m_compressor; // NULL - not compressed
+    tau_additional::communications_handling::TextPacketsTranscoder * m_transcoder; // NULL - the text packets
+    uint64_t m_captureID; // 0 - the traffic is not captured
+public:
+    ServerConnectionWriter(int output_socket_handle, EpollServerSettings const & settings,
+        std::vector<ConnectionType *> & flushQueue, TimingWheel & timingWheel, ConnectionType * connection):
+        BufferedGenerator(output_socket_handle, settings.outgoingHighWaterMark),
+        m_flushQueue(flushQueue),
+        m_delayedCalls(timingWheel),
+        m_connection(connection),
+        m_settings(settings),
+        m_compressor(NULL),
+        m_transcoder(NULL),
+        m_captureID(0)
+    {
+        if (settings.trafficCapture != NULL && settings.trafficCapture->isOpen()) {
+            m_captureID = settings.trafficCapture->connectionOpened();
+        }
+    };
+    ~ServerConnectionWriter() {
+        captureClosed();
+        delete m_compressor;
+        delete m_transcoder;
+    }
+
+    virtual void sendData(std::string const & data) {
+        if (isSendingDeferred() && !data.empty()) {
+            deferSending(tau_additional::util::SharedBuffer(data)); // compressed, when it is its turn
+            return;
+        }
+        if (m_captureID != 0) {
+            m_settings.trafficCapture->outgoingData(m_captureID, data.data(), data.size());
+        }
+        if (m_transcoder != NULL) {
+            sendBinary(data.data(), data.size());
+        } else if (m_compressor == NULL) {
+            BufferedGenerator::sendData(data);
+        } else {
+            sendCompressed(data.data(), data.size());
+        }
+    }
+    virtual void sendSharedBuffer(tau_additional::util::SharedBuffer const & data) {
+        if (isSendingDeferred() && !data.empty()) {
+            deferSending(data);
+            return;
+        }
+        if (m_captureID != 0) {
+            m_settings.trafficCapture->outgoingData(m_captureID, data.data(), data.size());
+        }
+        if (m_transcoder != NULL) {
+            sendBinary(data.data(), data.size());
+        } else if (m_compressor == NULL) {
+            BufferedGenerator::sendSharedBuffer(data);
+        } else {
+            sendCompressed(data.data(), data.size());
+        }
+    }
+
+    virtual bool startCompression() {
+        if (m_compressor != NULL) {
+            return true;
+        }
+        if (!m_settings.compressionEnabled || isWriteFailed() || isStreaming()) {
+            return false; // can't be switched in the middle of the stream
+        }
+        m_compressor = new tau_additional::communications_handling::StreamCompressor(
+            m_settings.compressionThreshold, m_settings.compressionLevel);
+        if (!m_compressor->isValid()) {
+            delete m_compressor;
+            m_compressor = NULL;
+            return false;
+        }
+        std::string header;
+        m_compressor->appendStreamHeader(header);
+        BufferedGenerator::sendSharedBuffer(tau_additional::util::SharedBuffer::adopt(header));
+        return true;
+    }
+    // NULL if the stream is not compressed
+    tau_additional::communications_handling::StreamCompressor const * getCompressor() const {
+        return m_compressor;
+    }
+
+    // The capture of the connection is ended: the replay supports the text packets only.
+    virtual bool startBinaryEncoding() {
+        if (m_transcoder != NULL) {
+            return true;
+        }
+        if (isWriteFailed() || isStreaming()) {
+            return false; // can't be switched in the middle of the stream
+        }
+        m_transcoder = new tau_additional::communications_handling::TextPacketsTranscoder();
+        if (!m_transcoder->isValid()) {
+            delete m_transcoder;
+            m_transcoder = NULL;
+            return false;
+        }
+        captureClosed();
+        return true;
+    }
+    // NULL if the connection uses the text packets. The server parses the client's data with
+    // the transcoder's dictionary (see BinaryPacketParser).
+    tau_additional::communications_handling::TextPacketsTranscoder const * getTranscoder() const {
+        return m_transcoder;
+    }
+
+    // The server passes the incoming data (decompressed) here, before it is parsed
+    void captureIncomingData(char const * data, size_t size) {
+        if (m_captureID != 0) {
+            m_settings.trafficCapture->incomingData(m_captureID, data, size);
+        }
+    }
+    void captureClosed() {
+        if (m_captureID != 0) {
+            m_settings.trafficCapture->connectionClosed(m_captureID);
+            m_captureID = 0;
+        }
+    }
+
+    virtual void scheduleDelayedCall(Callback & callback, uint64_t delayNanoseconds) {
+        if (isWriteFailed()) {
+            return; // the connection is closed
+        }
+        m_delayedCalls.scheduleDelayedCall(callback, delayNanoseconds);
+    }
+    virtual void cancelDelayedCall(Callback & callback) {
+        m_delayedCalls.cancelDelayedCall(callback);
+    }
+    void cancelAllDelayedCalls() {
+        m_delayedCalls.cancelAllDelayedCalls();
+    }
+protected:
+    virtual void onFlushNeeded() {
+        m_flushQueue.push_back(m_connection);
+    }
+private:
+    // The packet, which the transcoder can't convert, closes the connection: the client
+    // can't parse the text packets any more.
+    void sendBinary(char const * data, size_t size) {
+        if (isWriteFailed() || size == 0) {
+            return;
+        }
+        std::string packets;
+        if (!m_transcoder->transcode(data, size, packets)) {
+            close_connection();
+            return;
+        }
+        if (packets.empty()) {
+            return; // the packet is incomplete yet
+        }
+        if (m_compressor == NULL) {
+            BufferedGenerator::sendSharedBuffer(tau_additional::util::SharedBuffer::adopt(packets));
+        } else {
+            sendCompressed(packets.data(), packets.size());
+        }
+    }
+
+    // Every packet is a separate frame: the shared packets are compressed for every
+    // connection, as the compression context differs.
+    void sendCompressed(char const * data, size_t size) {
+        if (isWriteFailed() || size == 0) {
+            return;
+        }
+        std::string frame;
+        m_compressor->compress(data, size, frame);
+        BufferedGenerator::sendSharedBuffer(tau_additional::util::SharedBuffer::adopt(frame));
+    }
+};
+
+// Single-threaded server, which serves any number of clients with the edge-triggered epoll loop.
+// Every accepted connection gets its own outgoing packets generator, events dispatcher and
+// incoming data stream parser. The EventsDispatcherType should be constructible from the
+// OutgiongPacketsGenerator reference (same requirement as for the tau::util::SimpleBoostAsioServer).
+// The outgoing packets are queued and written once per event loop turn.
+// The connections support the delayed calls (see DelayedCallsScheduler); the due calls are
+// executed after the socket events of the loop turn, before the queued data is written.
+// The delayed calls of all the connections share one TimingWheel (1 ms resolution),
+// so the number of the pending calls does not affect the cost of the loop turn.
+// The connections support the stream compression, if it is enabled in the settings
+// (see CompressionSwitch), and the binary encoding (see BinaryEncodingSwitch).
+template <typename EventsDispatcherType>
+class EpollServer
+{
+    struct Connection;
+    typedef ServerConnectionWriter<Connection> ConnectionWriter;
+
+    struct Connection
+    {
+        Connection(int handle, EpollServerSettings const & settings,
+            std::vector<Connection *> & flushQueue, TimingWheel & timingWheel):
+            writer(handle, settings, flushQueue, timingWheel, this),
+            dispatcher(writer),
+            writableEventsRequested(false),
+            readPaused(false),
+            closed(false),
+            previous(NULL),
+            next(NULL)
+        {};
+        ConnectionWriter writer;
+        EventsDispatcherType dispatcher;
+        tau_additional::communications_handling::RawIncomingDataStreamParser parser;
+        tau_additional::communications_handling::BinaryPacketParser binaryParser; // after the switch to the binary encoding
+        tau_additional::communications_handling::StreamDecompressor decompressor;
+        bool writableEventsRequested;
+        bool readPaused;
+        bool closed;
+        // The list of the open connections (for the server's destructor)
+        Connection * previous;
+        Connection * next;
+    };
+
+    unsigned short m_listenPort;
+    EpollServerSettings m_settings;
+    int m_listenSocketHandle;
+    int m_epollHandle;
+    int m_wakeUpHandle; // the eventfd, which stop() writes into, so epoll_wait() returns at once
+    int m_reserveHandle; // closed to accept (and drop) the connection, when the process is out of the descriptors
+    sockaddr_in m_serverAddr;
+    volatile size_t m_connectionsCount; // changed by the event loop thread, can be read from any thread
+    volatile size_t m_acceptedConnectionsCount;
+    volatile int m_stopRequested; // set from any thread
+    Connection * m_openConnections;
+    std::string m_lastError;
+    std::vector<char> m_receiveBuffer;
+    std::string m_decompressedData;
+    std::vector<Connection *> m_flushQueue;
+    std::vector<Connection *> m_closedConnections;
+    TimingWheel m_timingWheel;
+    TimingWheelCallsScheduler m_serverDelayedCalls;
+public:
+    EpollServer(unsigned short listenPort, EpollServerSettings const & settings = EpollServerSettings()):
+        m_listenPort(listenPort),
+        m_settings(settings),
+        m_listenSocketHandle(-1),
+        m_epollHandle(-1),
+        m_wakeUpHandle(-1),
+        m_reserveHandle(-1),
+        m_connectionsCount(0),
+        m_acceptedConnectionsCount(0),
+        m_stopRequested(0),
+        m_openConnections(NULL),
+        m_receiveBuffer(settings.receiveBufferSize > 0 ? settings.receiveBufferSize : 64 * 1024),
+        m_serverDelayedCalls(m_timingWheel)
+    {
+        if (m_settings.maxEventsPerWait <= 0) {
+            m_settings.maxEventsPerWait = 256;
+        }
+    };
+
+    // Should not be called while run() is running. The open connections are closed
+    // (their dispatchers get onConnectionClosed()).
+    ~EpollServer() {
+        while (m_openConnections != NULL) {
+            closeConnection(m_openConnections);
+        }
+        deleteClosedConnections();
+        if (m_epollHandle != -1) {
+            close(m_epollHandle);
+        }
+        if (m_wakeUpHandle != -1) {
+            close(m_wakeUpHandle);
+        }
+        if (m_reserveHandle != -1) {
+            close(m_reserveHandle);
+        }
+        if (m_listenSocketHandle != -1) {
+            close(m_listenSocketHandle);
+        }
+    }
+
+    // Creates the listening socket and the epoll instance.
+    // Returns false (see getLastError()) if something went wrong.
+    bool start() {
+        m_listenSocketHandle = socket(AF_INET, SOCK_STREAM, 0);
+        if (m_listenSocketHandle == -1) {
+            return setError("Can't create the socket");
+        }
+        int reuseAddr = 1;
+        setsockopt(m_listenSocketHandle, SOL_SOCKET, SO_REUSEADDR, &reuseAddr, sizeof(reuseAddr));
+        int reusePort = 1;
+        if (m_settings.reusePort
+            && setsockopt(m_listenSocketHandle, SOL_SOCKET, SO_REUSEPORT, &reusePort, sizeof(reusePort)) < 0) {
+            return setError("Can't enable SO_REUSEPORT on the socket");
+        }
+        memset(&m_serverAddr, 0, sizeof(m_serverAddr));
+        m_serverAddr.sin_family = AF_INET;
+        m_serverAddr.sin_addr.s_addr = INADDR_ANY;
+        m_serverAddr.sin_port = htons(m_listenPort);
+        if (bind(m_listenSocketHandle, (sockaddr*)(&m_serverAddr), sizeof(m_serverAddr)) < 0) {
+            return setError("Can't bind the socket");
+        }
+        if (!epoll_server_details::setNonBlocking(m_listenSocketHandle)) {
+            return setError("Can't switch the listening socket to the non-blocking mode");
+        }
+        if (listen(m_listenSocketHandle, SOMAXCONN) < 0) {
+            return setError("Can't listen on the socket");
+        }
+        m_epollHandle = epoll_create1(0);
+        if (m_epollHandle == -1) {
+            return setError("Can't create the epoll instance");
+        }
+        epoll_event listenEvent;
+        listenEvent.events = EPOLLIN | EPOLLET;
+        listenEvent.data.ptr = NULL; // NULL marks the listening socket
+        if (epoll_ctl(m_epollHandle, EPOLL_CTL_ADD, m_listenSocketHandle, &listenEvent) == -1) {
+            return setError("Can't register the listening socket in epoll");
+        }
+        m_wakeUpHandle = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (m_wakeUpHandle == -1) {
+            return setError("Can't create the eventfd");
+        }
+        epoll_event wakeUpEvent;
+        wakeUpEvent.events = EPOLLIN;
+        wakeUpEvent.data.ptr = &m_wakeUpHandle; // the address of the handle marks the eventfd
+        if (epoll_ctl(m_epollHandle, EPOLL_CTL_ADD, m_wakeUpHandle, &wakeUpEvent) == -1) {
+            return setError("Can't register the eventfd in epoll");
+        }
+        m_reserveHandle = open("/dev/null", O_RDONLY | O_CLOEXEC);
+        return true;
+    }
+
+    // Runs the event loop until stop() is called. Returns false if epoll_wait() failed.
+    bool run() {
+        std::vector<epoll_event> events(m_settings.maxEventsPerWait);
+        while (!__sync_fetch_and_add(&m_stopRequested, 0)) {
+            int eventsCount = epoll_wait(m_epollHandle, &events[0], m_settings.maxEventsPerWait, getWaitTimeout());
+            if (eventsCount == -1) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return setError("epoll_wait() failed");
+            }
+            for (int i = 0; i < eventsCount; ++i) {
+                if (events[i].data.ptr == NULL) {
+                    acceptNewConnections();
+                } else if (events[i].data.ptr == &m_wakeUpHandle) {
+                    uint64_t value;
+                    while (read(m_wakeUpHandle, &value, sizeof(value)) == -1 && errno == EINTR) {}
+                } else {
+                    processConnectionEvent(
+                        static_cast<Connection *>(events[i].data.ptr), events[i].events);
+                }
+            }
+            runDueDelayedCalls();
+            flushQueuedData();
+            deleteClosedConnections();
+        }
+        return true;
+    }
+
+    // Can be called from any thread: the event loop wakes up and returns from run().
+    void stop() {
+        __sync_lock_test_and_set(&m_stopRequested, 1);
+        if (m_wakeUpHandle != -1) {
+            uint64_t value = 1;
+            while (write(m_wakeUpHandle, &value, sizeof(value)) == -1 && errno == EINTR) {}
+        }
+    }
+
+    // The delayed calls, which are not bound to a connection (for example, the periodic updates,
+    // which are broadcast to a group of clients). Executed by the event loop thread, in the same
+    // place as the connections' delayed calls; should be used from that thread (or before run()).
+    tau_additional::communications_handling::DelayedCallsScheduler & getScheduler() {
+        return m_serverDelayedCalls;
+    }
+
+    // Can be called from any thread
+    size_t getConnectionsCount() const {
+        return m_connectionsCount;
+    }
+    // Since the start; can be called from any thread
+    size_t getAcceptedConnectionsCount() const {
+        return m_acceptedConnectionsCount;
+    }
+
+    std::string const & getLastError() const {
+        return m_lastError;
+    }
+private:
+    bool setError(std::string const & message) {
+        m_lastError = message + ": " + strerror(errno);
+        return false;
+    }
+
+    void acceptNewConnections() {
+        while (true) {
+            sockaddr_in client;
+            socklen_t client_socket_size = sizeof(client);
+            int client_handle = accept4(m_listenSocketHandle,
+                (sockaddr*)(&client), &client_socket_size, SOCK_NONBLOCK);
+            if (client_handle == -1) {
+                if (errno == EINTR || errno == ECONNABORTED) {
+                    continue;
+                }
+                if ((errno == EMFILE || errno == ENFILE) && dropPendingConnection()) {
+                    continue;
+                }
+                return; // EAGAIN - no more pending connections; anything else - try on the next event
+            }
+            Connection * connection = new Connection(client_handle, m_settings, m_flushQueue, m_timingWheel);
+            epoll_event connectionEvent;
+            connectionEvent.events = EPOLLIN | EPOLLRDHUP | EPOLLET;
+            connectionEvent.data.ptr = connection;
+            if (epoll_ctl(m_epollHandle, EPOLL_CTL_ADD, client_handle, &connectionEvent) == -1) {
+                close(client_handle);
+                delete connection;
+                continue;
+            }
+            connection->next = m_openConnections;
+            if (m_openConnections != NULL) {
+                m_openConnections->previous = connection;
+            }
+            m_openConnections = connection;
+            __sync_add_and_fetch(&m_connectionsCount, 1);
+            __sync_add_and_fetch(&m_acceptedConnectionsCount, 1);
+            tau::communications_handling::ClientConnectionInfo connectionInfo(
+                epoll_server_details::getAddrString(client), ntohs(client.sin_port),
+                epoll_server_details::getAddrString(m_serverAddr), ntohs(m_serverAddr.sin_port));
+            connection->dispatcher.onClientConnected(connectionInfo);
+        }
+    }
+
+    // Out of the descriptors: the edge-triggered listening socket won't be reported again, while the
+    // connections are pending, so they are accepted (with the reserve descriptor) and closed at once.
+    // If it does not work, the listening socket is re-armed to be reported on the next wait.
+    // Returns false if the accepting should be stopped.
+    bool dropPendingConnection() {
+        int handle = -1;
+        if (m_reserveHandle != -1) {
+            close(m_reserveHandle);
+            handle = accept(m_listenSocketHandle, NULL, NULL);
+            int acceptError = errno;
+            if (handle != -1) {
+                close(handle);
+            }
+            m_reserveHandle = open("/dev/null", O_RDONLY | O_CLOEXEC);
+            if (handle != -1) {
+                return true;
+            }
+            if (acceptError != EMFILE && acceptError != ENFILE) {
+                return false; // EAGAIN - no more pending connections
+            }
+        }
+        epoll_event listenEvent;
+        listenEvent.events = EPOLLIN | EPOLLET;
+        listenEvent.data.ptr = NULL;
+        epoll_ctl(m_epollHandle, EPOLL_CTL_MOD, m_listenSocketHandle, &listenEvent);
+        return false;
+    }
+
+    void processConnectionEvent(Connection * connection, uint32_t events) {
+        if (connection->closed) {
+            return;
+        }
+        if (events & EPOLLOUT) {
+            connection->writer.flush();
+            if (connection->readPaused && !connection->writer.isAboveHighWaterMark()) {
+                // Edge-triggered mode: the data, which was left unread, won't be reported again
+                connection->readPaused = false;
+                events |= EPOLLIN;
+            }
+            updateConnectionState(connection);
+            if (connection->closed) {
+                return;
+            }
+        }
+        bool peerClosed = (events & (EPOLLHUP | EPOLLERR)) != 0;
+        if ((events & (EPOLLIN | EPOLLRDHUP)) && !connection->readPaused) {
+            peerClosed = readIncomingData(connection) || peerClosed;
+        }
+        if (peerClosed) {
+            closeConnection(connection);
+        }
+    }
+
+    // Returns true if the connection should be closed (the peer has closed it, or has sent
+    // the broken compressed data or the broken binary packets).
+    bool readIncomingData(Connection * connection) {
+        // Edge-triggered mode: the socket should be drained until EAGAIN
+        while (!connection->writer.isCloseRequested()) {
+            if (connection->writer.isAboveHighWaterMark()) {
+                connection->readPaused = true;
+                return false;
+            }
+            ssize_t read_bufSize = recv(connection->writer.getSocketHandle(),
+                &m_receiveBuffer[0], m_receiveBuffer.size(), 0);
+            if (read_bufSize > 0 && connection->writer.getCompressor() == NULL) {
+                if (!parseIncomingData(connection, &m_receiveBuffer[0], size_t(read_bufSize))) {
+                    return true;
+                }
+            } else if (read_bufSize > 0) {
+                if (connection->writer.getTranscoder() != NULL) {
+                    connection->decompressor.setBinaryFraming(); // the binary packets may contain the zero bytes
+                }
+                m_decompressedData.clear();
+                if (!connection->decompressor.decompress(&m_receiveBuffer[0], read_bufSize, m_decompressedData)) {
+                    return true; // the broken compressed stream: the connection is closed
+                }
+                if (!m_decompressedData.empty()
+                    && !parseIncomingData(connection, m_decompressedData.data(), m_decompressedData.size())) {
+                    return true;
+                }
+            } else if (read_bufSize == -1 && errno == EINTR) {
+                continue;
+            } else {
+                return (read_bufSize == 0 || (errno != EAGAIN && errno != EWOULDBLOCK));
+            }
+        }
+        return false;
+    }
+
+    // Returns false if the binary packets are broken.
+    bool parseIncomingData(Connection * connection, char const * data, size_t size) {
+        tau_additional::communications_handling::TextPacketsTranscoder const * transcoder = connection->writer.getTranscoder();
+        if (transcoder != NULL) {
+            connection->binaryParser.setDictionary(&transcoder->getDictionary());
+            return connection->binaryParser.newData(data, size, connection->dispatcher);
+        }
+        connection->writer.captureIncomingData(data, size);
+        connection->parser.newData(data, size, connection->dispatcher);
+        return true;
+    }
+
+    // Milliseconds till the timing wheel should be advanced (-1 if there are no delayed calls).
+    int getWaitTimeout() const {
+        uint64_t deadline = m_timingWheel.getNextWakeUpTime();
+        if (deadline == TimingWheel::NO_WAKE_UP) {
+            return -1;
+        }
+        uint64_t now = getMonotonicNanoseconds();
+        if (deadline <= now) {
+            return 0;
+        }
+        uint64_t result = (deadline - now + 999999) / 1000000; // rounded up, so the call is due on wake up
+        return (result > uint64_t(INT_MAX)) ? INT_MAX : int(result);
+    }
+
+    void runDueDelayedCalls() {
+        m_timingWheel.advance(getMonotonicNanoseconds());
+    }
+
+    void flushQueuedData() {
+        std::vector<Connection *> connectionsToFlush;
+        while (!m_flushQueue.empty()) {
+            connectionsToFlush.swap(m_flushQueue);
+            for (size_t i = 0; i < connectionsToFlush.size(); ++i) {
+                Connection * connection = connectionsToFlush[i];
+                if (connection->closed) {
+                    continue;
+                }
+                connection->writer.flush();
+                updateConnectionState(connection);
+                if (!connection->closed && connection->readPaused
+                    && !connection->writer.isAboveHighWaterMark()) {
+                    connection->readPaused = false;
+                    if (readIncomingData(connection)) {
+                        closeConnection(connection);
+                    }
+                }
+            }
+            connectionsToFlush.clear();
+        }
+    }
+
+    // Applies the requests, which the user code could have made during the callbacks:
+    // closes the connection or subscribes to the 'writable' notifications for the queued data.
+    void updateConnectionState(Connection * connection) {
+        if (connection->writer.isWriteFailed()) {
+            closeConnection(connection);
+            return;
+        }
+        bool needWritableEvents = connection->writer.hasQueuedData();
+        if (connection->writer.isCloseRequested() && !needWritableEvents) {
+            closeConnection(connection);
+            return;
+        }
+        if (needWritableEvents != connection->writableEventsRequested) {
+            epoll_event connectionEvent;
+            connectionEvent.events = EPOLLIN | EPOLLRDHUP | EPOLLET | (needWritableEvents ? uint32_t(EPOLLOUT) : 0u);
+            connectionEvent.data.ptr = connection;
+            epoll_ctl(m_epollHandle, EPOLL_CTL_MOD, connection->writer.getSocketHandle(), &connectionEvent);
+            connection->writableEventsRequested = needWritableEvents;
+        }
+    }
+
+    // The connection object is deleted at the end of the event loop turn,
+    // because it can still be referenced from the flush queue.
+    void closeConnection(Connection * connection) {
+        if (connection->closed) {
+            return;
+        }
+        connection->closed = true;
+        connection->dispatcher.onConnectionClosed();
+        connection->writer.cancelAllDelayedCalls();
+        connection->writer.captureClosed();
+        int handle = connection->writer.getSocketHandle();
+        connection->writer.detachSocket();
+        epoll_ctl(m_epollHandle, EPOLL_CTL_DEL, handle, NULL);
+        close(handle);
+        if (connection->previous != NULL) {
+            connection->previous->next = connection->next;
+        } else {
+            m_openConnections = connection->next;
+        }
+        if (connection->next != NULL) {
+            connection->next->previous = connection->previous;
+        }
+        m_closedConnections.push_back(connection);
+        __sync_sub_and_fetch(&m_connectionsCount, 1);
+    }
+
+    void deleteClosedConnections() {
+        for (size_t i = 0; i < m_closedConnections.size(); ++i) {
+            delete m_closedConnections[i];
+        }
+        m_closedConnections.clear();
+    }
+};
+
+}
+}
+#endif
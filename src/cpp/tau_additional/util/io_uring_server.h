@@ -0,0 +1,1137 @@
+// This source file is part of the 'tau' open source project.
+// Copyright (c) 2016, Yuriy Vosel.
+// Licensed under Boost Software License.
+// See LICENSE.txt for the licence information.
+
+#ifndef TAU_ADDITIONAL_UTIL_IO_URING_SERVER_H
+#define TAU_ADDITIONAL_UTIL_IO_URING_SERVER_H
+
+#include <tau_additional/util/epoll_server.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <signal.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <utility>
+#include <vector>
+
+// The multishot operations and the provided buffers rings appeared in the 5.19 kernel headers
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#if defined(IORING_ACCEPT_MULTISHOT) && defined(IORING_RECV_MULTISHOT) && defined(__NR_io_uring_setup)
+#define TAU_ADDITIONAL_IO_URING_AVAILABLE
+#endif
+#endif
+#endif
+
+namespace tau_additional {
+namespace util {
+
+struct IoUringServerSettings : public EpollServerSettings
+{
+    IoUringServerSettings():
+        queueDepth(1024),
+        providedBuffersCount(256),
+        providedBufferSize(16 * 1024)
+    {};
+    // The submission queue size; the completion queue is 4 times bigger (the overflowing
+    // completions are kept by the kernel, so it is not a hard limit).
+    unsigned queueDepth;
+    // The receive buffers, which are registered in the kernel once and shared by all the connections:
+    // the kernel picks the free one, when the data arrives (the receiveBufferSize of the base settings
+    // is not used). The count should be the power of two (up to 32768).
+    unsigned providedBuffersCount;
+    unsigned providedBufferSize;
+};
+
+#ifdef TAU_ADDITIONAL_IO_URING_AVAILABLE
+
+namespace io_uring_server_details {
+    // The submission and completion queues, shared with the kernel (the raw system calls are used,
+    // so there is no dependency on liburing). Not thread-safe.
+    class Ring
+    {
+        int m_handle;
+        void * m_ringsMemory;
+        size_t m_ringsMemorySize;
+        io_uring_sqe * m_sqes;
+        size_t m_sqesSize;
+        unsigned * m_sqHead;
+        unsigned * m_sqTail;
+        unsigned * m_sqArray;
+        unsigned m_sqMask;
+        unsigned m_sqEntries;
+        unsigned m_sqLocalTail; // the queued entries, which are not visible to the kernel yet
+        unsigned m_sqSubmittedTail;
+        unsigned * m_cqHead;
+        unsigned * m_cqTail;
+        unsigned m_cqMask;
+        io_uring_cqe * m_cqes;
+        uint64_t m_enterCalls;
+        uint64_t m_submittedEntries;
+
+        Ring(Ring const &);
+        Ring & operator = (Ring const &);
+    public:
+        Ring():
+            m_handle(-1), m_ringsMemory(MAP_FAILED), m_ringsMemorySize(0), m_sqes(NULL), m_sqesSize(0),
+            m_sqHead(NULL), m_sqTail(NULL), m_sqArray(NULL), m_sqMask(0), m_sqEntries(0),
+            m_sqLocalTail(0), m_sqSubmittedTail(0), m_cqHead(NULL), m_cqTail(NULL), m_cqMask(0), m_cqes(NULL),
+            m_enterCalls(0), m_submittedEntries(0)
+        {};
+        ~Ring() {
+            if (m_sqes != NULL) {
+                munmap(m_sqes, m_sqesSize);
+            }
+            if (m_ringsMemory != MAP_FAILED) {
+                munmap(m_ringsMemory, m_ringsMemorySize);
+            }
+            if (m_handle != -1) {
+                close(m_handle);
+            }
+        }
+
+        // Returns false (errno is set) if io_uring is not available or lacks the required features.
+        bool init(unsigned entries) {
+            io_uring_params params;
+            memset(&params, 0, sizeof(params));
+            params.flags = IORING_SETUP_CQSIZE | IORING_SETUP_SUBMIT_ALL | IORING_SETUP_COOP_TASKRUN;
+            params.cq_entries = entries * 4;
+            m_handle = int(syscall(__NR_io_uring_setup, entries, &params));
+            if (m_handle == -1 && errno == EINVAL) {
+                // The older kernel: without the optional flags
+                memset(&params, 0, sizeof(params));
+                params.flags = IORING_SETUP_CQSIZE;
+                params.cq_entries = entries * 4;
+                m_handle = int(syscall(__NR_io_uring_setup, entries, &params));
+            }
+            if (m_handle == -1) {
+                return false;
+            }
+            unsigned const requiredFeatures = IORING_FEAT_SINGLE_MMAP | IORING_FEAT_NODROP | IORING_FEAT_EXT_ARG;
+            if ((params.features & requiredFeatures) != requiredFeatures) {
+                errno = ENOSYS;
+                return false;
+            }
+            size_t sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+            size_t cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+            m_ringsMemorySize = (sqRingSize > cqRingSize) ? sqRingSize : cqRingSize;
+            m_ringsMemory = mmap(NULL, m_ringsMemorySize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                m_handle, IORING_OFF_SQ_RING);
+            if (m_ringsMemory == MAP_FAILED) {
+                return false;
+            }
+            m_sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+            void * sqes = mmap(NULL, m_sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                m_handle, IORING_OFF_SQES);
+            if (sqes == MAP_FAILED) {
+                return false;
+            }
+            m_sqes = static_cast<io_uring_sqe *>(sqes);
+            char * rings = static_cast<char *>(m_ringsMemory);
+            m_sqHead = reinterpret_cast<unsigned *>(rings + params.sq_off.head);
+            m_sqTail = reinterpret_cast<unsigned *>(rings + params.sq_off.tail);
+            m_sqArray = reinterpret_cast<unsigned *>(rings + params.sq_off.array);
+            m_sqMask = *reinterpret_cast<unsigned *>(rings + params.sq_off.ring_mask);
+            m_sqEntries = params.sq_entries;
+            m_sqLocalTail = m_sqSubmittedTail = *m_sqTail;
+            m_cqHead = reinterpret_cast<unsigned *>(rings + params.cq_off.head);
+            m_cqTail = reinterpret_cast<unsigned *>(rings + params.cq_off.tail);
+            m_cqMask = *reinterpret_cast<unsigned *>(rings + params.cq_off.ring_mask);
+            m_cqes = reinterpret_cast<io_uring_cqe *>(rings + params.cq_off.cqes);
+            return true;
+        }
+
+        // Checks that the kernel supports all the operations from the list.
+        bool supportsOperations(unsigned char const * operations, size_t count) const {
+            size_t probeSize = sizeof(io_uring_probe) + 256 * sizeof(io_uring_probe_op);
+            std::vector<char> probeMemory(probeSize, 0);
+            io_uring_probe * probe = reinterpret_cast<io_uring_probe *>(&probeMemory[0]);
+            if (registerObject(IORING_REGISTER_PROBE, probe, 256) < 0) {
+                return false;
+            }
+            for (size_t i = 0; i < count; ++i) {
+                if (operations[i] > probe->last_op || !(probe->ops[operations[i]].flags & IO_URING_OP_SUPPORTED)) {
+                    errno = ENOSYS;
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        int registerObject(unsigned opcode, void * argument, unsigned count) const {
+            return int(syscall(__NR_io_uring_register, m_handle, opcode, argument, count));
+        }
+
+        // The zeroed entry; NULL if the queue is full and could not be submitted.
+        io_uring_sqe * getSqe() {
+            if (m_sqLocalTail - __atomic_load_n(m_sqHead, __ATOMIC_ACQUIRE) >= m_sqEntries) {
+                submit(false, -1);
+                if (m_sqLocalTail - __atomic_load_n(m_sqHead, __ATOMIC_ACQUIRE) >= m_sqEntries) {
+                    return NULL;
+                }
+            }
+            unsigned index = m_sqLocalTail & m_sqMask;
+            io_uring_sqe * result = &m_sqes[index];
+            memset(result, 0, sizeof(*result));
+            m_sqArray[index] = index;
+            ++m_sqLocalTail;
+            return result;
+        }
+
+        // Submits the queued entries and, if asked, waits for at least one completion or for the
+        // timeout (negative - no timeout, 0 - does not wait). One system call.
+        // Returns false if the ring failed.
+        bool submit(bool wait, int64_t timeoutNanoseconds) {
+            __atomic_store_n(m_sqTail, m_sqLocalTail, __ATOMIC_RELEASE);
+            unsigned toSubmit = m_sqLocalTail - m_sqSubmittedTail;
+            bool waitForCompletion = wait && timeoutNanoseconds != 0 && !hasCompletions();
+            if (toSubmit == 0 && !waitForCompletion) {
+                return true;
+            }
+            __kernel_timespec timeout;
+            io_uring_getevents_arg argument;
+            memset(&argument, 0, sizeof(argument));
+            argument.sigmask_sz = _NSIG / 8;
+            if (timeoutNanoseconds > 0) {
+                timeout.tv_sec = timeoutNanoseconds / 1000000000;
+                timeout.tv_nsec = timeoutNanoseconds % 1000000000;
+                argument.ts = reinterpret_cast<uintptr_t>(&timeout);
+            }
+            unsigned flags = IORING_ENTER_EXT_ARG | (waitForCompletion ? IORING_ENTER_GETEVENTS : 0);
+            ++m_enterCalls;
+            int result = int(syscall(__NR_io_uring_enter, m_handle, toSubmit, waitForCompletion ? 1 : 0,
+                flags, &argument, sizeof(argument)));
+            if (result >= 0) {
+                m_sqSubmittedTail += unsigned(result);
+                m_submittedEntries += unsigned(result);
+                return true;
+            }
+            // Interrupted, timed out, or the completion queue is overflown (will be drained by the caller)
+            return (errno == EINTR || errno == ETIME || errno == EBUSY || errno == EAGAIN);
+        }
+
+        bool hasCompletions() const {
+            return *m_cqHead != __atomic_load_n(m_cqTail, __ATOMIC_ACQUIRE);
+        }
+        // The completion is copied, and its slot is released at once: the handlers can queue the new entries.
+        bool popCompletion(io_uring_cqe & result) {
+            unsigned head = *m_cqHead;
+            if (head == __atomic_load_n(m_cqTail, __ATOMIC_ACQUIRE)) {
+                return false;
+            }
+            result = m_cqes[head & m_cqMask];
+            __atomic_store_n(m_cqHead, head + 1, __ATOMIC_RELEASE);
+            return true;
+        }
+
+        uint64_t getEnterCalls() const {
+            return m_enterCalls;
+        }
+        uint64_t getSubmittedEntries() const {
+            return m_submittedEntries;
+        }
+    };
+
+    // The receive buffers, which the kernel picks for the incoming data itself (the provided buffers ring).
+    // The buffer is returned to the ring, when its data is handled.
+    class ProvidedBuffers
+    {
+        io_uring_buf * m_ring;
+        size_t m_ringSize;
+        char * m_data;
+        unsigned m_count;
+        unsigned m_bufferSize;
+        uint16_t * m_tail;
+        uint16_t m_localTail;
+
+        ProvidedBuffers(ProvidedBuffers const &);
+        ProvidedBuffers & operator = (ProvidedBuffers const &);
+    public:
+        ProvidedBuffers():
+            m_ring(NULL), m_ringSize(0), m_data(NULL), m_count(0), m_bufferSize(0), m_tail(NULL), m_localTail(0)
+        {};
+        ~ProvidedBuffers() {
+            if (m_ring != NULL) {
+                munmap(m_ring, m_ringSize);
+            }
+            free(m_data);
+        }
+
+        bool init(Ring & ring, unsigned count, unsigned bufferSize, uint16_t groupID) {
+            if (count == 0 || count > 32768 || (count & (count - 1)) != 0 || bufferSize == 0) {
+                errno = EINVAL;
+                return false;
+            }
+            m_ringSize = count * sizeof(io_uring_buf);
+            void * ringMemory = mmap(NULL, m_ringSize, PROT_READ | PROT_WRITE, MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+            if (ringMemory == MAP_FAILED) {
+                return false;
+            }
+            m_ring = static_cast<io_uring_buf *>(ringMemory);
+            // The tail is placed over the reserved field of the first entry
+            m_tail = reinterpret_cast<uint16_t *>(reinterpret_cast<char *>(m_ring) + offsetof(io_uring_buf, resv));
+            m_data = static_cast<char *>(malloc(size_t(count) * bufferSize));
+            if (m_data == NULL) {
+                errno = ENOMEM;
+                return false;
+            }
+            m_count = count;
+            m_bufferSize = bufferSize;
+            io_uring_buf_reg registration;
+            memset(&registration, 0, sizeof(registration));
+            registration.ring_addr = reinterpret_cast<uintptr_t>(m_ring);
+            registration.ring_entries = count;
+            registration.bgid = groupID;
+            if (ring.registerObject(IORING_REGISTER_PBUF_RING, &registration, 1) < 0) {
+                return false;
+            }
+            for (unsigned i = 0; i < count; ++i) {
+                add(uint16_t(i));
+            }
+            publish();
+            return true;
+        }
+
+        char * getBuffer(unsigned bufferID) {
+            return m_data + size_t(bufferID) * m_bufferSize;
+        }
+        void recycle(unsigned bufferID) {
+            add(uint16_t(bufferID));
+            publish();
+        }
+    private:
+        void add(uint16_t bufferID) {
+            io_uring_buf & entry = m_ring[m_localTail & (m_count - 1)];
+            entry.addr = reinterpret_cast<uintptr_t>(getBuffer(bufferID));
+            entry.len = m_bufferSize;
+            entry.bid = bufferID;
+            ++m_localTail;
+        }
+        void publish() {
+            __atomic_store_n(m_tail, m_localTail, __ATOMIC_RELEASE);
+        }
+    };
+};
+
+// Single-threaded server with the same interface and behaviour as the EpollServer (the events
+// dispatchers, the delayed calls, the compression, the binary encoding), which uses the Linux
+// io_uring instead of epoll:
+// - the listening socket has a few accepts in flight, every one with its own buffer for the peer
+//   address (the multishot accept would share one buffer between all the connections), so there
+//   are no getpeername() calls;
+// - every connection has one multishot receive, which takes the buffers from the shared ring of the
+//   provided (registered once) buffers, so there are no recv() calls and no per-connection buffers;
+// - the queued packets of the connection are sent with one sendmsg submission (one at a time, the next
+//   one is submitted, when it completes); the closing connection gets the linked send + shutdown + close.
+// All the submissions of the event loop turn and the wait for the completions are one io_uring_enter()
+// call, so at the high connection counts there is a fraction of a system call per event.
+// stop() wakes the loop up through the eventfd, which the ring is reading from.
+// Requires the 5.19+ kernel (see IoUringOrEpollServer for the fallback to epoll); the multishot
+// receive requires 6.0+, on the older kernels the single-shot one is re-armed after every completion.
+template <typename EventsDispatcherType>
+class IoUringServer
+{
+public:
+    struct Statistics
+    {
+        Statistics(): loopTurns(0), completions(0), enterCalls(0), submittedEntries(0) {};
+        uint64_t loopTurns;
+        uint64_t completions;
+        uint64_t enterCalls;        // the system calls of the event loop
+        uint64_t submittedEntries;
+    };
+private:
+    struct Connection;
+    typedef ServerConnectionWriter<Connection> ConnectionWriter;
+
+    struct Connection
+    {
+        Connection(int socketHandle, EpollServerSettings const & settings,
+            std::vector<Connection *> & flushQueue, TimingWheel & timingWheel):
+            writer(socketHandle, settings, flushQueue, timingWheel, this),
+            dispatcher(writer),
+            handle(socketHandle),
+            pendingOperations(0),
+            receiving(false),
+            sending(false),
+            readPaused(false),
+            closed(false),
+            previous(NULL),
+            next(NULL)
+        {
+            memset(&sendMessage, 0, sizeof(sendMessage));
+        };
+        ConnectionWriter writer;
+        EventsDispatcherType dispatcher;
+        tau_additional::communications_handling::RawIncomingDataStreamParser parser;
+        tau_additional::communications_handling::BinaryPacketParser binaryParser; // after the switch to the binary encoding
+        tau_additional::communications_handling::StreamDecompressor decompressor;
+        int handle; // the writer forgets it, when the connection is closed
+        iovec sendBuffers[tau_additional::communications_handling::BufferedOutgoingPacketsGenerator::MAX_BUFFERS_PER_SYSCALL];
+        msghdr sendMessage;
+        std::string pausedData; // received after the reading was paused
+        size_t pendingOperations; // the connection is deleted, when the kernel has nothing of it
+        bool receiving;
+        bool sending;
+        bool readPaused;
+        bool closed;
+        // The list of the open connections (for the server's destructor)
+        Connection * previous;
+        Connection * next;
+    };
+
+    // The accept in flight: the kernel writes the peer address into it
+    struct AcceptSlot
+    {
+        sockaddr_in address;
+        socklen_t addressSize;
+        bool armed;
+    };
+
+    // The operation is kept in the low bits of the user_data, the connection pointer (the accept slot
+    // index for the accepts) - in the rest
+    enum Operation
+    {
+        OPERATION_ACCEPT = 1,
+        OPERATION_RECEIVE,
+        OPERATION_SEND,
+        OPERATION_CANCEL,
+        OPERATION_SHUTDOWN,
+        OPERATION_CLOSE,
+        OPERATION_WAKE_UP
+    };
+    static const uint64_t OPERATION_BITS = 3;
+    static const uint64_t OPERATION_MASK = 7;
+    static const uint16_t BUFFERS_GROUP_ID = 0;
+    static const size_t ACCEPTS_IN_FLIGHT = 16;
+    // After the failed accept (for example, out of the file descriptors) it is retried with the delay
+    static const uint64_t ACCEPT_RETRY_DELAY = uint64_t(10) * 1000000;
+    // The destructor waits this long for the kernel to complete the submissions of the closed connections
+    static const int64_t CLOSE_WAIT_STEP = int64_t(10) * 1000000;
+    static const int CLOSE_WAIT_STEPS = 100;
+
+    class AcceptRetry : public tau_additional::communications_handling::DelayedCallsScheduler::Callback
+    {
+        IoUringServer & m_server;
+    public:
+        AcceptRetry(IoUringServer & server): m_server(server) {};
+        virtual void onDelayedCall() {
+            m_server.armAccepts();
+        }
+    };
+
+    unsigned short m_listenPort;
+    IoUringServerSettings m_settings;
+    int m_listenSocketHandle;
+    int m_wakeUpHandle; // the eventfd, which stop() writes into, so io_uring_enter() returns at once
+    uint64_t m_wakeUpValue; // the eventfd read buffer
+    sockaddr_in m_serverAddr;
+    volatile size_t m_connectionsCount; // changed by the event loop thread, can be read from any thread
+    volatile size_t m_acceptedConnectionsCount;
+    volatile int m_stopRequested; // set from any thread
+    bool m_ioUringUnavailable;
+    bool m_multishotReceive;
+    std::string m_lastError;
+    std::vector<AcceptSlot> m_acceptSlots;
+    Connection * m_openConnections;
+    io_uring_server_details::Ring m_ring;
+    io_uring_server_details::ProvidedBuffers m_receiveBuffers;
+    std::string m_decompressedData;
+    std::vector<Connection *> m_flushQueue;
+    std::vector<Connection *> m_closedConnections;
+    TimingWheel m_timingWheel;
+    TimingWheelCallsScheduler m_serverDelayedCalls;
+    Statistics m_statistics;
+    AcceptRetry m_acceptRetry;
+
+    IoUringServer(IoUringServer const &);
+    IoUringServer & operator = (IoUringServer const &);
+public:
+    IoUringServer(unsigned short listenPort, IoUringServerSettings const & settings = IoUringServerSettings()):
+        m_listenPort(listenPort),
+        m_settings(settings),
+        m_listenSocketHandle(-1),
+        m_wakeUpHandle(-1),
+        m_wakeUpValue(0),
+        m_connectionsCount(0),
+        m_acceptedConnectionsCount(0),
+        m_stopRequested(0),
+        m_ioUringUnavailable(false),
+        m_multishotReceive(true),
+        m_acceptSlots(ACCEPTS_IN_FLIGHT),
+        m_openConnections(NULL),
+        m_serverDelayedCalls(m_timingWheel),
+        m_acceptRetry(*this)
+    {
+        if (m_settings.queueDepth < 16) {
+            m_settings.queueDepth = 16;
+        }
+    };
+
+    // Should not be called while run() is running. The open connections are closed (their
+    // dispatchers get onConnectionClosed()), and the kernel is waited for to finish with their buffers.
+    ~IoUringServer() {
+        __sync_lock_test_and_set(&m_stopRequested, 1); // the accepted connections are not served any more
+        m_serverDelayedCalls.cancelDelayedCall(m_acceptRetry);
+        while (m_openConnections != NULL) {
+            closeConnection(m_openConnections);
+        }
+        wakeUp(); // completes the eventfd read
+        for (int step = 0; step < CLOSE_WAIT_STEPS && !m_closedConnections.empty(); ++step) {
+            if (!m_ring.submit(true, CLOSE_WAIT_STEP)) {
+                break;
+            }
+            processCompletions();
+            deleteClosedConnections();
+        }
+        if (m_listenSocketHandle != -1) {
+            close(m_listenSocketHandle);
+        }
+        if (m_wakeUpHandle != -1) {
+            close(m_wakeUpHandle);
+        }
+        // Only if the kernel is stuck: the ring is closed after them
+        for (size_t i = 0; i < m_closedConnections.size(); ++i) {
+            delete m_closedConnections[i];
+        }
+    }
+
+    // Sets up the io_uring instance and the listening socket.
+    // Returns false (see getLastError() and isIoUringUnavailable()) if something went wrong.
+    bool start() {
+        static unsigned char const REQUIRED_OPERATIONS[] = { IORING_OP_ACCEPT, IORING_OP_RECV,
+            IORING_OP_SENDMSG, IORING_OP_ASYNC_CANCEL, IORING_OP_SHUTDOWN, IORING_OP_CLOSE, IORING_OP_READ };
+        if (!m_ring.init(m_settings.queueDepth)
+            || !m_ring.supportsOperations(REQUIRED_OPERATIONS, sizeof(REQUIRED_OPERATIONS))
+            || !m_receiveBuffers.init(m_ring, m_settings.providedBuffersCount,
+                m_settings.providedBufferSize, BUFFERS_GROUP_ID)) {
+            m_ioUringUnavailable = true;
+            return setError("io_uring is not available");
+        }
+        m_listenSocketHandle = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (m_listenSocketHandle == -1) {
+            return setError("Can't create the socket");
+        }
+        int reuseAddr = 1;
+        setsockopt(m_listenSocketHandle, SOL_SOCKET, SO_REUSEADDR, &reuseAddr, sizeof(reuseAddr));
+        int reusePort = 1;
+        if (m_settings.reusePort
+            && setsockopt(m_listenSocketHandle, SOL_SOCKET, SO_REUSEPORT, &reusePort, sizeof(reusePort)) < 0) {
+            return setError("Can't enable SO_REUSEPORT on the socket");
+        }
+        memset(&m_serverAddr, 0, sizeof(m_serverAddr));
+        m_serverAddr.sin_family = AF_INET;
+        m_serverAddr.sin_addr.s_addr = INADDR_ANY;
+        m_serverAddr.sin_port = htons(m_listenPort);
+        if (bind(m_listenSocketHandle, (sockaddr*)(&m_serverAddr), sizeof(m_serverAddr)) < 0) {
+            return setError("Can't bind the socket");
+        }
+        if (listen(m_listenSocketHandle, SOMAXCONN) < 0) {
+            return setError("Can't listen on the socket");
+        }
+        m_wakeUpHandle = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (m_wakeUpHandle == -1) {
+            return setError("Can't create the eventfd");
+        }
+        armWakeUp();
+        armAccepts();
+        return true;
+    }
+
+    // Runs the event loop until stop() is called. Returns false if the io_uring failed.
+    bool run() {
+        while (!__sync_fetch_and_add(&m_stopRequested, 0)) {
+            if (!m_ring.submit(true, getWaitTimeout())) {
+                return setError("io_uring_enter() failed");
+            }
+            ++m_statistics.loopTurns;
+            processCompletions();
+            runDueDelayedCalls();
+            flushQueuedData();
+            deleteClosedConnections();
+        }
+        return true;
+    }
+
+    // Can be called from any thread (after start()) and from the callbacks.
+    void stop() {
+        __sync_lock_test_and_set(&m_stopRequested, 1);
+        wakeUp();
+    }
+
+    // See EpollServer::getScheduler()
+    tau_additional::communications_handling::DelayedCallsScheduler & getScheduler() {
+        return m_serverDelayedCalls;
+    }
+
+    // Can be called from any thread
+    size_t getConnectionsCount() const {
+        return m_connectionsCount;
+    }
+    // Since the start; can be called from any thread
+    size_t getAcceptedConnectionsCount() const {
+        return m_acceptedConnectionsCount;
+    }
+
+    // True if start() failed, because the kernel does not support the required io_uring features
+    // (or io_uring is disabled), so the other server should be used.
+    bool isIoUringUnavailable() const {
+        return m_ioUringUnavailable;
+    }
+
+    Statistics getStatistics() const {
+        Statistics result = m_statistics;
+        result.enterCalls = m_ring.getEnterCalls();
+        result.submittedEntries = m_ring.getSubmittedEntries();
+        return result;
+    }
+
+    std::string const & getLastError() const {
+        return m_lastError;
+    }
+private:
+    bool setError(std::string const & message) {
+        m_lastError = message + ": " + strerror(errno);
+        return false;
+    }
+
+    static uint64_t getUserData(Connection * connection, Operation operation) {
+        return uint64_t(reinterpret_cast<uintptr_t>(connection)) | uint64_t(operation);
+    }
+
+    // Nanoseconds till the timing wheel should be advanced (-1 if there are no delayed calls).
+    int64_t getWaitTimeout() const {
+        if (!m_flushQueue.empty()) {
+            return 0;
+        }
+        uint64_t deadline = m_timingWheel.getNextWakeUpTime();
+        if (deadline == TimingWheel::NO_WAKE_UP) {
+            return -1;
+        }
+        uint64_t now = getMonotonicNanoseconds();
+        return (deadline <= now) ? 0 : int64_t(deadline - now);
+    }
+
+    // Every accept slot, which is not in flight, gets its accept. The slot, which can't be
+    // submitted (the queue is full), is retried with the delay.
+    void armAccepts() {
+        for (size_t i = 0; i < m_acceptSlots.size(); ++i) {
+            AcceptSlot & slot = m_acceptSlots[i];
+            if (slot.armed) {
+                continue;
+            }
+            io_uring_sqe * sqe = m_ring.getSqe();
+            if (sqe == NULL) {
+                m_serverDelayedCalls.scheduleDelayedCall(m_acceptRetry, ACCEPT_RETRY_DELAY);
+                return;
+            }
+            slot.addressSize = sizeof(slot.address);
+            sqe->opcode = IORING_OP_ACCEPT;
+            sqe->fd = m_listenSocketHandle;
+            sqe->addr = reinterpret_cast<uintptr_t>(&slot.address);
+            sqe->addr2 = reinterpret_cast<uintptr_t>(&slot.addressSize);
+            sqe->accept_flags = SOCK_CLOEXEC;
+            sqe->user_data = (uint64_t(i) << OPERATION_BITS) | uint64_t(OPERATION_ACCEPT);
+            slot.armed = true;
+        }
+    }
+
+    void armWakeUp() {
+        io_uring_sqe * sqe = m_ring.getSqe();
+        if (sqe == NULL) {
+            return; // stop() is noticed at the next completion
+        }
+        sqe->opcode = IORING_OP_READ;
+        sqe->fd = m_wakeUpHandle;
+        sqe->addr = reinterpret_cast<uintptr_t>(&m_wakeUpValue);
+        sqe->len = sizeof(m_wakeUpValue);
+        sqe->user_data = getUserData(NULL, OPERATION_WAKE_UP);
+    }
+
+    void wakeUp() {
+        if (m_wakeUpHandle != -1) {
+            uint64_t value = 1;
+            while (write(m_wakeUpHandle, &value, sizeof(value)) == -1 && errno == EINTR) {}
+        }
+    }
+
+    void armReceive(Connection * connection) {
+        io_uring_sqe * sqe = m_ring.getSqe();
+        if (sqe == NULL) {
+            closeConnection(connection);
+            return;
+        }
+        sqe->opcode = IORING_OP_RECV;
+        sqe->fd = connection->handle;
+        sqe->flags = IOSQE_BUFFER_SELECT;
+        sqe->buf_group = BUFFERS_GROUP_ID;
+        sqe->ioprio = m_multishotReceive ? IORING_RECV_MULTISHOT : 0;
+        sqe->user_data = getUserData(connection, OPERATION_RECEIVE);
+        connection->receiving = true;
+        ++connection->pendingOperations;
+    }
+
+    // The queued data of the connection; the linked submission is executed only if this one succeeds.
+    bool submitSend(Connection * connection, bool linkNext) {
+        size_t buffersCount = connection->writer.prepareWrite(connection->sendBuffers,
+            sizeof(connection->sendBuffers) / sizeof(connection->sendBuffers[0]));
+        if (buffersCount == 0) {
+            return false;
+        }
+        io_uring_sqe * sqe = m_ring.getSqe();
+        if (sqe == NULL) {
+            connection->writer.completeWrite(-1);
+            return false;
+        }
+        connection->sendMessage.msg_iov = connection->sendBuffers;
+        connection->sendMessage.msg_iovlen = buffersCount;
+        sqe->opcode = IORING_OP_SENDMSG;
+        sqe->fd = connection->handle;
+        sqe->addr = reinterpret_cast<uintptr_t>(&connection->sendMessage);
+        sqe->len = 1;
+        // The kernel keeps sending until everything is written (no partial writes to continue)
+        sqe->msg_flags = MSG_NOSIGNAL | MSG_WAITALL;
+        sqe->flags = linkNext ? IOSQE_IO_LINK : 0;
+        sqe->user_data = getUserData(connection, OPERATION_SEND);
+        connection->sending = true;
+        ++connection->pendingOperations;
+        return true;
+    }
+
+    void processCompletions() {
+        io_uring_cqe completion;
+        while (m_ring.popCompletion(completion)) {
+            ++m_statistics.completions;
+            Connection * connection = reinterpret_cast<Connection *>(
+                uintptr_t(completion.user_data & ~OPERATION_MASK));
+            switch (Operation(completion.user_data & OPERATION_MASK)) {
+                case OPERATION_ACCEPT:
+                    processAcceptCompletion(m_acceptSlots[size_t(completion.user_data >> OPERATION_BITS)], completion.res);
+                    break;
+                case OPERATION_WAKE_UP:
+                    if (!__sync_fetch_and_add(&m_stopRequested, 0)) {
+                        armWakeUp();
+                    }
+                    break;
+                case OPERATION_RECEIVE:
+                    processReceiveCompletion(connection, completion);
+                    break;
+                case OPERATION_SEND:
+                    connection->sending = false;
+                    --connection->pendingOperations;
+                    connection->writer.completeWrite(completion.res);
+                    updateConnectionState(connection);
+                    break;
+                case OPERATION_CLOSE:
+                    if (completion.res == -ECANCELED) {
+                        close(connection->handle); // the linked send or shutdown has failed
+                    }
+                    --connection->pendingOperations;
+                    break;
+                default: // cancel, shutdown
+                    --connection->pendingOperations;
+                    break;
+            }
+        }
+    }
+
+    void processAcceptCompletion(AcceptSlot & slot, int result) {
+        slot.armed = false;
+        if (__sync_fetch_and_add(&m_stopRequested, 0)) {
+            if (result >= 0) {
+                close(result); // the server is being destroyed
+            }
+            return;
+        }
+        if (result < 0) {
+            m_serverDelayedCalls.scheduleDelayedCall(m_acceptRetry, ACCEPT_RETRY_DELAY);
+            return;
+        }
+        acceptConnection(result, slot.address);
+        armAccepts();
+    }
+
+    void acceptConnection(int clientHandle, sockaddr_in const & client) {
+        Connection * connection = new Connection(clientHandle, m_settings, m_flushQueue, m_timingWheel);
+        __sync_add_and_fetch(&m_connectionsCount, 1);
+        __sync_add_and_fetch(&m_acceptedConnectionsCount, 1);
+        connection->next = m_openConnections;
+        if (m_openConnections != NULL) {
+            m_openConnections->previous = connection;
+        }
+        m_openConnections = connection;
+        tau::communications_handling::ClientConnectionInfo connectionInfo(
+            epoll_server_details::getAddrString(client), ntohs(client.sin_port),
+            epoll_server_details::getAddrString(m_serverAddr), ntohs(m_serverAddr.sin_port));
+        connection->dispatcher.onClientConnected(connectionInfo);
+        if (!connection->closed) {
+            armReceive(connection);
+        }
+    }
+
+    void processReceiveCompletion(Connection * connection, io_uring_cqe const & completion) {
+        bool more = (completion.flags & IORING_CQE_F_MORE) != 0;
+        if (!more) {
+            connection->receiving = false;
+            --connection->pendingOperations;
+        }
+        if (completion.res > 0 && (completion.flags & IORING_CQE_F_BUFFER)) {
+            unsigned bufferID = completion.flags >> IORING_CQE_BUFFER_SHIFT;
+            if (!connection->closed) {
+                handleReceivedData(connection, m_receiveBuffers.getBuffer(bufferID), size_t(completion.res));
+            }
+            m_receiveBuffers.recycle(bufferID);
+        } else if (completion.res == -EINVAL && m_multishotReceive) {
+            m_multishotReceive = false; // the kernel older than 6.0
+        } else if (completion.res != -ENOBUFS && completion.res != -ECANCELED) {
+            closeConnection(connection); // the peer has closed the connection, or the error
+        }
+        if (!connection->receiving && !connection->closed && !connection->readPaused) {
+            armReceive(connection);
+        }
+    }
+
+    void handleReceivedData(Connection * connection, char const * data, size_t size) {
+        if (connection->writer.isCloseRequested()) {
+            return;
+        }
+        if (connection->readPaused) {
+            connection->pausedData.append(data, size);
+            return;
+        }
+        if (connection->writer.getCompressor() == NULL) {
+            if (!parseIncomingData(connection, data, size)) {
+                closeConnection(connection); // the broken binary packets
+                return;
+            }
+        } else {
+            if (connection->writer.getTranscoder() != NULL) {
+                connection->decompressor.setBinaryFraming(); // the binary packets may contain the zero bytes
+            }
+            m_decompressedData.clear();
+            if (!connection->decompressor.decompress(data, size, m_decompressedData)) {
+                closeConnection(connection); // the broken compressed stream
+                return;
+            }
+            if (!m_decompressedData.empty()
+                && !parseIncomingData(connection, m_decompressedData.data(), m_decompressedData.size())) {
+                closeConnection(connection); // the broken binary packets
+                return;
+            }
+        }
+        if (!connection->closed && connection->writer.isAboveHighWaterMark()) {
+            pauseReading(connection);
+        }
+    }
+
+    // Returns false if the binary packets are broken.
+    bool parseIncomingData(Connection * connection, char const * data, size_t size) {
+        tau_additional::communications_handling::TextPacketsTranscoder const * transcoder = connection->writer.getTranscoder();
+        if (transcoder != NULL) {
+            connection->binaryParser.setDictionary(&transcoder->getDictionary());
+            return connection->binaryParser.newData(data, size, connection->dispatcher);
+        }
+        connection->writer.captureIncomingData(data, size);
+        connection->parser.newData(data, size, connection->dispatcher);
+        return true;
+    }
+
+    // The requests are not read, until the queued data is written; the data, which the kernel
+    // has already received, is kept aside.
+    void pauseReading(Connection * connection) {
+        connection->readPaused = true;
+        if (!connection->receiving) {
+            return;
+        }
+        io_uring_sqe * sqe = m_ring.getSqe();
+        if (sqe == NULL) {
+            return;
+        }
+        sqe->opcode = IORING_OP_ASYNC_CANCEL;
+        sqe->fd = -1;
+        sqe->addr = getUserData(connection, OPERATION_RECEIVE);
+        sqe->user_data = getUserData(connection, OPERATION_CANCEL);
+        ++connection->pendingOperations;
+    }
+
+    void resumeReading(Connection * connection) {
+        connection->readPaused = false;
+        std::string pausedData;
+        pausedData.swap(connection->pausedData);
+        if (!pausedData.empty()) {
+            handleReceivedData(connection, pausedData.data(), pausedData.size());
+        }
+        if (!connection->closed && !connection->readPaused && !connection->receiving) {
+            armReceive(connection);
+        }
+    }
+
+    void runDueDelayedCalls() {
+        m_timingWheel.advance(getMonotonicNanoseconds());
+    }
+
+    void flushQueuedData() {
+        std::vector<Connection *> connectionsToFlush;
+        while (!m_flushQueue.empty()) {
+            connectionsToFlush.swap(m_flushQueue);
+            for (size_t i = 0; i < connectionsToFlush.size(); ++i) {
+                updateConnectionState(connectionsToFlush[i]);
+            }
+            connectionsToFlush.clear();
+        }
+    }
+
+    // Applies the requests, which the user code could have made during the callbacks:
+    // closes the connection or submits the queued data. The next send is submitted, when the
+    // previous one completes.
+    void updateConnectionState(Connection * connection) {
+        if (connection->closed) {
+            return;
+        }
+        if (connection->writer.isWriteFailed()) {
+            closeConnection(connection);
+            return;
+        }
+        if (connection->sending) {
+            return;
+        }
+        if (connection->writer.isCloseRequested() && !connection->writer.isStreaming()) {
+            closeConnection(connection, true);
+            return;
+        }
+        submitSend(connection, false);
+        if (connection->readPaused && !connection->writer.isAboveHighWaterMark()) {
+            resumeReading(connection);
+        }
+    }
+
+    // The connection object is deleted, when all its submissions are completed.
+    // The rest of the queued data (if asked), the shutdown and the close are submitted as one chain.
+    void closeConnection(Connection * connection, bool sendQueuedData = false) {
+        if (connection->closed) {
+            return;
+        }
+        connection->closed = true;
+        connection->dispatcher.onConnectionClosed();
+        connection->writer.cancelAllDelayedCalls();
+        connection->writer.captureClosed();
+        if (sendQueuedData && !connection->sending) {
+            submitSend(connection, true);
+        }
+        connection->writer.detachSocket();
+        io_uring_sqe * shutdownSqe = m_ring.getSqe();
+        if (shutdownSqe != NULL) {
+            // Ends the multishot receive and the blocked send of the connection
+            shutdownSqe->opcode = IORING_OP_SHUTDOWN;
+            shutdownSqe->fd = connection->handle;
+            shutdownSqe->len = SHUT_RDWR;
+            shutdownSqe->flags = IOSQE_IO_LINK;
+            shutdownSqe->user_data = getUserData(connection, OPERATION_SHUTDOWN);
+            ++connection->pendingOperations;
+        }
+        io_uring_sqe * closeSqe = (shutdownSqe != NULL) ? m_ring.getSqe() : NULL;
+        if (closeSqe != NULL) {
+            closeSqe->opcode = IORING_OP_CLOSE;
+            closeSqe->fd = connection->handle;
+            closeSqe->user_data = getUserData(connection, OPERATION_CLOSE);
+            ++connection->pendingOperations;
+        } else {
+            shutdown(connection->handle, SHUT_RDWR);
+            close(connection->handle);
+        }
+        if (connection->previous != NULL) {
+            connection->previous->next = connection->next;
+        } else {
+            m_openConnections = connection->next;
+        }
+        if (connection->next != NULL) {
+            connection->next->previous = connection->previous;
+        }
+        m_closedConnections.push_back(connection);
+        __sync_sub_and_fetch(&m_connectionsCount, 1);
+    }
+
+    void deleteClosedConnections() {
+        size_t kept = 0;
+        for (size_t i = 0; i < m_closedConnections.size(); ++i) {
+            if (m_closedConnections[i]->pendingOperations == 0) {
+                delete m_closedConnections[i];
+            } else {
+                m_closedConnections[kept++] = m_closedConnections[i];
+            }
+        }
+        m_closedConnections.resize(kept);
+    }
+};
+
+#endif
+
+namespace io_uring_server_details {
+    // Keeps the delayed calls, which are scheduled before the server is chosen, and passes them
+    // to the chosen server's scheduler (their delays count from that moment); then forwards the calls.
+    class PendingCallsScheduler : public tau_additional::communications_handling::DelayedCallsScheduler
+    {
+        typedef std::vector<std::pair<Callback *, uint64_t> > Calls;
+
+        Calls m_calls;
+        tau_additional::communications_handling::DelayedCallsScheduler * m_target;
+    public:
+        PendingCallsScheduler(): m_target(NULL) {};
+
+        virtual void scheduleDelayedCall(Callback & callback, uint64_t delayNanoseconds) {
+            if (m_target != NULL) {
+                m_target->scheduleDelayedCall(callback, delayNanoseconds);
+                return;
+            }
+            cancelDelayedCall(callback);
+            m_calls.push_back(std::make_pair(&callback, delayNanoseconds));
+        }
+        virtual void cancelDelayedCall(Callback & callback) {
+            if (m_target != NULL) {
+                m_target->cancelDelayedCall(callback);
+                return;
+            }
+            for (Calls::iterator it = m_calls.begin(); it != m_calls.end(); ++it) {
+                if (it->first == &callback) {
+                    m_calls.erase(it);
+                    return;
+                }
+            }
+        }
+
+        void setTarget(tau_additional::communications_handling::DelayedCallsScheduler & target) {
+            m_target = &target;
+            for (size_t i = 0; i < m_calls.size(); ++i) {
+                target.scheduleDelayedCall(*m_calls[i].first, m_calls[i].second);
+            }
+            m_calls.clear();
+        }
+    };
+};
+
+// Uses the IoUringServer, if the kernel supports it, and the EpollServer otherwise (the choice is
+// made in start()). The interface is the same as the one of the servers.
+template <typename EventsDispatcherType>
+class IoUringOrEpollServer
+{
+#ifdef TAU_ADDITIONAL_IO_URING_AVAILABLE
+    typedef IoUringServer<EventsDispatcherType> IoUringServerType;
+#else
+    struct IoUringServerType; // not available in this build
+#endif
+    unsigned short m_listenPort;
+    IoUringServerSettings m_settings;
+    IoUringServerType * m_ioUringServer;
+    EpollServer<EventsDispatcherType> * m_epollServer;
+    io_uring_server_details::PendingCallsScheduler m_scheduler;
+    std::string m_fallbackReason;
+
+    IoUringOrEpollServer(IoUringOrEpollServer const &);
+    IoUringOrEpollServer & operator = (IoUringOrEpollServer const &);
+public:
+    IoUringOrEpollServer(unsigned short listenPort, IoUringServerSettings const & settings = IoUringServerSettings()):
+        m_listenPort(listenPort),
+        m_settings(settings),
+        m_ioUringServer(NULL),
+        m_epollServer(NULL)
+    {};
+    ~IoUringOrEpollServer() {
+#ifdef TAU_ADDITIONAL_IO_URING_AVAILABLE
+        delete m_ioUringServer;
+#endif
+        delete m_epollServer;
+    }
+
+    bool start() {
+#ifdef TAU_ADDITIONAL_IO_URING_AVAILABLE
+        m_ioUringServer = new IoUringServerType(m_listenPort, m_settings);
+        if (m_ioUringServer->start()) {
+            m_scheduler.setTarget(m_ioUringServer->getScheduler());
+            return true;
+        }
+        if (!m_ioUringServer->isIoUringUnavailable()) {
+            return false; // the socket problem: the EpollServer would have it too
+        }
+        m_fallbackReason = m_ioUringServer->getLastError();
+        delete m_ioUringServer;
+        m_ioUringServer = NULL;
+#else
+        m_fallbackReason = "io_uring is not supported by this build";
+#endif
+        m_epollServer = new EpollServer<EventsDispatcherType>(m_listenPort, m_settings);
+        if (!m_epollServer->start()) {
+            return false;
+        }
+        m_scheduler.setTarget(m_epollServer->getScheduler());
+        return true;
+    }
+
+    // Returns false at once, if the server is not started.
+    bool run() {
+#ifdef TAU_ADDITIONAL_IO_URING_AVAILABLE
+        if (m_ioUringServer != NULL) {
+            return m_ioUringServer->run();
+        }
+#endif
+        return (m_epollServer != NULL) && m_epollServer->run();
+    }
+
+    // Does nothing, if the server is not started.
+    void stop() {
+#ifdef TAU_ADDITIONAL_IO_URING_AVAILABLE
+        if (m_ioUringServer != NULL) {
+            m_ioUringServer->stop();
+            return;
+        }
+#endif
+        if (m_epollServer != NULL) {
+            m_epollServer->stop();
+        }
+    }
+
+    // The calls, which are scheduled before start(), are passed to the chosen server in start().
+    tau_additional::communications_handling::DelayedCallsScheduler & getScheduler() {
+        return m_scheduler;
+    }
+
+    size_t getConnectionsCount() const {
+#ifdef TAU_ADDITIONAL_IO_URING_AVAILABLE
+        if (m_ioUringServer != NULL) {
+            return m_ioUringServer->getConnectionsCount();
+        }
+#endif
+        return (m_epollServer != NULL) ? m_epollServer->getConnectionsCount() : 0;
+    }
+    size_t getAcceptedConnectionsCount() const {
+#ifdef TAU_ADDITIONAL_IO_URING_AVAILABLE
+        if (m_ioUringServer != NULL) {
+            return m_ioUringServer->getAcceptedConnectionsCount();
+        }
+#endif
+        return (m_epollServer != NULL) ? m_epollServer->getAcceptedConnectionsCount() : 0;
+    }
+
+    bool isIoUringUsed() const {
+        return m_ioUringServer != NULL;
+    }
+    // Why the EpollServer is used (empty if it is not)
+    std::string const & getFallbackReason() const {
+        return m_fallbackReason;
+    }
+
+    std::string const & getLastError() const {
+#ifdef TAU_ADDITIONAL_IO_URING_AVAILABLE
+        if (m_ioUringServer != NULL) {
+            return m_ioUringServer->getLastError();
+        }
+#endif
+        return (m_epollServer != NULL) ? m_epollServer->getLastError() : m_fallbackReason;
+    }
+};
+
+}
+}
+#endif
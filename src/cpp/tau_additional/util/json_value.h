@@ -0,0 +1,452 @@
+// This source file is part of the 'tau' open source project.
+// Copyright (c) 2016, Yuriy Vosel.
+// Licensed under Boost Software License.
+// See LICENSE.txt for the licence information.
+
+#ifndef TAU_ADDITIONAL_UTIL_JSON_VALUE_H
+#define TAU_ADDITIONAL_UTIL_JSON_VALUE_H
+
+#include <tau_additional/util/byte_scanner.h>
+#include <stddef.h>
+#include <string>
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+namespace tau_additional {
+namespace util {
+
+// Minimal JSON document model, enough to inspect the layouts produced by LayoutInfo::getJson().
+// The object members keep their original order. The numbers are kept as their source text.
+class JsonValue
+{
+public:
+    enum Type {
+        TYPE_NULL,
+        TYPE_BOOL,
+        TYPE_NUMBER,
+        TYPE_STRING,
+        TYPE_ARRAY,
+        TYPE_OBJECT
+    };
+    typedef std::pair<std::string, JsonValue> Member;
+private:
+    Type m_type;
+    bool m_bool;
+    std::string m_string; // string value or the number text
+    std::vector<JsonValue> m_items;
+    std::vector<Member> m_members;
+public:
+    JsonValue(): m_type(TYPE_NULL), m_bool(false) {};
+
+    Type getType() const {
+        return m_type;
+    }
+    bool getBool() const {
+        return m_bool;
+    }
+    std::string const & getString() const {
+        return m_string;
+    }
+    std::vector<JsonValue> const & getItems() const {
+        return m_items;
+    }
+    std::vector<Member> const & getMembers() const {
+        return m_members;
+    }
+    // Returns NULL if there is no such member (or the value is not an object).
+    JsonValue const * findMember(std::string const & key) const {
+        for (size_t i = 0; i < m_members.size(); ++i) {
+            if (m_members[i].first == key) {
+                return &(m_members[i].second);
+            }
+        }
+        return NULL;
+    }
+
+    // Building the document (for example, from another encoding). Every setter replaces
+    // the previous value; addItem()/addMember() make the value an array/object if it is not.
+    void setNull() {
+        reset(TYPE_NULL);
+    }
+    void setBool(bool value) {
+        reset(TYPE_BOOL);
+        m_bool = value;
+    }
+    // The number is kept as its text
+    void setNumber(std::string const & text) {
+        reset(TYPE_NUMBER);
+        m_string = text;
+    }
+    void setString(std::string const & value) {
+        reset(TYPE_STRING);
+        m_string = value;
+    }
+    void setArray() {
+        reset(TYPE_ARRAY);
+    }
+    void setObject() {
+        reset(TYPE_OBJECT);
+    }
+    JsonValue & addItem() {
+        if (m_type != TYPE_ARRAY) {
+            setArray();
+        }
+        m_items.push_back(JsonValue());
+        return m_items.back();
+    }
+    JsonValue & addMember(std::string const & key) {
+        if (m_type != TYPE_OBJECT) {
+            setObject();
+        }
+        m_members.push_back(Member(key, JsonValue()));
+        return m_members.back().second;
+    }
+    void reserveChildren(size_t count) {
+        if (m_type == TYPE_ARRAY) {
+            m_items.reserve(count);
+        } else if (m_type == TYPE_OBJECT) {
+            m_members.reserve(count);
+        }
+    }
+
+    // Appends the compact JSON text (no whitespace) to the output.
+    void write(std::string & output) const {
+        switch (m_type) {
+            case TYPE_NULL: output += "null"; break;
+            case TYPE_BOOL: output += m_bool ? "true" : "false"; break;
+            case TYPE_NUMBER: output += m_string; break;
+            case TYPE_STRING: writeString(m_string, output); break;
+            case TYPE_ARRAY:
+                output += '[';
+                for (size_t i = 0; i < m_items.size(); ++i) {
+                    if (i != 0) {
+                        output += ',';
+                    }
+                    m_items[i].write(output);
+                }
+                output += ']';
+                break;
+            case TYPE_OBJECT:
+                output += '{';
+                for (size_t i = 0; i < m_members.size(); ++i) {
+                    if (i != 0) {
+                        output += ',';
+                    }
+                    writeString(m_members[i].first, output);
+                    output += ':';
+                    m_members[i].second.write(output);
+                }
+                output += '}';
+                break;
+        }
+    }
+    std::string toJson() const {
+        std::string result;
+        write(result);
+        return result;
+    }
+
+    void swap(JsonValue & other) {
+        std::swap(m_type, other.m_type);
+        std::swap(m_bool, other.m_bool);
+        m_string.swap(other.m_string);
+        m_items.swap(other.m_items);
+        m_members.swap(other.m_members);
+    }
+
+    // Parses the whole text. Returns false if the text is not a valid JSON document.
+    static bool parse(std::string const & text, JsonValue & result) {
+        Parser parser(text);
+        return parser.parseDocument(result);
+    }
+private:
+    void reset(Type type) {
+        m_type = type;
+        m_bool = false;
+        m_string.clear();
+        m_items.clear();
+        m_members.clear();
+    }
+
+    static void writeString(std::string const & value, std::string & output) {
+        static char const HEX_DIGITS[] = "0123456789abcdef";
+        static ByteSet const ESCAPED = ByteSet('"').add('\\').addControlCharacters();
+        output += '"';
+        for (size_t i = 0; i < value.size(); ++i) {
+            // the plain runs are copied at once
+            size_t runLength = findFirstOf(value.data() + i, value.size() - i, ESCAPED);
+            output.append(value, i, runLength);
+            i += runLength;
+            if (i == value.size()) {
+                break;
+            }
+            unsigned char c = static_cast<unsigned char>(value[i]);
+            switch (c) {
+                case '"': output += "\\\""; break;
+                case '\\': output += "\\\\"; break;
+                case '\n': output += "\\n"; break;
+                case '\r': output += "\\r"; break;
+                case '\t': output += "\\t"; break;
+                default:
+                    if (c < 0x20) {
+                        output += "\\u00";
+                        output += HEX_DIGITS[c >> 4];
+                        output += HEX_DIGITS[c & 0x0F];
+                    } else {
+                        output += char(c);
+                    }
+            }
+        }
+        output += '"';
+    }
+
+    class Parser
+    {
+        std::string const & m_text;
+        size_t m_position;
+        size_t m_depth;
+        static const size_t MAX_DEPTH = 256;
+    public:
+        explicit Parser(std::string const & text): m_text(text), m_position(0), m_depth(0) {};
+
+        bool parseDocument(JsonValue & result) {
+            if (!parseValue(result)) {
+                return false;
+            }
+            skipWhitespace();
+            return m_position == m_text.size();
+        }
+    private:
+        void skipWhitespace() {
+            while (m_position < m_text.size()) {
+                char c = m_text[m_position];
+                if (c != ' ' && c != '\t' && c != '\n' && c != '\r') {
+                    return;
+                }
+                ++m_position;
+            }
+        }
+
+        bool consumeLiteral(char const * literal) {
+            size_t length = std::char_traits<char>::length(literal);
+            if (m_text.compare(m_position, length, literal) != 0) {
+                return false;
+            }
+            m_position += length;
+            return true;
+        }
+
+        bool parseValue(JsonValue & result) {
+            skipWhitespace();
+            if (m_position >= m_text.size()) {
+                return false;
+            }
+            char c = m_text[m_position];
+            if (c == '{') {
+                return parseObject(result);
+            } else if (c == '[') {
+                return parseArray(result);
+            } else if (c == '"') {
+                result.m_type = TYPE_STRING;
+                return parseString(result.m_string);
+            } else if (c == 't' || c == 'f') {
+                result.m_type = TYPE_BOOL;
+                result.m_bool = (c == 't');
+                return consumeLiteral(result.m_bool ? "true" : "false");
+            } else if (c == 'n') {
+                result.m_type = TYPE_NULL;
+                return consumeLiteral("null");
+            }
+            return parseNumber(result);
+        }
+
+        bool parseNumber(JsonValue & result) {
+            size_t start = m_position;
+            while (m_position < m_text.size()) {
+                char c = m_text[m_position];
+                if ((c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E') {
+                    ++m_position;
+                } else {
+                    break;
+                }
+            }
+            if (m_position == start) {
+                return false;
+            }
+            result.m_type = TYPE_NUMBER;
+            result.m_string.assign(m_text, start, m_position - start);
+            return true;
+        }
+
+        bool parseObject(JsonValue & result) {
+            if (++m_depth > MAX_DEPTH) {
+                return false;
+            }
+            result.m_type = TYPE_OBJECT;
+            ++m_position; // '{'
+            skipWhitespace();
+            if (m_position < m_text.size() && m_text[m_position] == '}') {
+                ++m_position;
+                --m_depth;
+                return true;
+            }
+            while (true) {
+                skipWhitespace();
+                result.m_members.push_back(Member());
+                Member & member = result.m_members.back();
+                if (m_position >= m_text.size() || m_text[m_position] != '"' || !parseString(member.first)) {
+                    return false;
+                }
+                skipWhitespace();
+                if (m_position >= m_text.size() || m_text[m_position] != ':') {
+                    return false;
+                }
+                ++m_position;
+                if (!parseValue(member.second)) {
+                    return false;
+                }
+                skipWhitespace();
+                if (m_position >= m_text.size()) {
+                    return false;
+                }
+                if (m_text[m_position] == ',') {
+                    ++m_position;
+                } else if (m_text[m_position] == '}') {
+                    ++m_position;
+                    --m_depth;
+                    return true;
+                } else {
+                    return false;
+                }
+            }
+        }
+
+        bool parseArray(JsonValue & result) {
+            if (++m_depth > MAX_DEPTH) {
+                return false;
+            }
+            result.m_type = TYPE_ARRAY;
+            ++m_position; // '['
+            skipWhitespace();
+            if (m_position < m_text.size() && m_text[m_position] == ']') {
+                ++m_position;
+                --m_depth;
+                return true;
+            }
+            while (true) {
+                result.m_items.push_back(JsonValue());
+                if (!parseValue(result.m_items.back())) {
+                    return false;
+                }
+                skipWhitespace();
+                if (m_position >= m_text.size()) {
+                    return false;
+                }
+                if (m_text[m_position] == ',') {
+                    ++m_position;
+                } else if (m_text[m_position] == ']') {
+                    ++m_position;
+                    --m_depth;
+                    return true;
+                } else {
+                    return false;
+                }
+            }
+        }
+
+        bool parseHexDigits(unsigned & result) {
+            if (m_position + 4 > m_text.size()) {
+                return false;
+            }
+            result = 0;
+            for (size_t i = 0; i < 4; ++i) {
+                char c = m_text[m_position++];
+                result <<= 4;
+                if (c >= '0' && c <= '9') {
+                    result |= unsigned(c - '0');
+                } else if (c >= 'a' && c <= 'f') {
+                    result |= unsigned(c - 'a' + 10);
+                } else if (c >= 'A' && c <= 'F') {
+                    result |= unsigned(c - 'A' + 10);
+                } else {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        static void appendUtf8(std::string & output, unsigned codePoint) {
+            if (codePoint < 0x80) {
+                output += char(codePoint);
+            } else if (codePoint < 0x800) {
+                output += char(0xC0 | (codePoint >> 6));
+                output += char(0x80 | (codePoint & 0x3F));
+            } else if (codePoint < 0x10000) {
+                output += char(0xE0 | (codePoint >> 12));
+                output += char(0x80 | ((codePoint >> 6) & 0x3F));
+                output += char(0x80 | (codePoint & 0x3F));
+            } else {
+                output += char(0xF0 | (codePoint >> 18));
+                output += char(0x80 | ((codePoint >> 12) & 0x3F));
+                output += char(0x80 | ((codePoint >> 6) & 0x3F));
+                output += char(0x80 | (codePoint & 0x3F));
+            }
+        }
+
+        bool parseString(std::string & output) {
+            static ByteSet const SPECIAL = ByteSet('"').add('\\');
+            ++m_position; // opening quote
+            output.clear();
+            while (m_position < m_text.size()) {
+                size_t runLength = findFirstOf(m_text.data() + m_position, m_text.size() - m_position, SPECIAL);
+                output.append(m_text, m_position, runLength);
+                m_position += runLength;
+                if (m_position >= m_text.size()) {
+                    return false;
+                }
+                char c = m_text[m_position++];
+                if (c == '"') {
+                    return true;
+                }
+                if (m_position >= m_text.size()) {
+                    return false;
+                }
+                char escaped = m_text[m_position++];
+                switch (escaped) {
+                    case '"': output += '"'; break;
+                    case '\\': output += '\\'; break;
+                    case '/': output += '/'; break;
+                    case 'b': output += '\b'; break;
+                    case 'f': output += '\f'; break;
+                    case 'n': output += '\n'; break;
+                    case 'r': output += '\r'; break;
+                    case 't': output += '\t'; break;
+                    case 'u': {
+                        unsigned codePoint;
+                        if (!parseHexDigits(codePoint)) {
+                            return false;
+                        }
+                        if (codePoint >= 0xD800 && codePoint < 0xDC00
+                            && consumeLiteral("\\u")) {
+                            unsigned lowSurrogate;
+                            if (!parseHexDigits(lowSurrogate) || lowSurrogate < 0xDC00 || lowSurrogate > 0xDFFF) {
+                                return false;
+                            }
+                            codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (lowSurrogate - 0xDC00);
+                        }
+                        appendUtf8(output, codePoint);
+                        break;
+                    }
+                    default:
+                        return false;
+                }
+            }
+            return false;
+        }
+    };
+};
+
+}
+}
+#endif
@@ -0,0 +1,192 @@
+// This source file is part of the 'tau' open source project.
+// Copyright (c) 2016, Yuriy Vosel.
+// Licensed under Boost Software License.
+// See LICENSE.txt for the licence information.
+
+#ifndef TAU_ADDITIONAL_UTIL_METERED_EVENTS_DISPATCHER_H
+#define TAU_ADDITIONAL_UTIL_METERED_EVENTS_DISPATCHER_H
+
+#include <tau/util/basic_events_dispatcher.h>
+#include <tau_additional/util/metrics.h>
+#include <tau_additional/util/monotonic_clock.h>
+#include <stdint.h>
+#include <algorithm>
+#include <string>
+
+namespace tau_additional {
+namespace util {
+
+namespace metered_events_dispatcher_details {
+    enum PacketType {
+        REQUEST_PROCESSING_ERROR,
+        CLIENT_DEVICE_INFO,
+        BUTTON_CLICK,
+        LAYOUT_PAGE_SWITCHED,
+        BOOL_VALUE_UPDATE,
+        TEXT_VALUE_UPDATE,
+        PACKET_TYPES_COUNT
+    };
+
+    inline char const * getPacketTypeName(unsigned packetType) {
+        static char const * const names[PACKET_TYPES_COUNT] = {
+            "requestProcessingError",
+            "clientDeviceInfo",
+            "buttonClick",
+            "layoutPageSwitched",
+            "boolValueUpdate",
+            "textValueUpdate"
+        };
+        return names[packetType];
+    }
+
+    // The metrics of one packet type
+    struct PacketTypeMetrics
+    {
+        MetricsCounter * packetsReceived;
+        MetricsHistogram * handlerTime;
+    };
+
+    // The metrics of all the packet types in the current registry. Cached per thread:
+    // the connections of one event loop take them without the registry's lock.
+    inline PacketTypeMetrics const * getPacketTypesMetrics() {
+        static __thread uint64_t cachedRegistryID = 0;
+        static __thread PacketTypeMetrics cachedMetrics[PACKET_TYPES_COUNT];
+        MetricsRegistry & registry = MetricsRegistry::getCurrent();
+        if (cachedRegistryID != registry.getID()) {
+            for (unsigned i = 0; i < PACKET_TYPES_COUNT; ++i) {
+                std::string name(getPacketTypeName(i));
+                cachedMetrics[i].packetsReceived = &registry.getCounter("packets_received." + name);
+                cachedMetrics[i].handlerTime = &registry.getHistogram("handler_time_ns." + name);
+            }
+            cachedRegistryID = registry.getID();
+        }
+        return cachedMetrics;
+    }
+};
+
+// Measuring stage in front of the events dispatcher. Counts the received packets of every type
+// and records the time, spent in every packetReceived_* callback, into the current MetricsRegistry
+// (packets_received.<type> counters, handler_time_ns.<type> histograms; see MetricsRegistry::getCurrent()).
+// The totals of the connection are registered in the MetricsRegistry too, so the snapshot shows
+// the clients, whose requests cost the most. The handlers time is also excluded from the
+// parse time, which the RawIncomingDataStreamParser records.
+//
+// Usage: EpollServer<MeteredEventsDispatcher<MyEventsDispatcher> > server(port);
+// When combined with the other stages, the metered one should be the outer one
+// (MeteredEventsDispatcher<CoalescingEventsDispatcher<MyEventsDispatcher> >).
+template <typename EventsDispatcherType>
+class MeteredEventsDispatcher : public EventsDispatcherType
+{
+    typedef metered_events_dispatcher_details::PacketTypeMetrics PacketTypeMetrics;
+
+    class HandlerTimer
+    {
+        MeteredEventsDispatcher & m_owner;
+        PacketTypeMetrics const & m_metrics;
+        uint64_t m_start;
+
+        HandlerTimer(HandlerTimer const &);
+        HandlerTimer & operator = (HandlerTimer const &);
+    public:
+        HandlerTimer(MeteredEventsDispatcher & owner, unsigned packetType):
+            m_owner(owner),
+            m_metrics(owner.m_packetTypesMetrics[packetType]),
+            m_start(getMonotonicNanoseconds())
+        {};
+        ~HandlerTimer() {
+            uint64_t elapsed = getMonotonicNanoseconds() - m_start;
+            m_metrics.packetsReceived->increment();
+            m_metrics.handlerTime->record(elapsed);
+            m_owner.m_connectionMetrics.packetsReceived.increment();
+            m_owner.m_connectionMetrics.handlersNanoseconds.add(elapsed);
+            metrics_details::getHandlersNanoseconds() += elapsed;
+        }
+    };
+
+    PacketTypeMetrics m_packetTypesMetrics[metered_events_dispatcher_details::PACKET_TYPES_COUNT];
+    ConnectionMetrics m_connectionMetrics;
+    MetricsRegistry & m_registry; // the current one of the thread, which has created the connection
+    bool m_connectionRegistered;
+public:
+    MeteredEventsDispatcher(
+        tau::communications_handling::OutgiongPacketsGenerator & outgoingGeneratorToUse):
+            EventsDispatcherType(outgoingGeneratorToUse),
+            m_registry(MetricsRegistry::getCurrent()),
+            m_connectionRegistered(false)
+        {
+            PacketTypeMetrics const * packetTypesMetrics = metered_events_dispatcher_details::getPacketTypesMetrics();
+            std::copy(packetTypesMetrics, packetTypesMetrics + metered_events_dispatcher_details::PACKET_TYPES_COUNT,
+                m_packetTypesMetrics);
+        };
+
+    virtual ~MeteredEventsDispatcher() {
+        unregisterConnection();
+    }
+
+    virtual void onClientConnected(
+        tau::communications_handling::ClientConnectionInfo const & connectionInfo)
+    {
+        m_registry.addConnection(m_connectionMetrics, connectionInfo.getRemoteAddrDump());
+        m_connectionRegistered = true;
+        EventsDispatcherType::onClientConnected(connectionInfo);
+    }
+    virtual void onConnectionClosed()
+    {
+        EventsDispatcherType::onConnectionClosed();
+        unregisterConnection();
+    }
+
+    virtual void packetReceived_requestProcessingError(
+        std::string const & layoutID, std::string const & additionalData)
+    {
+        HandlerTimer timer(*this, metered_events_dispatcher_details::REQUEST_PROCESSING_ERROR);
+        EventsDispatcherType::packetReceived_requestProcessingError(layoutID, additionalData);
+    }
+    virtual void packetReceived_clientDeviceInfo(
+        tau::communications_handling::ClientDeviceInfo const & info)
+    {
+        HandlerTimer timer(*this, metered_events_dispatcher_details::CLIENT_DEVICE_INFO);
+        EventsDispatcherType::packetReceived_clientDeviceInfo(info);
+    }
+    virtual void packetReceived_buttonClick(
+        tau::common::ElementID const & buttonID)
+    {
+        HandlerTimer timer(*this, metered_events_dispatcher_details::BUTTON_CLICK);
+        EventsDispatcherType::packetReceived_buttonClick(buttonID);
+    }
+    virtual void packetReceived_layoutPageSwitched(
+        tau::common::LayoutPageID const & newActiveLayoutPageID)
+    {
+        HandlerTimer timer(*this, metered_events_dispatcher_details::LAYOUT_PAGE_SWITCHED);
+        EventsDispatcherType::packetReceived_layoutPageSwitched(newActiveLayoutPageID);
+    }
+    virtual void packetReceived_boolValueUpdate(
+        tau::common::ElementID const & inputBoxID,
+        bool new_value, bool is_automatic_update)
+    {
+        HandlerTimer timer(*this, metered_events_dispatcher_details::BOOL_VALUE_UPDATE);
+        EventsDispatcherType::packetReceived_boolValueUpdate(inputBoxID, new_value, is_automatic_update);
+    }
+    virtual void packetReceived_textValueUpdate(
+        tau::common::ElementID const & inputBoxID,
+        std::string const & new_value, bool is_automatic_update)
+    {
+        HandlerTimer timer(*this, metered_events_dispatcher_details::TEXT_VALUE_UPDATE);
+        EventsDispatcherType::packetReceived_textValueUpdate(inputBoxID, new_value, is_automatic_update);
+    }
+
+    ConnectionMetrics const & getConnectionMetrics() const {
+        return m_connectionMetrics;
+    }
+private:
+    void unregisterConnection() {
+        if (m_connectionRegistered) {
+            m_connectionRegistered = false;
+            m_registry.removeConnection(m_connectionMetrics);
+        }
+    }
+};
+
+}
+}
+#endif
@@ -0,0 +1,363 @@
+// This source file is part of the 'tau' open source project.
+// Copyright (c) 2016, Yuriy Vosel.
+// Licensed under Boost Software License.
+// See LICENSE.txt for the licence information.
+
+#ifndef TAU_ADDITIONAL_UTIL_METRICS_H
+#define TAU_ADDITIONAL_UTIL_METRICS_H
+
+#include <tau_additional/util/monotonic_clock.h>
+#include <tau_additional/util/mutex.h>
+#include <stdint.h>
+#include <algorithm>
+#include <map>
+#include <ostream>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace tau_additional {
+namespace util {
+
+// Counter, which can be incremented from any thread without locks.
+class MetricsCounter
+{
+    volatile uint64_t m_value;
+
+    MetricsCounter(MetricsCounter const &);
+    MetricsCounter & operator = (MetricsCounter const &);
+public:
+    MetricsCounter(): m_value(0) {};
+
+    void add(uint64_t value) {
+        __sync_fetch_and_add(&m_value, value);
+    }
+    void increment() {
+        __sync_fetch_and_add(&m_value, uint64_t(1));
+    }
+    uint64_t getValue() const {
+        return __sync_fetch_and_add(const_cast<volatile uint64_t *>(&m_value), uint64_t(0));
+    }
+};
+
+// Histogram with the log-linear buckets (the HdrHistogram layout): every power of two range is
+// split into SUB_BUCKETS equal buckets, so the values are recorded with ~6% precision
+// from 1 to 2^64 with the fixed memory footprint (~8 KB). Recording is lock-free.
+// The values up to SUB_BUCKETS are exact.
+class MetricsHistogram
+{
+public:
+    static const unsigned SUB_BUCKET_BITS = 4;
+    static const unsigned SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+    static const unsigned BUCKETS_COUNT = (64 - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+    // Consistent enough copy of the histogram (the concurrent records may be half-visible).
+    struct Snapshot
+    {
+        Snapshot(): count(0), sum(0), max(0) {
+            for (unsigned i = 0; i < BUCKETS_COUNT; ++i) {
+                buckets[i] = 0;
+            }
+        };
+        uint64_t buckets[BUCKETS_COUNT];
+        uint64_t count;
+        uint64_t sum;
+        uint64_t max;
+
+        // Merges the records of the other histogram (for example, of the other shard)
+        void add(Snapshot const & other) {
+            for (unsigned i = 0; i < BUCKETS_COUNT; ++i) {
+                buckets[i] += other.buckets[i];
+            }
+            count += other.count;
+            sum += other.sum;
+            max = std::max(max, other.max);
+        }
+
+        uint64_t getMean() const {
+            return (count > 0) ? (sum / count) : 0;
+        }
+        // The value, below which the given fraction of the records is (0.99 for p99).
+        // The result is the middle of the bucket, capped by the max recorded value.
+        uint64_t getPercentile(double fraction) const {
+            if (count == 0) {
+                return 0;
+            }
+            uint64_t rank = uint64_t(fraction * double(count) + 0.5);
+            if (rank == 0) {
+                rank = 1;
+            }
+            uint64_t seen = 0;
+            for (unsigned i = 0; i < BUCKETS_COUNT; ++i) {
+                seen += buckets[i];
+                if (seen >= rank) {
+                    uint64_t result = getBucketLowerBound(i) + getBucketWidth(i) / 2;
+                    return (result < max) ? result : max;
+                }
+            }
+            return max;
+        }
+    };
+private:
+    volatile uint64_t m_buckets[BUCKETS_COUNT];
+    volatile uint64_t m_count;
+    volatile uint64_t m_sum;
+    volatile uint64_t m_max;
+
+    MetricsHistogram(MetricsHistogram const &);
+    MetricsHistogram & operator = (MetricsHistogram const &);
+public:
+    MetricsHistogram(): m_count(0), m_sum(0), m_max(0) {
+        for (unsigned i = 0; i < BUCKETS_COUNT; ++i) {
+            m_buckets[i] = 0;
+        }
+    };
+
+    void record(uint64_t value) {
+        __sync_fetch_and_add(&m_buckets[getBucketIndex(value)], uint64_t(1));
+        __sync_fetch_and_add(&m_count, uint64_t(1));
+        __sync_fetch_and_add(&m_sum, value);
+        uint64_t currentMax = m_max;
+        while (value > currentMax) {
+            uint64_t previous = __sync_val_compare_and_swap(&m_max, currentMax, value);
+            if (previous == currentMax) {
+                break;
+            }
+            currentMax = previous;
+        }
+    }
+
+    void getSnapshot(Snapshot & result) const {
+        for (unsigned i = 0; i < BUCKETS_COUNT; ++i) {
+            result.buckets[i] = m_buckets[i];
+        }
+        result.count = m_count;
+        result.sum = m_sum;
+        result.max = m_max;
+    }
+
+    static unsigned getBucketIndex(uint64_t value) {
+        if (value < SUB_BUCKETS) {
+            return unsigned(value);
+        }
+        unsigned highestBit = 63 - unsigned(__builtin_clzll(value));
+        unsigned shift = highestBit - SUB_BUCKET_BITS;
+        // The top SUB_BUCKET_BITS + 1 bits of the value select the bucket within its power of two
+        return (shift + 1) * SUB_BUCKETS + unsigned(value >> shift) - SUB_BUCKETS;
+    }
+    static uint64_t getBucketLowerBound(unsigned index) {
+        if (index < SUB_BUCKETS) {
+            return index;
+        }
+        unsigned shift = index / SUB_BUCKETS - 1;
+        return uint64_t(SUB_BUCKETS + index % SUB_BUCKETS) << shift;
+    }
+    static uint64_t getBucketWidth(unsigned index) {
+        return (index < SUB_BUCKETS) ? 1 : (uint64_t(1) << (index / SUB_BUCKETS - 1));
+    }
+};
+
+// Per-connection totals, which let to find the clients (panels), that cost the most.
+// Registered in the MetricsRegistry for the connection lifetime.
+struct ConnectionMetrics
+{
+    MetricsCounter packetsReceived;
+    MetricsCounter handlersNanoseconds;
+};
+
+// Set of the named counters and histograms.
+// The process-wide one (getInstance()) is never deleted: its metric objects live till the process exit,
+// so the references can be cached (for example, in the function-local static variables)
+// and used from any thread. Only the creation takes the lock.
+// The event loop thread, which should not share the cache lines with the other loops (for example,
+// the shard of the ShardedServer), makes its own registry current (see setCurrent()). The data path
+// objects take their metrics from the current registry (see getCurrent()), and the snapshot of the
+// process-wide registry sums the ones of the registries, which are attached to it.
+// The metrics of the attached registry live as long as the registry.
+class MetricsRegistry
+{
+    typedef std::map<std::string, MetricsCounter *> Counters;
+    typedef std::map<std::string, MetricsHistogram *> Histograms;
+    typedef std::map<ConnectionMetrics const *, std::string> Connections;
+    typedef std::set<MetricsRegistry *> AttachedRegistries;
+
+    typedef std::map<std::string, uint64_t> CounterValues;
+    typedef std::map<std::string, MetricsHistogram::Snapshot> HistogramSnapshots;
+    typedef std::vector<std::pair<uint64_t, std::pair<uint64_t, std::string> > > ConnectionValues;
+
+    Mutex m_mutex;
+    Counters m_counters;
+    Histograms m_histograms;
+    Connections m_connections;
+    MetricsRegistry * m_parent;
+    AttachedRegistries m_attached;
+    uint64_t m_id;
+
+    MetricsRegistry(): m_parent(NULL), m_id(createID()) {};
+    MetricsRegistry(MetricsRegistry const &);
+    MetricsRegistry & operator = (MetricsRegistry const &);
+public:
+    // The registry, which is summed into the parent's snapshot
+    explicit MetricsRegistry(MetricsRegistry & parent): m_parent(&parent), m_id(createID()) {
+        ScopedLock lock(parent.m_mutex);
+        parent.m_attached.insert(this);
+    };
+
+    // Should be destroyed after the objects, which use its metrics
+    ~MetricsRegistry() {
+        if (m_parent != NULL) {
+            ScopedLock lock(m_parent->m_mutex);
+            m_parent->m_attached.erase(this);
+        }
+        for (Counters::iterator it = m_counters.begin(); it != m_counters.end(); ++it) {
+            delete it->second;
+        }
+        for (Histograms::iterator it = m_histograms.begin(); it != m_histograms.end(); ++it) {
+            delete it->second;
+        }
+    }
+
+    static MetricsRegistry & getInstance() {
+        static MetricsRegistry * instance = new MetricsRegistry(); // never deleted: used by the exit-time threads
+        return *instance;
+    }
+
+    // The registry of the calling thread: the one, which was set by setCurrent(), or the process-wide one
+    static MetricsRegistry & getCurrent() {
+        MetricsRegistry * current = getCurrentPointer();
+        return (current != NULL) ? *current : getInstance();
+    }
+    // NULL - back to the process-wide one
+    static void setCurrent(MetricsRegistry * registry) {
+        getCurrentPointer() = registry;
+    }
+
+    // Unique within the process (unlike the address, which the next registry may reuse)
+    uint64_t getID() const {
+        return m_id;
+    }
+
+    MetricsCounter & getCounter(std::string const & name) {
+        ScopedLock lock(m_mutex);
+        MetricsCounter *& result = m_counters[name];
+        if (result == NULL) {
+            result = new MetricsCounter();
+        }
+        return *result;
+    }
+
+    MetricsHistogram & getHistogram(std::string const & name) {
+        ScopedLock lock(m_mutex);
+        MetricsHistogram *& result = m_histograms[name];
+        if (result == NULL) {
+            result = new MetricsHistogram();
+        }
+        return *result;
+    }
+
+    // The name is shown in the snapshot (for example, the remote address of the client).
+    void addConnection(ConnectionMetrics const & connection, std::string const & name) {
+        ScopedLock lock(m_mutex);
+        m_connections[&connection] = name;
+    }
+    void removeConnection(ConnectionMetrics const & connection) {
+        ScopedLock lock(m_mutex);
+        m_connections.erase(&connection);
+    }
+
+    // Text dump, one metric per line:
+    //   counter <name> <value>
+    //   histogram <name> count=... mean=... p50=... p99=... p999=... max=...
+    //   connection <name> packets=... handlers_time_ns=...
+    // The metrics of the attached registries are summed by name.
+    // The connections are sorted by the time spent in their handlers, only the top ones are shown.
+    void writeSnapshot(std::ostream & output, size_t maxConnectionsToShow = 20) {
+        CounterValues counters;
+        HistogramSnapshots histograms;
+        ConnectionValues connections;
+        {
+            // The attached registries detach themselves under this lock
+            ScopedLock lock(m_mutex);
+            collectValues(counters, histograms, connections);
+            for (AttachedRegistries::const_iterator it = m_attached.begin(); it != m_attached.end(); ++it) {
+                ScopedLock attachedLock((*it)->m_mutex);
+                (*it)->collectValues(counters, histograms, connections);
+            }
+        }
+        for (CounterValues::const_iterator it = counters.begin(); it != counters.end(); ++it) {
+            output << "counter " << it->first << " " << it->second << "\n";
+        }
+        for (HistogramSnapshots::const_iterator it = histograms.begin(); it != histograms.end(); ++it) {
+            MetricsHistogram::Snapshot const & snapshot = it->second;
+            output << "histogram " << it->first
+                << " count=" << snapshot.count
+                << " mean=" << snapshot.getMean()
+                << " p50=" << snapshot.getPercentile(0.5)
+                << " p99=" << snapshot.getPercentile(0.99)
+                << " p999=" << snapshot.getPercentile(0.999)
+                << " max=" << snapshot.max << "\n";
+        }
+        std::sort(connections.rbegin(), connections.rend());
+        output << "counter connections.active " << connections.size() << "\n";
+        for (size_t i = 0; i < connections.size() && i < maxConnectionsToShow; ++i) {
+            output << "connection " << connections[i].second.second
+                << " packets=" << connections[i].second.first
+                << " handlers_time_ns=" << connections[i].first << "\n";
+        }
+    }
+private:
+    static uint64_t createID() {
+        static volatile uint64_t lastID = 0;
+        return __sync_add_and_fetch(&lastID, uint64_t(1));
+    }
+
+    static MetricsRegistry *& getCurrentPointer() {
+        static __thread MetricsRegistry * current = NULL;
+        return current;
+    }
+
+    // Under the lock: the connections unregister themselves under it, so their counters can be read here
+    void collectValues(CounterValues & counters, HistogramSnapshots & histograms, ConnectionValues & connections) const {
+        for (Counters::const_iterator it = m_counters.begin(); it != m_counters.end(); ++it) {
+            counters[it->first] += it->second->getValue();
+        }
+        MetricsHistogram::Snapshot snapshot;
+        for (Histograms::const_iterator it = m_histograms.begin(); it != m_histograms.end(); ++it) {
+            it->second->getSnapshot(snapshot);
+            histograms[it->first].add(snapshot);
+        }
+        for (Connections::const_iterator it = m_connections.begin(); it != m_connections.end(); ++it) {
+            connections.push_back(std::make_pair(it->first->handlersNanoseconds.getValue(),
+                std::make_pair(it->first->packetsReceived.getValue(), it->second)));
+        }
+    }
+};
+
+namespace metrics_details {
+    // Time, spent by the current thread in the measured events dispatcher callbacks.
+    // Lets the incoming data parser exclude the handlers time from its own time.
+    inline uint64_t & getHandlersNanoseconds() {
+        static __thread uint64_t handlersNanoseconds = 0;
+        return handlersNanoseconds;
+    }
+
+    inline volatile int & getDataPathMetricsFlag() {
+        static volatile int enabled = 0;
+        return enabled;
+    }
+};
+
+// The metrics of the data path (the incoming data parser, the outgoing packets generators) are
+// recorded only after they are enabled: the exporters (see metrics_exporter.h) enable them, when they
+// start. Until then no clock reads and no shared counter updates are made per chunk or per flush.
+inline void enableDataPathMetrics(bool enabled = true) {
+    __sync_lock_test_and_set(&metrics_details::getDataPathMetricsFlag(), enabled ? 1 : 0);
+}
+
+inline bool areDataPathMetricsEnabled() {
+    return metrics_details::getDataPathMetricsFlag() != 0;
+}
+
+}
+}
+#endif
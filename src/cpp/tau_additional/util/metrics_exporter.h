@@ -0,0 +1,257 @@
+// This source file is part of the 'tau' open source project.
+// Copyright (c) 2016, Yuriy Vosel.
+// Licensed under Boost Software License.
+// See LICENSE.txt for the licence information.
+
+#ifndef TAU_ADDITIONAL_UTIL_METRICS_EXPORTER_H
+#define TAU_ADDITIONAL_UTIL_METRICS_EXPORTER_H
+
+#include <tau_additional/util/metrics.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+namespace tau_additional {
+namespace util {
+
+namespace metrics_exporter_details {
+    inline std::string getSnapshotText() {
+        std::ostringstream result;
+        MetricsRegistry::getInstance().writeSnapshot(result);
+        return result.str();
+    }
+
+    inline bool sendAll(int handle, std::string const & data) {
+        size_t sent = 0;
+        while (sent < data.size()) {
+            ssize_t result = send(handle, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+            if (result == -1 && errno == EINTR) {
+                continue;
+            }
+            if (result <= 0) {
+                return false;
+            }
+            sent += size_t(result);
+        }
+        return true;
+    }
+};
+
+// Writes the MetricsRegistry snapshot to the file every periodMilliseconds from its own thread.
+// The snapshot is written to '<path>.tmp' first and then renamed, so the readers (tail, scripts)
+// never see a half-written file.
+class MetricsFileDumper
+{
+    std::string m_path;
+    unsigned m_periodMilliseconds;
+    pthread_t m_thread;
+    bool m_started;
+    volatile int m_stopRequested;
+
+    MetricsFileDumper(MetricsFileDumper const &);
+    MetricsFileDumper & operator = (MetricsFileDumper const &);
+public:
+    MetricsFileDumper(std::string const & path, unsigned periodMilliseconds = 10000):
+        m_path(path),
+        m_periodMilliseconds(periodMilliseconds > 0 ? periodMilliseconds : 1),
+        m_started(false),
+        m_stopRequested(0)
+    {};
+    ~MetricsFileDumper() {
+        stop();
+    }
+
+    bool start() {
+        if (m_started) {
+            return true;
+        }
+        enableDataPathMetrics();
+        __sync_lock_test_and_set(&m_stopRequested, 0);
+        m_started = (pthread_create(&m_thread, NULL, &MetricsFileDumper::threadFunction, this) == 0);
+        return m_started;
+    }
+
+    // Writes the last snapshot and joins the thread.
+    void stop() {
+        if (!m_started) {
+            return;
+        }
+        __sync_lock_test_and_set(&m_stopRequested, 1);
+        pthread_join(m_thread, NULL);
+        m_started = false;
+    }
+
+    bool dumpNow() const {
+        std::string temporaryPath(m_path + ".tmp");
+        {
+            std::ofstream output(temporaryPath.c_str(), std::ios::out | std::ios::trunc);
+            output << metrics_exporter_details::getSnapshotText();
+            if (!output) {
+                return false;
+            }
+        }
+        return rename(temporaryPath.c_str(), m_path.c_str()) == 0;
+    }
+private:
+    static void * threadFunction(void * parameter) {
+        static_cast<MetricsFileDumper *>(parameter)->run();
+        return NULL;
+    }
+
+    void run() {
+        // The stop request is checked every 100 ms, so stop() does not wait for the whole period
+        timespec slice;
+        slice.tv_sec = 0;
+        slice.tv_nsec = 100 * 1000000;
+        unsigned sinceLastDump = 0;
+        while (!__sync_fetch_and_add(&m_stopRequested, 0)) {
+            nanosleep(&slice, NULL);
+            sinceLastDump += 100;
+            if (sinceLastDump >= m_periodMilliseconds) {
+                sinceLastDump = 0;
+                dumpNow();
+            }
+        }
+        dumpNow();
+    }
+};
+
+// Serves the MetricsRegistry snapshot on the local (127.0.0.1) TCP port from its own thread:
+// every accepted connection gets the snapshot text and is closed.
+// Works with curl (an HTTP request gets the HTTP response) and with nc/telnet (plain text):
+//   curl http://127.0.0.1:<port>/
+class MetricsTextEndpoint
+{
+    static const int REQUEST_WAIT_MILLISECONDS = 100;
+
+    unsigned short m_port;
+    int m_listenSocketHandle;
+    pthread_t m_thread;
+    bool m_started;
+    volatile int m_stopRequested;
+    std::string m_lastError;
+
+    MetricsTextEndpoint(MetricsTextEndpoint const &);
+    MetricsTextEndpoint & operator = (MetricsTextEndpoint const &);
+public:
+    explicit MetricsTextEndpoint(unsigned short port):
+        m_port(port),
+        m_listenSocketHandle(-1),
+        m_started(false),
+        m_stopRequested(0)
+    {};
+    ~MetricsTextEndpoint() {
+        stop();
+    }
+
+    // Returns false (see getLastError()) if the port can't be listened on.
+    bool start() {
+        if (m_started) {
+            return true;
+        }
+        m_listenSocketHandle = socket(AF_INET, SOCK_STREAM, 0);
+        if (m_listenSocketHandle == -1) {
+            return setError("Can't create the socket");
+        }
+        int reuseAddr = 1;
+        setsockopt(m_listenSocketHandle, SOL_SOCKET, SO_REUSEADDR, &reuseAddr, sizeof(reuseAddr));
+        sockaddr_in address;
+        memset(&address, 0, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        address.sin_port = htons(m_port);
+        if (bind(m_listenSocketHandle, (sockaddr*)(&address), sizeof(address)) < 0) {
+            return setError("Can't bind the socket");
+        }
+        if (listen(m_listenSocketHandle, 16) < 0) {
+            return setError("Can't listen on the socket");
+        }
+        enableDataPathMetrics();
+        __sync_lock_test_and_set(&m_stopRequested, 0);
+        if (pthread_create(&m_thread, NULL, &MetricsTextEndpoint::threadFunction, this) != 0) {
+            return setError("Can't start the thread");
+        }
+        m_started = true;
+        return true;
+    }
+
+    void stop() {
+        if (m_started) {
+            __sync_lock_test_and_set(&m_stopRequested, 1);
+            shutdown(m_listenSocketHandle, SHUT_RDWR); // wakes the accept() up
+            pthread_join(m_thread, NULL);
+            m_started = false;
+        }
+        if (m_listenSocketHandle != -1) {
+            close(m_listenSocketHandle);
+            m_listenSocketHandle = -1;
+        }
+    }
+
+    std::string const & getLastError() const {
+        return m_lastError;
+    }
+private:
+    bool setError(std::string const & message) {
+        m_lastError = message + ": " + strerror(errno);
+        if (m_listenSocketHandle != -1) {
+            close(m_listenSocketHandle);
+            m_listenSocketHandle = -1;
+        }
+        return false;
+    }
+
+    static void * threadFunction(void * parameter) {
+        static_cast<MetricsTextEndpoint *>(parameter)->run();
+        return NULL;
+    }
+
+    void run() {
+        while (!__sync_fetch_and_add(&m_stopRequested, 0)) {
+            int clientHandle = accept(m_listenSocketHandle, NULL, NULL);
+            if (clientHandle == -1) {
+                if (errno == EINTR || errno == ECONNABORTED) {
+                    continue;
+                }
+                return;
+            }
+            serveClient(clientHandle);
+            close(clientHandle);
+        }
+    }
+
+    void serveClient(int clientHandle) {
+        // The client may send nothing (nc), so the request is waited for only a short time
+        timeval timeout;
+        timeout.tv_sec = 0;
+        timeout.tv_usec = REQUEST_WAIT_MILLISECONDS * 1000;
+        setsockopt(clientHandle, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        char request[1024];
+        ssize_t requestSize = recv(clientHandle, request, sizeof(request), 0);
+        std::string snapshot(metrics_exporter_details::getSnapshotText());
+        if (requestSize >= 4 && memcmp(request, "GET ", 4) == 0) {
+            std::ostringstream header;
+            header << "HTTP/1.0 200 OK\r\nContent-Type: text/plain\r\nContent-Length: "
+                << snapshot.size() << "\r\nConnection: close\r\n\r\n";
+            if (!metrics_exporter_details::sendAll(clientHandle, header.str())) {
+                return;
+            }
+        }
+        metrics_exporter_details::sendAll(clientHandle, snapshot);
+    }
+};
+
+}
+}
+#endif
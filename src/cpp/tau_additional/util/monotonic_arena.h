@@ -0,0 +1,136 @@
+// This source file is part of the 'tau' open source project.
+// Copyright (c) 2016, Yuriy Vosel.
+// Licensed under Boost Software License.
+// See LICENSE.txt for the licence information.
+
+#ifndef TAU_ADDITIONAL_UTIL_MONOTONIC_ARENA_H
+#define TAU_ADDITIONAL_UTIL_MONOTONIC_ARENA_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <new>
+
+namespace tau_additional {
+namespace util {
+
+// Allocates the memory from the big blocks and frees it all at once. The objects are not
+// destroyed, so only the trivially destructible ones should be placed there.
+// reset() keeps the blocks: the arena, which is reused for the similar work (for example,
+// building the same layout again), does not allocate at all after the first time.
+// Not thread-safe.
+class MonotonicArena
+{
+public:
+    struct Statistics
+    {
+        Statistics(): blocksAllocated(0), bytesAllocated(0), bytesUsed(0) {};
+        uint64_t blocksAllocated; // the heap allocations
+        uint64_t bytesAllocated;
+        uint64_t bytesUsed;       // since the last reset()
+    };
+
+    static const size_t DEFAULT_BLOCK_SIZE = 16 * 1024;
+    static const size_t ALIGNMENT = 16;
+private:
+    struct Block
+    {
+        Block * next;
+        size_t size; // of the data, which follows the header
+    };
+    static const size_t HEADER_SIZE = (sizeof(Block) + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+
+    Block * m_firstBlock;
+    Block * m_currentBlock;
+    size_t m_currentOffset;
+    size_t m_blockSize;
+    Statistics m_statistics;
+
+    MonotonicArena(MonotonicArena const &);
+    MonotonicArena & operator = (MonotonicArena const &);
+public:
+    explicit MonotonicArena(size_t blockSize = DEFAULT_BLOCK_SIZE):
+        m_firstBlock(NULL),
+        m_currentBlock(NULL),
+        m_currentOffset(0),
+        m_blockSize(blockSize > ALIGNMENT ? blockSize : ALIGNMENT)
+    {};
+    ~MonotonicArena() {
+        while (m_firstBlock != NULL) {
+            Block * next = m_firstBlock->next;
+            free(m_firstBlock);
+            m_firstBlock = next;
+        }
+    }
+
+    // The result is aligned to the ALIGNMENT. Throws std::bad_alloc, as the operator new does.
+    void * allocate(size_t size) {
+        size = (size + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+        if (m_currentBlock == NULL || m_currentBlock->size - m_currentOffset < size) {
+            switchToBlock(size);
+        }
+        void * result = getBlockData(m_currentBlock) + m_currentOffset;
+        m_currentOffset += size;
+        m_statistics.bytesUsed += size;
+        return result;
+    }
+
+    template <typename ObjectType>
+    ObjectType * create() {
+        return new (allocate(sizeof(ObjectType))) ObjectType();
+    }
+
+    // The copy is not zero-terminated.
+    char const * copyString(char const * data, size_t size) {
+        if (size == 0) {
+            return "";
+        }
+        char * result = static_cast<char *>(allocate(size));
+        memcpy(result, data, size);
+        return result;
+    }
+
+    // Everything, which was allocated, is forgotten; the blocks are kept for the reuse.
+    void reset() {
+        m_currentBlock = m_firstBlock;
+        m_currentOffset = 0;
+        m_statistics.bytesUsed = 0;
+    }
+
+    Statistics const & getStatistics() const {
+        return m_statistics;
+    }
+private:
+    static char * getBlockData(Block * block) {
+        return reinterpret_cast<char *>(block) + HEADER_SIZE;
+    }
+
+    // The next kept block is used, if it is big enough; otherwise the new one is inserted after the current.
+    void switchToBlock(size_t size) {
+        Block * next = (m_currentBlock != NULL) ? m_currentBlock->next : m_firstBlock;
+        if (next == NULL || next->size < size) {
+            size_t dataSize = (size > m_blockSize) ? size : m_blockSize;
+            Block * block = static_cast<Block *>(malloc(HEADER_SIZE + dataSize));
+            if (block == NULL) {
+                throw std::bad_alloc();
+            }
+            block->size = dataSize;
+            block->next = next;
+            if (m_currentBlock != NULL) {
+                m_currentBlock->next = block;
+            } else {
+                m_firstBlock = block;
+            }
+            ++m_statistics.blocksAllocated;
+            m_statistics.bytesAllocated += HEADER_SIZE + dataSize;
+            next = block;
+        }
+        m_currentBlock = next;
+        m_currentOffset = 0;
+    }
+};
+
+}
+}
+#endif
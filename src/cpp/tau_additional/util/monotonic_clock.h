@@ -0,0 +1,25 @@
+// This source file is part of the 'tau' open source project.
+// Copyright (c) 2016, Yuriy Vosel.
+// Licensed under Boost Software License.
+// See LICENSE.txt for the licence information.
+
+#ifndef TAU_ADDITIONAL_UTIL_MONOTONIC_CLOCK_H
+#define TAU_ADDITIONAL_UTIL_MONOTONIC_CLOCK_H
+
+#include <time.h>
+#include <stdint.h>
+
+namespace tau_additional {
+namespace util {
+
+// Nanoseconds from some unspecified point in the past (CLOCK_MONOTONIC).
+// Suitable for measuring intervals, not for the wall clock time.
+inline uint64_t getMonotonicNanoseconds() {
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return uint64_t(now.tv_sec) * 1000000000ULL + uint64_t(now.tv_nsec);
+}
+
+}
+}
+#endif
@@ -0,0 +1,112 @@
+// This source file is part of the 'tau' open source project.
+// Copyright (c) 2016, Yuriy Vosel.
+// Licensed under Boost Software License.
+// See LICENSE.txt for the licence information.
+
+#ifndef TAU_ADDITIONAL_UTIL_MUTEX_H
+#define TAU_ADDITIONAL_UTIL_MUTEX_H
+
+#include <pthread.h>
+
+namespace tau_additional {
+namespace util {
+
+// Minimal pthread mutex wrapper (the POSIX builds don't depend on boost and may be C++03).
+class Mutex
+{
+    pthread_mutex_t m_mutex;
+
+    Mutex(Mutex const &);
+    Mutex & operator = (Mutex const &);
+public:
+    Mutex() {
+        pthread_mutex_init(&m_mutex, NULL);
+    };
+    ~Mutex() {
+        pthread_mutex_destroy(&m_mutex);
+    }
+    void lock() {
+        pthread_mutex_lock(&m_mutex);
+    }
+    // Returns false, if the mutex is locked by the other thread
+    bool tryLock() {
+        return pthread_mutex_trylock(&m_mutex) == 0;
+    }
+    void unlock() {
+        pthread_mutex_unlock(&m_mutex);
+    }
+};
+
+class ScopedLock
+{
+    Mutex & m_mutex;
+
+    ScopedLock(ScopedLock const &);
+    ScopedLock & operator = (ScopedLock const &);
+public:
+    explicit ScopedLock(Mutex & mutex): m_mutex(mutex) {
+        m_mutex.lock();
+    };
+    ~ScopedLock() {
+        m_mutex.unlock();
+    }
+};
+
+// Readers/writer lock: many concurrent readers or one writer.
+class ReadWriteMutex
+{
+    pthread_rwlock_t m_lock;
+
+    ReadWriteMutex(ReadWriteMutex const &);
+    ReadWriteMutex & operator = (ReadWriteMutex const &);
+public:
+    ReadWriteMutex() {
+        pthread_rwlock_init(&m_lock, NULL);
+    };
+    ~ReadWriteMutex() {
+        pthread_rwlock_destroy(&m_lock);
+    }
+    void lockForReading() {
+        pthread_rwlock_rdlock(&m_lock);
+    }
+    void lockForWriting() {
+        pthread_rwlock_wrlock(&m_lock);
+    }
+    void unlock() {
+        pthread_rwlock_unlock(&m_lock);
+    }
+};
+
+class ScopedReadLock
+{
+    ReadWriteMutex & m_mutex;
+
+    ScopedReadLock(ScopedReadLock const &);
+    ScopedReadLock & operator = (ScopedReadLock const &);
+public:
+    explicit ScopedReadLock(ReadWriteMutex & mutex): m_mutex(mutex) {
+        m_mutex.lockForReading();
+    };
+    ~ScopedReadLock() {
+        m_mutex.unlock();
+    }
+};
+
+class ScopedWriteLock
+{
+    ReadWriteMutex & m_mutex;
+
+    ScopedWriteLock(ScopedWriteLock const &);
+    ScopedWriteLock & operator = (ScopedWriteLock const &);
+public:
+    explicit ScopedWriteLock(ReadWriteMutex & mutex): m_mutex(mutex) {
+        m_mutex.lockForWriting();
+    };
+    ~ScopedWriteLock() {
+        m_mutex.unlock();
+    }
+};
+
+}
+}
+#endif
@@ -0,0 +1,376 @@
+// This source file is part of the 'tau' open source project.
+// Copyright (c) 2016, Yuriy Vosel.
+// Licensed under Boost Software License.
+// See LICENSE.txt for the licence information.
+
+#ifndef TAU_ADDITIONAL_UTIL_OFFLOADING_EVENTS_DISPATCHER_H
+#define TAU_ADDITIONAL_UTIL_OFFLOADING_EVENTS_DISPATCHER_H
+
+#include <tau/util/basic_events_dispatcher.h>
+#include <tau_additional/communications_handling/connection_executor.h>
+#include <tau_additional/communications_handling/shared_buffer_sender.h>
+#include <tau_additional/util/mutex.h>
+#include <tau_additional/util/shared_buffer.h>
+#include <tau_additional/util/worker_pool.h>
+#include <stddef.h>
+#include <string>
+
+namespace tau_additional {
+namespace util {
+
+namespace offloading_events_dispatcher_details {
+
+    // Outgoing packets generator of the offloaded dispatcher. Until startMarshalling() the calls
+    // go straight to the connection; after it they are called from the workers and are handed
+    // to the connection's thread as the ConnectionExecutor tasks (in the order of the calls).
+    // After stopMarshalling() (the connection is closed) the data is dropped.
+    class MarshallingOutgoingPacketsGenerator :
+        public tau::communications_handling::OutgiongPacketsGenerator,
+        public tau_additional::communications_handling::SharedBufferSender
+    {
+        typedef tau_additional::communications_handling::ConnectionExecutor ConnectionExecutor;
+
+        class SendDataTask : public ConnectionExecutor::Task
+        {
+            SharedBuffer m_data;
+        public:
+            explicit SendDataTask(SharedBuffer const & data): m_data(data) {};
+            virtual void run(tau::communications_handling::OutgiongPacketsGenerator & connection) {
+                tau_additional::communications_handling::sendSharedBuffer(connection, m_data);
+            }
+        };
+
+        class CloseConnectionTask : public ConnectionExecutor::Task
+        {
+        public:
+            virtual void run(tau::communications_handling::OutgiongPacketsGenerator & connection) {
+                connection.close_connection();
+            }
+        };
+
+        tau::communications_handling::OutgiongPacketsGenerator & m_connection;
+        Mutex m_mutex;
+        ConnectionExecutor * m_executor;
+        bool m_marshalling;
+
+        MarshallingOutgoingPacketsGenerator(MarshallingOutgoingPacketsGenerator const &);
+        MarshallingOutgoingPacketsGenerator & operator = (MarshallingOutgoingPacketsGenerator const &);
+    public:
+        explicit MarshallingOutgoingPacketsGenerator(
+            tau::communications_handling::OutgiongPacketsGenerator & connection):
+                m_connection(connection),
+                m_executor(NULL),
+                m_marshalling(false)
+            {};
+
+        // Called by the connection's thread
+        void startMarshalling(ConnectionExecutor & executor) {
+            ScopedLock lock(m_mutex);
+            m_executor = &executor;
+            m_marshalling = true;
+        }
+        // Called by the connection's thread. After the return the connection is not used anymore.
+        void stopMarshalling() {
+            ScopedLock lock(m_mutex);
+            m_executor = NULL;
+        }
+
+        virtual void sendData(std::string const & data) {
+            if (!m_marshalling) {
+                m_connection.sendData(data);
+            } else if (!data.empty()) {
+                execute(new SendDataTask(SharedBuffer(data)));
+            }
+        }
+        virtual void sendSharedBuffer(SharedBuffer const & data) {
+            if (!m_marshalling) {
+                tau_additional::communications_handling::sendSharedBuffer(m_connection, data);
+            } else if (!data.empty()) {
+                execute(new SendDataTask(data));
+            }
+        }
+        virtual void close_connection() {
+            if (!m_marshalling) {
+                m_connection.close_connection();
+            } else {
+                execute(new CloseConnectionTask());
+            }
+        }
+    private:
+        void execute(ConnectionExecutor::Task * task) {
+            ScopedLock lock(m_mutex);
+            if (m_executor != NULL) {
+                m_executor->execute(task);
+            } else {
+                delete task;
+            }
+        }
+    };
+};
+
+// Stage, which moves the events dispatcher off the network thread: the callbacks of the
+// EventsDispatcherType are run by the WorkerPool (see WorkerPool::getSharedInstance()), so a slow
+// handler (a database query, a blocking call) does not delay the other clients of the network
+// thread. Every connection has its own SerialTaskQueue, so the callbacks of one client are still
+// called one at a time and in the order of the packets. The sendPacket_* calls of the
+// EventsDispatcherType are handed back to the connection's thread.
+//
+// Usage: PooledBoostAsioServer<OffloadingEventsDispatcher<MySlowEventsDispatcher> > server(pool, port);
+// The connection should be a ConnectionExecutor (PooledBoostAsioServer); otherwise the callbacks
+// are called on the network thread, as without this stage. The EventsDispatcherType gets no
+// DelayedCallsScheduler (the delayed calls would run on the network thread), so the stages, which
+// need it, should be the outer ones: CoalescingEventsDispatcher<OffloadingEventsDispatcher<...> >.
+template <typename EventsDispatcherType>
+class OffloadingEventsDispatcher : public tau::util::BasicEventsDispatcher
+{
+    typedef offloading_events_dispatcher_details::MarshallingOutgoingPacketsGenerator MarshallingOutgoingPacketsGenerator;
+
+    // Deleted by the last task of the queue, after all the callbacks, which are still pending.
+    struct OffloadedDispatcher
+    {
+        explicit OffloadedDispatcher(tau::communications_handling::OutgiongPacketsGenerator & connection):
+            generator(connection),
+            dispatcher(generator)
+        {};
+        MarshallingOutgoingPacketsGenerator generator;
+        EventsDispatcherType dispatcher;
+    };
+
+    class CallbackTask : public SerialTaskQueue::Task
+    {
+    protected:
+        tau::util::BasicEventsDispatcher & m_dispatcher;
+    public:
+        explicit CallbackTask(OffloadedDispatcher & offloaded): m_dispatcher(offloaded.dispatcher) {};
+    };
+
+    class ClientConnectedTask : public CallbackTask
+    {
+        tau::communications_handling::ClientConnectionInfo m_connectionInfo;
+    public:
+        ClientConnectedTask(OffloadedDispatcher & offloaded,
+            tau::communications_handling::ClientConnectionInfo const & connectionInfo):
+                CallbackTask(offloaded), m_connectionInfo(connectionInfo) {};
+        virtual void run() {
+            this->m_dispatcher.onClientConnected(m_connectionInfo);
+        }
+    };
+
+    class ConnectionClosedTask : public CallbackTask
+    {
+    public:
+        explicit ConnectionClosedTask(OffloadedDispatcher & offloaded): CallbackTask(offloaded) {};
+        virtual void run() {
+            this->m_dispatcher.onConnectionClosed();
+        }
+    };
+
+    class RequestProcessingErrorTask : public CallbackTask
+    {
+        std::string m_layoutID;
+        std::string m_additionalData;
+    public:
+        RequestProcessingErrorTask(OffloadedDispatcher & offloaded,
+            std::string const & layoutID, std::string const & additionalData):
+                CallbackTask(offloaded), m_layoutID(layoutID), m_additionalData(additionalData) {};
+        virtual void run() {
+            this->m_dispatcher.packetReceived_requestProcessingError(m_layoutID, m_additionalData);
+        }
+    };
+
+    class ClientDeviceInfoTask : public CallbackTask
+    {
+        tau::communications_handling::ClientDeviceInfo m_info;
+    public:
+        ClientDeviceInfoTask(OffloadedDispatcher & offloaded,
+            tau::communications_handling::ClientDeviceInfo const & info):
+                CallbackTask(offloaded), m_info(info) {};
+        virtual void run() {
+            this->m_dispatcher.packetReceived_clientDeviceInfo(m_info);
+        }
+    };
+
+    class ButtonClickTask : public CallbackTask
+    {
+        tau::common::ElementID m_buttonID;
+    public:
+        ButtonClickTask(OffloadedDispatcher & offloaded, tau::common::ElementID const & buttonID):
+            CallbackTask(offloaded), m_buttonID(buttonID) {};
+        virtual void run() {
+            this->m_dispatcher.packetReceived_buttonClick(m_buttonID);
+        }
+    };
+
+    class LayoutPageSwitchedTask : public CallbackTask
+    {
+        tau::common::LayoutPageID m_pageID;
+    public:
+        LayoutPageSwitchedTask(OffloadedDispatcher & offloaded, tau::common::LayoutPageID const & pageID):
+            CallbackTask(offloaded), m_pageID(pageID) {};
+        virtual void run() {
+            this->m_dispatcher.packetReceived_layoutPageSwitched(m_pageID);
+        }
+    };
+
+    class BoolValueUpdateTask : public CallbackTask
+    {
+        tau::common::ElementID m_inputBoxID;
+        bool m_value;
+        bool m_isAutomaticUpdate;
+    public:
+        BoolValueUpdateTask(OffloadedDispatcher & offloaded,
+            tau::common::ElementID const & inputBoxID, bool value, bool isAutomaticUpdate):
+                CallbackTask(offloaded), m_inputBoxID(inputBoxID), m_value(value), m_isAutomaticUpdate(isAutomaticUpdate) {};
+        virtual void run() {
+            this->m_dispatcher.packetReceived_boolValueUpdate(m_inputBoxID, m_value, m_isAutomaticUpdate);
+        }
+    };
+
+    class TextValueUpdateTask : public CallbackTask
+    {
+        tau::common::ElementID m_inputBoxID;
+        std::string m_value;
+        bool m_isAutomaticUpdate;
+    public:
+        TextValueUpdateTask(OffloadedDispatcher & offloaded,
+            tau::common::ElementID const & inputBoxID, std::string const & value, bool isAutomaticUpdate):
+                CallbackTask(offloaded), m_inputBoxID(inputBoxID), m_value(value), m_isAutomaticUpdate(isAutomaticUpdate) {};
+        virtual void run() {
+            this->m_dispatcher.packetReceived_textValueUpdate(m_inputBoxID, m_value, m_isAutomaticUpdate);
+        }
+    };
+
+    class DeleteDispatcherTask : public SerialTaskQueue::Task
+    {
+        OffloadedDispatcher * m_offloaded;
+    public:
+        explicit DeleteDispatcherTask(OffloadedDispatcher * offloaded): m_offloaded(offloaded) {};
+        virtual void run() {
+            delete m_offloaded;
+        }
+    };
+
+    tau::communications_handling::OutgiongPacketsGenerator & m_connection;
+    OffloadedDispatcher * m_offloaded;
+    SerialTaskQueue * m_queue; // NULL - the callbacks are called directly
+    bool m_modeSelected;
+public:
+    OffloadingEventsDispatcher(
+        tau::communications_handling::OutgiongPacketsGenerator & outgoingGeneratorToUse):
+            tau::util::BasicEventsDispatcher(outgoingGeneratorToUse),
+            m_connection(outgoingGeneratorToUse),
+            m_offloaded(new OffloadedDispatcher(outgoingGeneratorToUse)),
+            m_queue(NULL),
+            m_modeSelected(false)
+        {};
+
+    virtual ~OffloadingEventsDispatcher() {
+        if (m_queue != NULL) {
+            m_offloaded->generator.stopMarshalling();
+            m_queue->add(new DeleteDispatcherTask(m_offloaded));
+            m_queue->release();
+        } else {
+            delete m_offloaded;
+        }
+    }
+
+    virtual void onClientConnected(
+        tau::communications_handling::ClientConnectionInfo const & connectionInfo)
+    {
+        if (offload()) {
+            m_queue->add(new ClientConnectedTask(*m_offloaded, connectionInfo));
+        } else {
+            m_offloaded->dispatcher.onClientConnected(connectionInfo);
+        }
+    }
+    virtual void onConnectionClosed()
+    {
+        if (offload()) {
+            m_queue->add(new ConnectionClosedTask(*m_offloaded));
+            // The packets of the callbacks, which are still pending, have nowhere to go
+            m_offloaded->generator.stopMarshalling();
+        } else {
+            m_offloaded->dispatcher.onConnectionClosed();
+        }
+    }
+
+    virtual void packetReceived_requestProcessingError(
+        std::string const & layoutID, std::string const & additionalData)
+    {
+        if (offload()) {
+            m_queue->add(new RequestProcessingErrorTask(*m_offloaded, layoutID, additionalData));
+        } else {
+            m_offloaded->dispatcher.packetReceived_requestProcessingError(layoutID, additionalData);
+        }
+    }
+    virtual void packetReceived_clientDeviceInfo(
+        tau::communications_handling::ClientDeviceInfo const & info)
+    {
+        if (offload()) {
+            m_queue->add(new ClientDeviceInfoTask(*m_offloaded, info));
+        } else {
+            m_offloaded->dispatcher.packetReceived_clientDeviceInfo(info);
+        }
+    }
+    virtual void packetReceived_buttonClick(
+        tau::common::ElementID const & buttonID)
+    {
+        if (offload()) {
+            m_queue->add(new ButtonClickTask(*m_offloaded, buttonID));
+        } else {
+            m_offloaded->dispatcher.packetReceived_buttonClick(buttonID);
+        }
+    }
+    virtual void packetReceived_layoutPageSwitched(
+        tau::common::LayoutPageID const & newActiveLayoutPageID)
+    {
+        if (offload()) {
+            m_queue->add(new LayoutPageSwitchedTask(*m_offloaded, newActiveLayoutPageID));
+        } else {
+            m_offloaded->dispatcher.packetReceived_layoutPageSwitched(newActiveLayoutPageID);
+        }
+    }
+    virtual void packetReceived_boolValueUpdate(
+        tau::common::ElementID const & inputBoxID,
+        bool new_value, bool is_automatic_update)
+    {
+        if (offload()) {
+            m_queue->add(new BoolValueUpdateTask(*m_offloaded, inputBoxID, new_value, is_automatic_update));
+        } else {
+            m_offloaded->dispatcher.packetReceived_boolValueUpdate(inputBoxID, new_value, is_automatic_update);
+        }
+    }
+    virtual void packetReceived_textValueUpdate(
+        tau::common::ElementID const & inputBoxID,
+        std::string const & new_value, bool is_automatic_update)
+    {
+        if (offload()) {
+            m_queue->add(new TextValueUpdateTask(*m_offloaded, inputBoxID, new_value, is_automatic_update));
+        } else {
+            m_offloaded->dispatcher.packetReceived_textValueUpdate(inputBoxID, new_value, is_automatic_update);
+        }
+    }
+
+    // False until the first callback, and when the connection can't run the tasks of the workers.
+    bool isOffloaded() const {
+        return m_queue != NULL;
+    }
+private:
+    // The connection is asked on the first callback (it is not completely constructed in the constructor).
+    bool offload() {
+        if (!m_modeSelected) {
+            m_modeSelected = true;
+            tau_additional::communications_handling::ConnectionExecutor * executor =
+                tau_additional::communications_handling::getConnectionExecutor(m_connection);
+            if (executor != NULL) {
+                m_offloaded->generator.startMarshalling(*executor);
+                m_queue = SerialTaskQueue::create(WorkerPool::getSharedInstance());
+            }
+        }
+        return m_queue != NULL;
+    }
+};
+
+}
+}
+#endif
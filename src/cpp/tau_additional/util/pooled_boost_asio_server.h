@@ -0,0 +1,382 @@
+// This source file is part of the 'tau' open source project.
+// Copyright (c) 2016, Yuriy Vosel.
+// Licensed under Boost Software License.
+// See LICENSE.txt for the licence information.
+
+#ifndef TAU_ADDITIONAL_UTIL_POOLED_BOOST_ASIO_SERVER_H
+#define TAU_ADDITIONAL_UTIL_POOLED_BOOST_ASIO_SERVER_H
+
+#include <tau/communications_handling/outgiong_packets_generator.h>
+#include <tau_additional/communications_handling/connection_executor.h>
+#include <tau_additional/communications_handling/delayed_calls_scheduler.h>
+#include <tau_additional/communications_handling/raw_incoming_data_stream_parser.h>
+#include <tau_additional/communications_handling/shared_buffer_sender.h>
+#include <tau_additional/util/metrics.h>
+#include <tau_additional/util/shared_buffer.h>
+#include <tau_additional/util/timing_wheel.h>
+#include <boost/asio.hpp>
+#include <boost/asio/deadline_timer.hpp>
+#include <boost/bind.hpp>
+#include <boost/enable_shared_from_this.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread.hpp>
+#include <string>
+#include <vector>
+
+namespace tau_additional {
+namespace util {
+
+// Timing wheel, which is advanced by the io_service thread: one deadline_timer is armed
+// for the next wake up time of the wheel (instead of one asio timer per delayed call).
+class IoServiceTimingWheel : public TimingWheel, private boost::noncopyable
+{
+    boost::asio::deadline_timer m_timer;
+    uint64_t m_armedWakeUpTime;
+    bool m_advancing;
+public:
+    explicit IoServiceTimingWheel(boost::asio::io_service & ioService):
+        m_timer(ioService),
+        m_armedWakeUpTime(NO_WAKE_UP),
+        m_advancing(false)
+    {};
+protected:
+    virtual void onTimerScheduled(uint64_t dueNanoseconds) {
+        // The timers, which are scheduled by the expiring ones, are taken into account after advance()
+        if (!m_advancing && dueNanoseconds < m_armedWakeUpTime) {
+            arm(dueNanoseconds);
+        }
+    }
+private:
+    void arm(uint64_t wakeUpTime) {
+        m_armedWakeUpTime = wakeUpTime;
+        uint64_t now = getMonotonicNanoseconds();
+        uint64_t delayMicroseconds = (wakeUpTime > now) ? ((wakeUpTime - now + 999) / 1000) : 0;
+        // Replaces the previous wait (its handler gets operation_aborted)
+        m_timer.expires_from_now(boost::posix_time::microseconds(delayMicroseconds));
+        m_timer.async_wait(boost::bind(&IoServiceTimingWheel::onWakeUp, this, boost::asio::placeholders::error));
+    }
+
+    void onWakeUp(boost::system::error_code const & error) {
+        if (error == boost::asio::error::operation_aborted) {
+            return;
+        }
+        m_armedWakeUpTime = NO_WAKE_UP;
+        m_advancing = true;
+        advance(getMonotonicNanoseconds());
+        m_advancing = false;
+        uint64_t nextWakeUpTime = getNextWakeUpTime();
+        if (nextWakeUpTime != NO_WAKE_UP) {
+            arm(nextWakeUpTime);
+        }
+    }
+};
+
+// Set of io_service objects, each of them is run by its own thread.
+// The objects, which are bound to one io_service (sockets, timers), are always
+// served by the same thread, so their handlers never run concurrently.
+class IoServicePool : private boost::noncopyable
+{
+    typedef boost::shared_ptr<boost::asio::io_service> IoServicePtr;
+    typedef boost::shared_ptr<boost::asio::io_service::work> WorkPtr;
+    typedef boost::shared_ptr<IoServiceTimingWheel> TimingWheelPtr;
+
+    std::vector<IoServicePtr> m_ioServices;
+    std::vector<WorkPtr> m_work;
+    std::vector<TimingWheelPtr> m_timingWheels; // declared after the io_services: destroyed before them
+    size_t m_nextIoService;
+public:
+    explicit IoServicePool(size_t poolSize): m_nextIoService(0) {
+        if (poolSize == 0) {
+            poolSize = 1;
+        }
+        for (size_t i = 0; i < poolSize; ++i) {
+            IoServicePtr ioService(new boost::asio::io_service(1));
+            m_ioServices.push_back(ioService);
+            // The 'work' object keeps the io_service::run() going when there are no pending handlers
+            m_work.push_back(WorkPtr(new boost::asio::io_service::work(*ioService)));
+            m_timingWheels.push_back(TimingWheelPtr(new IoServiceTimingWheel(*ioService)));
+        }
+    };
+
+    // Runs all the io_services (one thread per io_service). Blocks until stop() is called.
+    void run() {
+        boost::thread_group threads;
+        for (size_t i = 0; i < m_ioServices.size(); ++i) {
+            threads.create_thread(
+                boost::bind(&IoServicePool::runIoService, m_ioServices[i]));
+        }
+        threads.join_all();
+    }
+
+    void stop() {
+        for (size_t i = 0; i < m_ioServices.size(); ++i) {
+            m_ioServices[i]->stop();
+        }
+    }
+
+    // Round-robin selection. Should be called from one thread (the acceptor's one).
+    boost::asio::io_service & getNextIoService() {
+        boost::asio::io_service & result = *m_ioServices[m_nextIoService];
+        m_nextIoService = (m_nextIoService + 1) % m_ioServices.size();
+        return result;
+    }
+
+    boost::asio::io_service & getIoService(size_t index) {
+        return *m_ioServices[index % m_ioServices.size()];
+    }
+
+    // The timing wheel, which is advanced by the thread of the io_service.
+    // Should be used only from that thread (or before run()).
+    TimingWheel & getTimingWheel(boost::asio::io_service & ioService) {
+        for (size_t i = 0; i < m_ioServices.size(); ++i) {
+            if (m_ioServices[i].get() == &ioService) {
+                return *m_timingWheels[i];
+            }
+        }
+        return *m_timingWheels[0];
+    }
+
+    size_t getSize() const {
+        return m_ioServices.size();
+    }
+private:
+    static void runIoService(IoServicePtr ioService) {
+        ioService->run();
+    }
+};
+
+namespace pooled_boost_asio_server_details {
+
+// One client connection. All its handlers (and therefore all the events dispatcher
+// callbacks) are executed by the thread, which runs the connection's io_service.
+template <typename EventsDispatcherType>
+class Connection :
+    public boost::enable_shared_from_this<Connection<EventsDispatcherType> >,
+    public tau::communications_handling::OutgiongPacketsGenerator,
+    public tau_additional::communications_handling::SharedBufferSender,
+    public tau_additional::communications_handling::DelayedCallsScheduler,
+    public tau_additional::communications_handling::ConnectionExecutor,
+    private boost::noncopyable
+{
+    typedef boost::shared_ptr<ConnectionExecutor::Task> TaskPtr;
+
+    static const size_t RECEIVE_BUFFER_SIZE = 64 * 1024;
+
+    boost::asio::io_service & m_ioService;
+    boost::asio::ip::tcp::socket m_socket;
+    // Declared before the dispatcher: its parts (for example, the CoalescingElementUpdatesSender or
+    // the PeriodicCall) cancel their delayed calls, when they are destroyed
+    TimingWheelCallsScheduler m_delayedCalls;
+    EventsDispatcherType m_dispatcher;
+    tau_additional::communications_handling::RawIncomingDataStreamParser m_parser;
+    std::vector<char> m_receiveBuffer;
+    std::vector<tau_additional::util::SharedBuffer> m_buffersBeingWritten;
+    std::vector<tau_additional::util::SharedBuffer> m_pendingBuffers;
+    std::vector<boost::asio::const_buffer> m_writeBuffers;
+    bool m_writeInProgress;
+    bool m_closeRequested;
+    bool m_closed;
+    tau_additional::util::MetricsCounter & m_writtenBytesMetric;
+    tau_additional::util::MetricsHistogram & m_queuedBytesMetric;
+public:
+    // The timing wheel should be advanced by the thread of the io_service.
+    Connection(boost::asio::io_service & ioService, TimingWheel & timingWheel):
+        m_ioService(ioService),
+        m_socket(ioService),
+        m_delayedCalls(timingWheel),
+        m_dispatcher(*this),
+        m_receiveBuffer(RECEIVE_BUFFER_SIZE),
+        m_writeInProgress(false),
+        m_closeRequested(false),
+        m_closed(false),
+        m_writtenBytesMetric(tau_additional::util::MetricsRegistry::getInstance().getCounter("outgoing_data.bytes")),
+        m_queuedBytesMetric(tau_additional::util::MetricsRegistry::getInstance().getHistogram("outgoing_data.queued_bytes"))
+    {};
+
+    boost::asio::ip::tcp::socket & getSocket() {
+        return m_socket;
+    }
+
+    // Called from the acceptor's thread, so the actual work is posted to the connection's thread.
+    void start() {
+        m_ioService.post(
+            boost::bind(&Connection::onStarted, this->shared_from_this()));
+    }
+
+    // The first packet is written at once; the packets, which are sent while that write is in progress,
+    // are queued and written together with one async_write(), when it completes (the batches are formed
+    // by the write completions, not by the handlers).
+    virtual void sendData(std::string const & data) {
+        if (m_closed || data.empty()) {
+            return;
+        }
+        m_pendingBuffers.push_back(tau_additional::util::SharedBuffer(data));
+        startWriting();
+    }
+    // Unlike sendData(), can be called from any thread (for example, by the SessionRegistry broadcast):
+    // the buffer is queued (without copying) by the connection's own thread.
+    virtual void sendSharedBuffer(tau_additional::util::SharedBuffer const & data) {
+        m_ioService.dispatch(
+            boost::bind(&Connection::queueSharedBuffer, this->shared_from_this(), data));
+    }
+    virtual void scheduleDelayedCall(DelayedCallsScheduler::Callback & callback, uint64_t delayNanoseconds) {
+        if (m_closed) {
+            return;
+        }
+        m_delayedCalls.scheduleDelayedCall(callback, delayNanoseconds);
+    }
+    virtual void cancelDelayedCall(DelayedCallsScheduler::Callback & callback) {
+        m_delayedCalls.cancelDelayedCall(callback);
+    }
+    virtual void close_connection() {
+        m_closeRequested = true;
+        if (!m_writeInProgress) {
+            closeSocket();
+        }
+    }
+    // Can be called from any thread (for example, by the OffloadingEventsDispatcher workers).
+    virtual void execute(ConnectionExecutor::Task * task) {
+        m_ioService.dispatch(
+            boost::bind(&Connection::runTask, this->shared_from_this(), TaskPtr(task)));
+    }
+private:
+    void runTask(TaskPtr task) {
+        task->run(*this);
+    }
+
+    void onStarted() {
+        boost::system::error_code error;
+        boost::asio::ip::tcp::endpoint remote = m_socket.remote_endpoint(error);
+        boost::asio::ip::tcp::endpoint local = m_socket.local_endpoint(error);
+        tau::communications_handling::ClientConnectionInfo connectionInfo(
+            remote.address().to_string(), remote.port(), local.address().to_string(), local.port());
+        m_dispatcher.onClientConnected(connectionInfo);
+        startReading();
+    }
+
+    void startReading() {
+        if (m_closed || m_closeRequested) {
+            return;
+        }
+        m_socket.async_read_some(boost::asio::buffer(m_receiveBuffer),
+            boost::bind(&Connection::onDataReceived, this->shared_from_this(),
+                boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred));
+    }
+
+    void onDataReceived(boost::system::error_code const & error, size_t bytesTransferred) {
+        if (error) {
+            closeSocket();
+            return;
+        }
+        m_parser.newData(&m_receiveBuffer[0], bytesTransferred, m_dispatcher);
+        startReading();
+    }
+
+    void queueSharedBuffer(tau_additional::util::SharedBuffer const & data) {
+        if (m_closed || data.empty()) {
+            return;
+        }
+        m_pendingBuffers.push_back(data);
+        startWriting();
+    }
+
+    void startWriting() {
+        if (m_writeInProgress || m_pendingBuffers.empty()) {
+            return;
+        }
+        m_writeInProgress = true;
+        m_buffersBeingWritten.swap(m_pendingBuffers);
+        m_writeBuffers.clear();
+        for (size_t i = 0; i < m_buffersBeingWritten.size(); ++i) {
+            m_writeBuffers.push_back(boost::asio::const_buffer(
+                m_buffersBeingWritten[i].data(), m_buffersBeingWritten[i].size()));
+        }
+        if (tau_additional::util::areDataPathMetricsEnabled()) {
+            m_queuedBytesMetric.record(boost::asio::buffer_size(m_writeBuffers));
+        }
+        boost::asio::async_write(m_socket, m_writeBuffers,
+            boost::bind(&Connection::onDataWritten, this->shared_from_this(),
+                boost::asio::placeholders::error, boost::asio::placeholders::bytes_transferred));
+    }
+
+    void onDataWritten(boost::system::error_code const & error, size_t bytesTransferred) {
+        if (tau_additional::util::areDataPathMetricsEnabled()) {
+            m_writtenBytesMetric.add(bytesTransferred);
+        }
+        m_writeInProgress = false;
+        m_buffersBeingWritten.clear();
+        if (error) {
+            closeSocket();
+            return;
+        }
+        startWriting();
+        if (m_closeRequested && !m_writeInProgress) {
+            closeSocket();
+        }
+    }
+
+    void closeSocket() {
+        if (m_closed) {
+            return;
+        }
+        m_closed = true;
+        boost::system::error_code ignored;
+        m_socket.shutdown(boost::asio::ip::tcp::socket::shutdown_both, ignored);
+        m_socket.close(ignored);
+        m_dispatcher.onConnectionClosed();
+        m_delayedCalls.cancelAllDelayedCalls();
+    }
+};
+
+};
+
+// Server, which spreads the connections between the threads of the IoServicePool (round-robin).
+// Each connection is bound to a single io_service, so the callbacks of the
+// EventsDispatcherType object, which serves one client, never run concurrently.
+// Callbacks for different clients do run concurrently, so the dispatchers
+// should not share mutable state without synchronization.
+template <typename EventsDispatcherType>
+class PooledBoostAsioServer : private boost::noncopyable
+{
+    typedef pooled_boost_asio_server_details::Connection<EventsDispatcherType> ConnectionType;
+    typedef boost::shared_ptr<ConnectionType> ConnectionPtr;
+
+    IoServicePool & m_pool;
+    boost::asio::ip::tcp::acceptor m_acceptor;
+    TimingWheelCallsScheduler m_serverDelayedCalls;
+public:
+    // The acceptor is served by the first io_service of the pool.
+    PooledBoostAsioServer(IoServicePool & pool, short port):
+        m_pool(pool),
+        m_acceptor(pool.getIoService(0),
+            boost::asio::ip::tcp::endpoint(boost::asio::ip::tcp::v4(), port)),
+        m_serverDelayedCalls(pool.getTimingWheel(pool.getIoService(0)))
+    {};
+
+    // The delayed calls, which are not bound to a connection (for example, the periodic updates,
+    // which are broadcast to a group of clients). Executed by the thread of the first io_service;
+    // should be used from that thread (or before the pool is run).
+    tau_additional::communications_handling::DelayedCallsScheduler & getScheduler() {
+        return m_serverDelayedCalls;
+    }
+
+    void start() {
+        boost::asio::io_service & ioService = m_pool.getNextIoService();
+        ConnectionPtr connection(new ConnectionType(ioService, m_pool.getTimingWheel(ioService)));
+        m_acceptor.async_accept(connection->getSocket(),
+            boost::bind(&PooledBoostAsioServer::onAccepted, this, connection,
+                boost::asio::placeholders::error));
+    }
+private:
+    void onAccepted(ConnectionPtr connection, boost::system::error_code const & error) {
+        if (!error) {
+            connection->start();
+        }
+        start();
+    }
+};
+
+}
+}
+#endif
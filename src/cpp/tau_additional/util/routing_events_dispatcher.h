@@ -0,0 +1,186 @@
+// This source file is part of the 'tau' open source project.
+// Copyright (c) 2016, Yuriy Vosel.
+// Licensed under Boost Software License.
+// See LICENSE.txt for the licence information.
+
+#ifndef TAU_ADDITIONAL_UTIL_ROUTING_EVENTS_DISPATCHER_H
+#define TAU_ADDITIONAL_UTIL_ROUTING_EVENTS_DISPATCHER_H
+
+#include <tau/util/basic_events_dispatcher.h>
+#include <tau_additional/common/id_string.h>
+#include <tau_additional/common/interned_id.h>
+#include <tau_additional/util/unordered_map.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace tau_additional {
+namespace util {
+
+// Maps the element ids to the handlers (member functions of the DispatcherType).
+// The routes are stored by the interned id handle: the incoming id is resolved with one
+// hash table search, then the routes are found by the index, regardless of the elements count.
+// The table keeps its own copy of the handles of its elements, which does not change after the
+// table is built, so the routing does not lock the process-wide IdInterner.
+template <typename DispatcherType>
+class EventsRoutingTable
+{
+public:
+    typedef void (DispatcherType::*ButtonClickHandler)(
+        tau::common::ElementID const & buttonID);
+    typedef void (DispatcherType::*BoolValueUpdateHandler)(
+        tau::common::ElementID const & inputBoxID, bool new_value, bool is_automatic_update);
+    typedef void (DispatcherType::*TextValueUpdateHandler)(
+        tau::common::ElementID const & inputBoxID, std::string const & new_value, bool is_automatic_update);
+private:
+    struct Routes
+    {
+        Routes(): buttonClick(NULL), boolValueUpdate(NULL), textValueUpdate(NULL) {};
+        ButtonClickHandler buttonClick;
+        BoolValueUpdateHandler boolValueUpdate;
+        TextValueUpdateHandler textValueUpdate;
+    };
+
+    typedef typename tau_additional::util::UnorderedMap<std::string, uint32_t>::type Handles;
+
+    std::vector<Routes> m_routes;
+    Handles m_handles;
+    size_t m_elementsCount;
+public:
+    EventsRoutingTable(): m_elementsCount(0) {};
+
+    EventsRoutingTable & onButtonClick(
+        tau_additional::common::InternedElementID const & buttonID, ButtonClickHandler handler) {
+        getRoutesForUpdate(buttonID).buttonClick = handler;
+        return *this;
+    }
+    EventsRoutingTable & onBoolValueUpdate(
+        tau_additional::common::InternedElementID const & inputBoxID, BoolValueUpdateHandler handler) {
+        getRoutesForUpdate(inputBoxID).boolValueUpdate = handler;
+        return *this;
+    }
+    EventsRoutingTable & onTextValueUpdate(
+        tau_additional::common::InternedElementID const & inputBoxID, TextValueUpdateHandler handler) {
+        getRoutesForUpdate(inputBoxID).textValueUpdate = handler;
+        return *this;
+    }
+
+    // The route* methods return false if there is no handler for the element.
+    bool routeButtonClick(DispatcherType & dispatcher, tau::common::ElementID const & buttonID) const {
+        Routes const * routes = findRoutes(buttonID);
+        if (routes == NULL || routes->buttonClick == NULL) {
+            return false;
+        }
+        (dispatcher.*(routes->buttonClick))(buttonID);
+        return true;
+    }
+    bool routeBoolValueUpdate(DispatcherType & dispatcher,
+        tau::common::ElementID const & inputBoxID, bool new_value, bool is_automatic_update) const {
+        Routes const * routes = findRoutes(inputBoxID);
+        if (routes == NULL || routes->boolValueUpdate == NULL) {
+            return false;
+        }
+        (dispatcher.*(routes->boolValueUpdate))(inputBoxID, new_value, is_automatic_update);
+        return true;
+    }
+    bool routeTextValueUpdate(DispatcherType & dispatcher,
+        tau::common::ElementID const & inputBoxID, std::string const & new_value, bool is_automatic_update) const {
+        Routes const * routes = findRoutes(inputBoxID);
+        if (routes == NULL || routes->textValueUpdate == NULL) {
+            return false;
+        }
+        (dispatcher.*(routes->textValueUpdate))(inputBoxID, new_value, is_automatic_update);
+        return true;
+    }
+
+    size_t getElementsCount() const {
+        return m_elementsCount;
+    }
+private:
+    Routes & getRoutesForUpdate(tau_additional::common::InternedElementID const & elementID) {
+        if (elementID.getHandle() >= m_routes.size()) {
+            m_routes.resize(elementID.getHandle() + 1);
+        }
+        Routes & result = m_routes[elementID.getHandle()];
+        if (result.buttonClick == NULL && result.boolValueUpdate == NULL && result.textValueUpdate == NULL) {
+            ++m_elementsCount;
+            m_handles.insert(std::make_pair(tau_additional::common::getIdString(elementID), elementID.getHandle()));
+        }
+        return result;
+    }
+    Routes const * findRoutes(tau::common::ElementID const & elementID) const {
+        typename Handles::const_iterator found = m_handles.find(tau_additional::common::getIdString(elementID));
+        if (found == m_handles.end()) {
+            return NULL;
+        }
+        return &m_routes[found->second];
+    }
+};
+
+// Events dispatcher, which routes the button clicks and the value updates through the
+// EventsRoutingTable instead of the if/else chain. The DerivedType should provide
+//     static void registerEventRoutes(EventsRoutingTable<DerivedType> & table);
+// The table is built once (on the first event) and shared by all the DerivedType instances.
+// The events without a registered handler go to the packetReceived_unrouted* methods.
+template <typename DerivedType>
+class RoutingEventsDispatcher : public tau::util::BasicEventsDispatcher
+{
+public:
+    typedef EventsRoutingTable<DerivedType> RoutingTable;
+
+    RoutingEventsDispatcher(
+        tau::communications_handling::OutgiongPacketsGenerator & outgoingGeneratorToUse):
+            tau::util::BasicEventsDispatcher(outgoingGeneratorToUse)
+        {};
+
+    virtual void packetReceived_buttonClick(
+        tau::common::ElementID const & buttonID)
+    {
+        if (!getRoutingTable().routeButtonClick(getDerived(), buttonID)) {
+            packetReceived_unroutedButtonClick(buttonID);
+        }
+    }
+    virtual void packetReceived_boolValueUpdate(
+        tau::common::ElementID const & inputBoxID,
+        bool new_value, bool is_automatic_update)
+    {
+        if (!getRoutingTable().routeBoolValueUpdate(getDerived(), inputBoxID, new_value, is_automatic_update)) {
+            packetReceived_unroutedBoolValueUpdate(inputBoxID, new_value, is_automatic_update);
+        }
+    }
+    virtual void packetReceived_textValueUpdate(
+        tau::common::ElementID const & inputBoxID,
+        std::string const & new_value, bool is_automatic_update)
+    {
+        if (!getRoutingTable().routeTextValueUpdate(getDerived(), inputBoxID, new_value, is_automatic_update)) {
+            packetReceived_unroutedTextValueUpdate(inputBoxID, new_value, is_automatic_update);
+        }
+    }
+protected:
+    virtual void packetReceived_unroutedButtonClick(
+        tau::common::ElementID const & buttonID) {}
+    virtual void packetReceived_unroutedBoolValueUpdate(
+        tau::common::ElementID const & inputBoxID,
+        bool new_value, bool is_automatic_update) {}
+    virtual void packetReceived_unroutedTextValueUpdate(
+        tau::common::ElementID const & inputBoxID,
+        std::string const & new_value, bool is_automatic_update) {}
+
+    static RoutingTable const & getRoutingTable() {
+        static RoutingTable const table(buildRoutingTable());
+        return table;
+    }
+private:
+    DerivedType & getDerived() {
+        return static_cast<DerivedType &>(*this);
+    }
+    static RoutingTable buildRoutingTable() {
+        RoutingTable result;
+        DerivedType::registerEventRoutes(result);
+        return result;
+    }
+};
+
+}
+}
+#endif
@@ -0,0 +1,200 @@
+// This source file is part of the 'tau' open source project.
+// Copyright (c) 2016, Yuriy Vosel.
+// Licensed under Boost Software License.
+// See LICENSE.txt for the licence information.
+
+#ifndef TAU_ADDITIONAL_UTIL_SHARDED_SERVER_H
+#define TAU_ADDITIONAL_UTIL_SHARDED_SERVER_H
+
+#include <tau_additional/util/epoll_server.h>
+#include <tau_additional/util/metrics.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace tau_additional {
+namespace util {
+
+// Runs several copies (shards) of the single-threaded server (EpollServer, IoUringServer or
+// IoUringOrEpollServer), each one in its own thread, pinned to its own CPU. Every shard has its own
+// listening socket on the same port (SO_REUSEPORT), so the kernel spreads the new connections between
+// the shards, and the accept storm is handled by all the CPUs at once. The shard owns its connections
+// end to end: their parsers, dispatchers and delayed calls are used only by the shard's thread.
+// Every shard has its own MetricsRegistry (see getShardMetrics()), which is current in the shard's
+// thread: the shards do not update the same counters, and the process-wide snapshot sums them.
+// The state, which the dispatchers of different shards share, has to be thread-safe, and the packets
+// should not be sent to the connections of the other shards (for example, the SessionRegistry
+// broadcasts should stay within the shard).
+template <typename ServerType, typename SettingsType = EpollServerSettings>
+class ShardedServer
+{
+    struct Shard
+    {
+        Shard(ShardedServer & ownerToUse, unsigned short listenPort, SettingsType const & settings, int cpuToUse):
+            owner(ownerToUse), metrics(MetricsRegistry::getInstance()), server(listenPort, settings),
+            cpu(cpuToUse), runResult(false)
+        {};
+        ShardedServer & owner;
+        MetricsRegistry metrics; // outlives the server: its connections use the metrics till they are closed
+        ServerType server;
+        int cpu; // -1 - not pinned
+        bool runResult;
+        pthread_t thread;
+    };
+
+    std::vector<Shard *> m_shards;
+    volatile int m_stopRequested;
+    std::string m_lastError;
+
+    ShardedServer(ShardedServer const &);
+    ShardedServer & operator = (ShardedServer const &);
+public:
+    // shardsCount == 0 - one shard per CPU, which the process is allowed to use.
+    // With pinThreads == false the shards' threads are left to the scheduler.
+    explicit ShardedServer(unsigned short listenPort, SettingsType const & settings = SettingsType(),
+        size_t shardsCount = 0, bool pinThreads = true):
+        m_stopRequested(0)
+    {
+        std::vector<int> cpus = getAllowedCpus();
+        if (shardsCount == 0) {
+            shardsCount = cpus.empty() ? 1 : cpus.size();
+        }
+        SettingsType shardSettings(settings);
+        shardSettings.reusePort = true;
+        for (size_t i = 0; i < shardsCount; ++i) {
+            int cpu = (pinThreads && !cpus.empty()) ? cpus[i % cpus.size()] : -1;
+            m_shards.push_back(new Shard(*this, listenPort, shardSettings, cpu));
+        }
+    };
+
+    ~ShardedServer() {
+        for (size_t i = 0; i < m_shards.size(); ++i) {
+            delete m_shards[i];
+        }
+    }
+
+    // Starts all the shards (creates their listening sockets).
+    // Returns false (see getLastError()) if any of them failed.
+    bool start() {
+        for (size_t i = 0; i < m_shards.size(); ++i) {
+            if (!m_shards[i]->server.start()) {
+                std::ostringstream error;
+                error << "Shard " << i << ": " << m_shards[i]->server.getLastError();
+                m_lastError = error.str();
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Runs the shards' event loops in their threads until stop() is called.
+    // Returns false if any of the loops failed (the other ones keep running until stop()).
+    bool run() {
+        std::vector<pthread_t> threads;
+        for (size_t i = 0; i < m_shards.size(); ++i) {
+            if (pthread_create(&m_shards[i]->thread, NULL, &ShardedServer::threadFunction, m_shards[i]) != 0) {
+                m_lastError = "Can't create the shard thread";
+                stop();
+                break;
+            }
+            threads.push_back(m_shards[i]->thread);
+        }
+        bool result = m_lastError.empty();
+        for (size_t i = 0; i < threads.size(); ++i) {
+            pthread_join(threads[i], NULL);
+            if (!m_shards[i]->runResult && result) {
+                std::ostringstream error;
+                error << "Shard " << i << ": " << m_shards[i]->server.getLastError();
+                m_lastError = error.str();
+                result = false;
+            }
+        }
+        return result;
+    }
+
+    // Can be called from any thread: every shard's server wakes its loop up.
+    void stop() {
+        __sync_lock_test_and_set(&m_stopRequested, 1);
+        for (size_t i = 0; i < m_shards.size(); ++i) {
+            m_shards[i]->server.stop();
+        }
+    }
+
+    size_t getShardsCount() const {
+        return m_shards.size();
+    }
+    // The shard's server: for the configuration before run() (for example, its getScheduler());
+    // while running, it should be used only from the shard's thread.
+    ServerType & getShard(size_t index) {
+        return m_shards[index]->server;
+    }
+    // The CPU, which the shard's thread is pinned to (-1 - not pinned)
+    int getShardCpu(size_t index) const {
+        return m_shards[index]->cpu;
+    }
+    // The shard's own metrics (the MetricsRegistry::getInstance() snapshot includes them)
+    MetricsRegistry & getShardMetrics(size_t index) {
+        return m_shards[index]->metrics;
+    }
+
+    // The connections counts can be read from any thread, while the shards are running: the even
+    // spread of the accepted connections shows that the kernel balances the load between the shards.
+    size_t getShardConnectionsCount(size_t index) const {
+        return m_shards[index]->server.getConnectionsCount();
+    }
+    size_t getShardAcceptedConnectionsCount(size_t index) const {
+        return m_shards[index]->server.getAcceptedConnectionsCount();
+    }
+    size_t getConnectionsCount() const {
+        size_t result = 0;
+        for (size_t i = 0; i < m_shards.size(); ++i) {
+            result += getShardConnectionsCount(i);
+        }
+        return result;
+    }
+
+    std::string const & getLastError() const {
+        return m_lastError;
+    }
+private:
+    bool isStopRequested() {
+        return __sync_fetch_and_add(&m_stopRequested, 0) != 0;
+    }
+
+    static std::vector<int> getAllowedCpus() {
+        std::vector<int> result;
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        if (sched_getaffinity(0, sizeof(cpus), &cpus) == 0) {
+            for (int i = 0; i < CPU_SETSIZE; ++i) {
+                if (CPU_ISSET(i, &cpus)) {
+                    result.push_back(i);
+                }
+            }
+        }
+        return result;
+    }
+
+    static void * threadFunction(void * shardPointer) {
+        Shard & shard = *static_cast<Shard *>(shardPointer);
+        if (shard.cpu != -1) {
+            cpu_set_t cpus;
+            CPU_ZERO(&cpus);
+            CPU_SET(shard.cpu, &cpus);
+            pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus); // not fatal, if it is not allowed
+        }
+        MetricsRegistry::setCurrent(&shard.metrics);
+        // The IoUringOrEpollServer does not remember the stop(), which came before its start()
+        shard.runResult = shard.owner.isStopRequested() || shard.server.run();
+        MetricsRegistry::setCurrent(NULL);
+        return NULL;
+    }
+};
+
+}
+}
+#endif
@@ -0,0 +1,91 @@
+// This source file is part of the 'tau' open source project.
+// Copyright (c) 2016, Yuriy Vosel.
+// Licensed under Boost Software License.
+// See LICENSE.txt for the licence information.
+
+#ifndef TAU_ADDITIONAL_UTIL_SHARED_BUFFER_H
+#define TAU_ADDITIONAL_UTIL_SHARED_BUFFER_H
+
+#include <stddef.h>
+#include <string>
+
+namespace tau_additional {
+namespace util {
+
+// Immutable, reference counted byte buffer. Copying it just increments the counter
+// (atomically, so the copies can be passed between the threads), so one serialized
+// packet can be queued for many connections without copying the data.
+class SharedBuffer
+{
+    struct Storage
+    {
+        Storage(): referencesCount(1) {};
+        std::string data;
+        volatile long referencesCount;
+    };
+    Storage * m_storage;
+public:
+    SharedBuffer(): m_storage(NULL) {};
+
+    explicit SharedBuffer(std::string const & data): m_storage(new Storage()) {
+        m_storage->data = data;
+    };
+
+    SharedBuffer(char const * data, size_t size): m_storage(new Storage()) {
+        m_storage->data.assign(data, size);
+    };
+
+    SharedBuffer(SharedBuffer const & other): m_storage(other.m_storage) {
+        addReference();
+    };
+
+    SharedBuffer & operator = (SharedBuffer const & other) {
+        if (m_storage != other.m_storage) {
+            SharedBuffer(other).swap(*this);
+        }
+        return *this;
+    }
+
+    ~SharedBuffer() {
+        if (m_storage != NULL && __sync_sub_and_fetch(&(m_storage->referencesCount), 1) == 0) {
+            delete m_storage;
+        }
+    }
+
+    // Takes the contents of the string without copying it (the string is left empty).
+    static SharedBuffer adopt(std::string & data) {
+        SharedBuffer result;
+        result.m_storage = new Storage();
+        result.m_storage->data.swap(data);
+        return result;
+    }
+
+    void swap(SharedBuffer & other) {
+        Storage * tmp = m_storage;
+        m_storage = other.m_storage;
+        other.m_storage = tmp;
+    }
+
+    char const * data() const {
+        return (m_storage != NULL) ? m_storage->data.data() : "";
+    }
+    size_t size() const {
+        return (m_storage != NULL) ? m_storage->data.size() : 0;
+    }
+    bool empty() const {
+        return size() == 0;
+    }
+    std::string str() const {
+        return (m_storage != NULL) ? m_storage->data : std::string();
+    }
+private:
+    void addReference() {
+        if (m_storage != NULL) {
+            __sync_add_and_fetch(&(m_storage->referencesCount), 1);
+        }
+    }
+};
+
+}
+}
+#endif
@@ -0,0 +1,346 @@
+// This source file is part of the 'tau' open source project.
+// Copyright (c) 2016, Yuriy Vosel.
+// Licensed under Boost Software License.
+// See LICENSE.txt for the licence information.
+
+#ifndef TAU_ADDITIONAL_UTIL_TIMING_WHEEL_H
+#define TAU_ADDITIONAL_UTIL_TIMING_WHEEL_H
+
+#include <tau_additional/communications_handling/delayed_calls_scheduler.h>
+#include <tau_additional/util/monotonic_clock.h>
+#include <stdint.h>
+#include <map>
+
+namespace tau_additional {
+namespace util {
+
+// Hierarchical timing wheel (4 levels of 256 slots, the Linux kernel timers layout).
+// Scheduling and cancelling a timer is O(1), advancing the wheel by one tick is O(1) plus the
+// timers, which expire (or move to the lower level) on that tick, so any number of timers
+// costs the same per tick. The timers fire on the first tick boundary after the deadline
+// (never early, up to one tick late); the ones, whose deadline is not later than the time of the
+// last advance(), are due at once and fire on the next advance(). The deadlines further than
+// 2^32 ticks are re-checked when they reach the lowest level.
+// Not thread-safe: all the calls (and the timer callbacks) happen in one thread.
+class TimingWheel
+{
+public:
+    static const uint64_t DEFAULT_TICK_NANOSECONDS = 1000000;
+    static const uint64_t NO_WAKE_UP = ~uint64_t(0);
+
+    // Intrusive timer node: the wheel does not allocate. Destroying the scheduled timer cancels it.
+    class Timer
+    {
+        friend class TimingWheel;
+
+        Timer * m_previous;
+        Timer * m_next;
+        TimingWheel * m_wheel; // NULL if not scheduled
+        uint64_t m_deadlineTick;
+
+        Timer(Timer const &);
+        Timer & operator = (Timer const &);
+    public:
+        Timer(): m_previous(this), m_next(this), m_wheel(NULL), m_deadlineTick(0) {};
+        virtual ~Timer() {
+            if (m_wheel != NULL) {
+                m_wheel->cancel(*this);
+            }
+        }
+        bool isScheduled() const {
+            return m_wheel != NULL;
+        }
+        // The timer is not scheduled any more, when it is called; it can schedule itself again.
+        virtual void onTimerExpired() = 0;
+    private:
+        bool isListEmpty() const {
+            return m_next == this;
+        }
+        void unlink() {
+            m_previous->m_next = m_next;
+            m_next->m_previous = m_previous;
+            m_previous = this;
+            m_next = this;
+        }
+        // Inserts the node before this one (this node is the list head)
+        void pushBack(Timer & node) {
+            node.m_previous = m_previous;
+            node.m_next = this;
+            m_previous->m_next = &node;
+            m_previous = &node;
+        }
+    };
+private:
+    static const unsigned LEVELS = 4;
+    static const unsigned SLOT_BITS = 8;
+    static const unsigned SLOTS = 1 << SLOT_BITS;
+    static const uint64_t SLOT_MASK = SLOTS - 1;
+
+    // The list heads are the Timer objects, which are never scheduled
+    class ListHead : public Timer
+    {
+    public:
+        virtual void onTimerExpired() {}
+    };
+
+    uint64_t m_tickNanoseconds;
+    uint64_t m_currentTick; // all the timers due on this tick or before it have been run
+    uint64_t m_currentNanoseconds; // the time of the last advance()
+    ListHead m_slots[LEVELS][SLOTS];
+    ListHead m_dueTimers; // scheduled for the current tick or earlier
+    uint64_t m_firstLevelOccupied[SLOTS / 64];
+    size_t m_timersCount;
+
+    TimingWheel(TimingWheel const &);
+    TimingWheel & operator = (TimingWheel const &);
+public:
+    explicit TimingWheel(uint64_t tickNanoseconds = DEFAULT_TICK_NANOSECONDS,
+        uint64_t nowNanoseconds = getMonotonicNanoseconds()):
+        m_tickNanoseconds(tickNanoseconds > 0 ? tickNanoseconds : 1),
+        m_currentTick(nowNanoseconds / m_tickNanoseconds),
+        m_currentNanoseconds(nowNanoseconds),
+        m_timersCount(0)
+    {
+        for (unsigned i = 0; i < SLOTS / 64; ++i) {
+            m_firstLevelOccupied[i] = 0;
+        }
+    };
+
+    virtual ~TimingWheel() {
+        // The timers, which outlive the wheel, should not try to unlink themselves from it
+        cancelList(m_dueTimers);
+        for (unsigned level = 0; level < LEVELS; ++level) {
+            for (unsigned slot = 0; slot < SLOTS; ++slot) {
+                cancelList(m_slots[level][slot]);
+            }
+        }
+    }
+
+    // Schedules (or reschedules) the timer. The deadline is in the getMonotonicNanoseconds() time.
+    void schedule(Timer & timer, uint64_t deadlineNanoseconds) {
+        if (timer.m_wheel != NULL) {
+            cancel(timer);
+        }
+        timer.m_wheel = this;
+        if (deadlineNanoseconds <= m_currentNanoseconds) {
+            timer.m_deadlineTick = m_currentTick; // goes to the due timers
+        } else {
+            timer.m_deadlineTick = (deadlineNanoseconds + m_tickNanoseconds - 1) / m_tickNanoseconds;
+        }
+        ++m_timersCount;
+        place(timer);
+        onTimerScheduled(timer.m_deadlineTick * m_tickNanoseconds);
+    }
+
+    void cancel(Timer & timer) {
+        if (timer.m_wheel != this) {
+            return;
+        }
+        timer.unlink();
+        timer.m_wheel = NULL;
+        --m_timersCount;
+        unsigned firstLevelSlot = unsigned(timer.m_deadlineTick & SLOT_MASK);
+        if (m_slots[0][firstLevelSlot].isListEmpty()) {
+            m_firstLevelOccupied[firstLevelSlot / 64] &= ~(uint64_t(1) << (firstLevelSlot % 64));
+        }
+    }
+
+    // Runs the timers, whose deadlines are not later than now.
+    void advance(uint64_t nowNanoseconds = getMonotonicNanoseconds()) {
+        if (nowNanoseconds > m_currentNanoseconds) {
+            m_currentNanoseconds = nowNanoseconds;
+        }
+        runList(m_dueTimers);
+        uint64_t targetTick = nowNanoseconds / m_tickNanoseconds;
+        while (m_currentTick < targetTick) {
+            if (m_timersCount == 0) {
+                m_currentTick = targetTick;
+                break;
+            }
+            ++m_currentTick;
+            unsigned slot = unsigned(m_currentTick & SLOT_MASK);
+            if (slot == 0) {
+                cascade();
+            }
+            if (!m_slots[0][slot].isListEmpty()) {
+                m_firstLevelOccupied[slot / 64] &= ~(uint64_t(1) << (slot % 64));
+                runList(m_slots[0][slot]);
+            }
+            runList(m_dueTimers); // the ones, which were scheduled 'for now' by the callbacks
+        }
+    }
+
+    // The time, when advance() should be called next: not later than the first deadline
+    // (it can be earlier, when the timers of the upper levels should be moved down).
+    // Returns NO_WAKE_UP if there are no timers.
+    uint64_t getNextWakeUpTime() const {
+        if (m_timersCount == 0) {
+            return NO_WAKE_UP;
+        }
+        if (!m_dueTimers.isListEmpty()) {
+            return 0;
+        }
+        unsigned currentSlot = unsigned(m_currentTick & SLOT_MASK);
+        uint64_t rotationStart = m_currentTick - currentSlot;
+        for (unsigned word = (currentSlot + 1) / 64; word < SLOTS / 64; ++word) {
+            uint64_t bits = m_firstLevelOccupied[word];
+            if (word == (currentSlot + 1) / 64) {
+                bits &= ~uint64_t(0) << ((currentSlot + 1) % 64);
+            }
+            if (bits != 0) {
+                return (rotationStart + word * 64 + unsigned(__builtin_ctzll(bits))) * m_tickNanoseconds;
+            }
+        }
+        // Nothing in this rotation of the first level: the next one starts with the cascade
+        return (rotationStart + SLOTS) * m_tickNanoseconds;
+    }
+
+    size_t getTimersCount() const {
+        return m_timersCount;
+    }
+    uint64_t getTickNanoseconds() const {
+        return m_tickNanoseconds;
+    }
+    uint64_t getCurrentNanoseconds() const {
+        return m_currentNanoseconds;
+    }
+protected:
+    // Called after every schedule() with the time, when the timer is going to be due.
+    // Override it to wake the loop, which calls advance(), up earlier if needed.
+    virtual void onTimerScheduled(uint64_t /*dueNanoseconds*/) {}
+private:
+    void place(Timer & timer) {
+        uint64_t deadline = timer.m_deadlineTick;
+        if (deadline <= m_currentTick) {
+            m_dueTimers.pushBack(timer);
+            return;
+        }
+        uint64_t distance = deadline - m_currentTick;
+        if (distance >= (uint64_t(1) << (SLOT_BITS * LEVELS))) {
+            // Parked in the farthest slot, placed again when it gets there
+            deadline = m_currentTick + (uint64_t(1) << (SLOT_BITS * LEVELS)) - 1;
+            distance = deadline - m_currentTick;
+        }
+        unsigned level = 0;
+        while (distance >= (uint64_t(1) << (SLOT_BITS * (level + 1)))) {
+            ++level;
+        }
+        unsigned slot = unsigned((deadline >> (SLOT_BITS * level)) & SLOT_MASK);
+        m_slots[level][slot].pushBack(timer);
+        if (level == 0) {
+            m_firstLevelOccupied[slot / 64] |= uint64_t(1) << (slot % 64);
+        }
+    }
+
+    // Called when the first level starts a new rotation: the timers of the next slot of every
+    // upper level, which has completed its own rotation, are moved down.
+    void cascade() {
+        for (unsigned level = 1; level < LEVELS; ++level) {
+            unsigned slot = unsigned((m_currentTick >> (SLOT_BITS * level)) & SLOT_MASK);
+            ListHead moved;
+            takeList(m_slots[level][slot], moved);
+            while (!moved.isListEmpty()) {
+                Timer & timer = *moved.m_next;
+                timer.unlink();
+                place(timer);
+            }
+            if (slot != 0) {
+                break;
+            }
+        }
+    }
+
+    // The callbacks can schedule and cancel any timers (including the ones of the same list),
+    // so the list is detached first and taken apart one timer at a time.
+    void runList(ListHead & list) {
+        if (list.isListEmpty()) {
+            return;
+        }
+        ListHead expiring;
+        takeList(list, expiring);
+        while (!expiring.isListEmpty()) {
+            Timer & timer = *expiring.m_next;
+            timer.unlink();
+            timer.m_wheel = NULL;
+            --m_timersCount;
+            timer.onTimerExpired();
+        }
+    }
+
+    static void takeList(ListHead & from, ListHead & to) {
+        if (from.isListEmpty()) {
+            return;
+        }
+        to.m_next = from.m_next;
+        to.m_previous = from.m_previous;
+        to.m_next->m_previous = &to;
+        to.m_previous->m_next = &to;
+        from.m_next = &from;
+        from.m_previous = &from;
+    }
+
+    void cancelList(ListHead & list) {
+        while (!list.isListEmpty()) {
+            Timer & timer = *list.m_next;
+            timer.unlink();
+            timer.m_wheel = NULL;
+        }
+        m_timersCount = 0;
+    }
+};
+
+// DelayedCallsScheduler on top of the TimingWheel. Used by the servers for the connections'
+// delayed calls and for the server-wide ones (for example, the periodic pushes to a group).
+// Every callback gets its own timer node, which is reused when the callback is scheduled again.
+class TimingWheelCallsScheduler : public tau_additional::communications_handling::DelayedCallsScheduler
+{
+    class ScheduledCall : public TimingWheel::Timer
+    {
+        Callback & m_callback;
+    public:
+        explicit ScheduledCall(Callback & callback): m_callback(callback) {};
+        virtual void onTimerExpired() {
+            m_callback.onDelayedCall();
+        }
+    };
+    typedef std::map<Callback *, ScheduledCall *> ScheduledCalls;
+
+    TimingWheel & m_wheel;
+    ScheduledCalls m_scheduledCalls;
+
+    TimingWheelCallsScheduler(TimingWheelCallsScheduler const &);
+    TimingWheelCallsScheduler & operator = (TimingWheelCallsScheduler const &);
+public:
+    explicit TimingWheelCallsScheduler(TimingWheel & wheel): m_wheel(wheel) {};
+    virtual ~TimingWheelCallsScheduler() {
+        cancelAllDelayedCalls();
+    }
+
+    virtual void scheduleDelayedCall(Callback & callback, uint64_t delayNanoseconds) {
+        ScheduledCall *& scheduledCall = m_scheduledCalls[&callback];
+        if (scheduledCall == NULL) {
+            scheduledCall = new ScheduledCall(callback);
+        }
+        // The call without the delay is due at once (it runs on the next advance() of the wheel)
+        m_wheel.schedule(*scheduledCall, (delayNanoseconds == 0) ?
+            m_wheel.getCurrentNanoseconds() : getMonotonicNanoseconds() + delayNanoseconds);
+    }
+    // The timer node is kept (the callback can be cancelling itself from its own onDelayedCall()).
+    virtual void cancelDelayedCall(Callback & callback) {
+        ScheduledCalls::iterator found = m_scheduledCalls.find(&callback);
+        if (found != m_scheduledCalls.end()) {
+            m_wheel.cancel(*found->second);
+        }
+    }
+    // Should not be called from the delayed calls of this scheduler.
+    void cancelAllDelayedCalls() {
+        for (ScheduledCalls::iterator it = m_scheduledCalls.begin(); it != m_scheduledCalls.end(); ++it) {
+            delete it->second;
+        }
+        m_scheduledCalls.clear();
+    }
+};
+
+}
+}
+#endif
@@ -0,0 +1,36 @@
+// This source file is part of the 'tau' open source project.
+// Copyright (c) 2016, Yuriy Vosel.
+// Licensed under Boost Software License.
+// See LICENSE.txt for the licence information.
+
+#ifndef TAU_ADDITIONAL_UTIL_UNORDERED_MAP_H
+#define TAU_ADDITIONAL_UTIL_UNORDERED_MAP_H
+
+#ifdef TAU_CPP_03_COMPATIBILITY
+#include <tr1/unordered_map>
+#else
+#include <unordered_map>
+#endif
+
+namespace tau_additional {
+namespace util {
+
+// Hash map type, which is available both in the C++03 (TR1) and in the C++11 builds.
+// Usage: UnorderedMap<std::string, int>::type
+#ifdef TAU_CPP_03_COMPATIBILITY
+template <typename KeyType, typename ValueType, typename HashType = std::tr1::hash<KeyType> >
+struct UnorderedMap
+{
+    typedef std::tr1::unordered_map<KeyType, ValueType, HashType> type;
+};
+#else
+template <typename KeyType, typename ValueType, typename HashType = std::hash<KeyType> >
+struct UnorderedMap
+{
+    typedef std::unordered_map<KeyType, ValueType, HashType> type;
+};
+#endif
+
+}
+}
+#endif
@@ -0,0 +1,312 @@
+// This source file is part of the 'tau' open source project.
+// Copyright (c) 2016, Yuriy Vosel.
+// Licensed under Boost Software License.
+// See LICENSE.txt for the licence information.
+
+#ifndef TAU_ADDITIONAL_UTIL_WORKER_POOL_H
+#define TAU_ADDITIONAL_UTIL_WORKER_POOL_H
+
+#include <tau_additional/util/mutex.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <stddef.h>
+#include <deque>
+#include <vector>
+
+// Threads count of WorkerPool::getSharedInstance(); 0 - max(online CPUs, 4)
+#ifndef TAU_ADDITIONAL_WORKER_POOL_THREADS
+#define TAU_ADDITIONAL_WORKER_POOL_THREADS 0
+#endif
+
+namespace tau_additional {
+namespace util {
+
+// Fixed set of threads, which run the submitted tasks. Every worker has its own deque:
+// the tasks, which are submitted by a worker, go to its own deque and are taken from its back
+// (the most recent, still cache-hot ones first); the tasks from the other threads are spread
+// between the workers round-robin. An idle worker steals the oldest task from the front of
+// another worker's deque, so one long task does not hold the tasks queued behind it.
+// The task, which gives the worker up to the others and wants to continue later (see yield()),
+// goes to the front of the deque: it runs after the tasks, which are already queued.
+class WorkerPool
+{
+public:
+    // The pool does not own the tasks: a one-shot task may delete itself at the end of run().
+    class Task
+    {
+    public:
+        virtual ~Task() {};
+        virtual void run() = 0;
+    };
+private:
+    struct Worker
+    {
+        Worker(WorkerPool & ownerToUse, size_t indexToUse): owner(ownerToUse), index(indexToUse) {};
+        WorkerPool & owner;
+        size_t index;
+        Mutex mutex;
+        std::deque<Task *> tasks;
+        pthread_t thread;
+    };
+
+    std::vector<Worker *> m_workers;
+    pthread_mutex_t m_idleMutex;
+    pthread_cond_t m_idleCondition;
+    volatile size_t m_pendingTasks;
+    volatile size_t m_sleepingWorkers;
+    volatile size_t m_nextWorker;
+    volatile bool m_stopRequested;
+
+    WorkerPool(WorkerPool const &);
+    WorkerPool & operator = (WorkerPool const &);
+public:
+    // threadsCount == 0 - one worker per online CPU.
+    explicit WorkerPool(size_t threadsCount = 0):
+        m_pendingTasks(0),
+        m_sleepingWorkers(0),
+        m_nextWorker(0),
+        m_stopRequested(false)
+    {
+        if (threadsCount == 0) {
+            long cpusCount = sysconf(_SC_NPROCESSORS_ONLN);
+            threadsCount = (cpusCount > 0) ? size_t(cpusCount) : 1;
+        }
+        pthread_mutex_init(&m_idleMutex, NULL);
+        pthread_cond_init(&m_idleCondition, NULL);
+        for (size_t i = 0; i < threadsCount; ++i) {
+            m_workers.push_back(new Worker(*this, i));
+        }
+        for (size_t i = 0; i < m_workers.size(); ++i) {
+            pthread_create(&m_workers[i]->thread, NULL, &WorkerPool::threadFunction, m_workers[i]);
+        }
+    };
+
+    // The tasks, which are still queued, are not run.
+    ~WorkerPool() {
+        pthread_mutex_lock(&m_idleMutex);
+        m_stopRequested = true;
+        pthread_cond_broadcast(&m_idleCondition);
+        pthread_mutex_unlock(&m_idleMutex);
+        for (size_t i = 0; i < m_workers.size(); ++i) {
+            pthread_join(m_workers[i]->thread, NULL);
+        }
+        for (size_t i = 0; i < m_workers.size(); ++i) {
+            delete m_workers[i];
+        }
+        pthread_cond_destroy(&m_idleCondition);
+        pthread_mutex_destroy(&m_idleMutex);
+    }
+
+    // Can be called from any thread, including the workers (from the running task).
+    void submit(Task & task) {
+        push(task, false);
+    }
+
+    // Submits the task after the ones, which are already queued (FIFO), instead of running it next:
+    // for the running task, which resubmits itself to let the other tasks run.
+    void yield(Task & task) {
+        push(task, true);
+    }
+
+    size_t getThreadsCount() const {
+        return m_workers.size();
+    }
+
+    // The pool, which is shared by the OffloadingEventsDispatcher instances (created on the first use).
+    // The offloaded handlers are often blocked rather than busy, so even a single CPU machine gets
+    // several workers (see TAU_ADDITIONAL_WORKER_POOL_THREADS).
+    static WorkerPool & getSharedInstance() {
+        static WorkerPool * instance = new WorkerPool(getSharedInstanceThreadsCount()); // never deleted: may be used until the exit
+        return *instance;
+    }
+private:
+    void push(Task & task, bool yielding) {
+        Worker * current = getCurrentWorker();
+        Worker & target = (current != NULL && &current->owner == this) ?
+            *current : *m_workers[__sync_fetch_and_add(&m_nextWorker, 1) % m_workers.size()];
+        {
+            ScopedLock lock(target.mutex);
+            if (yielding) {
+                target.tasks.push_front(&task);
+            } else {
+                target.tasks.push_back(&task);
+            }
+        }
+        // Full barrier: either the sleeping worker sees the pending task, or the task sees it sleeping
+        __sync_add_and_fetch(&m_pendingTasks, 1);
+        if (__sync_fetch_and_add(&m_sleepingWorkers, 0) != 0) {
+            pthread_mutex_lock(&m_idleMutex);
+            pthread_cond_signal(&m_idleCondition);
+            pthread_mutex_unlock(&m_idleMutex);
+        }
+    }
+
+    static size_t getSharedInstanceThreadsCount() {
+        static const size_t MIN_THREADS_COUNT = 4;
+        if (TAU_ADDITIONAL_WORKER_POOL_THREADS > 0) {
+            return TAU_ADDITIONAL_WORKER_POOL_THREADS;
+        }
+        long cpusCount = sysconf(_SC_NPROCESSORS_ONLN);
+        return (cpusCount > long(MIN_THREADS_COUNT)) ? size_t(cpusCount) : MIN_THREADS_COUNT;
+    }
+
+    static Worker *& getCurrentWorker() {
+        static __thread Worker * current = NULL;
+        return current;
+    }
+
+    static void * threadFunction(void * parameter) {
+        Worker * worker = static_cast<Worker *>(parameter);
+        getCurrentWorker() = worker;
+        worker->owner.run(*worker);
+        return NULL;
+    }
+
+    void run(Worker & worker) {
+        while (!m_stopRequested) {
+            Task * task = takeTask(worker);
+            if (task != NULL) {
+                task->run();
+            } else {
+                waitForTasks();
+            }
+        }
+    }
+
+    Task * takeTask(Worker & worker) {
+        Task * result = popBack(worker);
+        for (size_t i = 1; result == NULL && i < m_workers.size(); ++i) {
+            result = popFront(*m_workers[(worker.index + i) % m_workers.size()]);
+        }
+        if (result != NULL) {
+            __sync_sub_and_fetch(&m_pendingTasks, 1);
+        }
+        return result;
+    }
+
+    static Task * popBack(Worker & worker) {
+        ScopedLock lock(worker.mutex);
+        if (worker.tasks.empty()) {
+            return NULL;
+        }
+        Task * result = worker.tasks.back();
+        worker.tasks.pop_back();
+        return result;
+    }
+
+    static Task * popFront(Worker & victim) {
+        ScopedLock lock(victim.mutex);
+        if (victim.tasks.empty()) {
+            return NULL;
+        }
+        Task * result = victim.tasks.front();
+        victim.tasks.pop_front();
+        return result;
+    }
+
+    void waitForTasks() {
+        pthread_mutex_lock(&m_idleMutex);
+        __sync_add_and_fetch(&m_sleepingWorkers, 1);
+        if (__sync_fetch_and_add(&m_pendingTasks, 0) == 0 && !m_stopRequested) {
+            pthread_cond_wait(&m_idleCondition, &m_idleMutex);
+        }
+        __sync_sub_and_fetch(&m_sleepingWorkers, 1);
+        pthread_mutex_unlock(&m_idleMutex);
+    }
+};
+
+// Runs its tasks one at a time, in the order of add(), on the threads of the WorkerPool
+// (the "strand"): at most one pool thread serves the queue at any moment, so the tasks
+// don't need any synchronization between themselves. After MAX_TASKS_PER_RUN tasks the queue
+// goes back to the pool behind the tasks, which are already queued (see WorkerPool::yield()),
+// so a busy queue does not keep the worker from the other queues.
+//
+// Reference counted: the pool holds a reference while the queue is scheduled, so the owner
+// may release() it with the tasks still pending - the queue is deleted after the last of them.
+class SerialTaskQueue : private WorkerPool::Task
+{
+public:
+    // Owned by the queue: deleted right after run() (or with the queue, if never run).
+    typedef WorkerPool::Task Task;
+private:
+    static const size_t MAX_TASKS_PER_RUN = 64;
+
+    WorkerPool & m_pool;
+    Mutex m_mutex;
+    std::deque<Task *> m_tasks;
+    bool m_scheduled;
+    volatile int m_references;
+
+    SerialTaskQueue(SerialTaskQueue const &);
+    SerialTaskQueue & operator = (SerialTaskQueue const &);
+
+    explicit SerialTaskQueue(WorkerPool & pool):
+        m_pool(pool),
+        m_scheduled(false),
+        m_references(1)
+    {};
+    virtual ~SerialTaskQueue() {
+        for (size_t i = 0; i < m_tasks.size(); ++i) {
+            delete m_tasks[i];
+        }
+    }
+public:
+    // The result has one reference, which belongs to the caller.
+    static SerialTaskQueue * create(WorkerPool & pool) {
+        return new SerialTaskQueue(pool);
+    }
+
+    void addReference() {
+        __sync_add_and_fetch(&m_references, 1);
+    }
+    void release() {
+        if (__sync_sub_and_fetch(&m_references, 1) == 0) {
+            delete this;
+        }
+    }
+
+    // Can be called from any thread.
+    void add(Task * task) {
+        {
+            ScopedLock lock(m_mutex);
+            m_tasks.push_back(task);
+            if (m_scheduled) {
+                return;
+            }
+            m_scheduled = true;
+        }
+        addReference();
+        m_pool.submit(*this);
+    }
+private:
+    virtual void run() {
+        bool drained = false;
+        for (size_t i = 0; i < MAX_TASKS_PER_RUN && !drained; ++i) {
+            Task * task = NULL;
+            {
+                ScopedLock lock(m_mutex);
+                if (m_tasks.empty()) {
+                    // The next add() schedules the queue again (with its own reference)
+                    m_scheduled = false;
+                    drained = true;
+                } else {
+                    task = m_tasks.front();
+                    m_tasks.pop_front();
+                }
+            }
+            if (task != NULL) {
+                task->run();
+                delete task;
+            }
+        }
+        if (drained) {
+            release(); // may delete the queue
+        } else {
+            m_pool.yield(*this); // still scheduled: keeps the reference
+        }
+    }
+};
+
+}
+}
+#endif
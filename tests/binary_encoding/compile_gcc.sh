@@ -0,0 +1,4 @@
+#!/bin/bash
+LIBRARY_LOCATION=../../../src/cpp/
+ADDITIONAL_LIBRARY_LOCATION=../../src/cpp/
+g++ -std=c++03 -D TAU_HEADERONLY -D TAU_CPP_03_COMPATIBILITY -pthread -I $LIBRARY_LOCATION -I $ADDITIONAL_LIBRARY_LOCATION main.cpp -o test_gcc_cpp03 -lz
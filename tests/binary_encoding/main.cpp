@@ -0,0 +1,341 @@
+// This source file is part of the 'tau' open source project.
+// Copyright (c) 2016, Yuriy Vosel.
+// Licensed under Boost Software License.
+// See LICENSE.txt for the licence information.
+
+// Checks the binary encoding of the server's connections over the loopback: the client, which asks
+// for it in the device info, gets the binary 'reset layout' packet (it is decoded back to the same
+// layout), its binary click reaches the dispatcher, and the note, which the dispatcher sends in reply,
+// comes as the binary packet with the id from the layout's string table. The client, which does
+// not ask for it, still gets the text packets. The servers have the compression enabled: the data of
+// the clients, which do not ask for it, is parsed as is (the binary packets have the zero bytes, like
+// the compressed stream header). The client, which asks for both the compression and the binary
+// encoding, sends its binary packet with the zero byte uncompressed, and then starts its own compressed
+// stream: both reach the dispatcher. Both the EpollServer and the IoUringServer are checked (the
+// IoUringServer - if the kernel supports it).
+// Exits with the non-zero code, if a check fails.
+
+#include <tau/util/basic_events_dispatcher.h>
+#include <tau_additional/common/id_string.h>
+#include <tau_additional/communications_handling/binary_encoding.h>
+#include <tau_additional/communications_handling/packet_serializer.h>
+#include <tau_additional/communications_handling/stream_compression.h>
+#include <tau_additional/util/epoll_server.h>
+#include <tau_additional/util/io_uring_server.h>
+#include <tau_additional/util/json_value.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <string.h>
+#include <iostream>
+#include <string>
+
+namespace {
+    char const LAYOUT_JSON[] = "{\"pages\":[{\"id\":\"PAGE_1\",\"layout\":{\"type\":\"split\",\"children\":["
+        "{\"type\":\"button\",\"id\":\"BUTTON_1\",\"note\":\"Click me\"},"
+        "{\"type\":\"label\",\"id\":\"STATUS_LABEL\",\"note\":\"Not clicked\"}]}}],\"start\":\"PAGE_1\"}";
+
+    bool g_failed = false;
+    volatile int g_binaryEncodingStarted = 0;
+    std::string g_clickedButton; // written by the server thread before the reply is sent
+
+    void check(bool condition, std::string const & description) {
+        std::cout << (condition ? "ok:     " : "FAILED: ") << description << "\n";
+        g_failed = g_failed || !condition;
+    }
+
+    // The server is stopped by its own thread, when the last client disconnects
+    class StoppableServer
+    {
+    public:
+        virtual ~StoppableServer() {};
+        virtual void stop() = 0;
+    };
+    StoppableServer * g_server = NULL;
+    int g_clientsLeft = 0;
+};
+
+// Starts the compression and the binary encoding (if the client asks for them), sends the layout in reply to the device info, the note in reply to the click and the bool value back
+class TestDispatcher : public tau::util::BasicEventsDispatcher
+{
+    tau::communications_handling::OutgiongPacketsGenerator & m_outgoingGenerator;
+public:
+    TestDispatcher(tau::communications_handling::OutgiongPacketsGenerator & outgoingGeneratorToUse):
+        tau::util::BasicEventsDispatcher(outgoingGeneratorToUse), m_outgoingGenerator(outgoingGeneratorToUse)
+    {};
+    virtual void packetReceived_clientDeviceInfo(tau::communications_handling::ClientDeviceInfo const & info) {
+        tau_additional::communications_handling::startCompressionIfNegotiated(m_outgoingGenerator, info);
+        if (tau_additional::communications_handling::startBinaryEncodingIfNegotiated(m_outgoingGenerator, info)) {
+            __sync_lock_test_and_set(&g_binaryEncodingStarted, 1);
+        }
+        sendPacket_resetLayout(LAYOUT_JSON);
+    }
+    virtual void packetReceived_buttonClick(tau::common::ElementID const & buttonID) {
+        g_clickedButton = tau_additional::common::getIdString(buttonID);
+        sendPacket_changeElementNote(tau::common::ElementID("STATUS_LABEL"), "Clicked " + g_clickedButton);
+    }
+    virtual void packetReceived_boolValueUpdate(tau::common::ElementID const & inputBoxID, bool value, bool) {
+        sendPacket_updateBooleanValue(inputBoxID, value);
+    }
+    virtual void onConnectionClosed() {
+        if (--g_clientsLeft == 0) {
+            g_server->stop();
+        }
+    }
+};
+
+namespace {
+    template <typename ServerType>
+    class ServerRunner : public StoppableServer
+    {
+        ServerType & m_server;
+    public:
+        explicit ServerRunner(ServerType & server): m_server(server) {};
+        virtual void stop() {
+            m_server.stop();
+        }
+        static void * run(void * server) {
+            static_cast<ServerType *>(server)->run();
+            return NULL;
+        }
+    };
+
+    int connectToServer(unsigned short port) {
+        sockaddr_in address;
+        memset(&address, 0, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        address.sin_port = htons(port);
+        int handle = socket(AF_INET, SOCK_STREAM, 0);
+        timeval timeout;
+        timeout.tv_sec = 5;
+        timeout.tv_usec = 0;
+        setsockopt(handle, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        if (connect(handle, (sockaddr*)(&address), sizeof(address)) == -1) {
+            close(handle);
+            return -1;
+        }
+        return handle;
+    }
+
+    void sendText(int handle, std::string const & data) {
+        send(handle, data.data(), data.size(), MSG_NOSIGNAL);
+    }
+
+    // Moves the first complete binary packet (without its length prefix) from the data to the payload
+    bool takePacket(std::string & data, std::string & payload) {
+        tau_additional::communications_handling::binary_encoding_details::Reader reader(data.data(), data.size());
+        uint64_t payloadSize;
+        if (!reader.readVarint(payloadSize) || payloadSize > reader.getRemainingSize()) {
+            return false;
+        }
+        payload.assign(data, reader.getPosition(), size_t(payloadSize));
+        data.erase(0, reader.getPosition() + size_t(payloadSize));
+        return true;
+    }
+
+    // Receives one binary packet; false on the timeout
+    bool receivePacket(int handle, std::string & received, std::string & payload) {
+        for (;;) {
+            if (takePacket(received, payload)) {
+                return true;
+            }
+            char buffer[4096];
+            ssize_t result = recv(handle, buffer, sizeof(buffer), 0);
+            if (result <= 0) {
+                return false;
+            }
+            received.append(buffer, size_t(result));
+        }
+    }
+
+    // The same, for the compressed stream of the server
+    bool receiveCompressedPacket(int handle, tau_additional::communications_handling::StreamDecompressor & decompressor,
+        std::string & received, std::string & payload)
+    {
+        for (;;) {
+            if (takePacket(received, payload)) {
+                return true;
+            }
+            char buffer[4096];
+            ssize_t result = recv(handle, buffer, sizeof(buffer), 0);
+            if (result <= 0 || !decompressor.decompress(buffer, size_t(result), received)) {
+                return false;
+            }
+        }
+    }
+
+    // Receives the data, till it ends with the '\n' (the text packets)
+    std::string receiveText(int handle) {
+        std::string received;
+        char buffer[4096];
+        while (received.empty() || received[received.size() - 1] != '\n') {
+            ssize_t result = recv(handle, buffer, sizeof(buffer), 0);
+            if (result <= 0) {
+                break;
+            }
+            received.append(buffer, size_t(result));
+        }
+        return received;
+    }
+
+    void checkBinaryClient(unsigned short port, std::string const & serverName) {
+        using tau_additional::communications_handling::BinaryPacketSerializer;
+        int handle = connectToServer(port);
+        check(handle != -1, serverName + ": the binary client is connected");
+        if (handle == -1) {
+            return;
+        }
+        sendText(handle, std::string("info|token=binary;encodings=")
+            + tau_additional::communications_handling::getBinaryEncodingName() + "\n");
+        std::string received;
+        std::string payload;
+        bool resetReceived = receivePacket(handle, received, payload);
+        check(__sync_fetch_and_add(&g_binaryEncodingStarted, 0) != 0,
+            serverName + ": the connection is switched to the binary encoding");
+        check(resetReceived && !payload.empty() && payload[0] == char(BinaryPacketSerializer::RESET_LAYOUT),
+            serverName + ": the layout comes as the binary 'reset layout' packet");
+
+        tau_additional::util::JsonValue decodedLayout;
+        tau_additional::communications_handling::BinaryLayoutDictionary dictionary;
+        bool decoded = !payload.empty() && tau_additional::communications_handling::BinaryLayoutCodec::decode(
+            payload.data() + 1, payload.size() - 1, decodedLayout, &dictionary);
+        tau_additional::util::JsonValue expectedLayout;
+        tau_additional::util::JsonValue::parse(LAYOUT_JSON, expectedLayout);
+        std::string decodedJson;
+        std::string expectedJson;
+        decodedLayout.write(decodedJson);
+        expectedLayout.write(expectedJson);
+        check(decoded && decodedJson == expectedJson,
+            serverName + ": the binary layout is decoded to the layout, which was sent");
+
+        BinaryPacketSerializer serializer(&dictionary);
+        sendText(handle, serializer.buttonClick(tau::common::ElementID("BUTTON_1")));
+        bool noteReceived = receivePacket(handle, received, payload);
+        check(g_clickedButton == "BUTTON_1", serverName + ": the binary click reaches the dispatcher");
+        std::string expectedNote = serializer.changeElementNote(tau::common::ElementID("STATUS_LABEL"), "Clicked BUTTON_1");
+        std::string expectedPayload;
+        takePacket(expectedNote, expectedPayload);
+        check(noteReceived && received.empty() && payload == expectedPayload,
+            serverName + ": the reply note comes as the binary packet with the id from the string table");
+
+        std::string boolUpdate = serializer.boolValueUpdate(tau::common::ElementID("BUTTON_1"), false, false);
+        sendText(handle, boolUpdate);
+        bool boolValueReceived = receivePacket(handle, received, payload);
+        std::string expectedBoolValue = serializer.updateBooleanValue(tau::common::ElementID("BUTTON_1"), false);
+        takePacket(expectedBoolValue, expectedPayload);
+        check(boolUpdate.find('\0') != std::string::npos && boolValueReceived && payload == expectedPayload,
+            serverName + ": the binary packet with the zero byte is not taken for the compressed stream");
+        close(handle);
+    }
+
+    void checkCompressedBinaryClient(unsigned short port, std::string const & serverName) {
+        using tau_additional::communications_handling::BinaryPacketSerializer;
+        int handle = connectToServer(port);
+        check(handle != -1, serverName + ": the compressed binary client is connected");
+        if (handle == -1) {
+            return;
+        }
+        sendText(handle, "info|token=compressed;encodings=" + tau_additional::communications_handling::getCompressionName()
+            + "," + tau_additional::communications_handling::getBinaryEncodingName() + "\n");
+        tau_additional::communications_handling::StreamDecompressor decompressor;
+        std::string received;
+        std::string payload;
+        bool resetReceived = receiveCompressedPacket(handle, decompressor, received, payload);
+        tau_additional::util::JsonValue decodedLayout;
+        tau_additional::communications_handling::BinaryLayoutDictionary dictionary;
+        check(resetReceived && decompressor.isCompressed() && !payload.empty()
+            && payload[0] == char(BinaryPacketSerializer::RESET_LAYOUT)
+            && tau_additional::communications_handling::BinaryLayoutCodec::decode(
+                payload.data() + 1, payload.size() - 1, decodedLayout, &dictionary),
+            serverName + ": the binary layout comes in the compressed stream");
+
+        BinaryPacketSerializer serializer(&dictionary);
+        std::string boolUpdate = serializer.boolValueUpdate(tau::common::ElementID("BUTTON_1"), false, false);
+        sendText(handle, boolUpdate);
+        bool boolValueReceived = receiveCompressedPacket(handle, decompressor, received, payload);
+        std::string expectedBoolValue = serializer.updateBooleanValue(tau::common::ElementID("BUTTON_1"), false);
+        std::string expectedPayload;
+        takePacket(expectedBoolValue, expectedPayload);
+        check(boolUpdate.find('\0') != std::string::npos && boolValueReceived && payload == expectedPayload,
+            serverName + ": the uncompressed binary packet with the zero byte is not taken for the compressed stream");
+
+        tau_additional::communications_handling::StreamCompressor compressor;
+        std::string compressedClick;
+        compressor.appendStreamHeader(compressedClick);
+        std::string click = serializer.buttonClick(tau::common::ElementID("BUTTON_1"));
+        compressor.compress(click.data(), click.size(), compressedClick);
+        g_clickedButton.clear();
+        sendText(handle, compressedClick);
+        bool noteReceived = receiveCompressedPacket(handle, decompressor, received, payload);
+        std::string expectedNote = serializer.changeElementNote(tau::common::ElementID("STATUS_LABEL"), "Clicked BUTTON_1");
+        takePacket(expectedNote, expectedPayload);
+        check(noteReceived && g_clickedButton == "BUTTON_1" && payload == expectedPayload,
+            serverName + ": the client's compressed stream, which starts after the binary packet, is unpacked");
+        close(handle);
+    }
+
+    void checkTextClient(unsigned short port, std::string const & serverName) {
+        int handle = connectToServer(port);
+        check(handle != -1, serverName + ": the text client is connected");
+        if (handle == -1) {
+            return;
+        }
+        sendText(handle, "info|token=text\n");
+        std::string expectedReset = tau_additional::communications_handling::PacketSerializer().resetLayout(LAYOUT_JSON);
+        check(receiveText(handle) == expectedReset,
+            serverName + ": the client, which does not ask for it, gets the text packets");
+        close(handle);
+    }
+
+    // The clients connect one after another; the server stops, when the last one disconnects
+    template <typename ServerType>
+    void checkServer(ServerType & server, unsigned short port, std::string const & serverName) {
+        ServerRunner<ServerType> runner(server);
+        g_server = &runner;
+        g_clientsLeft = 3;
+        __sync_lock_test_and_set(&g_binaryEncodingStarted, 0);
+        g_clickedButton.clear();
+        pthread_t thread;
+        pthread_create(&thread, NULL, &ServerRunner<ServerType>::run, &server);
+        checkBinaryClient(port, serverName);
+        checkCompressedBinaryClient(port, serverName);
+        checkTextClient(port, serverName);
+        pthread_join(thread, NULL);
+        g_server = NULL;
+    }
+};
+
+int main()
+{
+    unsigned short const port = 12361;
+    {
+        tau_additional::util::EpollServerSettings settings;
+        settings.compressionEnabled = true;
+        tau_additional::util::EpollServer<TestDispatcher> server(port, settings);
+        bool started = server.start();
+        check(started, "EpollServer is started");
+        if (started) {
+            checkServer(server, port, "EpollServer");
+        }
+    }
+    {
+        tau_additional::util::IoUringServerSettings settings;
+        settings.compressionEnabled = true;
+        tau_additional::util::IoUringServer<TestDispatcher> server(port, settings);
+        bool started = server.start();
+        if (!started && server.isIoUringUnavailable()) {
+            std::cout << "skipped: IoUringServer (" << server.getLastError() << ")\n";
+        } else {
+            check(started, "IoUringServer is started");
+            if (started) {
+                checkServer(server, port, "IoUringServer");
+            }
+        }
+    }
+    return g_failed ? 1 : 0;
+}
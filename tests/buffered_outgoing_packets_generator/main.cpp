@@ -0,0 +1,99 @@
+// This source file is part of the 'tau' open source project.
+// Copyright (c) 2016, Yuriy Vosel.
+// Licensed under Boost Software License.
+// See LICENSE.txt for the licence information.
+
+// Checks, that the packets, which wait for the stream to end, count for the high water mark of the
+// BufferedOutgoingPacketsGenerator: the client, which reads nothing, keeps the stream (and the packets,
+// sent after it) waiting, and the connection should stop reading the requests. Then the client reads
+// everything: the stream comes first, the packets after it, and the generator goes below the mark.
+// Exits with the non-zero code, if a check fails.
+
+#include <tau_additional/communications_handling/buffered_outgoing_packets_generator.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+namespace {
+    static const size_t HIGH_WATER_MARK = 256 * 1024;
+    static const size_t STREAM_CHUNK_SIZE = 16 * 1024;
+    static const size_t STREAM_CHUNKS_COUNT = 64;
+    static const size_t PACKETS_COUNT = 100;
+
+    bool g_failed = false;
+
+    void check(bool condition, std::string const & description) {
+        std::cout << (condition ? "ok:     " : "FAILED: ") << description << "\n";
+        g_failed = g_failed || !condition;
+    }
+
+    std::string getPacket(size_t index) {
+        std::ostringstream result;
+        result << "NOTE|LABEL_" << index << "|" << std::string(4096, 'x') << "\n";
+        return result.str();
+    }
+
+    // The chunks of the letter 's'
+    class TestStream : public tau_additional::communications_handling::OutgoingDataSource
+    {
+        size_t m_chunksLeft;
+    public:
+        TestStream(): m_chunksLeft(STREAM_CHUNKS_COUNT) {};
+        virtual tau_additional::util::SharedBuffer getNextChunk() {
+            if (m_chunksLeft == 0) {
+                return tau_additional::util::SharedBuffer();
+            }
+            --m_chunksLeft;
+            return tau_additional::util::SharedBuffer(std::string(STREAM_CHUNK_SIZE, 's'));
+        }
+    };
+};
+
+int main()
+{
+    int handles[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, handles) == -1) {
+        std::cout << "FAILED: can't create the socket pair\n";
+        return 1;
+    }
+    fcntl(handles[0], F_SETFL, fcntl(handles[0], F_GETFL) | O_NONBLOCK);
+    std::string expectedData(STREAM_CHUNK_SIZE * STREAM_CHUNKS_COUNT, 's');
+    {
+        tau_additional::communications_handling::BufferedOutgoingPacketsGenerator generator(handles[0], HIGH_WATER_MARK);
+        generator.sendStream(new TestStream());
+        generator.flush(); // the socket buffer is filled, the rest of the stream waits
+        size_t packetsSize = 0;
+        for (size_t i = 0; i < PACKETS_COUNT; ++i) {
+            std::string packet = getPacket(i);
+            generator.sendData(packet);
+            expectedData += packet;
+            packetsSize += packet.size();
+        }
+        check(generator.isStreaming() && generator.getQueuedBytes() < HIGH_WATER_MARK,
+            "the stream is not sent yet, the queue itself is below the high water mark");
+        check(generator.getDeferredBytes() == packetsSize,
+            "the packets, which wait for the stream, are counted as deferred");
+        check(generator.isAboveHighWaterMark(), "the deferred packets count for the high water mark");
+
+        std::string received;
+        char buffer[64 * 1024];
+        while (received.size() < expectedData.size()) {
+            generator.flush();
+            ssize_t result = recv(handles[1], buffer, sizeof(buffer), 0);
+            if (result <= 0) {
+                break;
+            }
+            received.append(buffer, size_t(result));
+        }
+        check(received == expectedData, "the stream comes first, the packets after it");
+        check(!generator.isStreaming() && generator.getDeferredBytes() == 0 && !generator.isAboveHighWaterMark(),
+            "everything is sent: the generator is below the high water mark");
+    }
+    close(handles[0]);
+    close(handles[1]);
+    return g_failed ? 1 : 0;
+}
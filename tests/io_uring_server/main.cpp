@@ -0,0 +1,168 @@
+// This source file is part of the 'tau' open source project.
+// Copyright (c) 2016, Yuriy Vosel.
+// Licensed under Boost Software License.
+// See LICENSE.txt for the licence information.
+
+// Checks the IoUringServer's lifetime: the dispatcher gets the client's address from the accept,
+// stop() from the other thread ends the idle event loop at once, and the destructor closes the open
+// connection (its dispatcher gets onConnectionClosed(), the client gets the end of the stream).
+// Then checks, that the IoUringOrEpollServer can be stopped and given the delayed calls before start().
+// Exits with the non-zero code, if a check fails (or the loop does not stop in 10 seconds).
+
+#include <tau/util/basic_events_dispatcher.h>
+#include <tau_additional/util/io_uring_server.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <string.h>
+#include <time.h>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+namespace {
+    bool g_failed = false;
+    volatile int g_connectedCount = 0;
+    volatile int g_closedCount = 0;
+    std::string g_clientAddress; // written by the server thread before g_connectedCount
+
+    void check(bool condition, std::string const & description) {
+        std::cout << (condition ? "ok:     " : "FAILED: ") << description << "\n";
+        g_failed = g_failed || !condition;
+    }
+
+    void sleepMilliseconds(long milliseconds) {
+        timespec duration;
+        duration.tv_sec = milliseconds / 1000;
+        duration.tv_nsec = (milliseconds % 1000) * 1000000;
+        nanosleep(&duration, NULL);
+    }
+};
+
+class TestDispatcher : public tau::util::BasicEventsDispatcher
+{
+public:
+    TestDispatcher(tau::communications_handling::OutgiongPacketsGenerator & outgoingGeneratorToUse):
+        tau::util::BasicEventsDispatcher(outgoingGeneratorToUse)
+    {};
+    virtual void onClientConnected(tau::communications_handling::ClientConnectionInfo const & info) {
+        g_clientAddress = info.getRemoteAddrDump();
+        __sync_add_and_fetch(&g_connectedCount, 1);
+    }
+    virtual void onConnectionClosed() {
+        __sync_add_and_fetch(&g_closedCount, 1);
+    }
+};
+
+namespace {
+    template <typename ServerType>
+    void * runServer(void * server) {
+        static_cast<ServerType *>(server)->run();
+        return NULL;
+    }
+
+    int connectToServer(unsigned short port) {
+        sockaddr_in address;
+        memset(&address, 0, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        address.sin_port = htons(port);
+        int handle = socket(AF_INET, SOCK_STREAM, 0);
+        timeval timeout;
+        timeout.tv_sec = 5;
+        timeout.tv_usec = 0;
+        setsockopt(handle, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        if (connect(handle, (sockaddr*)(&address), sizeof(address)) == -1) {
+            close(handle);
+            return -1;
+        }
+        return handle;
+    }
+
+    // 'address:port' of the client's end of the connection
+    std::string getLocalAddress(int handle) {
+        sockaddr_in address;
+        socklen_t addressSize = sizeof(address);
+        memset(&address, 0, sizeof(address));
+        getsockname(handle, (sockaddr*)(&address), &addressSize);
+        std::ostringstream result;
+        result << inet_ntoa(address.sin_addr) << ":" << ntohs(address.sin_port);
+        return result.str();
+    }
+
+    // Stops the server from its own thread, when the delayed call is due
+    template <typename ServerType>
+    class StopCall : public tau_additional::communications_handling::DelayedCallsScheduler::Callback
+    {
+        ServerType & m_server;
+    public:
+        explicit StopCall(ServerType & server): m_server(server) {};
+        virtual void onDelayedCall() {
+            m_server.stop();
+        }
+    };
+
+    void checkIoUringServer(unsigned short port) {
+        typedef tau_additional::util::IoUringServer<TestDispatcher> Server;
+        Server * server = new Server(port);
+        if (!server->start()) {
+            if (server->isIoUringUnavailable()) {
+                std::cout << "skipped: IoUringServer (" << server->getLastError() << ")\n";
+            } else {
+                check(false, "IoUringServer is started: " + server->getLastError());
+            }
+            delete server;
+            return;
+        }
+        pthread_t thread;
+        pthread_create(&thread, NULL, &runServer<Server>, server);
+        int handle = connectToServer(port);
+        check(handle != -1, "the client is connected");
+        for (int waited = 0; waited < 5000 && __sync_fetch_and_add(&g_connectedCount, 0) == 0; ++waited) {
+            sleepMilliseconds(1);
+        }
+        check(__sync_fetch_and_add(&g_connectedCount, 0) == 1 && handle != -1
+            && g_clientAddress == getLocalAddress(handle),
+            "the dispatcher gets the client's address and port from the accept");
+        // The loop has nothing to do: it sleeps in io_uring_enter() without the timeout
+        server->stop();
+        pthread_join(thread, NULL);
+        check(true, "stop() from the other thread ends the idle event loop");
+        check(__sync_fetch_and_add(&g_closedCount, 0) == 0, "the connection stays open after the loop is stopped");
+        delete server;
+        check(__sync_fetch_and_add(&g_closedCount, 0) == 1, "the destructor closes the open connection");
+        char buffer[16];
+        check(handle != -1 && recv(handle, buffer, sizeof(buffer), 0) == 0, "the client gets the end of the stream");
+        if (handle != -1) {
+            close(handle);
+        }
+    }
+
+    void checkIoUringOrEpollServer(unsigned short port) {
+        typedef tau_additional::util::IoUringOrEpollServer<TestDispatcher> Server;
+        Server server(port);
+        server.stop(); // not started: nothing happens
+        StopCall<Server> stopCall(server);
+        server.getScheduler().scheduleDelayedCall(stopCall, 0);
+        bool started = server.start();
+        check(started, std::string("IoUringOrEpollServer is started (")
+            + (server.isIoUringUsed() ? "io_uring" : "epoll") + ")");
+        if (started) {
+            // The delayed call, which was scheduled before start(), stops the loop
+            server.run();
+            check(true, "the delayed call, which was scheduled before start(), is executed by the chosen server");
+        }
+    }
+};
+
+int main()
+{
+    alarm(10); // the loop, which is not stopped, fails the test
+    checkIoUringServer(12362);
+    checkIoUringOrEpollServer(12363);
+    return g_failed ? 1 : 0;
+}
@@ -0,0 +1,121 @@
+// This source file is part of the 'tau' open source project.
+// Copyright (c) 2016, Yuriy Vosel.
+// Licensed under Boost Software License.
+// See LICENSE.txt for the licence information.
+
+// Checks, that the pooled connection, which is closed with the coalesced updates still pending, is destroyed
+// cleanly: the CoalescingElementUpdatesSender of its dispatcher cancels its delayed call, when it is destroyed,
+// and the connection's scheduler should still be alive then. The call on the destroyed scheduler is caught
+// by the -fsanitize=vptr check (see compile_gcc.sh), which stops the test.
+// Exits with the non-zero code, if a check fails (or the connections are not destroyed in 10 seconds).
+
+#include <tau/util/basic_events_dispatcher.h>
+#include <tau_additional/util/pooled_boost_asio_server.h>
+#include <tau_additional/communications_handling/coalescing_element_updates_sender.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <string.h>
+#include <iostream>
+#include <string>
+
+namespace {
+    static const unsigned short PORT = 12366;
+    static const int CLIENTS_COUNT = 4;
+    char const REQUEST[] = "text|TEXT_INPUT|new value\n";
+
+    bool g_failed = false;
+    int g_dispatchersDestroyed = 0;
+
+    void check(bool condition, std::string const & description) {
+        std::cout << (condition ? "ok:     " : "FAILED: ") << description << "\n";
+        g_failed = g_failed || !condition;
+    }
+};
+
+// Requests the coalesced update and closes the connection in the same handler: the update is still pending,
+// when the connection is destroyed
+class TestDispatcher : public tau::util::BasicEventsDispatcher
+{
+    tau::communications_handling::OutgiongPacketsGenerator & m_connection;
+    tau_additional::communications_handling::CoalescingElementUpdatesSender m_elementUpdates;
+public:
+    TestDispatcher(tau::communications_handling::OutgiongPacketsGenerator & outgoingGeneratorToUse):
+        tau::util::BasicEventsDispatcher(outgoingGeneratorToUse),
+        m_connection(outgoingGeneratorToUse),
+        m_elementUpdates(outgoingGeneratorToUse)
+    {};
+    virtual ~TestDispatcher() {
+        __sync_add_and_fetch(&g_dispatchersDestroyed, 1);
+    }
+    virtual void packetReceived_textValueUpdate(tau::common::ElementID const & inputBoxID, std::string const & value,
+        bool isAutomaticUpdate)
+    {
+        m_elementUpdates.changeElementNote(tau::common::ElementID("STATUS_LABEL"), value);
+        m_elementUpdates.updateTextValue(inputBoxID, value);
+        m_connection.close_connection();
+    }
+};
+
+namespace {
+    void * runPool(void * pool) {
+        static_cast<tau_additional::util::IoServicePool *>(pool)->run();
+        return NULL;
+    }
+
+    int connectToServer(unsigned short port) {
+        sockaddr_in address;
+        memset(&address, 0, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        address.sin_port = htons(port);
+        int handle = socket(AF_INET, SOCK_STREAM, 0);
+        if (connect(handle, (sockaddr*)(&address), sizeof(address)) == -1) {
+            close(handle);
+            return -1;
+        }
+        return handle;
+    }
+
+    // Sends the request and waits, until the server closes the connection
+    bool sendAndWaitForClose(int handle) {
+        send(handle, REQUEST, sizeof(REQUEST) - 1, MSG_NOSIGNAL);
+        char buffer[256];
+        ssize_t result = 0;
+        do {
+            result = recv(handle, buffer, sizeof(buffer), 0);
+        } while (result > 0);
+        return result == 0;
+    }
+};
+
+int main()
+{
+    alarm(10); // the connections, which are not destroyed, fail the test
+    tau_additional::util::IoServicePool pool(2);
+    tau_additional::util::PooledBoostAsioServer<TestDispatcher> server(pool, PORT);
+    server.start();
+    pthread_t thread;
+    pthread_create(&thread, NULL, &runPool, &pool);
+
+    bool closed = true;
+    for (int i = 0; i < CLIENTS_COUNT; ++i) {
+        int handle = connectToServer(PORT);
+        closed = closed && handle != -1 && sendAndWaitForClose(handle);
+        if (handle != -1) {
+            close(handle);
+        }
+    }
+    check(closed, "the server closes the connections with the pending updates");
+    while (__sync_add_and_fetch(&g_dispatchersDestroyed, 0) < CLIENTS_COUNT) {
+        usleep(1000);
+    }
+    check(true, "the connections with the pending updates are destroyed");
+
+    pool.stop();
+    pthread_join(thread, NULL);
+    return g_failed ? 1 : 0;
+}
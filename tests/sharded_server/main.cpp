@@ -0,0 +1,171 @@
+// This source file is part of the 'tau' open source project.
+// Copyright (c) 2016, Yuriy Vosel.
+// Licensed under Boost Software License.
+// See LICENSE.txt for the licence information.
+
+// Checks the ShardedServer (two shards, with the EpollServer and with the IoUringOrEpollServer):
+// every shard records the metrics of its own connections in its own MetricsRegistry, the process-wide
+// snapshot sums them, and stop() from the other thread wakes all the shards up at once (before,
+// the shards polled the stop flag every 100 ms).
+// Exits with the non-zero code, if a check fails (or the loops do not stop in 10 seconds).
+
+#include <tau/util/basic_events_dispatcher.h>
+#include <tau_additional/util/epoll_server.h>
+#include <tau_additional/util/io_uring_server.h>
+#include <tau_additional/util/metered_events_dispatcher.h>
+#include <tau_additional/util/metrics.h>
+#include <tau_additional/util/monotonic_clock.h>
+#include <tau_additional/util/sharded_server.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <string.h>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+    static const size_t CLIENTS_COUNT = 8;
+    char const REQUEST[] = "info|token=sharded\n";
+
+    bool g_failed = false;
+
+    void check(bool condition, std::string const & description) {
+        std::cout << (condition ? "ok:     " : "FAILED: ") << description << "\n";
+        g_failed = g_failed || !condition;
+    }
+};
+
+// Replies with a note to the device info
+class TestDispatcher : public tau::util::BasicEventsDispatcher
+{
+public:
+    TestDispatcher(tau::communications_handling::OutgiongPacketsGenerator & outgoingGeneratorToUse):
+        tau::util::BasicEventsDispatcher(outgoingGeneratorToUse)
+    {};
+    virtual void packetReceived_clientDeviceInfo(tau::communications_handling::ClientDeviceInfo const & info) {
+        sendPacket_changeElementNote(tau::common::ElementID("STATUS_LABEL"), "connected");
+    }
+};
+
+typedef tau_additional::util::MeteredEventsDispatcher<TestDispatcher> Dispatcher;
+
+namespace {
+    template <typename ServerType>
+    void * runServer(void * server) {
+        static_cast<ServerType *>(server)->run();
+        return NULL;
+    }
+
+    int connectToServer(unsigned short port) {
+        sockaddr_in address;
+        memset(&address, 0, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        address.sin_port = htons(port);
+        int handle = socket(AF_INET, SOCK_STREAM, 0);
+        timeval timeout;
+        timeout.tv_sec = 5;
+        timeout.tv_usec = 0;
+        setsockopt(handle, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        if (connect(handle, (sockaddr*)(&address), sizeof(address)) == -1) {
+            close(handle);
+            return -1;
+        }
+        return handle;
+    }
+
+    // Sends the device info and waits for the reply: the request is processed by the shard
+    bool exchange(int handle) {
+        send(handle, REQUEST, sizeof(REQUEST) - 1, MSG_NOSIGNAL);
+        char buffer[256];
+        ssize_t result = recv(handle, buffer, sizeof(buffer), 0);
+        return result > 0 && buffer[result - 1] == '\n';
+    }
+
+    uint64_t getCounterValue(tau_additional::util::MetricsRegistry & registry, std::string const & name) {
+        return registry.getCounter(name).getValue();
+    }
+
+    template <typename ServerType, typename SettingsType>
+    void checkServer(unsigned short port, std::string const & serverName) {
+        typedef tau_additional::util::ShardedServer<ServerType, SettingsType> Server;
+        Server server(port, SettingsType(), 2, false);
+        bool started = server.start();
+        check(started, serverName + ": the shards are started");
+        if (!started) {
+            std::cout << server.getLastError() << "\n";
+            return;
+        }
+        pthread_t thread;
+        pthread_create(&thread, NULL, &runServer<Server>, &server);
+        std::vector<int> handles;
+        bool exchanged = true;
+        for (size_t i = 0; i < CLIENTS_COUNT; ++i) {
+            int handle = connectToServer(port);
+            exchanged = exchanged && handle != -1 && exchange(handle);
+            handles.push_back(handle);
+        }
+        check(exchanged, serverName + ": every client gets the reply");
+
+        bool shardsMetricsMatch = true;
+        uint64_t packetsReceived = 0;
+        for (size_t i = 0; i < server.getShardsCount(); ++i) {
+            tau_additional::util::MetricsRegistry & metrics = server.getShardMetrics(i);
+            uint64_t accepted = server.getShardAcceptedConnectionsCount(i);
+            uint64_t shardPackets = getCounterValue(metrics, "packets_received.clientDeviceInfo");
+            shardsMetricsMatch = shardsMetricsMatch && shardPackets == accepted
+                && getCounterValue(metrics, "incoming_data.bytes") == accepted * (sizeof(REQUEST) - 1);
+            packetsReceived += shardPackets;
+        }
+        check(shardsMetricsMatch && packetsReceived == CLIENTS_COUNT,
+            serverName + ": every shard records the metrics of its own connections");
+        check(getCounterValue(tau_additional::util::MetricsRegistry::getInstance(),
+            "packets_received.clientDeviceInfo") == 0,
+            serverName + ": the shards do not update the process-wide counters");
+
+        std::ostringstream snapshot;
+        tau_additional::util::MetricsRegistry::getInstance().writeSnapshot(snapshot);
+        std::ostringstream expectedPackets;
+        expectedPackets << "counter packets_received.clientDeviceInfo " << CLIENTS_COUNT << "\n";
+        std::ostringstream expectedConnections;
+        expectedConnections << "counter connections.active " << CLIENTS_COUNT << "\n";
+        check(snapshot.str().find(expectedPackets.str()) != std::string::npos
+            && snapshot.str().find(expectedConnections.str()) != std::string::npos,
+            serverName + ": the process-wide snapshot sums the shards' metrics");
+
+        // The shards' loops are idle: nothing but the stop() wakes them up
+        uint64_t stopStart = tau_additional::util::getMonotonicNanoseconds();
+        server.stop();
+        pthread_join(thread, NULL);
+        uint64_t stopTime = tau_additional::util::getMonotonicNanoseconds() - stopStart;
+        std::ostringstream stopDescription;
+        stopDescription << serverName << ": stop() wakes the shards up at once (" << stopTime / 1000 << " us)";
+        check(stopTime < uint64_t(50) * 1000000, stopDescription.str());
+        for (size_t i = 0; i < handles.size(); ++i) {
+            if (handles[i] != -1) {
+                close(handles[i]);
+            }
+        }
+    }
+};
+
+int main()
+{
+    alarm(10); // the loop, which is not stopped, fails the test
+    tau_additional::util::enableDataPathMetrics();
+    checkServer<tau_additional::util::EpollServer<Dispatcher>, tau_additional::util::EpollServerSettings>(
+        12364, "EpollServer");
+    checkServer<tau_additional::util::IoUringOrEpollServer<Dispatcher>, tau_additional::util::IoUringServerSettings>(
+        12365, "IoUringOrEpollServer");
+    std::ostringstream snapshot;
+    tau_additional::util::MetricsRegistry::getInstance().writeSnapshot(snapshot);
+    check(snapshot.str().find("counter connections.active 0\n") != std::string::npos,
+        "the destroyed shards' metrics are not in the snapshot");
+    return g_failed ? 1 : 0;
+}
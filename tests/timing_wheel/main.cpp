@@ -0,0 +1,83 @@
+// This source file is part of the 'tau' open source project.
+// Copyright (c) 2016, Yuriy Vosel.
+// Licensed under Boost Software License.
+// See LICENSE.txt for the licence information.
+
+// Checks, when the TimingWheel timers fire: the ones, which are due at once (the delay 0, the
+// deadline in the past), fire on the immediate advance(); the future ones - never early.
+// Exits with the non-zero code, if any check fails.
+
+#include <tau_additional/util/timing_wheel.h>
+#include <iostream>
+
+namespace {
+    uint64_t const MILLISECOND = 1000000;
+    int g_failures = 0;
+
+    void check(bool condition, char const * description) {
+        std::cout << (condition ? "ok:     " : "FAILED: ") << description << "\n";
+        if (!condition) {
+            ++g_failures;
+        }
+    }
+
+    class CountingTimer : public tau_additional::util::TimingWheel::Timer
+    {
+    public:
+        size_t m_firedCount;
+        CountingTimer(): m_firedCount(0) {};
+        virtual void onTimerExpired() {
+            ++m_firedCount;
+        }
+    };
+
+    class CountingCallback : public tau_additional::communications_handling::DelayedCallsScheduler::Callback
+    {
+    public:
+        size_t m_calledCount;
+        CountingCallback(): m_calledCount(0) {};
+        virtual void onDelayedCall() {
+            ++m_calledCount;
+        }
+    };
+};
+
+int main()
+{
+    // The start time is not on the tick boundary: the rounding up of the deadline would delay the timer
+    uint64_t now = 1000 * MILLISECOND + MILLISECOND / 2;
+    {
+        tau_additional::util::TimingWheel wheel(MILLISECOND, now);
+        CountingTimer timer;
+        wheel.schedule(timer, now);
+        check(wheel.getNextWakeUpTime() <= now, "the timer with the delay 0 wakes the loop up at once");
+        wheel.advance(now);
+        check(timer.m_firedCount == 1, "the timer with the delay 0 fires on the immediate advance(now)");
+    }
+    {
+        tau_additional::util::TimingWheel wheel(MILLISECOND, now);
+        CountingTimer timer;
+        wheel.schedule(timer, now - 5 * MILLISECOND);
+        wheel.advance(now);
+        check(timer.m_firedCount == 1, "the timer with the deadline in the past fires on the immediate advance(now)");
+    }
+    {
+        tau_additional::util::TimingWheel wheel(MILLISECOND, now);
+        CountingTimer timer;
+        wheel.schedule(timer, now + 3 * MILLISECOND);
+        wheel.advance(now);
+        wheel.advance(now + 2 * MILLISECOND);
+        check(timer.m_firedCount == 0, "the future timer does not fire early");
+        wheel.advance(now + 4 * MILLISECOND);
+        check(timer.m_firedCount == 1, "the future timer fires after its deadline");
+    }
+    {
+        tau_additional::util::TimingWheel wheel(MILLISECOND);
+        tau_additional::util::TimingWheelCallsScheduler scheduler(wheel);
+        CountingCallback callback;
+        scheduler.scheduleDelayedCall(callback, 0);
+        wheel.advance(wheel.getCurrentNanoseconds());
+        check(callback.m_calledCount == 1, "the delayed call with the delay 0 runs on the immediate advance()");
+    }
+    return (g_failures == 0) ? 0 : 1;
+}
@@ -0,0 +1,169 @@
+// This source file is part of the 'tau' open source project.
+// Copyright (c) 2016, Yuriy Vosel.
+// Licensed under Boost Software License.
+// See LICENSE.txt for the licence information.
+
+// Checks the TrafficCapture: the records of several threads, which write at once, are all in the file
+// and in order; the write, which fails (the file size limit is hit), does not turn the capture off:
+// the data, which was not written, is written by the next flush(), and the file is read back whole.
+// Exits with the non-zero code, if a check fails.
+
+#include <tau_additional/communications_handling/traffic_capture.h>
+#include <sys/resource.h>
+#include <pthread.h>
+#include <signal.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+    static const size_t THREADS_COUNT = 4;
+    static const size_t RECORDS_PER_THREAD = 20000;
+
+    bool g_failed = false;
+
+    void check(bool condition, std::string const & description) {
+        std::cout << (condition ? "ok:     " : "FAILED: ") << description << "\n";
+        g_failed = g_failed || !condition;
+    }
+
+    std::string getRecordData(size_t index) {
+        std::ostringstream result;
+        result << "click|BUTTON_" << index << "\n";
+        return result.str();
+    }
+
+    struct Writer
+    {
+        tau_additional::communications_handling::TrafficCapture * capture;
+        uint64_t connectionID;
+        pthread_t thread;
+    };
+
+    void * writeRecords(void * writerPointer) {
+        Writer & writer = *static_cast<Writer *>(writerPointer);
+        for (size_t i = 0; i < RECORDS_PER_THREAD; ++i) {
+            std::string data = getRecordData(i);
+            writer.capture->incomingData(writer.connectionID, data.data(), data.size());
+        }
+        return NULL;
+    }
+
+    // Checks, that every connection's records are all there and in order; returns the records count
+    size_t readCapture(std::string const & path, std::vector<size_t> & recordsPerConnection, bool & ordered,
+        bool & truncated)
+    {
+        tau_additional::communications_handling::TrafficCaptureReader reader;
+        if (!reader.open(path)) {
+            std::cout << reader.getLastError() << "\n";
+            return 0;
+        }
+        tau_additional::communications_handling::TrafficCaptureReader::Record record;
+        size_t result = 0;
+        ordered = true;
+        while (reader.next(record)) {
+            ++result;
+            if (record.type != tau_additional::communications_handling::TRAFFIC_INCOMING_DATA) {
+                continue;
+            }
+            if (record.connectionID >= recordsPerConnection.size()) {
+                recordsPerConnection.resize(size_t(record.connectionID) + 1, 0);
+            }
+            size_t & index = recordsPerConnection[size_t(record.connectionID)];
+            ordered = ordered && std::string(record.data, record.size) == getRecordData(index);
+            ++index;
+        }
+        truncated = reader.isTruncated();
+        return result;
+    }
+
+    void checkConcurrentWriters(std::string const & path) {
+        tau_additional::communications_handling::TrafficCapture capture;
+        check(capture.open(path), "the capture is opened: " + capture.getLastError());
+        std::vector<Writer> writers(THREADS_COUNT);
+        for (size_t i = 0; i < writers.size(); ++i) {
+            writers[i].capture = &capture;
+            writers[i].connectionID = capture.connectionOpened();
+            pthread_create(&writers[i].thread, NULL, &writeRecords, &writers[i]);
+        }
+        for (size_t i = 0; i < writers.size(); ++i) {
+            pthread_join(writers[i].thread, NULL);
+            capture.connectionClosed(writers[i].connectionID);
+        }
+        capture.close();
+        tau_additional::communications_handling::TrafficCapture::Statistics statistics = capture.getStatistics();
+        size_t expectedRecords = THREADS_COUNT * (RECORDS_PER_THREAD + 2);
+        check(statistics.records == expectedRecords && statistics.writeFailures == 0,
+            "all the records of the threads, which write at once, are written");
+
+        std::vector<size_t> recordsPerConnection;
+        bool ordered = false;
+        bool truncated = true;
+        size_t recordsRead = readCapture(path, recordsPerConnection, ordered, truncated);
+        bool complete = recordsRead == expectedRecords && !truncated;
+        for (size_t i = 0; i < writers.size(); ++i) {
+            complete = complete && recordsPerConnection.size() > writers[i].connectionID
+                && recordsPerConnection[size_t(writers[i].connectionID)] == RECORDS_PER_THREAD;
+        }
+        check(complete && ordered, "every thread's records are read back in order");
+    }
+
+    void checkFailedWrite(std::string const & path) {
+        signal(SIGXFSZ, SIG_IGN); // the write() over the limit fails with EFBIG instead
+        rlimit originalLimit;
+        getrlimit(RLIMIT_FSIZE, &originalLimit);
+
+        tau_additional::communications_handling::TrafficCapture capture;
+        check(capture.open(path), "the capture is opened: " + capture.getLastError());
+        uint64_t connectionID = capture.connectionOpened();
+        capture.flush();
+        rlimit limit = originalLimit;
+        limit.rlim_cur = 100; // the header and the first record fit, a part of the next ones too
+        setrlimit(RLIMIT_FSIZE, &limit);
+        for (size_t i = 0; i < 10; ++i) {
+            std::string data = getRecordData(i);
+            capture.incomingData(connectionID, data.data(), data.size());
+        }
+        bool flushed = capture.flush();
+        check(!flushed && !capture.getLastError().empty(), "the write over the file size limit fails: "
+            + capture.getLastError());
+
+        setrlimit(RLIMIT_FSIZE, &originalLimit);
+        for (size_t i = 10; i < 20; ++i) {
+            std::string data = getRecordData(i);
+            capture.incomingData(connectionID, data.data(), data.size());
+        }
+        capture.connectionClosed(connectionID);
+        flushed = capture.flush();
+        check(flushed && capture.getLastError().empty(), "the next write succeeds and clears the error");
+        capture.close();
+        tau_additional::communications_handling::TrafficCapture::Statistics statistics = capture.getStatistics();
+        check(statistics.records == 22 && statistics.writeFailures == 0, "no records are lost");
+
+        std::vector<size_t> recordsPerConnection;
+        bool ordered = false;
+        bool truncated = true;
+        size_t recordsRead = readCapture(path, recordsPerConnection, ordered, truncated);
+        check(recordsRead == 22 && !truncated && ordered && recordsPerConnection.size() > connectionID
+            && recordsPerConnection[size_t(connectionID)] == 20,
+            "the data, which failed to be written, is written first: the file is read back whole");
+    }
+};
+
+int main()
+{
+    char path[] = "/tmp/tau_traffic_capture_testXXXXXX";
+    int handle = mkstemp(path);
+    if (handle == -1) {
+        std::cout << "FAILED: can't create the temporary file\n";
+        return 1;
+    }
+    close(handle);
+    checkConcurrentWriters(path);
+    checkFailedWrite(path);
+    unlink(path);
+    return g_failed ? 1 : 0;
+}
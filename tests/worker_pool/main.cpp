@@ -0,0 +1,75 @@
+// This source file is part of the 'tau' open source project.
+// Copyright (c) 2016, Yuriy Vosel.
+// Licensed under Boost Software License.
+// See LICENSE.txt for the licence information.
+
+// Checks, that the SerialTaskQueue, which never runs out of the tasks, does not starve the other
+// queue on the same worker: the pool has one thread, the first queue's every task adds the next one,
+// until the second queue's task runs (or the time is out).
+// Exits with the non-zero code, if the check fails.
+
+#include <tau_additional/util/worker_pool.h>
+#include <time.h>
+#include <iostream>
+
+namespace {
+    volatile int g_busyQueueStopped = 0;
+    volatile int g_otherQueueRan = 0;
+    volatile size_t g_busyTasksRun = 0;
+
+    // Adds the next task to its queue, until it is told to stop
+    class BusyTask : public tau_additional::util::SerialTaskQueue::Task
+    {
+        tau_additional::util::SerialTaskQueue & m_queue;
+    public:
+        explicit BusyTask(tau_additional::util::SerialTaskQueue & queue): m_queue(queue) {};
+        virtual void run() {
+            __sync_add_and_fetch(&g_busyTasksRun, 1);
+            if (__sync_fetch_and_add(&g_busyQueueStopped, 0) == 0) {
+                m_queue.add(new BusyTask(m_queue));
+            }
+        }
+    };
+
+    class OtherTask : public tau_additional::util::SerialTaskQueue::Task
+    {
+    public:
+        virtual void run() {
+            __sync_lock_test_and_set(&g_otherQueueRan, 1);
+            __sync_lock_test_and_set(&g_busyQueueStopped, 1);
+        }
+    };
+
+    void sleepMilliseconds(long milliseconds) {
+        timespec duration;
+        duration.tv_sec = milliseconds / 1000;
+        duration.tv_nsec = (milliseconds % 1000) * 1000000;
+        nanosleep(&duration, NULL);
+    }
+};
+
+int main()
+{
+    tau_additional::util::WorkerPool pool(1);
+    tau_additional::util::SerialTaskQueue * busyQueue = tau_additional::util::SerialTaskQueue::create(pool);
+    tau_additional::util::SerialTaskQueue * otherQueue = tau_additional::util::SerialTaskQueue::create(pool);
+    busyQueue->add(new BusyTask(*busyQueue));
+    // The busy queue occupies the worker before the other one gets its task
+    while (__sync_fetch_and_add(&g_busyTasksRun, 0) < 1000) {
+        sleepMilliseconds(1);
+    }
+    otherQueue->add(new OtherTask());
+    for (int waited = 0; waited < 5000 && !__sync_fetch_and_add(&g_otherQueueRan, 0); ++waited) {
+        sleepMilliseconds(1);
+    }
+    bool otherQueueRan = (__sync_fetch_and_add(&g_otherQueueRan, 0) != 0);
+    __sync_lock_test_and_set(&g_busyQueueStopped, 1);
+    std::cout << (otherQueueRan ? "ok:     " : "FAILED: ")
+        << "two serial queues on one worker both make progress (the busy queue ran "
+        << __sync_fetch_and_add(&g_busyTasksRun, 0) << " tasks)\n";
+    // Let the busy queue drain, before the pool is destroyed
+    sleepMilliseconds(100);
+    busyQueue->release();
+    otherQueue->release();
+    return otherQueueRan ? 0 : 1;
+}